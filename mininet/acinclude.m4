@@ -268,6 +268,40 @@ AC_DEFUN([OFP_CHECK_IF_PACKET],
                 [Define to 1 if net/if_packet.h is available.])
    fi])
 
+dnl Checks for --enable-stage-timers, which compiles the per-stage
+dnl datapath latency histograms into ofdatapath.
+AC_DEFUN([OFP_CHECK_STAGE_TIMERS],
+  [AC_ARG_ENABLE(
+     [stage-timers],
+     [AC_HELP_STRING([--enable-stage-timers],
+                     [Time the datapath pipeline stages (switched on at
+                      run time with --stage-timers or dpctl stats-stages)])],
+     [case "${enableval}" in
+        (yes) stage_timers=true ;;
+        (no)  stage_timers=false ;;
+        (*) AC_MSG_ERROR([bad value ${enableval} for --enable-stage-timers]) ;;
+      esac],
+     [stage_timers=false])
+   AM_CONDITIONAL([STAGE_TIMERS], [test x$stage_timers = xtrue])])
+
+dnl Checks for --enable-dp-log, the most verbose level of the log messages
+dnl compiled into the datapath.
+AC_DEFUN([OFP_CHECK_DP_LOG],
+  [AC_ARG_ENABLE(
+     [dp-log],
+     [AC_HELP_STRING([--enable-dp-log=dbg|info|warn],
+                     [Most verbose log level compiled into the datapath;
+                      info or warn remove the cost of the messages below
+                      it from the forwarding path (default: dbg)])],
+     [case "${enableval}" in
+        (yes|dbg) DP_LOG_CPPFLAGS= ;;
+        (info) DP_LOG_CPPFLAGS=-DVLOG_MAX_LEVEL=VLL_INFO ;;
+        (warn) DP_LOG_CPPFLAGS=-DVLOG_MAX_LEVEL=VLL_WARN ;;
+        (*) AC_MSG_ERROR([bad value ${enableval} for --enable-dp-log]) ;;
+      esac],
+     [DP_LOG_CPPFLAGS=])
+   AC_SUBST([DP_LOG_CPPFLAGS])])
+
 dnl Checks for dpkg-buildpackage.  If this is available then we check
 dnl that the Debian packaging is functional at "make distcheck" time.
 AC_DEFUN([OFP_CHECK_DPKG_BUILDPACKAGE],
@@ -0,0 +1,21 @@
+#
+# Datapath micro-benchmarks, built and run by "make bench"
+#
+
+EXTRA_PROGRAMS += bench/ofbench
+CLEANFILES += bench/ofbench
+
+# The benchmarks link the whole datapath, without its main().
+bench_ofbench_SOURCES = \
+	$(udatapath_ofdatapath_SOURCES) \
+	bench/ofbench.c
+
+bench_ofbench_LDADD = $(udatapath_ofdatapath_LDADD)
+bench_ofbench_CPPFLAGS = $(AM_CPPFLAGS) $(DP_LOG_CPPFLAGS) -DUDATAPATH_AS_LIB
+# Allocations are counted by wrapping the allocator.
+bench_ofbench_LDFLAGS = -Wl,--wrap=malloc -Wl,--wrap=calloc -Wl,--wrap=realloc
+nodist_EXTRA_bench_ofbench_SOURCES = dummy.cxx
+
+.PHONY: bench
+bench: bench/ofbench
+	bench/ofbench $(BENCHFLAGS)
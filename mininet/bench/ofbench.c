@@ -0,0 +1,1094 @@
+/* Copyright (c) 2011, TrafficLab, Ericsson Research, Hungary
+ * Copyright (c) 2012, CPqD, Brazil 
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Ericsson Research nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Micro-benchmarks for the datapath hot paths.
+ *
+ * Every benchmark is a single operation run in a loop for a calibrated
+ * number of iterations; the result is reported as nanoseconds and heap
+ * allocations per operation, at several table sizes where the cost depends
+ * on them. Allocations are counted by wrapping malloc(), calloc() and
+ * realloc() at link time (see bench/automake.mk), so they include every
+ * xmalloc() in the switch code but not the allocations done inside libc
+ * or the C++ runtime.
+ *
+ * With --csv the results are printed as comma-separated values, which can be
+ * saved and given back with --baseline: every result is then compared to the
+ * one of the same benchmark and size in the baseline, and ofbench exits with
+ * a failure status if any of them takes longer than the tolerance allows or
+ * allocates more. */
+
+#include <config.h>
+#include <arpa/inet.h>
+#include <errno.h>
+#include <getopt.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "command-line.h"
+#include "compiler.h"
+#include "dynamic-string.h"
+#include "hmap.h"
+#include "ofpbuf.h"
+#include "packets.h"
+#include "timeval.h"
+#include "util.h"
+#include "vlog.h"
+#include "oflib/ofl-actions.h"
+#include "oflib/ofl-messages.h"
+#include "oflib/ofl-structs.h"
+#include "oflib/oxm-match.h"
+#include "nbee_link/nbee_link.h"
+#include "udatapath/datapath.h"
+#include "udatapath/dp_ports.h"
+#include "udatapath/flow_table.h"
+#include "udatapath/packet.h"
+#include "udatapath/packet_handle_std.h"
+#include "udatapath/pipeline.h"
+
+/* Allocation counting. */
+
+void *__real_malloc(size_t);
+void *__real_calloc(size_t, size_t);
+void *__real_realloc(void *, size_t);
+void *__wrap_malloc(size_t);
+void *__wrap_calloc(size_t, size_t);
+void *__wrap_realloc(void *, size_t);
+
+static unsigned long long int n_allocs;
+
+void *
+__wrap_malloc(size_t size) {
+    n_allocs++;
+    return __real_malloc(size);
+}
+
+void *
+__wrap_calloc(size_t n, size_t size) {
+    n_allocs++;
+    return __real_calloc(n, size);
+}
+
+void *
+__wrap_realloc(void *p, size_t size) {
+    n_allocs++;
+    return __real_realloc(p, size);
+}
+
+/* Harness. */
+
+typedef void bench_op_func(void *aux, unsigned int i);
+typedef void bench_reset_func(void *aux);
+
+static long long int budget_ns = 200 * 1000 * 1000;
+static const char *filter;
+static bool csv;
+
+/* A result read from the --baseline file. */
+struct baseline {
+    char *name;
+    size_t size;
+    double ns;
+    double allocs;
+};
+
+static struct baseline *baselines;
+static size_t n_baselines;
+static double tolerance = 10.0;     /* Percent. */
+static unsigned int n_regressions;
+
+static bool
+bench_selected(const char *name) {
+    return filter == NULL || strstr(name, filter) != NULL;
+}
+
+static const struct baseline *
+baseline_find(const char *name, size_t size) {
+    size_t i;
+
+    for (i = 0; i < n_baselines; i++) {
+        if (baselines[i].size == size && !strcmp(baselines[i].name, name)) {
+            return &baselines[i];
+        }
+    }
+    return NULL;
+}
+
+/* Reads the results of an earlier "ofbench --csv" run from 'file_name'. */
+static void
+baseline_read(const char *file_name) {
+    struct ds line = DS_EMPTY_INITIALIZER;
+    size_t allocated = 0;
+    int line_no = 0;
+    FILE *file;
+
+    file = fopen(file_name, "r");
+    if (file == NULL) {
+        ofp_fatal(errno, "%s: open failed", file_name);
+    }
+    while (!ds_get_line(&line, file)) {
+        struct baseline b;
+        char name[64];
+
+        line_no++;
+        if (line_no == 1 && !strncmp(ds_cstr(&line), "benchmark,", 10)) {
+            continue;
+        }
+        if (sscanf(ds_cstr(&line), "%63[^,],%zu,%lf,%lf",
+                   name, &b.size, &b.ns, &b.allocs) != 4) {
+            ofp_fatal(0, "%s:%d: cannot parse baseline result",
+                      file_name, line_no);
+        }
+        if (n_baselines >= allocated) {
+            baselines = x2nrealloc(baselines, &allocated, sizeof *baselines);
+        }
+        b.name = xstrdup(name);
+        baselines[n_baselines++] = b;
+    }
+    ds_destroy(&line);
+    fclose(file);
+}
+
+/* Prints a result and, with a baseline, compares it. */
+static void
+bench_report(const char *name, size_t size, double ns, double allocs,
+             unsigned int n) {
+    const struct baseline *b = baseline_find(name, size);
+    bool regression = false;
+    double delta = 0.0;
+
+    if (b != NULL) {
+        delta = b->ns > 0 ? (ns - b->ns) * 100.0 / b->ns : 0.0;
+        /* Allocations do not depend on the machine load; any more of them
+         * is a regression. */
+        regression = delta > tolerance || allocs > b->allocs + 0.005;
+    }
+    if (csv) {
+        printf("%s,%zu,%.1f,%.2f,%u\n", name, size, ns, allocs, n);
+    } else if (b != NULL) {
+        printf("%-28s %7zu %12.1f %10.2f %12u %+7.1f%%%s\n", name, size,
+               ns, allocs, n, delta, regression ? "  REGRESSION" : "");
+    } else {
+        printf("%-28s %7zu %12.1f %10.2f %12u\n", name, size, ns, allocs, n);
+    }
+    fflush(stdout);
+
+    if (regression) {
+        fprintf(stderr, "%s: %s/%zu regressed: %.1f ns/op and %.2f allocs/op, "
+                "baseline %.1f and %.2f\n", program_name, name, size, ns,
+                allocs, b->ns, b->allocs);
+        n_regressions++;
+    }
+}
+
+/* Runs 'op' with an increasing number of iterations until one run takes at
+ * least the time budget, and reports that run. 'reset', if nonnull, brings
+ * 'aux' back to its initial state before every run and is not timed. */
+static void
+bench_run(const char *name, size_t size, bench_op_func *op,
+          bench_reset_func *reset, void *aux) {
+    unsigned long long int allocs;
+    long long int elapsed, start;
+    unsigned int n = 1;
+    unsigned int i;
+
+    if (!bench_selected(name)) {
+        return;
+    }
+    for (;;) {
+        unsigned long long int next;
+
+        if (reset != NULL) {
+            reset(aux);
+        }
+        allocs = n_allocs;
+        start = time_nsec();
+        for (i = 0; i < n; i++) {
+            op(aux, i);
+        }
+        elapsed = time_nsec() - start;
+        allocs = n_allocs - allocs;
+
+        if (elapsed >= budget_ns || n >= UINT_MAX / 100) {
+            break;
+        }
+        /* Aim 20% past the budget, growing at most 100x per step. */
+        next = elapsed > 0 ? (unsigned long long int)n * budget_ns * 6
+                             / (elapsed * 5) + 1
+                           : (unsigned long long int)n * 100;
+        n = MIN(MAX(next, n + 1ULL), n * 100ULL);
+    }
+    bench_report(name, size, (double)elapsed / n, (double)allocs / n, n);
+}
+
+/* Deterministic pseudo-random numbers, so that runs are comparable. */
+static uint32_t
+bench_random(uint32_t *state) {
+    uint32_t x = *state;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+static void
+bench_mac(uint32_t i, uint8_t mac[ETH_ADDR_LEN]) {
+    mac[0] = 0x02;
+    mac[1] = 0x00;
+    mac[2] = i >> 24;
+    mac[3] = i >> 16;
+    mac[4] = i >> 8;
+    mac[5] = i;
+}
+
+/* Table sizes the ARP-Path and TCP-Path tables are measured at. */
+static const size_t path_sizes[] = { 16, 256, 4096 };
+
+/* Entries are installed with a lifetime far longer than any run, so that
+ * lookups never age them out. */
+#define BENCH_ENTRY_TIME 3600
+
+#define BENCH_KEYS 1024
+
+/* mac_to_port_*. */
+
+struct mac_bench {
+    struct mac_to_port table;
+    size_t size;
+    uint32_t keys[BENCH_KEYS];
+};
+
+static void
+mac_bench_clear(struct mac_bench *b) {
+    struct mac_port_time *e, *next;
+
+    for (e = b->table.inicio; e != NULL; e = next) {
+        next = e->next;
+        free(e);
+    }
+    mac_to_port_new(&b->table);
+}
+
+static void
+mac_bench_reset(void *b_) {
+    struct mac_bench *b = b_;
+    uint8_t mac[ETH_ADDR_LEN];
+    uint32_t i;
+
+    mac_bench_clear(b);
+    for (i = 0; i < b->size; i++) {
+        bench_mac(i, mac);
+        mac_to_port_add(&b->table, mac, 1 + i % 48, BENCH_ENTRY_TIME);
+    }
+}
+
+static void
+mac_bench_found(void *b_, unsigned int i) {
+    struct mac_bench *b = b_;
+    uint8_t mac[ETH_ADDR_LEN];
+
+    bench_mac(b->keys[i % BENCH_KEYS], mac);
+    mac_to_port_found_port(&b->table, mac);
+}
+
+static void
+mac_bench_update(void *b_, unsigned int i) {
+    struct mac_bench *b = b_;
+    uint8_t mac[ETH_ADDR_LEN];
+
+    bench_mac(b->keys[i % BENCH_KEYS], mac);
+    mac_to_port_update(&b->table, mac, 1 + i % 48, BENCH_ENTRY_TIME);
+}
+
+static void
+mac_bench_miss(void *b_, unsigned int i) {
+    struct mac_bench *b = b_;
+    uint8_t mac[ETH_ADDR_LEN];
+
+    bench_mac(b->size + b->keys[i % BENCH_KEYS], mac);
+    mac_to_port_found_port(&b->table, mac);
+}
+
+/* Appends an entry and evicts the oldest one, keeping the table size. */
+static void
+mac_bench_add(void *b_, unsigned int i) {
+    struct mac_bench *b = b_;
+    struct mac_port_time *oldest;
+    uint8_t mac[ETH_ADDR_LEN];
+
+    bench_mac(b->size + i, mac);
+    mac_to_port_add(&b->table, mac, 1 + i % 48, BENCH_ENTRY_TIME);
+
+    oldest = b->table.inicio;
+    b->table.inicio = oldest->next;
+    b->table.num_element--;
+    free(oldest);
+}
+
+static void
+bench_mac_to_port(void) {
+    struct mac_bench b;
+    size_t s;
+
+    mac_to_port_new(&b.table);
+    for (s = 0; s < ARRAY_SIZE(path_sizes); s++) {
+        uint32_t state = 0x9e3779b9;
+        size_t i;
+
+        b.size = path_sizes[s];
+        for (i = 0; i < BENCH_KEYS; i++) {
+            b.keys[i] = bench_random(&state) % b.size;
+        }
+        bench_run("mac_to_port_found_port", b.size, mac_bench_found,
+                  mac_bench_reset, &b);
+        bench_run("mac_to_port_found_port_miss", b.size, mac_bench_miss,
+                  mac_bench_reset, &b);
+        bench_run("mac_to_port_update", b.size, mac_bench_update,
+                  mac_bench_reset, &b);
+        bench_run("mac_to_port_add", b.size, mac_bench_add,
+                  mac_bench_reset, &b);
+    }
+    mac_bench_clear(&b);
+}
+
+/* table_tcp_*. */
+
+struct tcp_bench {
+    struct table_tcp table;
+    size_t size;
+    uint32_t keys[BENCH_KEYS];
+};
+
+/* Connection 'i' runs between two hosts taken from a small pool, the way
+ * many flows share a few servers in a data center. */
+static void
+tcp_bench_key(uint32_t i, uint8_t src[ETH_ADDR_LEN], uint8_t dst[ETH_ADDR_LEN],
+              uint16_t *port_src, uint16_t *port_dst) {
+    bench_mac(i % 64, src);
+    bench_mac(64 + (i / 64) % 64, dst);
+    *port_src = 1024 + i;
+    *port_dst = 80;
+}
+
+static void
+tcp_bench_clear(struct tcp_bench *b) {
+    struct table_tcp_time *e, *next;
+
+    for (e = b->table.inicio; e != NULL; e = next) {
+        next = e->next;
+        free(e);
+    }
+    table_tcp_new(&b->table);
+}
+
+static void
+tcp_bench_reset(void *b_) {
+    struct tcp_bench *b = b_;
+    uint8_t src[ETH_ADDR_LEN], dst[ETH_ADDR_LEN];
+    uint16_t port_src, port_dst;
+    uint32_t i;
+
+    tcp_bench_clear(b);
+    for (i = 0; i < b->size; i++) {
+        tcp_bench_key(i, src, dst, &port_src, &port_dst);
+        table_tcp_add(&b->table, src, dst, port_src, port_dst, 1 + i % 48,
+                      BENCH_ENTRY_TIME);
+    }
+}
+
+static void
+tcp_bench_found(void *b_, unsigned int i) {
+    struct tcp_bench *b = b_;
+    uint8_t src[ETH_ADDR_LEN], dst[ETH_ADDR_LEN];
+    uint16_t port_src, port_dst;
+
+    tcp_bench_key(b->keys[i % BENCH_KEYS], src, dst, &port_src, &port_dst);
+    /* Look the connection up in the reverse direction, as the returning
+     * SYN+ACK does. */
+    table_tcp_found_port(&b->table, dst, src, port_dst, port_src);
+}
+
+static void
+tcp_bench_update_time(void *b_, unsigned int i) {
+    struct tcp_bench *b = b_;
+    uint8_t src[ETH_ADDR_LEN], dst[ETH_ADDR_LEN];
+    uint16_t port_src, port_dst;
+
+    tcp_bench_key(b->keys[i % BENCH_KEYS], src, dst, &port_src, &port_dst);
+    table_tcp_update_time(&b->table, src, dst, port_src, port_dst,
+                          BENCH_ENTRY_TIME);
+}
+
+static void
+tcp_bench_miss(void *b_, unsigned int i) {
+    struct tcp_bench *b = b_;
+    uint8_t src[ETH_ADDR_LEN], dst[ETH_ADDR_LEN];
+    uint16_t port_src, port_dst;
+
+    tcp_bench_key(b->size + b->keys[i % BENCH_KEYS], src, dst,
+                  &port_src, &port_dst);
+    table_tcp_found_port(&b->table, src, dst, port_src, port_dst);
+}
+
+/* Adds a connection and removes it again, keeping the table size. */
+static void
+tcp_bench_add(void *b_, unsigned int i) {
+    struct tcp_bench *b = b_;
+    uint8_t src[ETH_ADDR_LEN], dst[ETH_ADDR_LEN];
+    uint16_t port_src, port_dst;
+    struct table_tcp_time *newest;
+
+    tcp_bench_key(b->size + i, src, dst, &port_src, &port_dst);
+    table_tcp_add(&b->table, src, dst, port_src, port_dst, 1 + i % 48,
+                  BENCH_ENTRY_TIME);
+
+    newest = b->table.inicio;
+    b->table.inicio = newest->next;
+    b->table.num_element--;
+    free(newest);
+}
+
+static void
+bench_table_tcp(void) {
+    struct tcp_bench b;
+    size_t s;
+
+    table_tcp_new(&b.table);
+    for (s = 0; s < ARRAY_SIZE(path_sizes); s++) {
+        uint32_t state = 0x9e3779b9;
+        size_t i;
+
+        b.size = path_sizes[s];
+        for (i = 0; i < BENCH_KEYS; i++) {
+            b.keys[i] = bench_random(&state) % b.size;
+        }
+        bench_run("table_tcp_found_port", b.size, tcp_bench_found,
+                  tcp_bench_reset, &b);
+        bench_run("table_tcp_found_port_miss", b.size, tcp_bench_miss,
+                  tcp_bench_reset, &b);
+        bench_run("table_tcp_update_time", b.size, tcp_bench_update_time,
+                  tcp_bench_reset, &b);
+        bench_run("table_tcp_add", b.size, tcp_bench_add,
+                  tcp_bench_reset, &b);
+    }
+    tcp_bench_clear(&b);
+}
+
+/* Frames. */
+
+enum bench_frame {
+    FRAME_ARP,
+    FRAME_TCP,
+    FRAME_UDP,
+    FRAME_VLAN_TCP,
+    FRAME_N
+};
+
+static const char *frame_names[FRAME_N] = { "arp", "tcp", "udp", "vlan_tcp" };
+
+/* Builds a minimum-size frame of type 'type' for flow number 'flow'. The
+ * addresses are the ones the flow table rule set below uses for the same
+ * flow number. */
+static struct ofpbuf *
+bench_frame_new(enum bench_frame type, uint32_t flow) {
+    struct ofpbuf *buf = ofpbuf_new(128);
+    struct eth_header *eth;
+    uint16_t eth_type;
+
+    eth = ofpbuf_put_zeros(buf, sizeof *eth);
+    bench_mac(0x10000 + flow, eth->eth_dst);
+    bench_mac(0x20000 + flow, eth->eth_src);
+
+    if (type == FRAME_VLAN_TCP) {
+        struct vlan_header *vlan;
+
+        eth->eth_type = htons(ETH_TYPE_VLAN);
+        vlan = ofpbuf_put_zeros(buf, sizeof *vlan);
+        vlan->vlan_tci = htons(100);
+        eth_type = ETH_TYPE_IP;
+        vlan->vlan_next_type = htons(eth_type);
+    } else {
+        eth_type = type == FRAME_ARP ? ETH_TYPE_ARP : ETH_TYPE_IP;
+        eth->eth_type = htons(eth_type);
+    }
+
+    if (type == FRAME_ARP) {
+        struct arp_eth_header *arp = ofpbuf_put_zeros(buf, sizeof *arp);
+
+        arp->ar_hrd = htons(1);
+        arp->ar_pro = htons(ETH_TYPE_IP);
+        arp->ar_hln = ETH_ADDR_LEN;
+        arp->ar_pln = 4;
+        arp->ar_op = htons(1);
+        memcpy(arp->ar_sha, eth->eth_src, ETH_ADDR_LEN);
+        arp->ar_spa = htonl(0x0a000000 + flow);
+        arp->ar_tpa = htonl(0x0a800000 + flow);
+    } else {
+        struct ip_header *ip = ofpbuf_put_zeros(buf, sizeof *ip);
+        bool tcp = type != FRAME_UDP;
+
+        ip->ip_ihl_ver = IP_IHL_VER(5, 4);
+        ip->ip_ttl = 64;
+        ip->ip_proto = tcp ? IP_TYPE_TCP : IP_TYPE_UDP;
+        ip->ip_src = htonl(0x0a000000 + flow);
+        ip->ip_dst = htonl(0x0a800000 + flow);
+        if (tcp) {
+            struct tcp_header *th = ofpbuf_put_zeros(buf, sizeof *th);
+
+            th->tcp_src = htons(1024 + flow % 60000);
+            th->tcp_dst = htons(80);
+            th->tcp_ctl = htons(0x5002); /* Header length 5, SYN. */
+        } else {
+            struct udp_header *uh = ofpbuf_put_zeros(buf, sizeof *uh);
+
+            uh->udp_src = htons(1024 + flow % 60000);
+            uh->udp_dst = htons(53);
+            uh->udp_len = htons(sizeof *uh);
+        }
+        ip->ip_tot_len = htons(buf->size - ((uint8_t *)ip
+                                            - (uint8_t *)buf->data));
+    }
+    if (buf->size < ETH_TOTAL_MIN) {
+        ofpbuf_put_zeros(buf, ETH_TOTAL_MIN - buf->size);
+    }
+    return buf;
+}
+
+/* Frees the fields of 'match' without freeing 'match' itself. */
+static void
+bench_match_clear(struct ofl_match *match) {
+    struct ofl_match_tlv *tlv, *next;
+
+    HMAP_FOR_EACH_SAFE (tlv, next, struct ofl_match_tlv, hmap_node,
+                        &match->match_fields) {
+        ofl_structs_match_tlv_free(tlv);
+    }
+    hmap_destroy(&match->match_fields);
+}
+
+/* nblink_packet_parse. */
+
+struct parse_bench {
+    struct ofpbuf *frame;
+    struct protocols_std proto;
+};
+
+static void
+parse_bench_op(void *b_, unsigned int i UNUSED) {
+    struct parse_bench *b = b_;
+    struct ofl_match match;
+
+    ofl_structs_match_init(&match);
+    nblink_packet_parse(b->frame, &match, &b->proto);
+    bench_match_clear(&match);
+}
+
+static void
+bench_packet_parse(void) {
+    struct parse_bench b;
+    enum bench_frame type;
+
+    for (type = 0; type < FRAME_N; type++) {
+        char name[64];
+
+        snprintf(name, sizeof name, "nblink_packet_parse_%s",
+                 frame_names[type]);
+        b.frame = bench_frame_new(type, 1);
+        bench_run(name, b.frame->size, parse_bench_op, NULL, &b);
+        ofpbuf_delete(b.frame);
+    }
+}
+
+/* packet_clone. */
+
+static void
+clone_bench_op(void *pkt, unsigned int i UNUSED) {
+    packet_destroy(packet_clone(pkt));
+}
+
+static void
+bench_packet_clone(struct datapath *dp) {
+    static const size_t sizes[] = { 64, 1500, 9000 };
+    size_t s;
+
+    for (s = 0; s < ARRAY_SIZE(sizes); s++) {
+        struct ofpbuf *buf = bench_frame_new(FRAME_TCP, 1);
+        struct packet *pkt;
+
+        ofpbuf_put_zeros(buf, sizes[s] - buf->size);
+        pkt = packet_create(dp, 1, buf, false);
+        bench_run("packet_clone", sizes[s], clone_bench_op, NULL, pkt);
+        packet_destroy(pkt);
+    }
+}
+
+/* flow_table_lookup. */
+
+static struct ofl_instruction_header **
+bench_output_instructions(uint32_t port, size_t *n) {
+    struct ofl_instruction_actions *ia = xmalloc(sizeof *ia);
+    struct ofl_action_output *out = xmalloc(sizeof *out);
+    struct ofl_instruction_header **insts = xmalloc(sizeof *insts);
+
+    out->header.type = OFPAT_OUTPUT;
+    out->header.len = sizeof(struct ofp_action_output);
+    out->port = port;
+    out->max_len = port == OFPP_CONTROLLER ? OFPCML_NO_BUFFER : 0;
+
+    ia->header.type = OFPIT_APPLY_ACTIONS;
+    ia->actions_num = 1;
+    ia->actions = xmalloc(sizeof *ia->actions);
+    ia->actions[0] = &out->header;
+
+    insts[0] = &ia->header;
+    *n = 1;
+    return insts;
+}
+
+static struct ofl_msg_flow_mod *
+bench_flow_mod_new(enum ofp_flow_mod_command command, uint16_t priority,
+                   struct ofl_match *match, uint32_t out_port) {
+    struct ofl_msg_flow_mod *fm = xmalloc(sizeof *fm);
+
+    fm->header.type = OFPT_FLOW_MOD;
+    fm->cookie = 0;
+    fm->cookie_mask = 0;
+    fm->table_id = 0;
+    fm->command = command;
+    fm->idle_timeout = 0;
+    fm->hard_timeout = 0;
+    fm->priority = priority;
+    fm->buffer_id = OFP_NO_BUFFER;
+    fm->out_port = OFPP_ANY;
+    fm->out_group = OFPG_ANY;
+    fm->flags = 0;
+    fm->match = &match->header;
+    if (command == OFPFC_ADD) {
+        fm->instructions = bench_output_instructions(out_port,
+                                                     &fm->instructions_num);
+    } else {
+        fm->instructions_num = 0;
+        fm->instructions = NULL;
+    }
+    return fm;
+}
+
+/* Fills in the match of rule 'i' of a rule set. The rules are a mix of what
+ * a controller typically installs: layer 2 forwarding on the destination
+ * address, exact TCP 5-tuples for steered connections, and per-port ARP
+ * handling. The values are stored the way the packet parser stores them. */
+static void
+bench_rule_match(uint32_t i, struct ofl_match *m, uint16_t *priority) {
+    ofl_structs_match_init(m);
+    switch (i % 3) {
+    case 0: {
+        uint8_t mac[ETH_ADDR_LEN];
+
+        bench_mac(0x10000 + i, mac);
+        ofl_structs_match_put_eth(m, OXM_OF_ETH_DST, mac);
+        *priority = 100;
+        break;
+    }
+    case 1:
+        ofl_structs_match_put16(m, OXM_OF_ETH_TYPE, ETH_TYPE_IP);
+        ofl_structs_match_put8(m, OXM_OF_IP_PROTO, IP_TYPE_TCP);
+        ofl_structs_match_put32(m, OXM_OF_IPV4_SRC, htonl(0x0a000000 + i));
+        ofl_structs_match_put32(m, OXM_OF_IPV4_DST, htonl(0x0a800000 + i));
+        ofl_structs_match_put16(m, OXM_OF_TCP_SRC, 1024 + i % 60000);
+        ofl_structs_match_put16(m, OXM_OF_TCP_DST, 80);
+        *priority = 200;
+        break;
+    default:
+        ofl_structs_match_put32(m, OXM_OF_IN_PORT, 1 + i);
+        ofl_structs_match_put16(m, OXM_OF_ETH_TYPE, ETH_TYPE_ARP);
+        *priority = 50;
+        break;
+    }
+}
+
+static void
+bench_flow_mod(struct flow_table *table, struct ofl_msg_flow_mod *fm,
+               struct ofl_exp *exp) {
+    bool match_kept = false, insts_kept = false;
+    ofl_err error;
+
+    error = flow_table_flow_mod(table, fm, &match_kept, &insts_kept);
+    if (error) {
+        ofp_fatal(0, "flow_mod failed (error 0x%x)", (unsigned int)error);
+    }
+    ofl_msg_free_flow_mod(fm, !match_kept, !insts_kept, exp);
+}
+
+/* Replaces the contents of 'table' with 'n_rules' rules plus a table-miss
+ * entry sending to the controller. */
+static void
+bench_install_rules(struct datapath *dp, struct flow_table *table,
+                    size_t n_rules) {
+    struct ofl_match *m;
+    size_t i;
+
+    m = xmalloc(sizeof *m);
+    ofl_structs_match_init(m);
+    bench_flow_mod(table, bench_flow_mod_new(OFPFC_DELETE, 0, m, OFPP_ANY),
+                   dp->exp);
+
+    for (i = 0; i < n_rules; i++) {
+        uint16_t priority;
+
+        m = xmalloc(sizeof *m);
+        bench_rule_match(i, m, &priority);
+        bench_flow_mod(table, bench_flow_mod_new(OFPFC_ADD, priority, m,
+                                                 1 + i % 48), dp->exp);
+    }
+
+    m = xmalloc(sizeof *m);
+    ofl_structs_match_init(m);
+    bench_flow_mod(table, bench_flow_mod_new(OFPFC_ADD, 0, m, OFPP_CONTROLLER),
+                   dp->exp);
+}
+
+#define LOOKUP_PACKETS 64
+
+struct lookup_bench {
+    struct flow_table *table;
+    struct packet *pkts[LOOKUP_PACKETS];
+};
+
+static void
+lookup_bench_op(void *b_, unsigned int i) {
+    struct lookup_bench *b = b_;
+
+    flow_table_lookup(b->table, b->pkts[i % LOOKUP_PACKETS]);
+}
+
+static void
+bench_flow_table_lookup(struct datapath *dp) {
+    static const size_t sizes[] = { 10, 100, 1000 };
+    struct lookup_bench b;
+    size_t s;
+
+    if (!bench_selected("flow_table_lookup")) {
+        return;
+    }
+    b.table = dp->pipeline->tables[0];
+    for (s = 0; s < ARRAY_SIZE(sizes); s++) {
+        uint32_t state = 0x9e3779b9;
+        size_t i;
+
+        bench_install_rules(dp, b.table, sizes[s]);
+        /* Three out of four packets hit one of the rules, spread over the
+         * whole table; the rest go to the table-miss entry. */
+        for (i = 0; i < LOOKUP_PACKETS; i++) {
+            uint32_t flow = bench_random(&state) % sizes[s];
+            enum bench_frame type;
+            uint32_t in_port;
+
+            switch (flow % 3) {
+            case 0:  type = FRAME_UDP; break;
+            case 1:  type = FRAME_TCP; break;
+            default: type = FRAME_ARP; break;
+            }
+            in_port = 1 + flow;
+            if (i % 4 == 3) {
+                flow += sizes[s];
+                in_port = 0xff00;
+            }
+            b.pkts[i] = packet_create(dp, in_port, bench_frame_new(type, flow),
+                                      false);
+        }
+        bench_run("flow_table_lookup", sizes[s], lookup_bench_op, NULL, &b);
+        for (i = 0; i < LOOKUP_PACKETS; i++) {
+            packet_destroy(b.pkts[i]);
+        }
+    }
+}
+
+/* ofl_msg_pack/ofl_msg_unpack. */
+
+struct msg_bench {
+    struct ofl_msg_header *msg;
+    uint8_t *buf;
+    size_t len;
+    struct ofl_exp *exp;
+};
+
+static void
+msg_bench_pack(void *b_, unsigned int i) {
+    struct msg_bench *b = b_;
+    uint8_t *buf;
+    size_t len;
+
+    ofl_msg_pack(b->msg, i, &buf, &len, b->exp);
+    free(buf);
+}
+
+static void
+msg_bench_unpack(void *b_, unsigned int i UNUSED) {
+    struct msg_bench *b = b_;
+    struct ofl_msg_header *msg;
+    uint32_t xid;
+
+    if (ofl_msg_unpack(b->buf, b->len, &msg, &xid, b->exp)) {
+        ofp_fatal(0, "cannot unpack the message being measured");
+    }
+    ofl_msg_free(msg, b->exp);
+}
+
+static void
+msg_bench_run(const char *kind, struct msg_bench *b) {
+    char name[64];
+
+    if (ofl_msg_pack(b->msg, 0, &b->buf, &b->len, b->exp)) {
+        ofp_fatal(0, "cannot pack %s", kind);
+    }
+    snprintf(name, sizeof name, "ofl_msg_pack_%s", kind);
+    bench_run(name, b->len, msg_bench_pack, NULL, b);
+    snprintf(name, sizeof name, "ofl_msg_unpack_%s", kind);
+    bench_run(name, b->len, msg_bench_unpack, NULL, b);
+    free(b->buf);
+    ofl_msg_free(b->msg, b->exp);
+}
+
+static void
+bench_msg(struct datapath *dp) {
+    struct ofl_msg_packet_in *pin;
+    struct ofpbuf *frame;
+    struct ofl_match *m;
+    struct msg_bench b;
+    uint16_t priority;
+
+    b.exp = dp->exp;
+
+    /* A 5-tuple flow_mod with one output action. */
+    m = xmalloc(sizeof *m);
+    bench_rule_match(1, m, &priority);
+    ofl_structs_match_put32(m, OXM_OF_IN_PORT, 1);
+    b.msg = &bench_flow_mod_new(OFPFC_ADD, priority, m, 2)->header;
+    msg_bench_run("flow_mod", &b);
+
+    /* A table-miss packet_in carrying a whole minimum-size frame. */
+    frame = bench_frame_new(FRAME_TCP, 1);
+    m = xmalloc(sizeof *m);
+    ofl_structs_match_init(m);
+    ofl_structs_match_put32(m, OXM_OF_IN_PORT, 1);
+    pin = xmalloc(sizeof *pin);
+    pin->header.type = OFPT_PACKET_IN;
+    pin->buffer_id = OFP_NO_BUFFER;
+    pin->total_len = frame->size;
+    pin->reason = OFPR_NO_MATCH;
+    pin->table_id = 0;
+    pin->cookie = 0xffffffffffffffffULL;
+    pin->match = &m->header;
+    pin->data_length = frame->size;
+    pin->data = xmemdup(frame->data, frame->size);
+    ofpbuf_delete(frame);
+    b.msg = &pin->header;
+    msg_bench_run("packet_in", &b);
+}
+
+/* oxm_pull_match. */
+
+struct oxm_bench {
+    struct ofpbuf *oxm;
+    int len;                    /* Length of the fields, without padding. */
+};
+
+static void
+oxm_bench_op(void *b_, unsigned int i UNUSED) {
+    struct oxm_bench *b = b_;
+    struct ofl_match match;
+    struct ofpbuf buf;
+
+    ofpbuf_use(&buf, b->oxm->data, b->oxm->size);
+    buf.size = b->oxm->size;
+    if (oxm_pull_match(&buf, &match, b->len)) {
+        ofp_fatal(0, "cannot pull the match being measured");
+    }
+    bench_match_clear(&match);
+}
+
+static void
+bench_oxm_pull_match(void) {
+    static const size_t sizes[] = { 1, 4, 8 };
+    uint8_t mac[ETH_ADDR_LEN];
+    struct oxm_bench b;
+    size_t s;
+
+    for (s = 0; s < ARRAY_SIZE(sizes); s++) {
+        struct ofl_match m;
+        size_t n = sizes[s];
+
+        ofl_structs_match_init(&m);
+        ofl_structs_match_put32(&m, OXM_OF_IN_PORT, 1);
+        if (n >= 4) {
+            ofl_structs_match_put16(&m, OXM_OF_ETH_TYPE, ETH_TYPE_IP);
+            ofl_structs_match_put32(&m, OXM_OF_IPV4_SRC, htonl(0x0a000001));
+            ofl_structs_match_put32(&m, OXM_OF_IPV4_DST, htonl(0x0a800001));
+        }
+        if (n >= 8) {
+            bench_mac(1, mac);
+            ofl_structs_match_put_eth(&m, OXM_OF_ETH_SRC, mac);
+            bench_mac(2, mac);
+            ofl_structs_match_put_eth(&m, OXM_OF_ETH_DST, mac);
+            ofl_structs_match_put8(&m, OXM_OF_IP_PROTO, IP_TYPE_TCP);
+            ofl_structs_match_put16(&m, OXM_OF_TCP_DST, 80);
+        }
+
+        b.oxm = ofpbuf_new(256);
+        b.len = oxm_put_match(b.oxm, &m);
+        bench_run("oxm_pull_match", n, oxm_bench_op, NULL, &b);
+        ofpbuf_delete(b.oxm);
+        bench_match_clear(&m);
+    }
+}
+
+static void
+usage(void) {
+    printf("%s: datapath micro-benchmarks\n"
+           "usage: %s [OPTIONS] [FILTER]\n"
+           "Runs the benchmarks whose name contains FILTER, or all of them.\n"
+           "\nOptions:\n"
+           "  -t, --time=MS           run each benchmark for about MS ms"
+           " (default: 200)\n"
+           "  --csv                   print the results as comma-separated"
+           " values\n"
+           "  --baseline=FILE         compare with the results in FILE,"
+           " saved with --csv\n"
+           "  --tolerance=PCT         slowdown over the baseline accepted"
+           " (default: 10)\n"
+           "  -h, --help              display this help message\n",
+           program_name, program_name);
+    exit(EXIT_SUCCESS);
+}
+
+static void
+parse_options(int argc, char *argv[]) {
+    enum {
+        OPT_CSV = UCHAR_MAX + 1,
+        OPT_BASELINE,
+        OPT_TOLERANCE
+    };
+    static struct option long_options[] = {
+        {"time", required_argument, 0, 't'},
+        {"csv", no_argument, 0, OPT_CSV},
+        {"baseline", required_argument, 0, OPT_BASELINE},
+        {"tolerance", required_argument, 0, OPT_TOLERANCE},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0},
+    };
+    char *short_options = long_options_to_short_options(long_options);
+
+    for (;;) {
+        int c = getopt_long(argc, argv, short_options, long_options, NULL);
+        if (c == -1) {
+            break;
+        }
+
+        switch (c) {
+        case 't': {
+            long long int ms = atoll(optarg);
+            if (ms <= 0) {
+                ofp_fatal(0, "value %s on -t or --time is not at least 1",
+                          optarg);
+            }
+            budget_ns = ms * 1000 * 1000;
+            break;
+        }
+
+        case OPT_CSV:
+            csv = true;
+            break;
+
+        case OPT_BASELINE:
+            baseline_read(optarg);
+            break;
+
+        case OPT_TOLERANCE:
+            tolerance = atof(optarg);
+            if (tolerance < 0) {
+                ofp_fatal(0, "value %s on --tolerance is negative", optarg);
+            }
+            break;
+
+        case 'h':
+            usage();
+
+        case '?':
+            exit(EXIT_FAILURE);
+
+        default:
+            abort();
+        }
+    }
+    free(short_options);
+
+    if (optind < argc) {
+        filter = argv[optind];
+    }
+}
+
+int
+main(int argc, char *argv[]) {
+    struct datapath *dp;
+
+    set_program_name(argv[0]);
+    time_init();
+    vlog_init();
+    vlog_set_levels(VLM_ANY_MODULE, VLF_CONSOLE, VLL_ERR);
+    parse_options(argc, argv);
+
+    dp = dp_new();
+
+    if (csv) {
+        printf("benchmark,size,ns_per_op,allocs_per_op,iterations\n");
+    } else {
+        printf("%-28s %7s %12s %10s %12s%s\n",
+               "benchmark", "size", "ns/op", "allocs/op", "iterations",
+               n_baselines > 0 ? "  vs base" : "");
+    }
+    bench_mac_to_port();
+    bench_table_tcp();
+    bench_flow_table_lookup(dp);
+    bench_packet_parse();
+    bench_packet_clone(dp);
+    bench_msg(dp);
+    bench_oxm_pull_match();
+
+    if (n_regressions > 0) {
+        fprintf(stderr, "%s: %u result%s regressed against the baseline\n",
+                program_name, n_regressions, n_regressions == 1 ? "" : "s");
+        return EXIT_FAILURE;
+    }
+    return 0;
+}
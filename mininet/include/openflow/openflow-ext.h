@@ -23,6 +23,7 @@ enum ofp_extension_commands { /* Queue configuration commands */
     OFP_EXT_QUEUE_MODIFY,  /* Add and/or modify */
     OFP_EXT_QUEUE_DELETE,  /* Remove a queue */
     OFP_EXT_SET_DESC,      /* Set ofp_desc_stat->dp_desc */
+    OFP_EXT_SET_PATH_MODE, /* Set the ARP-Path/TCP-Path forwarding mode */
 
     OFP_EXT_COUNT
 };
@@ -87,9 +88,264 @@ struct openflow_ext_set_dp_desc {
 };
 OFP_ASSERT(sizeof(struct openflow_ext_set_dp_desc) == 272);
 
+/* ARP-Path/TCP-Path forwarding modes. */
+enum ofp_path_mode {
+    OFP_PATH_MODE_ARP,          /* All traffic follows ARP-Path */
+    OFP_PATH_MODE_TCP,          /* TCP connections follow TCP-Path */
+    OFP_PATH_MODE_TCP_ELEPHANT, /* Only elephant TCP connections do */
+
+    OFP_PATH_MODE_COUNT,
+    OFP_PATH_MODE_KEEP = 0xff   /* Leave the mode unchanged */
+};
+
+enum ofp_path_mode_flags {
+    OFP_PATH_CTRL_NOTIFY      = 1 << 0, /* Copy ARP-Path frames to the
+                                           controller */
+    OFP_PATH_RECOVERY         = 1 << 1, /* Repair paths broken by a link
+                                           failure */
+    OFP_PATH_RECOVERY_DIST    = 1 << 2, /* Repair them between switches
+                                           instead of via the controller */
+    OFP_PATH_FAST_FAILOVER    = 1 << 3, /* Move to the backup port learnt
+                                           from duplicates on port down */
+    OFP_PATH_MEASURE_RECOVERY = 1 << 4  /* Log the time of each repair */
+};
+
+struct openflow_ext_set_path_mode {
+    struct ofp_extension_header header;
+    uint8_t mode;               /* One of OFP_PATH_MODE_*. */
+    uint8_t pad;
+    uint16_t flags;             /* OFP_PATH_* flags. */
+    uint16_t flags_mask;        /* Flags to change; others are kept. */
+    uint16_t bt_time;           /* Blocking time of the ARP-Path tables, in
+                                   seconds; 0 leaves it unchanged. */
+    uint16_t lt_time;           /* Learning time, likewise. */
+    uint16_t tcp_time;          /* Lifetime of TCP-Path entries, likewise. */
+    uint8_t pad2[4];
+};
+OFP_ASSERT(sizeof(struct openflow_ext_set_path_mode) == 32);
+
 #define ofq_error_string(rv) (((rv) < OFQ_ERR_COUNT) && ((rv) >= 0) ? \
     openflow_queue_error_strings[rv] : "Unknown error code")
 
+/****************************************************************
+ *
+ * Datapath stage timers (OFPMP_EXPERIMENTER multipart)
+ *
+ ****************************************************************/
+
+enum ofp_extension_multipart_types {
+    OFP_EXT_MP_STAGES,     /* Per-stage datapath latency histograms */
+    OFP_EXT_MP_TRACE,      /* Datapath event trace ring */
+    OFP_EXT_MP_COUNTERS,   /* Datapath counters */
+
+    OFP_EXT_MP_COUNT
+};
+
+/* Commands carried in an OFP_EXT_MP_STAGES request.  Every command is
+ * answered with the current histograms. */
+enum ofp_ext_stages_command {
+    OFP_EXT_STAGES_GET,     /* Only report */
+    OFP_EXT_STAGES_ENABLE,  /* Start timing */
+    OFP_EXT_STAGES_DISABLE, /* Stop timing */
+    OFP_EXT_STAGES_CLEAR    /* Report, then reset the histograms */
+};
+
+/* Flags in struct ofp_ext_stages_reply. */
+enum ofp_ext_stages_flags {
+    OFP_EXT_STAGES_COMPILED = 1 << 0, /* Built with --enable-stage-timers */
+    OFP_EXT_STAGES_ENABLED  = 1 << 1  /* Timers are running */
+};
+
+#define OFP_EXT_STAGE_NAME_LEN 16
+
+/* Samples are kept in log-linear buckets: below 4 ns every nanosecond has
+ * its own bucket, above that every power of two is split into four equal
+ * sub-buckets, so a bucket is never wider than a quarter of its value.  The
+ * last bucket also counts everything above its lower bound (about 7.5 s). */
+#define OFP_EXT_STAGE_BUCKETS 128
+
+struct ofp_ext_stages_request {
+    struct ofp_experimenter_multipart_header header; /* OPENFLOW_VENDOR_ID,
+                                                        OFP_EXT_MP_STAGES */
+    uint8_t command;            /* One of OFP_EXT_STAGES_*. */
+    uint8_t pad[7];
+};
+OFP_ASSERT(sizeof(struct ofp_ext_stages_request) == 16);
+
+struct ofp_ext_stage_stats {
+    char     name[OFP_EXT_STAGE_NAME_LEN];
+    uint64_t count;             /* Number of samples. */
+    uint64_t total_ns;          /* Sum of all samples. */
+    uint64_t min_ns;
+    uint64_t max_ns;
+    uint64_t buckets[OFP_EXT_STAGE_BUCKETS];
+};
+OFP_ASSERT(sizeof(struct ofp_ext_stage_stats) == 1072);
+
+struct ofp_ext_stages_reply {
+    struct ofp_experimenter_multipart_header header; /* OPENFLOW_VENDOR_ID,
+                                                        OFP_EXT_MP_STAGES */
+    uint32_t flags;             /* OFP_EXT_STAGES_* flags. */
+    uint8_t pad[4];
+    struct ofp_ext_stage_stats stages[0];
+};
+OFP_ASSERT(sizeof(struct ofp_ext_stages_reply) == 16);
+
+/****************************************************************
+ *
+ * Datapath event trace (OFPMP_EXPERIMENTER multipart)
+ *
+ ****************************************************************/
+
+/* Commands carried in an OFP_EXT_MP_TRACE request.  Only OFP_EXT_TRACE_GET
+ * is answered with records; the others only report the state of the ring. */
+enum ofp_ext_trace_command {
+    OFP_EXT_TRACE_GET,      /* Report the records in the ring */
+    OFP_EXT_TRACE_ENABLE,   /* Start recording, resizing the ring if asked */
+    OFP_EXT_TRACE_DISABLE,  /* Stop recording */
+    OFP_EXT_TRACE_CLEAR     /* Empty the ring */
+};
+
+/* Flags in struct ofp_ext_trace_reply. */
+enum ofp_ext_trace_flags {
+    OFP_EXT_TRACE_ENABLED = 1 << 0  /* Events are being recorded */
+};
+
+/* Events in struct ofp_ext_trace_record. */
+enum ofp_ext_trace_event {
+    OFP_EXT_TRACE_LEARN,    /* A MAC or connection was learnt on 'port' */
+    OFP_EXT_TRACE_LOOKUP,   /* Flow table lookup; 'arg' holds the table */
+    OFP_EXT_TRACE_PATH_IN,  /* TCP-Path path request received */
+    OFP_EXT_TRACE_PATH_OUT, /* TCP SYN sent on as a path request */
+    OFP_EXT_TRACE_FLOOD,    /* Frame flooded */
+    OFP_EXT_TRACE_RECOVERY, /* Path recovery step */
+    OFP_EXT_TRACE_DROP,     /* Frame dropped */
+
+    OFP_EXT_TRACE_EVENT_COUNT
+};
+
+/* Reasons of OFP_EXT_TRACE_LEARN. */
+enum ofp_ext_trace_learn {
+    OFP_EXT_TRACE_LEARN_NEW,        /* New ARP-Path entry */
+    OFP_EXT_TRACE_LEARN_MOVE,       /* ARP-Path entry moved to 'port' */
+    OFP_EXT_TRACE_LEARN_BACKUP,     /* 'port' is a backup ARP-Path port */
+    OFP_EXT_TRACE_LEARN_TCP_NEW,    /* New TCP-Path entry */
+    OFP_EXT_TRACE_LEARN_TCP_BACKUP  /* 'port' is a backup TCP-Path port */
+};
+
+/* Reasons of OFP_EXT_TRACE_LOOKUP.  On a hit 'arg' also holds the priority
+ * of the entry in its upper 16 bits. */
+enum ofp_ext_trace_lookup {
+    OFP_EXT_TRACE_LOOKUP_MISS,
+    OFP_EXT_TRACE_LOOKUP_HIT
+};
+
+/* Reasons of OFP_EXT_TRACE_RECOVERY. */
+enum ofp_ext_trace_recovery {
+    OFP_EXT_TRACE_RECOVERY_START,   /* A path broke */
+    OFP_EXT_TRACE_RECOVERY_DONE,    /* Repaired after 'arg' microseconds */
+    OFP_EXT_TRACE_RECOVERY_CTRL,    /* Repair asked to the controller */
+    OFP_EXT_TRACE_RECOVERY_DIST,    /* Repair asked to the other switches */
+    OFP_EXT_TRACE_RECOVERY_RX,      /* Repair frame received */
+    OFP_EXT_TRACE_RECOVERY_PORT_DOWN /* 'port' went down, 'arg' entries
+                                        failed over */
+};
+
+/* Reasons of OFP_EXT_TRACE_DROP. */
+enum ofp_ext_trace_drop {
+    OFP_EXT_TRACE_DROP_DUPLICATE,   /* Copy of a frame seen on another port */
+    OFP_EXT_TRACE_DROP_NO_ROUTE,    /* Destination not learnt */
+    OFP_EXT_TRACE_DROP_INVALID_TTL,
+    OFP_EXT_TRACE_DROP_NO_MATCH,    /* Table miss without ARP-Path */
+    OFP_EXT_TRACE_DROP_FILTERED     /* Ethertype not forwarded */
+};
+
+/* One event.  Fields that do not apply to the event are zero. */
+struct ofp_ext_trace_record {
+    uint64_t time_ns;           /* CLOCK_MONOTONIC of the switch. */
+    uint32_t in_port;
+    uint32_t port;              /* Port learnt, failed or sent to. */
+    uint32_t arg;               /* Event specific. */
+    uint16_t tp_src;            /* TCP ports of TCP-Path events. */
+    uint16_t tp_dst;
+    uint8_t  eth_src[OFP_ETH_ALEN];
+    uint8_t  eth_dst[OFP_ETH_ALEN];
+    uint8_t  event;             /* One of OFP_EXT_TRACE_*. */
+    uint8_t  reason;            /* Reason of the event. */
+    uint8_t  pad[2];
+};
+OFP_ASSERT(sizeof(struct ofp_ext_trace_record) == 40);
+
+struct ofp_ext_trace_request {
+    struct ofp_experimenter_multipart_header header; /* OPENFLOW_VENDOR_ID,
+                                                        OFP_EXT_MP_TRACE */
+    uint8_t  command;           /* One of OFP_EXT_TRACE_*. */
+    uint8_t  pad[3];
+    uint32_t size;              /* Records in the ring for ENABLE, or 0 to
+                                   keep the current size. */
+};
+OFP_ASSERT(sizeof(struct ofp_ext_trace_request) == 16);
+
+/* A long trace is split into several replies, each with the same header. */
+struct ofp_ext_trace_reply {
+    struct ofp_experimenter_multipart_header header; /* OPENFLOW_VENDOR_ID,
+                                                        OFP_EXT_MP_TRACE */
+    uint32_t flags;             /* OFP_EXT_TRACE_* flags. */
+    uint32_t size;              /* Records the ring holds. */
+    uint64_t total;             /* Records written since the last clear; the
+                                   ring keeps the last 'size' of them. */
+    uint64_t now_ns;            /* CLOCK_MONOTONIC when the trace was read. */
+    uint64_t wall_ns;           /* Wall clock at the same time. */
+    struct ofp_ext_trace_record records[0];
+};
+OFP_ASSERT(sizeof(struct ofp_ext_trace_reply) == 40);
+
+/* A trace saved to a file is this header, in network byte order, followed by
+ * the records. */
+#define OFP_EXT_TRACE_MAGIC "OFTRACE1"
+
+struct ofp_ext_trace_file_header {
+    char     magic[8];          /* OFP_EXT_TRACE_MAGIC, without the NUL. */
+    uint64_t datapath_id;
+    uint32_t flags;             /* As in struct ofp_ext_trace_reply. */
+    uint32_t size;
+    uint64_t total;
+    uint64_t now_ns;
+    uint64_t wall_ns;
+    uint64_t n_records;         /* Records that follow. */
+};
+OFP_ASSERT(sizeof(struct ofp_ext_trace_file_header) == 56);
+
+/****************************************************************
+ *
+ * Datapath counters (OFPMP_EXPERIMENTER multipart)
+ *
+ ****************************************************************/
+
+#define OFP_EXT_COUNTER_NAME_LEN 32
+
+struct ofp_ext_counters_request {
+    struct ofp_experimenter_multipart_header header; /* OPENFLOW_VENDOR_ID,
+                                                        OFP_EXT_MP_COUNTERS */
+};
+OFP_ASSERT(sizeof(struct ofp_ext_counters_request) == 8);
+
+/* One counter, named after the part of the datapath that keeps it, such as
+ * "buffers.evictions".  Gauges, such as "buffers.used", are reported the same
+ * way. */
+struct ofp_ext_counter {
+    char     name[OFP_EXT_COUNTER_NAME_LEN]; /* NUL padded. */
+    uint64_t value;
+};
+OFP_ASSERT(sizeof(struct ofp_ext_counter) == 40);
+
+struct ofp_ext_counters_reply {
+    struct ofp_experimenter_multipart_header header; /* OPENFLOW_VENDOR_ID,
+                                                        OFP_EXT_MP_COUNTERS */
+    struct ofp_ext_counter counters[0];
+};
+OFP_ASSERT(sizeof(struct ofp_ext_counters_reply) == 8);
+
 /****************************************************************
  *
  * Unsupported, but potential extended queue properties
@@ -107,8 +107,10 @@
 #include <net/if_arp.h>
 #include <net/route.h>
 #include <netinet/in.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "fatal-signal.h"
@@ -117,6 +119,7 @@
 #include "ofpbuf.h"
 #include "openflow/openflow.h"
 #include "packets.h"
+#include "pcap.h"
 #include "poll-loop.h"
 #include "socket-util.h"
 #include "svec.h"
@@ -142,7 +145,9 @@ struct netdev {
     int tap_fd;                 /* TAP character device, if any, otherwise the
                                  * network device. */
 
-    int netlink_fd;
+    /* Link state last reported by netdev_link_run(), NETDEV_LINK_NO_CHANGE
+     * until the first notification arrives. */
+    enum netdev_link_state link_state;
 
     /* one socket per queue.These are valid only for ordinary network devices*/
     int queue_fd[NETDEV_MAX_QUEUES + 1];
@@ -166,6 +171,36 @@ struct netdev {
 
     int save_flags;             /* Initial device flags. */
     int changed_flags;          /* Flags that we changed. */
+
+    /* Capture file state of "pcap:" and "pcap-sink:" devices, which have no
+     * file descriptors, otherwise null. */
+    struct netdev_pcap *pcap;
+};
+
+/* A "pcap:" device receives the frames of a capture file, loaded in memory
+ * when it is opened, as fast as they are read or at a fixed rate.  A
+ * "pcap-sink:" device receives nothing and writes the frames sent on it to a
+ * capture file, or just drops them.  Both let the datapath be driven without
+ * network devices or privileges, with the same input on every run. */
+struct netdev_pcap {
+    /* Replay. */
+    struct ofpbuf **frames;     /* Frames of the capture file. */
+    long long int *offsets;     /* Capture time of each frame, in us after
+                                 * the first one. */
+    size_t n_frames;
+    size_t next;                /* Next frame to be received. */
+    unsigned int rate;          /* Frames per second, 0 for no limit. */
+    bool trace;                 /* Keep the gaps of the capture instead. */
+    unsigned int loops;         /* Passes over the file, 0 for ever. */
+    unsigned int loop;          /* Current pass. */
+    long long int start;        /* Time the first frame was received, in us,
+                                 * or -1 before. */
+    long long int loop_start;   /* Start of the current pass after 'start'. */
+    unsigned long long int n_recv; /* Frames received. */
+    bool done;                  /* All passes received. */
+
+    /* Sink. */
+    FILE *sink;                 /* Capture file written, or null. */
 };
 
 /* All open network devices. */
@@ -174,6 +209,10 @@ static struct list netdev_list = LIST_INITIALIZER(&netdev_list);
 /* An AF_INET socket (used for ioctl operations). */
 static int af_inet_sock = -1;
 
+/* An rtnetlink socket subscribed to link notifications, shared by all network
+ * devices (used by netdev_link_run()). */
+static int link_sock = -1;
+
 /* This is set pretty low because we probably won't learn anything from the
  * additional log messages. */
 static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(5, 20);
@@ -182,8 +221,12 @@ static void init_netdev(void);
 static int do_open_netdev(const char *name, int ethertype, int tap_fd,
                           struct netdev **netdev_);
 static int restore_flags(struct netdev *netdev);
+static void pcap_destroy(struct netdev_pcap *);
+static void pad_to_minimum_length(struct ofpbuf *);
 static int get_flags(const char *netdev_name, int *flagsp);
 static int set_flags(const char *netdev_name, int flags);
+static void open_link_sock(void);
+static void request_link(int ifindex);
 
 /* Obtains the IPv6 address for 'name' into 'in6'. */
 static void
@@ -476,6 +519,11 @@ netdev_setup_slicing(struct netdev *netdev, uint16_t num_queues)
     int * fd;
     int error;
 
+    if (netdev->pcap) {
+        /* Capture file devices have no queues; everything goes to queue 0. */
+        netdev->num_queues = 0;
+        return 0;
+    }
     netdev->num_queues = num_queues;
 
     /* remove any previous queue configuration for this device */
@@ -671,6 +719,8 @@ netdev_open(const char *name, int ethertype, struct netdev **netdevp)
 {
     if (!strncmp(name, "tap:", 4)) {
         return netdev_open_tap(name + 4, netdevp);
+    } else if (!strncmp(name, "pcap:", 5) || !strncmp(name, "pcap-sink:", 10)) {
+        return netdev_open_pcap(name, netdevp);
     } else {
         return do_open_netdev(name, ethertype, -1, netdevp);
     }
@@ -722,14 +772,187 @@ netdev_open_tap(const char *name, struct netdev **netdevp)
     return error;
 }
 
+/* Loads the frames of the capture file 'file_name' into 'pcap'. */
+static int
+pcap_load(struct netdev_pcap *pcap, const char *file_name)
+{
+    size_t allocated = 0;
+    long long int first = 0, last = 0;
+    FILE *file;
+    int error;
+
+    file = fopen(file_name, "rb");
+    if (file == NULL) {
+        return errno;
+    }
+    error = pcap_read_header(file);
+    if (error) {
+        fclose(file);
+        return error > 0 ? error : EPROTO;
+    }
+    for (;;) {
+        struct ofpbuf *frame;
+        long long int when;
+
+        error = pcap_read(file, &frame, &when);
+        if (error) {
+            break;
+        }
+        if (pcap->n_frames >= allocated) {
+            size_t n = allocated;
+            pcap->frames = x2nrealloc(pcap->frames, &allocated,
+                                      sizeof *pcap->frames);
+            pcap->offsets = x2nrealloc(pcap->offsets, &n,
+                                       sizeof *pcap->offsets);
+        }
+        if (pcap->n_frames == 0) {
+            first = when;
+        }
+        last = MAX(last, when - first);
+        pcap->frames[pcap->n_frames] = frame;
+        pcap->offsets[pcap->n_frames] = last;
+        pcap->n_frames++;
+    }
+    fclose(file);
+    if (error != EOF) {
+        return error;
+    }
+    if (pcap->n_frames == 0) {
+        VLOG_ERR(LOG_MODULE, "%s: capture file has no frames", file_name);
+        return EINVAL;
+    }
+    return 0;
+}
+
+/* Parses 'spec', "FILE[:RATE[:LOOPS]]", and loads FILE into 'pcap'. */
+static int
+pcap_parse_replay(struct netdev_pcap *pcap, const char *spec)
+{
+    char *copy = xstrdup(spec);
+    char *rate, *loops;
+    int error;
+
+    rate = strchr(copy, ':');
+    loops = NULL;
+    if (rate) {
+        *rate++ = '\0';
+        loops = strchr(rate, ':');
+        if (loops) {
+            *loops++ = '\0';
+        }
+    }
+
+    pcap->loops = 1;
+    if (rate && !strcmp(rate, "trace")) {
+        pcap->trace = true;
+    } else if (rate && *rate) {
+        pcap->rate = atoi(rate);
+    }
+    if (loops && *loops) {
+        pcap->loops = atoi(loops);
+    }
+
+    error = pcap_load(pcap, copy);
+    if (error) {
+        VLOG_ERR(LOG_MODULE, "failed to load capture file %s: %s",
+                 copy, strerror(error));
+    }
+    free(copy);
+    return error;
+}
+
+/* Opens a capture file device.  'name' is either "pcap:FILE[:RATE[:LOOPS]]",
+ * a device that receives the frames of FILE, LOOPS times (default 1, 0 for
+ * ever), at RATE frames per second, with the gaps of the capture if RATE is
+ * "trace", or as fast as possible if RATE is 0 or missing; or
+ * "pcap-sink:[FILE]", a device that writes the frames sent on it to FILE,
+ * or drops them if FILE is empty.  Frames sent on a "pcap:" device are
+ * dropped.  Returns zero if successful, otherwise a positive errno value.  On
+ * success, sets '*netdevp' to the new network device, otherwise to null. */
+int
+netdev_open_pcap(const char *name, struct netdev **netdevp)
+{
+    struct netdev_pcap *pcap;
+    struct netdev *netdev;
+    int mtu = ETH_PAYLOAD_MAX;
+    size_t i;
+    int error;
+
+    init_netdev();
+    *netdevp = NULL;
+
+    pcap = xcalloc(1, sizeof *pcap);
+    pcap->start = -1;
+    if (!strncmp(name, "pcap-sink:", 10)) {
+        const char *file_name = name + 10;
+
+        pcap->done = true;
+        if (*file_name) {
+            pcap->sink = fopen(file_name, "wb");
+            if (pcap->sink == NULL) {
+                error = errno;
+                VLOG_ERR(LOG_MODULE, "failed to open capture file %s: %s",
+                         file_name, strerror(error));
+                pcap_destroy(pcap);
+                return error;
+            }
+            pcap_write_header(pcap->sink);
+        }
+    } else {
+        error = pcap_parse_replay(pcap, name + 5);
+        if (error) {
+            pcap_destroy(pcap);
+            return error;
+        }
+        for (i = 0; i < pcap->n_frames; i++) {
+            mtu = MAX(mtu, (int) pcap->frames[i]->size - VLAN_ETH_HEADER_LEN);
+        }
+    }
+
+    netdev = xcalloc(1, sizeof *netdev);
+    netdev->name = xstrdup(name);
+    netdev->netdev_fd = -1;
+    netdev->tap_fd = -1;
+    netdev->queue_fd[0] = -1;
+    netdev->link_state = NETDEV_LINK_NO_CHANGE;
+    netdev->hwaddr_family = ARPHRD_ETHER;
+    eth_addr_random(netdev->etheraddr);
+    netdev->mtu = mtu;
+    netdev->speed = SPEED_10000;
+    netdev->curr = OFPPF_10GB_FD | OFPPF_COPPER;
+    netdev->advertised = netdev->curr;
+    netdev->supported = netdev->curr;
+    netdev->pcap = pcap;
+    fatal_signal_block();
+    list_push_back(&netdev_list, &netdev->node);
+    fatal_signal_unblock();
+
+    *netdevp = netdev;
+    return 0;
+}
+
+static void
+pcap_destroy(struct netdev_pcap *pcap)
+{
+    size_t i;
+
+    for (i = 0; i < pcap->n_frames; i++) {
+        ofpbuf_delete(pcap->frames[i]);
+    }
+    free(pcap->frames);
+    free(pcap->offsets);
+    if (pcap->sink) {
+        fclose(pcap->sink);
+    }
+    free(pcap);
+}
+
 static int
 do_open_netdev(const char *name, int ethertype, int tap_fd,
                struct netdev **netdev_)
 {
     int netdev_fd;
-    int netlink_fd;
     struct sockaddr_ll sll;
-    struct sockaddr_nl snl;
     struct ifreq ifr;
     unsigned int ifindex;
     uint8_t etheraddr[ETH_ADDR_LEN];
@@ -744,18 +967,6 @@ do_open_netdev(const char *name, int ethertype, int tap_fd,
     *netdev_ = NULL;
     netdev_fd = -1;
 
-    netlink_fd = socket(PF_NETLINK, SOCK_RAW, NETLINK_ROUTE);
-
-    if (netlink_fd < 0) {
-        return errno;
-    }
-
-    /* Set non-blocking mode. */
-    error = set_nonblocking(netlink_fd);
-    if (error) {
-        goto error_already_set;
-    }
-
     /* Create raw socket. */
     netdev_fd = socket(PF_PACKET, SOCK_RAW,
                        htons(ethertype == NETDEV_ETH_TYPE_NONE ? 0
@@ -780,14 +991,6 @@ do_open_netdev(const char *name, int ethertype, int tap_fd,
         goto error_already_set;
     }
 
-    memset (&snl,0,sizeof(snl));
-    snl.nl_family = AF_NETLINK;
-    snl.nl_groups =  RTMGRP_LINK;
-
-    if (bind(netlink_fd, (struct sockaddr *)&snl, sizeof(snl)) < 0){
-        VLOG_ERR(LOG_MODULE, "netlink bind to %s failed: %s", name, strerror(errno));
-        goto error;
-    }
     /* Get ethernet device index. */
     strncpy(ifr.ifr_name, name, sizeof ifr.ifr_name);
     if (ioctl(netdev_fd, SIOCGIFINDEX, &ifr) < 0) {
@@ -855,13 +1058,14 @@ do_open_netdev(const char *name, int ethertype, int tap_fd,
     netdev->txqlen = txqlen;
     netdev->hwaddr_family = hwaddr_family;
     netdev->netdev_fd = netdev_fd;
-    netdev->netlink_fd = netlink_fd;
+    netdev->link_state = NETDEV_LINK_NO_CHANGE;
     netdev->tap_fd = tap_fd < 0 ? netdev_fd : tap_fd;
     netdev->queue_fd[0] = netdev->tap_fd;
     memcpy(netdev->etheraddr, etheraddr, sizeof etheraddr);
     netdev->mtu = mtu;
     netdev->in6 = in6;
     netdev->num_queues = 0;
+    netdev->pcap = NULL;
 
     /* Get speed, features. */
     do_ethtool(netdev);
@@ -875,6 +1079,7 @@ do_open_netdev(const char *name, int ethertype, int tap_fd,
     fatal_signal_block();
     list_push_back(&netdev_list, &netdev->node);
     fatal_signal_unblock();
+    request_link(ifindex);
 
     /* Success! */
     *netdev_ = netdev;
@@ -896,7 +1101,14 @@ netdev_close(struct netdev *netdev)
 {
     int i;
 
-    if (netdev) {
+    if (netdev && netdev->pcap) {
+        fatal_signal_block();
+        list_remove(&netdev->node);
+        fatal_signal_unblock();
+        pcap_destroy(netdev->pcap);
+        free(netdev->name);
+        free(netdev);
+    } else if (netdev) {
         /* Bring down interface and drop promiscuous mode, if we brought up
          * the interface or enabled promiscuous mode. */
         int error;
@@ -933,38 +1145,207 @@ pad_to_minimum_length(struct ofpbuf *buffer)
     }
 }
 
-int
-netdev_link_state(struct netdev *netdev)
-{
-     int len;
-     char buff[4096];
-     struct nlmsghdr *nlm;
-     struct ifinfomsg *ifa;
-     enum netdev_flags flags;
-     nlm = (struct nlmsghdr *)buff;
-     do
-     {
-        len = recv (netdev->netlink_fd,nlm,4096,0);
-        for (;(NLMSG_OK (nlm, len)) && (nlm->nlmsg_type != NLMSG_DONE); nlm = NLMSG_NEXT(nlm, len))
-         {
-             if (nlm->nlmsg_type != RTM_NEWLINK)
+/* Asks the kernel to send the link state of the device with 'ifindex', or of
+ * all devices if 'ifindex' is 0, to 'link_sock'.  The replies are read by
+ * netdev_link_run() like any other notification. */
+static void
+request_link(int ifindex)
+{
+    struct {
+        struct nlmsghdr nlh;
+        struct ifinfomsg ifi;
+    } req;
+
+    if (link_sock < 0) {
+        return;
+    }
+    memset(&req, 0, sizeof req);
+    req.nlh.nlmsg_len = sizeof req;
+    req.nlh.nlmsg_type = RTM_GETLINK;
+    req.nlh.nlmsg_flags = NLM_F_REQUEST | (ifindex ? 0 : NLM_F_DUMP);
+    req.ifi.ifi_family = AF_UNSPEC;
+    req.ifi.ifi_index = ifindex;
+    if (send(link_sock, &req, sizeof req, 0) < 0) {
+        VLOG_WARN_RL(LOG_MODULE, &rl, "rtnetlink link request failed: %s",
+                     strerror(errno));
+    }
+}
+
+/* Records 'iff_flags' and 'mtu' (if nonzero) as the current link flags and
+ * MTU of 'netdev', calling 'cb' if the link state or the MTU changed. */
+static void
+update_link(struct netdev *netdev, int iff_flags, int mtu,
+            netdev_link_cb *cb, void *aux)
+{
+    enum netdev_link_state state;
+    bool mtu_changed;
+
+    state = ((iff_flags & IFF_UP) && (iff_flags & IFF_LOWER_UP)
+             ? NETDEV_LINK_UP : NETDEV_LINK_DOWN);
+    mtu_changed = mtu > 0 && mtu != netdev->mtu;
+    if (mtu_changed) {
+        VLOG_INFO(LOG_MODULE, "%s: mtu changed from %d to %d",
+                  netdev->name, netdev->mtu, mtu);
+        netdev->mtu = mtu;
+    }
+    if (state != netdev->link_state) {
+        netdev->link_state = state;
+        cb(netdev, state, aux);
+    } else if (mtu_changed) {
+        cb(netdev, NETDEV_LINK_NO_CHANGE, aux);
+    }
+}
+
+/* Reports the link changes of all open network devices.  Link notifications
+ * from the kernel are read off the rtnetlink socket shared by every netdev, so
+ * the cost does not depend on the number of ports.  For each open device
+ * whose link went up or down, or whose MTU changed, 'cb' is called with the
+ * new state (NETDEV_LINK_NO_CHANGE for an MTU-only change).  A link is up when
+ * the interface is administratively up and has carrier.
+ *
+ * The state of a device is requested from the kernel when it is opened, so
+ * the first call after netdev_open() reports it.  If the kernel dropped
+ * notifications because the socket overflowed, the state of every device is
+ * requested again. */
+void
+netdev_link_run(netdev_link_cb *cb, void *aux)
+{
+    char buf[8192];
+    bool resync = false;
+
+    if (link_sock < 0) {
+        return;
+    }
+
+    for (;;) {
+        struct nlmsghdr *nlm;
+        ssize_t len;
+
+        len = recv(link_sock, buf, sizeof buf, 0);
+        if (len < 0) {
+            if (errno == EINTR) {
                 continue;
-             ifa = (struct ifinfomsg *) NLMSG_DATA (nlm);
-             if (ifa->ifi_index == netdev->ifindex){
-                 if (ifa->ifi_flags & IFF_UP){
-                     netdev_nodev_get_flags(netdev->name, &flags);
-                     netdev_set_flags(netdev, flags, false);
-                     return NETDEV_LINK_UP;
-                 }
-                 else {
-                     netdev_nodev_get_flags(netdev->name, &flags);
-                     netdev_set_flags(netdev, flags, false);
-                     return NETDEV_LINK_DOWN;
-                 }
-	     }
-         }
-     } while (len < 0 && errno == EINTR);
-     return NETDEV_LINK_NO_CHANGE;
+            }
+            if (errno == ENOBUFS) {
+                resync = true;
+                continue;
+            }
+            if (errno != EAGAIN) {
+                VLOG_WARN_RL(LOG_MODULE, &rl, "error reading rtnetlink socket: %s",
+                             strerror(errno));
+            }
+            break;
+        }
+
+        for (nlm = (struct nlmsghdr *) buf; NLMSG_OK(nlm, len);
+             nlm = NLMSG_NEXT(nlm, len)) {
+            struct ifinfomsg *ifi;
+            struct rtattr *rta;
+            struct netdev *netdev;
+            int rta_len;
+            int mtu = 0;
+
+            if (nlm->nlmsg_type != RTM_NEWLINK
+                || nlm->nlmsg_len < NLMSG_LENGTH(sizeof *ifi)) {
+                continue;
+            }
+            ifi = NLMSG_DATA(nlm);
+            rta_len = IFLA_PAYLOAD(nlm);
+            for (rta = IFLA_RTA(ifi); RTA_OK(rta, rta_len);
+                 rta = RTA_NEXT(rta, rta_len)) {
+                if (rta->rta_type == IFLA_MTU
+                    && RTA_PAYLOAD(rta) >= sizeof(uint32_t)) {
+                    mtu = *(uint32_t *) RTA_DATA(rta);
+                }
+            }
+
+            LIST_FOR_EACH (netdev, struct netdev, node, &netdev_list) {
+                if (netdev->ifindex == ifi->ifi_index) {
+                    update_link(netdev, ifi->ifi_flags, mtu, cb, aux);
+                }
+            }
+        }
+    }
+
+    if (resync) {
+        VLOG_WARN_RL(LOG_MODULE, &rl, "rtnetlink socket overflowed, "
+                     "requesting link state of all devices");
+        request_link(0);
+    }
+}
+
+/* Arranges for poll_block() to wake up when netdev_link_run() has link
+ * changes to report. */
+void
+netdev_link_wait(void)
+{
+    if (link_sock >= 0) {
+        poll_fd_wait(link_sock, POLLIN);
+    }
+}
+
+/* Returns the current time in microseconds, for pacing "pcap:" devices. */
+static long long int
+pcap_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+/* Returns the time at which the next frame of 'pcap' is due, in us. */
+static long long int
+pcap_due(const struct netdev_pcap *pcap)
+{
+    if (pcap->trace) {
+        return pcap->start + pcap->loop_start + pcap->offsets[pcap->next];
+    } else if (pcap->rate) {
+        return pcap->start + (long long int) (pcap->n_recv * 1000000ULL
+                                              / pcap->rate);
+    } else {
+        return pcap->start;
+    }
+}
+
+static int
+pcap_recv(struct netdev *netdev, struct ofpbuf *buffer, size_t max_mtu)
+{
+    struct netdev_pcap *pcap = netdev->pcap;
+    const struct ofpbuf *frame;
+    long long int now;
+
+    if (pcap->done) {
+        return EAGAIN;
+    }
+    now = pcap_now();
+    if (pcap->start < 0) {
+        pcap->start = now;
+    } else if (now < pcap_due(pcap)) {
+        return EAGAIN;
+    }
+
+    frame = pcap->frames[pcap->next];
+    ofpbuf_put(buffer, frame->data, MIN(frame->size, max_mtu));
+    pad_to_minimum_length(buffer);
+    pcap->n_recv++;
+
+    if (++pcap->next == pcap->n_frames) {
+        /* Leave the average gap of the capture between two passes. */
+        long long int span = pcap->offsets[pcap->n_frames - 1];
+        pcap->loop_start += span + (pcap->n_frames > 1
+                                    ? span / (pcap->n_frames - 1) : 0);
+        pcap->next = 0;
+        if (pcap->loops && ++pcap->loop >= pcap->loops) {
+            long long int elapsed = now - pcap->start;
+            pcap->done = true;
+            VLOG_INFO(LOG_MODULE, "%s: replayed %llu frames in %lld.%03lld ms "
+                      "(%.0f frames/s)", netdev->name, pcap->n_recv,
+                      elapsed / 1000, elapsed % 1000,
+                      elapsed ? pcap->n_recv * 1e6 / elapsed : 0.0);
+        }
+    }
+    return 0;
 }
 
 /* Attempts to receive a packet from 'netdev' into 'buffer', which the caller
@@ -1001,6 +1382,10 @@ netdev_recv(struct netdev *netdev, struct ofpbuf *buffer, size_t max_mtu)
     assert(buffer->size == 0);
     assert(ofpbuf_tailroom(buffer) >= ETH_TOTAL_MIN);
 
+    if (netdev->pcap) {
+        return pcap_recv(netdev, buffer, max_mtu);
+    }
+
 #ifdef HAVE_PACKET_AUXDATA
     /* Code from libpcap to reconstruct VLAN header */
     memset(&msg, 0, sizeof(struct msghdr));
@@ -1108,6 +1493,20 @@ netdev_recv(struct netdev *netdev, struct ofpbuf *buffer, size_t max_mtu)
 void
 netdev_recv_wait(struct netdev *netdev)
 {
+    struct netdev_pcap *pcap = netdev->pcap;
+
+    if (pcap) {
+        if (!pcap->done) {
+            long long int wait = (pcap->start < 0 ? 0
+                                  : pcap_due(pcap) - pcap_now());
+            if (wait <= 0) {
+                poll_immediate_wake();
+            } else {
+                poll_timer_wait((wait + 999) / 1000);
+            }
+        }
+        return;
+    }
     poll_fd_wait(netdev->tap_fd, POLLIN);
 }
 
@@ -1115,7 +1514,9 @@ netdev_recv_wait(struct netdev *netdev)
 int
 netdev_drain(struct netdev *netdev)
 {
-    if (netdev->tap_fd != netdev->netdev_fd) {
+    if (netdev->pcap) {
+        return 0;
+    } else if (netdev->tap_fd != netdev->netdev_fd) {
         drain_fd(netdev->tap_fd, netdev->txqlen);
         return 0;
     } else {
@@ -1144,6 +1545,13 @@ netdev_send(struct netdev *netdev, const struct ofpbuf *buffer,
 
     assert(class_id <= NETDEV_MAX_QUEUES);
 
+    if (netdev->pcap) {
+        if (netdev->pcap->sink) {
+            pcap_write(netdev->pcap->sink, buffer);
+        }
+        return 0;
+    }
+
     do {
         n_bytes = write(netdev->queue_fd[class_id], buffer->data, buffer->size);
     } while (n_bytes < 0 && errno == EINTR);
@@ -1178,7 +1586,10 @@ netdev_send(struct netdev *netdev, const struct ofpbuf *buffer,
 void
 netdev_send_wait(struct netdev *netdev)
 {
-    if (netdev->tap_fd == netdev->netdev_fd) {
+    if (netdev->pcap) {
+        /* Capture file devices always accept packets. */
+        poll_immediate_wake();
+    } else if (netdev->tap_fd == netdev->netdev_fd) {
         poll_fd_wait(netdev->tap_fd, POLLOUT);
     } else {
         /* TAP device always accepts packets.*/
@@ -1193,6 +1604,10 @@ netdev_set_etheraddr(struct netdev *netdev, const uint8_t mac[ETH_ADDR_LEN])
 {
     struct ifreq ifr;
 
+    if (netdev->pcap) {
+        memcpy(netdev->etheraddr, mac, ETH_ADDR_LEN);
+        return 0;
+    }
     memset(&ifr, 0, sizeof ifr);
     strncpy(ifr.ifr_name, netdev->name, sizeof ifr.ifr_name);
     ifr.ifr_hwaddr.sa_family = netdev->hwaddr_family;
@@ -1236,7 +1651,9 @@ netdev_get_mtu(const struct netdev *netdev)
 uint32_t
 netdev_get_features(struct netdev *netdev, int type)
 {
-    do_ethtool(netdev);
+    if (!netdev->pcap) {
+        do_ethtool(netdev);
+    }
     switch (type) {
     case NETDEV_FEAT_CURRENT:
         return netdev->curr;
@@ -1260,6 +1677,12 @@ netdev_get_in4(const struct netdev *netdev, struct in_addr *in4)
     struct ifreq ifr;
     struct in_addr ip = { INADDR_ANY };
 
+    if (netdev->pcap) {
+        if (in4) {
+            *in4 = ip;
+        }
+        return false;
+    }
     strncpy(ifr.ifr_name, netdev->name, sizeof ifr.ifr_name);
     ifr.ifr_addr.sa_family = AF_INET;
     if (ioctl(af_inet_sock, SIOCGIFADDR, &ifr) == 0) {
@@ -1357,6 +1780,10 @@ netdev_get_in6(const struct netdev *netdev, struct in6_addr *in6)
 int
 netdev_get_flags(const struct netdev *netdev, enum netdev_flags *flagsp)
 {
+    if (netdev->pcap) {
+        *flagsp = NETDEV_UP | NETDEV_PROMISC | NETDEV_CARRIER;
+        return 0;
+    }
     return netdev_nodev_get_flags(netdev->name, flagsp);
 }
 
@@ -1384,6 +1811,9 @@ do_update_flags(struct netdev *netdev, enum netdev_flags off,
     int old_flags, new_flags;
     int error;
 
+    if (netdev->pcap) {
+        return 0;
+    }
     error = get_flags(netdev->name, &old_flags);
     if (error) {
         return error;
@@ -1694,9 +2124,45 @@ init_netdev(void)
         if (af_inet_sock < 0) {
             ofp_fatal(errno, "socket(AF_INET)");
         }
+        open_link_sock();
     }
 }
 
+/* Opens 'link_sock'.  On failure link changes are simply not reported. */
+static void
+open_link_sock(void)
+{
+    struct sockaddr_nl snl;
+    int error;
+
+    link_sock = socket(PF_NETLINK, SOCK_RAW, NETLINK_ROUTE);
+    if (link_sock < 0) {
+        VLOG_WARN(LOG_MODULE, "could not create rtnetlink socket: %s",
+                  strerror(errno));
+        return;
+    }
+
+    error = set_nonblocking(link_sock);
+    if (error) {
+        goto error;
+    }
+
+    memset(&snl, 0, sizeof snl);
+    snl.nl_family = AF_NETLINK;
+    snl.nl_groups = RTMGRP_LINK;
+    if (bind(link_sock, (struct sockaddr *) &snl, sizeof snl) < 0) {
+        error = errno;
+        goto error;
+    }
+    return;
+
+error:
+    VLOG_WARN(LOG_MODULE, "could not set up rtnetlink socket: %s",
+              strerror(error));
+    close(link_sock);
+    link_sock = -1;
+}
+
 /* Restore the network device flags on 'netdev' to those that were active
  * before we changed them.  Returns 0 if successful, otherwise a positive
  * errno value.
@@ -1708,6 +2174,14 @@ restore_flags(struct netdev *netdev)
     struct ifreq ifr;
     int restore_flags;
 
+    if (netdev->pcap) {
+        /* Nothing to restore, but keep what was written to the capture. */
+        if (netdev->pcap->sink) {
+            fflush(netdev->pcap->sink);
+        }
+        return 0;
+    }
+
     /* Get current flags. */
     strncpy(ifr.ifr_name, netdev->name, sizeof ifr.ifr_name);
     if (ioctl(netdev->netdev_fd, SIOCGIFFLAGS, &ifr) < 0) {
@@ -82,11 +82,15 @@ struct netdev;
 
 int netdev_open(const char *name, int ethertype, struct netdev **);
 int netdev_open_tap(const char *name, struct netdev **);
+int netdev_open_pcap(const char *name, struct netdev **);
 void netdev_close(struct netdev *);
 
 int netdev_recv(struct netdev *, struct ofpbuf *, size_t);
 void netdev_recv_wait(struct netdev *);
-int netdev_link_state(struct netdev *netdev);
+typedef void netdev_link_cb(struct netdev *, enum netdev_link_state,
+                            void *aux);
+void netdev_link_run(netdev_link_cb *, void *aux);
+void netdev_link_wait(void);
 int netdev_drain(struct netdev *);
 int netdev_send(struct netdev *, const struct ofpbuf *, uint16_t class_id);
 void netdev_send_wait(struct netdev *);
@@ -38,6 +38,8 @@
 #include "dynamic-string.h"
 #include "util.h"
 
+static void ofpbuf_rebase__(struct ofpbuf *, void *);
+
 /* Initializes 'b' as an empty ofpbuf that contains the 'allocated' bytes of
  * memory starting at 'base'.
  *
@@ -54,6 +56,7 @@ ofpbuf_use(struct ofpbuf *b, void *base, size_t allocated)
     b->l2 = b->l3 = b->l4 = b->l7 = NULL;
     b->next = NULL;
     b->private_p = NULL;
+    b->ref_cnt = NULL;
 }
 
 /* Initializes 'b' as an empty ofpbuf with an initial capacity of 'size'
@@ -64,11 +67,19 @@ ofpbuf_init(struct ofpbuf *b, size_t size)
     ofpbuf_use(b, size ? xmalloc(size) : NULL, size);
 }
 
-/* Frees memory that 'b' points to. */
+/* Frees memory that 'b' points to.  If the memory is shared with other
+ * ofpbufs, only the reference held by 'b' is dropped. */
 void
 ofpbuf_uninit(struct ofpbuf *b)
 {
     if (b) {
+        if (b->ref_cnt != NULL) {
+            if (--*b->ref_cnt > 0) {
+                return;
+            }
+            free(b->ref_cnt);
+            b->ref_cnt = NULL;
+        }
         free(b->base);
     }
 }
@@ -125,6 +136,50 @@ ofpbuf_clone_data(const void *data, size_t size)
     return b;
 }
 
+/* Creates and returns a new ofpbuf that refers to the same memory as 'b',
+ * without copying the data.  Both ofpbufs may be read, moved and freed
+ * independently; before writing into either one of them (including its
+ * headroom and tailroom), ofpbuf_unshare() must be called on it.  The
+ * ofpbuf_put*() and ofpbuf_push*() functions do so automatically. */
+struct ofpbuf *
+ofpbuf_share(struct ofpbuf *b)
+{
+    struct ofpbuf *share = xmalloc(sizeof *share);
+
+    if (b->ref_cnt == NULL) {
+        b->ref_cnt = xmalloc(sizeof *b->ref_cnt);
+        *b->ref_cnt = 1;
+    }
+    (*b->ref_cnt)++;
+
+    *share = *b;
+    share->next = NULL;
+    share->private_p = NULL;
+    return share;
+}
+
+/* Ensures that 'b' is the only owner of its memory, copying its data into a
+ * private allocation of the same layout if it is shared.  The headroom and
+ * layer pointers of 'b' are preserved relative to the data. */
+void
+ofpbuf_unshare(struct ofpbuf *b)
+{
+    if (b->ref_cnt == NULL) {
+        return;
+    }
+    if (*b->ref_cnt > 1) {
+        void *new_base = xmalloc(b->allocated);
+
+        memcpy((char*)new_base + ofpbuf_headroom(b), b->data, b->size);
+        (*b->ref_cnt)--;
+        b->ref_cnt = NULL;
+        ofpbuf_rebase__(b, new_base);
+    } else {
+        free(b->ref_cnt);
+        b->ref_cnt = NULL;
+    }
+}
+
 /* Frees memory that 'b' points to, as well as 'b' itself. */
 void
 ofpbuf_delete(struct ofpbuf *b) 
@@ -181,6 +236,7 @@ ofpbuf_rebase__(struct ofpbuf *b, void *new_base)
 static void
 ofpbuf_resize_tailroom__(struct ofpbuf *b, size_t new_tailroom)
 {
+    ofpbuf_unshare(b);
     b->allocated = ofpbuf_headroom(b) + b->size + new_tailroom;
     ofpbuf_rebase__(b, xrealloc(b->base, b->allocated));
 }
@@ -219,6 +275,7 @@ void *
 ofpbuf_put_uninit(struct ofpbuf *b, size_t size) 
 {
     void *p;
+    ofpbuf_unshare(b);
     ofpbuf_prealloc_tailroom(b, size);
     p = ofpbuf_tail(b);
     b->size += size;
@@ -260,6 +317,7 @@ ofpbuf_reserve(struct ofpbuf *b, size_t size)
 void *
 ofpbuf_push_uninit(struct ofpbuf *b, size_t size) 
 {
+    ofpbuf_unshare(b);
     ofpbuf_prealloc_headroom(b, size);
     b->data = (char*)b->data - size;
     b->size += size;
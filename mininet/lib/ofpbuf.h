@@ -34,6 +34,7 @@
 #ifndef OFPBUF_H
 #define OFPBUF_H 1
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
@@ -56,6 +57,9 @@ struct ofpbuf {
 
     struct ofpbuf *next;        /* Next in a list of ofpbufs. */
     void *private_p;            /* Private pointer for use by owner. */
+
+    unsigned int *ref_cnt;      /* Number of ofpbufs sharing 'base', or NULL
+                                   if 'base' is owned by this ofpbuf only. */
 };
 
 void ofpbuf_use(struct ofpbuf *, void *, size_t);
@@ -70,6 +74,8 @@ struct ofpbuf *ofpbuf_clone(const struct ofpbuf *);
 struct ofpbuf *ofpbuf_clone_with_headroom(const struct ofpbuf *,
                                           size_t headroom);
 struct ofpbuf *ofpbuf_clone_data(const void *, size_t);
+struct ofpbuf *ofpbuf_share(struct ofpbuf *);
+void ofpbuf_unshare(struct ofpbuf *);
 void ofpbuf_delete(struct ofpbuf *);
 
 void *ofpbuf_at(const struct ofpbuf *, size_t offset, size_t size);
@@ -92,6 +98,15 @@ void ofpbuf_prealloc_tailroom(struct ofpbuf *, size_t);
 void ofpbuf_trim(struct ofpbuf *);
 
 void ofpbuf_clear(struct ofpbuf *);
+
+/* Returns true if the data of 'b' is also referenced by other ofpbufs, that
+ * is, if it must be unshared with ofpbuf_unshare() before writing to it. */
+static inline bool
+ofpbuf_is_shared(const struct ofpbuf *b)
+{
+    return b->ref_cnt != NULL && *b->ref_cnt > 1;
+}
+
 void *ofpbuf_pull(struct ofpbuf *, size_t);
 void *ofpbuf_try_pull(struct ofpbuf *, size_t);
 
@@ -37,6 +37,7 @@
 #include <errno.h>
 #include <inttypes.h>
 #include <string.h>
+#include <sys/time.h>
 #include "compiler.h"
 #include "ofpbuf.h"
 
@@ -75,7 +76,7 @@ pcap_open(const char *file_name, const char *mode)
     }
 
     if (mode[0] == 'r') {
-        if (!pcap_read_header(file)) {
+        if (pcap_read_header(file)) {
             fclose(file);
             return NULL;
         }
@@ -119,8 +120,20 @@ pcap_write_header(FILE *file)
     fwrite(&ph, sizeof ph, 1, file);
 }
 
+static uint32_t
+swap32(uint32_t x)
+{
+    return (((x & 0xff000000) >> 24) |
+            ((x & 0x00ff0000) >>  8) |
+            ((x & 0x0000ff00) <<  8) |
+            ((x & 0x000000ff) << 24));
+}
+
+/* Reads the next packet from 'file' into '*bufp'.  If 'when' is nonnull, also
+ * stores the packet's capture time in microseconds into '*when'.  Returns 0 if
+ * successful, EOF at the end of the file, otherwise a positive errno value. */
 int
-pcap_read(FILE *file, struct ofpbuf **bufp)
+pcap_read(FILE *file, struct ofpbuf **bufp, long long int *when)
 {
     struct pcaprec_hdr prh;
     struct ofpbuf *buf;
@@ -129,21 +142,21 @@ pcap_read(FILE *file, struct ofpbuf **bufp)
 
     *bufp = NULL;
 
-    /* Read header. */
+    /* Read header.  Running out of records is the normal end of the file. */
     if (fread(&prh, sizeof prh, 1, file) != 1) {
-        int error = ferror(file) ? errno : EOF;
-        VLOG_WARN(LOG_MODULE, "failed to read pcap record header: %s",
-                  error > 0 ? strerror(error) : "end of file");
-        return error;
+        if (ferror(file)) {
+            int error = errno;
+            VLOG_WARN(LOG_MODULE, "failed to read pcap record header: %s",
+                      strerror(error));
+            return error;
+        }
+        return EOF;
     }
 
     /* Calculate length. */
     len = prh.incl_len;
     if (len > 0xffff) {
-        uint32_t swapped_len = (((len & 0xff000000) >> 24) |
-                                ((len & 0x00ff0000) >>  8) |
-                                ((len & 0x0000ff00) <<  8) |
-                                ((len & 0x000000ff) << 24));
+        uint32_t swapped_len = swap32(len);
         if (swapped_len > 0xffff) {
             VLOG_WARN(LOG_MODULE, "bad packet length %zu or %"PRIu32" "
                       "reading pcap file",
@@ -151,6 +164,11 @@ pcap_read(FILE *file, struct ofpbuf **bufp)
             return EPROTO;
         }
         len = swapped_len;
+        prh.ts_sec = swap32(prh.ts_sec);
+        prh.ts_usec = swap32(prh.ts_usec);
+    }
+    if (when) {
+        *when = prh.ts_sec * 1000000LL + prh.ts_usec;
     }
 
     /* Read packet. */
@@ -167,12 +185,16 @@ pcap_read(FILE *file, struct ofpbuf **bufp)
     return 0;
 }
 
+/* Writes 'buf' to 'file', stamped with the current time. */
 void
-pcap_write(FILE *file, struct ofpbuf *buf)
+pcap_write(FILE *file, const struct ofpbuf *buf)
 {
     struct pcaprec_hdr prh;
-    prh.ts_sec = 0;
-    prh.ts_usec = 0;
+    struct timeval now;
+
+    gettimeofday(&now, NULL);
+    prh.ts_sec = now.tv_sec;
+    prh.ts_usec = now.tv_usec;
     prh.incl_len = buf->size;
     prh.orig_len = buf->size;
     fwrite(&prh, sizeof prh, 1, file);
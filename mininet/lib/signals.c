@@ -115,9 +115,11 @@ bool
 signal_poll(struct signal *s)
 {
     char buf[_POSIX_PIPE_BUF];
-    if (read(fds[0], buf, sizeof buf) != sizeof(buf)){
-        fprintf(stderr, "read failed: %s\n",
-                strerror(errno));    
+
+    /* Drain the wakeup bytes.  The pipe is nonblocking, so EAGAIN just means
+     * that no signal arrived since the last call. */
+    while (read(fds[0], buf, sizeof buf) > 0) {
+        continue;
     }
     if (signaled[s->signr]) {
         signaled[s->signr] = 0;
@@ -119,6 +119,19 @@ time_msec(void)
     return (long long int) now.tv_sec * 1000 + now.tv_usec / 1000;
 }
 
+/* Returns the current monotonic time, in ns. Unlike time_msec(), this is
+ * read from the clock on every call. */
+long long int
+time_nsec(void)
+{
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) < 0) {
+        ofp_fatal(errno, "clock_gettime failed");
+    }
+    return (long long int) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
 /* Configures the program to die with SIGALRM 'secs' seconds from now, if
  * 'secs' is nonzero, or disables the feature if 'secs' is zero. */
 void
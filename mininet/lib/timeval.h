@@ -60,6 +60,7 @@ void time_init(void);
 void time_refresh(void);
 time_t time_now(void);
 long long int time_msec(void);
+long long int time_nsec(void);
 void time_alarm(unsigned int secs);
 int time_poll(struct pollfd *, int n_pollfds, int timeout);
 
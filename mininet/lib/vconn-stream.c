@@ -39,6 +39,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <unistd.h>
 #include "ofpbuf.h"
 #include "openflow/openflow.h"
@@ -51,14 +52,35 @@
 #include "vlog.h"
 #define LOG_MODULE VLM_vconn_stream
 
-/* Active stream socket vconn. */
+/* Active stream socket vconn.
+ *
+ * Received data is read into a per-connection buffer as large as the socket
+ * will fill, and messages are framed out of it, so that a burst of messages
+ * costs one read() rather than two per message.  Sent messages are queued
+ * and written out together with writev() once the socket is writable, or as
+ * soon as enough of them have been queued. */
+
+/* Size of the receive buffer.  It grows if a message does not fit. */
+#define RX_BUFFER_SIZE  65536
+
+/* Queued bytes at which sent messages are written out right away. */
+#define TX_FLUSH_BYTES  65536
+
+/* Queued bytes at which stream_send() refuses new messages. */
+#define TX_QUEUE_MAX    (4 * TX_FLUSH_BYTES)
+
+/* Maximum number of messages written with a single writev(). */
+#define TX_IOV_MAX      64
 
 struct stream_vconn
 {
     struct vconn vconn;
     int fd;
-    struct ofpbuf *rxbuf;
-    struct ofpbuf *txbuf;
+    struct ofpbuf rxbuf;        /* Received data not yet returned. */
+    struct ofpbuf *tx_head;     /* Queued messages, linked by 'next'. */
+    struct ofpbuf *tx_tail;
+    size_t tx_bytes;            /* Number of bytes in the queue. */
+    int tx_error;               /* Error of a deferred write, if any. */
     struct poll_waiter *tx_waiter;
 };
 
@@ -67,6 +89,7 @@ static struct vconn_class stream_vconn_class;
 static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(10, 25);
 
 static void stream_clear_txbuf(struct stream_vconn *);
+static int stream_flush(struct stream_vconn *);
 
 int
 new_stream_vconn(const char *name, int fd, int connect_status,
@@ -78,9 +101,11 @@ new_stream_vconn(const char *name, int fd, int connect_status,
     vconn_init(&s->vconn, &stream_vconn_class, connect_status, ip, name,
                reconnectable);
     s->fd = fd;
-    s->txbuf = NULL;
+    s->tx_head = s->tx_tail = NULL;
+    s->tx_bytes = 0;
+    s->tx_error = 0;
     s->tx_waiter = NULL;
-    s->rxbuf = NULL;
+    ofpbuf_init(&s->rxbuf, RX_BUFFER_SIZE);
     *vconnp = &s->vconn;
     return 0;
 }
@@ -97,8 +122,12 @@ stream_close(struct vconn *vconn)
 {
     struct stream_vconn *s = stream_vconn_cast(vconn);
     poll_cancel(s->tx_waiter);
+    /* Give queued messages a last chance to make it out. */
+    if (!s->tx_error) {
+        stream_flush(s);
+    }
     stream_clear_txbuf(s);
-    ofpbuf_delete(s->rxbuf);
+    ofpbuf_uninit(&s->rxbuf);
     close(s->fd);
     free(s);
 }
@@ -110,118 +139,192 @@ stream_connect(struct vconn *vconn)
     return check_connection_completion(s->fd);
 }
 
+/* Returns the length of the first message in 'rx' if it has been received
+ * completely, 0 if it has not, or -1 if its header is invalid. */
+static int
+rx_message_length(const struct ofpbuf *rx)
+{
+    const struct ofp_header *oh = rx->data;
+    size_t length;
+
+    if (rx->size < sizeof(struct ofp_header)) {
+        return 0;
+    }
+    length = ntohs(oh->length);
+    if (length < sizeof(struct ofp_header)) {
+        VLOG_ERR_RL(LOG_MODULE, &rl, "received too-short ofp_header (%zu bytes)",
+                    length);
+        return -1;
+    }
+    return length <= rx->size ? length : 0;
+}
+
 static int
 stream_recv(struct vconn *vconn, struct ofpbuf **bufferp)
 {
     struct stream_vconn *s = stream_vconn_cast(vconn);
-    struct ofpbuf *rx;
-    size_t want_bytes;
+    struct ofpbuf *rx = &s->rxbuf;
     ssize_t retval;
 
-    if (s->rxbuf == NULL) {
-        s->rxbuf = ofpbuf_new(1564);
-    }
-    rx = s->rxbuf;
+    for (;;) {
+        int length = rx_message_length(rx);
+        size_t want_bytes;
 
-again:
-    if (sizeof(struct ofp_header) > rx->size) {
-        want_bytes = sizeof(struct ofp_header) - rx->size;
-    } else {
-        struct ofp_header *oh = rx->data;
-        size_t length = ntohs(oh->length);
-        if (length < sizeof(struct ofp_header)) {
-            VLOG_ERR_RL(LOG_MODULE, &rl, "received too-short ofp_header (%zu bytes)",
-                        length);
+        if (length < 0) {
             return EPROTO;
-        }
-        want_bytes = length - rx->size;
-        if (!want_bytes) {
-            *bufferp = rx;
-            s->rxbuf = NULL;
+        } else if (length > 0) {
+            *bufferp = ofpbuf_clone_data(rx->data, length);
+            ofpbuf_pull(rx, length);
+            if (!rx->size) {
+                rx->data = rx->base;
+            }
             return 0;
         }
-    }
-    ofpbuf_prealloc_tailroom(rx, want_bytes);
-
-    retval = read(s->fd, ofpbuf_tail(rx), want_bytes);
-    if (retval > 0) {
-        rx->size += retval;
-        if (retval == want_bytes) {
-            if (rx->size > sizeof(struct ofp_header)) {
-                *bufferp = rx;
-                s->rxbuf = NULL;
-                return 0;
+
+        /* Move the partial message to the front, and make sure the rest of
+         * it fits. */
+        if (rx->data != rx->base) {
+            memmove(rx->base, rx->data, rx->size);
+            rx->data = rx->base;
+        }
+        want_bytes = sizeof(struct ofp_header);
+        if (rx->size >= sizeof(struct ofp_header)) {
+            want_bytes = ntohs(((struct ofp_header *) rx->data)->length);
+        }
+        ofpbuf_prealloc_tailroom(rx, want_bytes - rx->size);
+
+        retval = read(s->fd, ofpbuf_tail(rx), ofpbuf_tailroom(rx));
+        if (retval > 0) {
+            rx->size += retval;
+        } else if (retval == 0) {
+            if (rx->size) {
+                VLOG_ERR_RL(LOG_MODULE, &rl, "connection dropped mid-packet");
+                return EPROTO;
             } else {
-                goto again;
+                return EOF;
             }
-        }
-        return EAGAIN;
-    } else if (retval == 0) {
-        if (rx->size) {
-            VLOG_ERR_RL(LOG_MODULE, &rl, "connection dropped mid-packet");
-            return EPROTO;
         } else {
-            return EOF;
+            return errno;
         }
-    } else {
-        return errno;
     }
 }
 
 static void
 stream_clear_txbuf(struct stream_vconn *s)
 {
-    ofpbuf_delete(s->txbuf);
-    s->txbuf = NULL;
+    while (s->tx_head) {
+        struct ofpbuf *next = s->tx_head->next;
+        ofpbuf_delete(s->tx_head);
+        s->tx_head = next;
+    }
+    s->tx_tail = NULL;
+    s->tx_bytes = 0;
     s->tx_waiter = NULL;
 }
 
+/* Writes out as much of the queued messages as the socket takes.  Returns 0
+ * if successful, even if messages remain queued, otherwise a positive errno
+ * value. */
+static int
+stream_flush(struct stream_vconn *s)
+{
+    while (s->tx_head) {
+        struct iovec iov[TX_IOV_MAX];
+        struct ofpbuf *b;
+        size_t n_iov = 0, n_bytes = 0, n_written;
+        ssize_t n;
+
+        for (b = s->tx_head; b && n_iov < TX_IOV_MAX; b = b->next) {
+            iov[n_iov].iov_base = b->data;
+            iov[n_iov].iov_len = b->size;
+            n_bytes += b->size;
+            n_iov++;
+        }
+
+        n = writev(s->fd, iov, n_iov);
+        if (n < 0) {
+            return errno == EAGAIN ? 0 : errno;
+        }
+        n_written = n;
+
+        s->tx_bytes -= n;
+        while (n > 0) {
+            b = s->tx_head;
+            if (n < b->size) {
+                ofpbuf_pull(b, n);
+                break;
+            }
+            n -= b->size;
+            s->tx_head = b->next;
+            ofpbuf_delete(b);
+        }
+        if (!s->tx_head) {
+            s->tx_tail = NULL;
+        }
+        if (n_written < n_bytes) {
+            /* The socket is full. */
+            break;
+        }
+    }
+    return 0;
+}
+
 static void
 stream_do_tx(int fd UNUSED, short int revents UNUSED, void *vconn_)
 {
     struct vconn *vconn = vconn_;
     struct stream_vconn *s = stream_vconn_cast(vconn);
-    ssize_t n = write(s->fd, s->txbuf->data, s->txbuf->size);
-    if (n < 0) {
-        if (errno != EAGAIN) {
-            VLOG_ERR_RL(LOG_MODULE, &rl, "send: %s", strerror(errno));
-            stream_clear_txbuf(s);
-            return;
-        }
-    } else if (n > 0) {
-        ofpbuf_pull(s->txbuf, n);
-        if (!s->txbuf->size) {
-            stream_clear_txbuf(s);
-            return;
-        }
+    int error;
+
+    s->tx_waiter = NULL;
+    error = stream_flush(s);
+    if (error) {
+        VLOG_ERR_RL(LOG_MODULE, &rl, "send: %s", strerror(error));
+        stream_clear_txbuf(s);
+        s->tx_error = error;
+        return;
+    }
+    if (s->tx_head) {
+        s->tx_waiter = poll_fd_callback(s->fd, POLLOUT, stream_do_tx, vconn);
     }
-    s->tx_waiter = poll_fd_callback(s->fd, POLLOUT, stream_do_tx, vconn);
 }
 
 static int
 stream_send(struct vconn *vconn, struct ofpbuf *buffer)
 {
     struct stream_vconn *s = stream_vconn_cast(vconn);
-    ssize_t retval;
 
-    if (s->txbuf) {
+    if (s->tx_error) {
+        return s->tx_error;
+    }
+    if (s->tx_bytes >= TX_QUEUE_MAX) {
         return EAGAIN;
     }
 
-    retval = write(s->fd, buffer->data, buffer->size);
-    if (retval == buffer->size) {
-        ofpbuf_delete(buffer);
-        return 0;
-    } else if (retval >= 0 || errno == EAGAIN) {
-        s->txbuf = buffer;
-        if (retval > 0) {
-            ofpbuf_pull(buffer, retval);
+    buffer->next = NULL;
+    if (s->tx_tail) {
+        s->tx_tail->next = buffer;
+    } else {
+        s->tx_head = buffer;
+    }
+    s->tx_tail = buffer;
+    s->tx_bytes += buffer->size;
+
+    if (s->tx_bytes >= TX_FLUSH_BYTES) {
+        int error = stream_flush(s);
+        if (error) {
+            /* The message is gone along with the rest of the queue. */
+            VLOG_ERR_RL(LOG_MODULE, &rl, "send: %s", strerror(error));
+            poll_cancel(s->tx_waiter);
+            stream_clear_txbuf(s);
+            s->tx_error = error;
+            return 0;
         }
+    }
+    if (s->tx_head && !s->tx_waiter) {
         s->tx_waiter = poll_fd_callback(s->fd, POLLOUT, stream_do_tx, vconn);
-        return 0;
-    } else {
-        return errno;
     }
+    return 0;
 }
 
 static void
@@ -234,15 +337,20 @@ stream_wait(struct vconn *vconn, enum vconn_wait_type wait)
         break;
 
     case WAIT_SEND:
-        if (!s->txbuf) {
-            poll_fd_wait(s->fd, POLLOUT);
+        if (s->tx_bytes < TX_QUEUE_MAX || s->tx_error) {
+            poll_immediate_wake();
         } else {
-            /* Nothing to do: need to drain txbuf first. */
+            /* Nothing to do: need to drain the queue first. */
         }
         break;
 
     case WAIT_RECV:
-        poll_fd_wait(s->fd, POLLIN);
+        if (rx_message_length(&s->rxbuf)) {
+            /* A message is already buffered. */
+            poll_immediate_wake();
+        } else {
+            poll_fd_wait(s->fd, POLLIN);
+        }
         break;
 
     default:
@@ -36,6 +36,7 @@
 #include <assert.h>
 #include <ctype.h>
 #include <errno.h>
+#include <pthread.h>
 #include <stdarg.h>
 #include <stdlib.h>
 #include <string.h>
@@ -98,6 +99,32 @@ static long long int boot_time;
 static char *log_file_name;
 static FILE *log_file;
 
+/* Background writer. Once started with vlog_start_writer(), messages for the
+ * syslog and file facilities are formatted by the caller and queued, and a
+ * thread of its own does the syslog() calls and file writes, so that a slow
+ * disk or syslog daemon never stalls the caller. Messages that find the
+ * queue full are dropped and counted. */
+#define VLOG_QUEUE_MAX 4096
+
+struct vlog_line {
+    int syslog_level;           /* Syslog level, or -1 for the log file. */
+    char *text;
+};
+
+static bool writer_running;
+static pthread_t writer_thread;
+static pthread_mutex_t queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_cond = PTHREAD_COND_INITIALIZER;  /* not empty */
+static pthread_cond_t idle_cond = PTHREAD_COND_INITIALIZER;   /* drained */
+static struct vlog_line queue[VLOG_QUEUE_MAX];
+static unsigned int queue_head, queue_tail; /* free-running indexes. */
+static unsigned int queue_dropped;          /* lines dropped, not reported. */
+static bool writer_busy;                    /* writing lines off the queue. */
+static bool writer_stop;
+
+/* Held by the writer while it writes to 'log_file'. */
+static pthread_mutex_t file_mutex = PTHREAD_MUTEX_INITIALIZER;
+
 static void format_log_message(enum vlog_module, enum vlog_level,
                                enum vlog_facility, unsigned int msg_num,
                                const char *message, va_list, struct ds *)
@@ -278,8 +305,11 @@ vlog_set_log_file(const char *file_name)
     /* Close old log file. */
     if (log_file) {
         VLOG_INFO(LOG_MODULE, "closing log file");
+        vlog_flush();
+        pthread_mutex_lock(&file_mutex);
         fclose(log_file);
         log_file = NULL;
+        pthread_mutex_unlock(&file_mutex);
     }
 
     /* Update log file name and free old name.  The ordering is important
@@ -293,7 +323,9 @@ vlog_set_log_file(const char *file_name)
 
     /* Open new log file and update min_levels[] to reflect whether we actually
      * have a log_file. */
+    pthread_mutex_lock(&file_mutex);
     log_file = fopen(log_file_name, "a");
+    pthread_mutex_unlock(&file_mutex);
     for (module = 0; module < VLM_N_MODULES; module++) {
         update_min_level(module);
     }
@@ -559,6 +591,134 @@ format_log_message(enum vlog_module module, enum vlog_level level,
     }
 }
 
+/* Queues 'text' for the writer, taking its ownership. */
+static void
+queue_line(int syslog_level, char *text)
+{
+    pthread_mutex_lock(&queue_mutex);
+    if (queue_tail - queue_head < VLOG_QUEUE_MAX) {
+        struct vlog_line *line = &queue[queue_tail++ % VLOG_QUEUE_MAX];
+
+        line->syslog_level = syslog_level;
+        line->text = text;
+        text = NULL;
+        pthread_cond_signal(&queue_cond);
+    } else {
+        queue_dropped++;
+    }
+    pthread_mutex_unlock(&queue_mutex);
+    free(text);
+}
+
+static void
+write_line(int syslog_level, const char *text)
+{
+    if (syslog_level >= 0) {
+        syslog(syslog_level, "%s", text);
+    } else if (log_file) {
+        fputs(text, log_file);
+    }
+}
+
+static void *
+writer_main(void *aux UNUSED)
+{
+    pthread_mutex_lock(&queue_mutex);
+    for (;;) {
+        unsigned int head, tail, dropped;
+
+        while (queue_head == queue_tail && !queue_dropped && !writer_stop) {
+            writer_busy = false;
+            pthread_cond_broadcast(&idle_cond);
+            pthread_cond_wait(&queue_cond, &queue_mutex);
+        }
+        if (queue_head == queue_tail && !queue_dropped) {
+            break;
+        }
+        writer_busy = true;
+        head = queue_head;
+        tail = queue_tail;
+        dropped = queue_dropped;
+        queue_dropped = 0;
+        pthread_mutex_unlock(&queue_mutex);
+
+        /* The lines between 'head' and 'tail' are only touched by this
+         * thread until 'queue_head' moves past them. */
+        pthread_mutex_lock(&file_mutex);
+        for (; head != tail; head++) {
+            struct vlog_line *line = &queue[head % VLOG_QUEUE_MAX];
+
+            write_line(line->syslog_level, line->text);
+            free(line->text);
+        }
+        if (dropped) {
+            char *text = xasprintf("vlog|WARN|dropped %u log messages: "
+                                   "the writer fell behind\n", dropped);
+
+            write_line(LOG_WARNING, text);
+            write_line(-1, text);
+            free(text);
+        }
+        if (log_file) {
+            fflush(log_file);
+        }
+        pthread_mutex_unlock(&file_mutex);
+
+        pthread_mutex_lock(&queue_mutex);
+        queue_head = tail;
+    }
+    writer_busy = false;
+    pthread_cond_broadcast(&idle_cond);
+    pthread_mutex_unlock(&queue_mutex);
+    return NULL;
+}
+
+static void
+stop_writer(void)
+{
+    pthread_mutex_lock(&queue_mutex);
+    writer_stop = true;
+    pthread_cond_signal(&queue_cond);
+    pthread_mutex_unlock(&queue_mutex);
+    pthread_join(writer_thread, NULL);
+    writer_running = false;
+}
+
+/* Starts writing the syslog and file facilities from a background thread.
+ * Call it after daemonize(), since the thread does not survive a fork(). The
+ * queue is written out at exit(). */
+void
+vlog_start_writer(void)
+{
+    int error;
+
+    if (writer_running) {
+        return;
+    }
+    error = pthread_create(&writer_thread, NULL, writer_main, NULL);
+    if (error) {
+        VLOG_WARN(LOG_MODULE, "could not start log writer thread (%s), "
+                  "logging synchronously", strerror(error));
+        return;
+    }
+    writer_running = true;
+    atexit(stop_writer);
+}
+
+/* Waits until the background writer has written out every message logged so
+ * far. */
+void
+vlog_flush(void)
+{
+    if (writer_running) {
+        pthread_mutex_lock(&queue_mutex);
+        while (queue_head != queue_tail || queue_dropped || writer_busy) {
+            pthread_cond_wait(&idle_cond, &queue_mutex);
+        }
+        pthread_mutex_unlock(&queue_mutex);
+    }
+}
+
 /* Writes 'message' to the log at the given 'level' and as coming from the
  * given 'module'.
  *
@@ -595,7 +755,11 @@ vlog_valist(enum vlog_module module, enum vlog_level level,
                                message, args, &s);
             for (line = strtok_r(s.string, "\n", &save_ptr); line;
                  line = strtok_r(NULL, "\n", &save_ptr)) {
-                syslog(syslog_level, "%s", line);
+                if (writer_running) {
+                    queue_line(syslog_level, xstrdup(line));
+                } else {
+                    syslog(syslog_level, "%s", line);
+                }
             }
         }
 
@@ -603,8 +767,12 @@ vlog_valist(enum vlog_module module, enum vlog_level level,
             format_log_message(module, level, VLF_FILE, msg_num,
                                message, args, &s);
             ds_put_char(&s, '\n');
-            fputs(ds_cstr(&s), log_file);
-            fflush(log_file);
+            if (writer_running) {
+                queue_line(-1, xstrdup(ds_cstr(&s)));
+            } else {
+                fputs(ds_cstr(&s), log_file);
+                fflush(log_file);
+            }
         }
 
         ds_destroy(&s);
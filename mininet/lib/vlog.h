@@ -128,6 +128,8 @@ void vlog_set_pattern(enum vlog_facility, const char *pattern);
 const char *vlog_get_log_file(void);
 int vlog_set_log_file(const char *file_name);
 int vlog_reopen_log_file(void);
+void vlog_start_writer(void);
+void vlog_flush(void);
 
 /* Function for actual logging. */
 void vlog_init(void);
@@ -153,10 +155,10 @@ void vlog_rate_limit(enum vlog_module, enum vlog_level,
  * MODULE.  When constructing a log message is expensive, this enables it
  * to be skipped. */
 #define VLOG_IS_EMER_ENABLED(MODULE) true
-#define VLOG_IS_ERR_ENABLED(MODULE) vlog_is_enabled(MODULE, VLL_EMER)
-#define VLOG_IS_WARN_ENABLED(MODULE) vlog_is_enabled(MODULE, VLL_WARN)
-#define VLOG_IS_INFO_ENABLED(MODULE) vlog_is_enabled(MODULE, VLL_INFO)
-#define VLOG_IS_DBG_ENABLED(MODULE) vlog_is_enabled(MODULE, VLL_DBG)
+#define VLOG_IS_ERR_ENABLED(MODULE) VLOG_IS_ENABLED(MODULE, VLL_ERR)
+#define VLOG_IS_WARN_ENABLED(MODULE) VLOG_IS_ENABLED(MODULE, VLL_WARN)
+#define VLOG_IS_INFO_ENABLED(MODULE) VLOG_IS_ENABLED(MODULE, VLL_INFO)
+#define VLOG_IS_DBG_ENABLED(MODULE) VLOG_IS_ENABLED(MODULE, VLL_DBG)
 
 /* Convenience macros.
  * Guaranteed to preserve errno.
@@ -181,15 +183,28 @@ void vlog_rate_limit(enum vlog_module, enum vlog_level,
 void vlog_usage(void);
 
 /* Implementation details. */
+
+/* The most verbose level compiled in.  Messages above it are discarded at
+ * compile time, along with the evaluation of their arguments; the
+ * configure option --enable-dp-log lowers it for the datapath. */
+#ifndef VLOG_MAX_LEVEL
+#define VLOG_MAX_LEVEL VLL_DBG
+#endif
+
+/* Tests the cached minimum level of MODULE, without a function call, so that
+ * the arguments of a disabled message are never evaluated. */
+#define VLOG_IS_ENABLED(MODULE, LEVEL)                                  \
+    ((LEVEL) <= VLOG_MAX_LEVEL && min_vlog_levels[MODULE] >= (LEVEL))
+
 #define VLOG(MODULE, LEVEL, ...)                        \
     do {                                                \
-        if (min_vlog_levels[MODULE] >= LEVEL)      {    \
+        if (VLOG_IS_ENABLED(MODULE, LEVEL)) {           \
             vlog(MODULE, LEVEL, __VA_ARGS__);           \
         }                                               \
     } while (0)
 #define VLOG_RL(MODULE, RL, LEVEL, ...)                             \
     do {                                                            \
-        if (min_vlog_levels[MODULE] >= LEVEL) {                     \
+        if (VLOG_IS_ENABLED(MODULE, LEVEL)) {                       \
             vlog_rate_limit(MODULE, LEVEL, RL, __VA_ARGS__);        \
         }                                                           \
     } while (0)
@@ -29,15 +29,19 @@
  * Author: Zoltán Lajos Kis <zoltan.lajos.kis@ericsson.com>
  */
 
+#include <errno.h>
+#include <inttypes.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
 #include <netinet/in.h>
 #include "openflow/openflow.h"
 #include "openflow/openflow-ext.h"
 #include "ofl-exp-openflow.h"
 #include "../oflib/ofl-log.h"
 #include "../oflib/ofl-print.h"
+#include "../oflib/ofl-utils.h"
 
 #define LOG_MODULE ofl_exp_of
 OFL_LOG_INIT(LOG_MODULE)
@@ -78,6 +82,27 @@ ofl_exp_openflow_msg_pack(struct ofl_msg_experimenter *msg, uint8_t **buf, size_
 
                 return 0;
             }
+            case (OFP_EXT_SET_PATH_MODE): {
+                struct ofl_exp_openflow_msg_set_path_mode *m = (struct ofl_exp_openflow_msg_set_path_mode *)exp;
+                struct openflow_ext_set_path_mode *ofp;
+
+                *buf_len  = sizeof(struct openflow_ext_set_path_mode);
+                *buf     = (uint8_t *)malloc(*buf_len);
+
+                ofp = (struct openflow_ext_set_path_mode *)(*buf);
+                ofp->header.vendor  = htonl(exp->header.experimenter_id);
+                ofp->header.subtype = htonl(exp->type);
+                ofp->mode       = m->mode;
+                ofp->pad        = 0x00;
+                ofp->flags      = htons(m->flags);
+                ofp->flags_mask = htons(m->flags_mask);
+                ofp->bt_time    = htons(m->bt_time);
+                ofp->lt_time    = htons(m->lt_time);
+                ofp->tcp_time   = htons(m->tcp_time);
+                memset(ofp->pad2, 0x00, sizeof(ofp->pad2));
+
+                return 0;
+            }
             default: {
                 OFL_LOG_WARN(LOG_MODULE, "Trying to print unknown Openflow Experimenter message.");
                 return -1;
@@ -152,6 +177,31 @@ ofl_exp_openflow_msg_unpack(struct ofp_header *oh, size_t *len, struct ofl_msg_e
                 (*msg) = (struct ofl_msg_experimenter *)dst;
                 return 0;
             }
+            case (OFP_EXT_SET_PATH_MODE): {
+                struct openflow_ext_set_path_mode *src;
+                struct ofl_exp_openflow_msg_set_path_mode *dst;
+
+                if (*len < sizeof(struct openflow_ext_set_path_mode)) {
+                    OFL_LOG_WARN(LOG_MODULE, "Received EXT_SET_PATH_MODE message has invalid length (%zu).", *len);
+                    return ofl_error(OFPET_BAD_REQUEST, OFPBRC_BAD_LEN);
+                }
+                *len -= sizeof(struct openflow_ext_set_path_mode);
+
+                src = (struct openflow_ext_set_path_mode *)exp;
+
+                dst = (struct ofl_exp_openflow_msg_set_path_mode *)malloc(sizeof(struct ofl_exp_openflow_msg_set_path_mode));
+                dst->header.header.experimenter_id = ntohl(exp->vendor);
+                dst->header.type                   = ntohl(exp->subtype);
+                dst->mode                          = src->mode;
+                dst->flags                         = ntohs(src->flags);
+                dst->flags_mask                    = ntohs(src->flags_mask);
+                dst->bt_time                       = ntohs(src->bt_time);
+                dst->lt_time                       = ntohs(src->lt_time);
+                dst->tcp_time                      = ntohs(src->tcp_time);
+
+                (*msg) = (struct ofl_msg_experimenter *)dst;
+                return 0;
+            }
             default: {
                 OFL_LOG_WARN(LOG_MODULE, "Trying to unpack unknown Openflow Experimenter message.");
                 return ofl_error(OFPET_BAD_REQUEST, OFPBRC_BAD_EXPERIMENTER);
@@ -181,6 +231,9 @@ ofl_exp_openflow_msg_free(struct ofl_msg_experimenter *msg) {
                 free(s->dp_desc);
                 break;
             }
+            case (OFP_EXT_SET_PATH_MODE): {
+                break;
+            }
             default: {
                 OFL_LOG_WARN(LOG_MODULE, "Trying to free unknown Openflow Experimenter message.");
             }
@@ -216,6 +269,14 @@ ofl_exp_openflow_msg_to_string(struct ofl_msg_experimenter *msg) {
                 fprintf(stream, "setdesc{desc=\"%s\"}", s->dp_desc);
                 break;
             }
+            case (OFP_EXT_SET_PATH_MODE): {
+                struct ofl_exp_openflow_msg_set_path_mode *m = (struct ofl_exp_openflow_msg_set_path_mode *)exp;
+                fprintf(stream, "setpathmode{mode=\"%s\", flags=\"0x%"PRIx16"\", mask=\"0x%"PRIx16"\", "
+                                "bt=\"%u\", lt=\"%u\", tcp=\"%u\"}",
+                        ofl_exp_path_mode_name(m->mode), m->flags, m->flags_mask,
+                        m->bt_time, m->lt_time, m->tcp_time);
+                break;
+            }
             default: {
                 OFL_LOG_WARN(LOG_MODULE, "Trying to print unknown Openflow Experimenter message.");
                 fprintf(stream, "ofexp{type=\"%u\"}", exp->type);
@@ -229,3 +290,779 @@ ofl_exp_openflow_msg_to_string(struct ofl_msg_experimenter *msg) {
     fclose(stream);
     return str;
 }
+
+int
+ofl_exp_openflow_stats_req_pack(struct ofl_msg_multipart_request_header *msg, uint8_t **buf, size_t *buf_len) {
+    struct ofl_exp_openflow_mp_request_header *exp = (struct ofl_exp_openflow_mp_request_header *)msg;
+
+    if (exp->header.experimenter_id == OPENFLOW_VENDOR_ID) {
+        switch (exp->type) {
+            case (OFP_EXT_MP_STAGES): {
+                struct ofl_exp_openflow_mp_request_stages *s = (struct ofl_exp_openflow_mp_request_stages *)exp;
+                struct ofp_multipart_request *req;
+                struct ofp_ext_stages_request *ofp;
+
+                *buf_len = sizeof(struct ofp_multipart_request) + sizeof(struct ofp_ext_stages_request);
+                *buf     = (uint8_t *)malloc(*buf_len);
+
+                req = (struct ofp_multipart_request *)(*buf);
+                ofp = (struct ofp_ext_stages_request *)req->body;
+                ofp->header.experimenter = htonl(exp->header.experimenter_id);
+                ofp->header.exp_type     = htonl(exp->type);
+                ofp->command = s->command;
+                memset(ofp->pad, 0x00, sizeof(ofp->pad));
+                return 0;
+            }
+            case (OFP_EXT_MP_TRACE): {
+                struct ofl_exp_openflow_mp_request_trace *t = (struct ofl_exp_openflow_mp_request_trace *)exp;
+                struct ofp_multipart_request *req;
+                struct ofp_ext_trace_request *ofp;
+
+                *buf_len = sizeof(struct ofp_multipart_request) + sizeof(struct ofp_ext_trace_request);
+                *buf     = (uint8_t *)malloc(*buf_len);
+
+                req = (struct ofp_multipart_request *)(*buf);
+                ofp = (struct ofp_ext_trace_request *)req->body;
+                ofp->header.experimenter = htonl(exp->header.experimenter_id);
+                ofp->header.exp_type     = htonl(exp->type);
+                ofp->command = t->command;
+                memset(ofp->pad, 0x00, sizeof(ofp->pad));
+                ofp->size = htonl(t->size);
+                return 0;
+            }
+            case (OFP_EXT_MP_COUNTERS): {
+                struct ofp_multipart_request *req;
+                struct ofp_ext_counters_request *ofp;
+
+                *buf_len = sizeof(struct ofp_multipart_request) + sizeof(struct ofp_ext_counters_request);
+                *buf     = (uint8_t *)malloc(*buf_len);
+
+                req = (struct ofp_multipart_request *)(*buf);
+                ofp = (struct ofp_ext_counters_request *)req->body;
+                ofp->header.experimenter = htonl(exp->header.experimenter_id);
+                ofp->header.exp_type     = htonl(exp->type);
+                return 0;
+            }
+            default: {
+                OFL_LOG_WARN(LOG_MODULE, "Trying to pack unknown Openflow Experimenter stats request.");
+                return -1;
+            }
+        }
+    } else {
+        OFL_LOG_WARN(LOG_MODULE, "Trying to pack non-Openflow Experimenter stats request.");
+        return -1;
+    }
+}
+
+ofl_err
+ofl_exp_openflow_stats_req_unpack(struct ofp_multipart_request *os, size_t *len, struct ofl_msg_multipart_request_header **msg) {
+    struct ofp_experimenter_multipart_header *exp;
+
+    if (*len < sizeof(struct ofp_experimenter_multipart_header)) {
+        OFL_LOG_WARN(LOG_MODULE, "Received EXPERIMENTER stats request has invalid length (%zu).", *len);
+        return ofl_error(OFPET_BAD_REQUEST, OFPBRC_BAD_LEN);
+    }
+
+    exp = (struct ofp_experimenter_multipart_header *)os->body;
+
+    if (ntohl(exp->experimenter) == OPENFLOW_VENDOR_ID) {
+        switch (ntohl(exp->exp_type)) {
+            case (OFP_EXT_MP_STAGES): {
+                struct ofp_ext_stages_request *src;
+                struct ofl_exp_openflow_mp_request_stages *dst;
+
+                if (*len < sizeof(struct ofp_ext_stages_request)) {
+                    OFL_LOG_WARN(LOG_MODULE, "Received EXT_MP_STAGES request has invalid length (%zu).", *len);
+                    return ofl_error(OFPET_BAD_REQUEST, OFPBRC_BAD_LEN);
+                }
+                *len -= sizeof(struct ofp_ext_stages_request);
+
+                src = (struct ofp_ext_stages_request *)exp;
+
+                dst = (struct ofl_exp_openflow_mp_request_stages *)malloc(sizeof(struct ofl_exp_openflow_mp_request_stages));
+                dst->header.header.experimenter_id = ntohl(exp->experimenter);
+                dst->header.type                   = ntohl(exp->exp_type);
+                dst->command                       = src->command;
+
+                (*msg) = (struct ofl_msg_multipart_request_header *)dst;
+                return 0;
+            }
+            case (OFP_EXT_MP_TRACE): {
+                struct ofp_ext_trace_request *src;
+                struct ofl_exp_openflow_mp_request_trace *dst;
+
+                if (*len < sizeof(struct ofp_ext_trace_request)) {
+                    OFL_LOG_WARN(LOG_MODULE, "Received EXT_MP_TRACE request has invalid length (%zu).", *len);
+                    return ofl_error(OFPET_BAD_REQUEST, OFPBRC_BAD_LEN);
+                }
+                *len -= sizeof(struct ofp_ext_trace_request);
+
+                src = (struct ofp_ext_trace_request *)exp;
+
+                dst = (struct ofl_exp_openflow_mp_request_trace *)malloc(sizeof(struct ofl_exp_openflow_mp_request_trace));
+                dst->header.header.experimenter_id = ntohl(exp->experimenter);
+                dst->header.type                   = ntohl(exp->exp_type);
+                dst->command                       = src->command;
+                dst->size                          = ntohl(src->size);
+
+                (*msg) = (struct ofl_msg_multipart_request_header *)dst;
+                return 0;
+            }
+            case (OFP_EXT_MP_COUNTERS): {
+                struct ofl_exp_openflow_mp_request_counters *dst;
+
+                if (*len < sizeof(struct ofp_ext_counters_request)) {
+                    OFL_LOG_WARN(LOG_MODULE, "Received EXT_MP_COUNTERS request has invalid length (%zu).", *len);
+                    return ofl_error(OFPET_BAD_REQUEST, OFPBRC_BAD_LEN);
+                }
+                *len -= sizeof(struct ofp_ext_counters_request);
+
+                dst = (struct ofl_exp_openflow_mp_request_counters *)malloc(sizeof(struct ofl_exp_openflow_mp_request_counters));
+                dst->header.header.experimenter_id = ntohl(exp->experimenter);
+                dst->header.type                   = ntohl(exp->exp_type);
+
+                (*msg) = (struct ofl_msg_multipart_request_header *)dst;
+                return 0;
+            }
+            default: {
+                OFL_LOG_WARN(LOG_MODULE, "Trying to unpack unknown Openflow Experimenter stats request.");
+                return ofl_error(OFPET_BAD_REQUEST, OFPBRC_BAD_EXP_TYPE);
+            }
+        }
+    } else {
+        OFL_LOG_WARN(LOG_MODULE, "Trying to unpack non-Openflow Experimenter stats request.");
+        return ofl_error(OFPET_BAD_REQUEST, OFPBRC_BAD_EXPERIMENTER);
+    }
+}
+
+int
+ofl_exp_openflow_stats_req_free(struct ofl_msg_multipart_request_header *msg) {
+    free(msg);
+    return 0;
+}
+
+static const char *
+stages_command_name(uint8_t command) {
+    switch (command) {
+        case (OFP_EXT_STAGES_GET):     return "get";
+        case (OFP_EXT_STAGES_ENABLE):  return "on";
+        case (OFP_EXT_STAGES_DISABLE): return "off";
+        case (OFP_EXT_STAGES_CLEAR):   return "clear";
+        default:                       return "?";
+    }
+}
+
+static const char *
+trace_command_name(uint8_t command) {
+    switch (command) {
+        case (OFP_EXT_TRACE_GET):     return "get";
+        case (OFP_EXT_TRACE_ENABLE):  return "on";
+        case (OFP_EXT_TRACE_DISABLE): return "off";
+        case (OFP_EXT_TRACE_CLEAR):   return "clear";
+        default:                      return "?";
+    }
+}
+
+char *
+ofl_exp_openflow_stats_req_to_string(struct ofl_msg_multipart_request_header *msg) {
+    struct ofl_exp_openflow_mp_request_header *exp = (struct ofl_exp_openflow_mp_request_header *)msg;
+    char *str;
+    size_t str_size;
+    FILE *stream = open_memstream(&str, &str_size);
+
+    if (exp->header.experimenter_id == OPENFLOW_VENDOR_ID && exp->type == OFP_EXT_MP_STAGES) {
+        struct ofl_exp_openflow_mp_request_stages *s = (struct ofl_exp_openflow_mp_request_stages *)exp;
+        fprintf(stream, "{type=\"stages\", flags=\"0x%"PRIx32"\", cmd=\"%s\"}",
+                msg->flags, stages_command_name(s->command));
+    } else if (exp->header.experimenter_id == OPENFLOW_VENDOR_ID && exp->type == OFP_EXT_MP_TRACE) {
+        struct ofl_exp_openflow_mp_request_trace *t = (struct ofl_exp_openflow_mp_request_trace *)exp;
+        fprintf(stream, "{type=\"trace\", flags=\"0x%"PRIx32"\", cmd=\"%s\", size=\"%"PRIu32"\"}",
+                msg->flags, trace_command_name(t->command), t->size);
+    } else if (exp->header.experimenter_id == OPENFLOW_VENDOR_ID && exp->type == OFP_EXT_MP_COUNTERS) {
+        fprintf(stream, "{type=\"counters\", flags=\"0x%"PRIx32"\"}", msg->flags);
+    } else {
+        OFL_LOG_WARN(LOG_MODULE, "Trying to print unknown Openflow Experimenter stats request.");
+        fprintf(stream, "{type=\"exp\", exp_id=\"%u\", exp_type=\"%u\"}",
+                exp->header.experimenter_id, exp->type);
+    }
+
+    fclose(stream);
+    return str;
+}
+
+int
+ofl_exp_openflow_stats_reply_pack(struct ofl_msg_multipart_reply_header *msg, uint8_t **buf, size_t *buf_len) {
+    struct ofl_exp_openflow_mp_reply_header *exp = (struct ofl_exp_openflow_mp_reply_header *)msg;
+
+    if (exp->header.experimenter_id == OPENFLOW_VENDOR_ID) {
+        switch (exp->type) {
+            case (OFP_EXT_MP_STAGES): {
+                struct ofl_exp_openflow_mp_reply_stages *s = (struct ofl_exp_openflow_mp_reply_stages *)exp;
+                struct ofp_multipart_reply *rep;
+                struct ofp_ext_stages_reply *ofp;
+                size_t i, j;
+
+                *buf_len = sizeof(struct ofp_multipart_reply) + sizeof(struct ofp_ext_stages_reply)
+                         + s->stages_num * sizeof(struct ofp_ext_stage_stats);
+                *buf     = (uint8_t *)malloc(*buf_len);
+
+                rep = (struct ofp_multipart_reply *)(*buf);
+                ofp = (struct ofp_ext_stages_reply *)rep->body;
+                ofp->header.experimenter = htonl(exp->header.experimenter_id);
+                ofp->header.exp_type     = htonl(exp->type);
+                ofp->flags = htonl(s->flags);
+                memset(ofp->pad, 0x00, sizeof(ofp->pad));
+
+                for (i = 0; i < s->stages_num; i++) {
+                    struct ofl_exp_stage_stats *src = &s->stages[i];
+                    struct ofp_ext_stage_stats *dst = &ofp->stages[i];
+
+                    strncpy(dst->name, src->name, OFP_EXT_STAGE_NAME_LEN);
+                    dst->count    = hton64(src->count);
+                    dst->total_ns = hton64(src->total_ns);
+                    dst->min_ns   = hton64(src->min_ns);
+                    dst->max_ns   = hton64(src->max_ns);
+                    for (j = 0; j < OFP_EXT_STAGE_BUCKETS; j++) {
+                        dst->buckets[j] = hton64(src->buckets[j]);
+                    }
+                }
+                return 0;
+            }
+            case (OFP_EXT_MP_TRACE): {
+                struct ofl_exp_openflow_mp_reply_trace *t = (struct ofl_exp_openflow_mp_reply_trace *)exp;
+                struct ofp_multipart_reply *rep;
+                struct ofp_ext_trace_reply *ofp;
+                size_t i;
+
+                *buf_len = sizeof(struct ofp_multipart_reply) + sizeof(struct ofp_ext_trace_reply)
+                         + t->records_num * sizeof(struct ofp_ext_trace_record);
+                *buf     = (uint8_t *)malloc(*buf_len);
+
+                rep = (struct ofp_multipart_reply *)(*buf);
+                ofp = (struct ofp_ext_trace_reply *)rep->body;
+                ofp->header.experimenter = htonl(exp->header.experimenter_id);
+                ofp->header.exp_type     = htonl(exp->type);
+                ofp->flags   = htonl(t->flags);
+                ofp->size    = htonl(t->size);
+                ofp->total   = hton64(t->total);
+                ofp->now_ns  = hton64(t->now_ns);
+                ofp->wall_ns = hton64(t->wall_ns);
+
+                for (i = 0; i < t->records_num; i++) {
+                    ofl_exp_trace_record_pack(&t->records[i], &ofp->records[i]);
+                }
+                return 0;
+            }
+            case (OFP_EXT_MP_COUNTERS): {
+                struct ofl_exp_openflow_mp_reply_counters *c = (struct ofl_exp_openflow_mp_reply_counters *)exp;
+                struct ofp_multipart_reply *rep;
+                struct ofp_ext_counters_reply *ofp;
+                size_t i;
+
+                *buf_len = sizeof(struct ofp_multipart_reply) + sizeof(struct ofp_ext_counters_reply)
+                         + c->counters_num * sizeof(struct ofp_ext_counter);
+                *buf     = (uint8_t *)malloc(*buf_len);
+
+                rep = (struct ofp_multipart_reply *)(*buf);
+                ofp = (struct ofp_ext_counters_reply *)rep->body;
+                ofp->header.experimenter = htonl(exp->header.experimenter_id);
+                ofp->header.exp_type     = htonl(exp->type);
+
+                for (i = 0; i < c->counters_num; i++) {
+                    strncpy(ofp->counters[i].name, c->counters[i].name, OFP_EXT_COUNTER_NAME_LEN);
+                    ofp->counters[i].value = hton64(c->counters[i].value);
+                }
+                return 0;
+            }
+            default: {
+                OFL_LOG_WARN(LOG_MODULE, "Trying to pack unknown Openflow Experimenter stats reply.");
+                return -1;
+            }
+        }
+    } else {
+        OFL_LOG_WARN(LOG_MODULE, "Trying to pack non-Openflow Experimenter stats reply.");
+        return -1;
+    }
+}
+
+ofl_err
+ofl_exp_openflow_stats_reply_unpack(struct ofp_multipart_reply *os, size_t *len, struct ofl_msg_multipart_reply_header **msg) {
+    struct ofp_experimenter_multipart_header *exp;
+
+    if (*len < sizeof(struct ofp_experimenter_multipart_header)) {
+        OFL_LOG_WARN(LOG_MODULE, "Received EXPERIMENTER stats reply has invalid length (%zu).", *len);
+        return ofl_error(OFPET_BAD_REQUEST, OFPBRC_BAD_LEN);
+    }
+
+    exp = (struct ofp_experimenter_multipart_header *)os->body;
+
+    if (ntohl(exp->experimenter) == OPENFLOW_VENDOR_ID) {
+        switch (ntohl(exp->exp_type)) {
+            case (OFP_EXT_MP_STAGES): {
+                struct ofp_ext_stages_reply *src;
+                struct ofl_exp_openflow_mp_reply_stages *dst;
+                size_t i, j;
+
+                if (*len < sizeof(struct ofp_ext_stages_reply) ||
+                    (*len - sizeof(struct ofp_ext_stages_reply)) % sizeof(struct ofp_ext_stage_stats) != 0) {
+                    OFL_LOG_WARN(LOG_MODULE, "Received EXT_MP_STAGES reply has invalid length (%zu).", *len);
+                    return ofl_error(OFPET_BAD_REQUEST, OFPBRC_BAD_LEN);
+                }
+                *len -= sizeof(struct ofp_ext_stages_reply);
+
+                src = (struct ofp_ext_stages_reply *)exp;
+
+                dst = (struct ofl_exp_openflow_mp_reply_stages *)malloc(sizeof(struct ofl_exp_openflow_mp_reply_stages));
+                dst->header.header.experimenter_id = ntohl(exp->experimenter);
+                dst->header.header.data_length     = 0;
+                dst->header.header.data            = NULL;
+                dst->header.type                   = ntohl(exp->exp_type);
+                dst->flags                         = ntohl(src->flags);
+                dst->stages_num                    = *len / sizeof(struct ofp_ext_stage_stats);
+                dst->stages = (struct ofl_exp_stage_stats *)malloc(dst->stages_num * sizeof(struct ofl_exp_stage_stats));
+
+                for (i = 0; i < dst->stages_num; i++) {
+                    struct ofp_ext_stage_stats *s = &src->stages[i];
+                    struct ofl_exp_stage_stats *d = &dst->stages[i];
+
+                    memcpy(d->name, s->name, OFP_EXT_STAGE_NAME_LEN);
+                    d->name[OFP_EXT_STAGE_NAME_LEN - 1] = '\0';
+                    d->count    = ntoh64(s->count);
+                    d->total_ns = ntoh64(s->total_ns);
+                    d->min_ns   = ntoh64(s->min_ns);
+                    d->max_ns   = ntoh64(s->max_ns);
+                    for (j = 0; j < OFP_EXT_STAGE_BUCKETS; j++) {
+                        d->buckets[j] = ntoh64(s->buckets[j]);
+                    }
+                }
+                *len -= dst->stages_num * sizeof(struct ofp_ext_stage_stats);
+
+                (*msg) = (struct ofl_msg_multipart_reply_header *)dst;
+                return 0;
+            }
+            case (OFP_EXT_MP_TRACE): {
+                struct ofp_ext_trace_reply *src;
+                struct ofl_exp_openflow_mp_reply_trace *dst;
+                size_t i;
+
+                if (*len < sizeof(struct ofp_ext_trace_reply) ||
+                    (*len - sizeof(struct ofp_ext_trace_reply)) % sizeof(struct ofp_ext_trace_record) != 0) {
+                    OFL_LOG_WARN(LOG_MODULE, "Received EXT_MP_TRACE reply has invalid length (%zu).", *len);
+                    return ofl_error(OFPET_BAD_REQUEST, OFPBRC_BAD_LEN);
+                }
+                *len -= sizeof(struct ofp_ext_trace_reply);
+
+                src = (struct ofp_ext_trace_reply *)exp;
+
+                dst = (struct ofl_exp_openflow_mp_reply_trace *)malloc(sizeof(struct ofl_exp_openflow_mp_reply_trace));
+                dst->header.header.experimenter_id = ntohl(exp->experimenter);
+                dst->header.header.data_length     = 0;
+                dst->header.header.data            = NULL;
+                dst->header.type                   = ntohl(exp->exp_type);
+                dst->flags                         = ntohl(src->flags);
+                dst->size                          = ntohl(src->size);
+                dst->total                         = ntoh64(src->total);
+                dst->now_ns                        = ntoh64(src->now_ns);
+                dst->wall_ns                       = ntoh64(src->wall_ns);
+                dst->records_num                   = *len / sizeof(struct ofp_ext_trace_record);
+                dst->records = (struct ofl_exp_trace_record *)malloc(dst->records_num * sizeof(struct ofl_exp_trace_record));
+
+                for (i = 0; i < dst->records_num; i++) {
+                    ofl_exp_trace_record_unpack(&src->records[i], &dst->records[i]);
+                }
+                *len -= dst->records_num * sizeof(struct ofp_ext_trace_record);
+
+                (*msg) = (struct ofl_msg_multipart_reply_header *)dst;
+                return 0;
+            }
+            case (OFP_EXT_MP_COUNTERS): {
+                struct ofp_ext_counters_reply *src;
+                struct ofl_exp_openflow_mp_reply_counters *dst;
+                size_t i;
+
+                if (*len < sizeof(struct ofp_ext_counters_reply) ||
+                    (*len - sizeof(struct ofp_ext_counters_reply)) % sizeof(struct ofp_ext_counter) != 0) {
+                    OFL_LOG_WARN(LOG_MODULE, "Received EXT_MP_COUNTERS reply has invalid length (%zu).", *len);
+                    return ofl_error(OFPET_BAD_REQUEST, OFPBRC_BAD_LEN);
+                }
+                *len -= sizeof(struct ofp_ext_counters_reply);
+
+                src = (struct ofp_ext_counters_reply *)exp;
+
+                dst = (struct ofl_exp_openflow_mp_reply_counters *)malloc(sizeof(struct ofl_exp_openflow_mp_reply_counters));
+                dst->header.header.experimenter_id = ntohl(exp->experimenter);
+                dst->header.header.data_length     = 0;
+                dst->header.header.data            = NULL;
+                dst->header.type                   = ntohl(exp->exp_type);
+                dst->counters_num                  = *len / sizeof(struct ofp_ext_counter);
+                dst->counters = (struct ofl_exp_counter *)malloc(dst->counters_num * sizeof(struct ofl_exp_counter));
+
+                for (i = 0; i < dst->counters_num; i++) {
+                    memcpy(dst->counters[i].name, src->counters[i].name, OFP_EXT_COUNTER_NAME_LEN);
+                    dst->counters[i].name[OFP_EXT_COUNTER_NAME_LEN - 1] = '\0';
+                    dst->counters[i].value = ntoh64(src->counters[i].value);
+                }
+                *len -= dst->counters_num * sizeof(struct ofp_ext_counter);
+
+                (*msg) = (struct ofl_msg_multipart_reply_header *)dst;
+                return 0;
+            }
+            default: {
+                OFL_LOG_WARN(LOG_MODULE, "Trying to unpack unknown Openflow Experimenter stats reply.");
+                return ofl_error(OFPET_BAD_REQUEST, OFPBRC_BAD_EXP_TYPE);
+            }
+        }
+    } else {
+        OFL_LOG_WARN(LOG_MODULE, "Trying to unpack non-Openflow Experimenter stats reply.");
+        return ofl_error(OFPET_BAD_REQUEST, OFPBRC_BAD_EXPERIMENTER);
+    }
+}
+
+int
+ofl_exp_openflow_stats_reply_free(struct ofl_msg_multipart_reply_header *msg) {
+    struct ofl_exp_openflow_mp_reply_header *exp = (struct ofl_exp_openflow_mp_reply_header *)msg;
+
+    if (exp->header.experimenter_id == OPENFLOW_VENDOR_ID && exp->type == OFP_EXT_MP_STAGES) {
+        free(((struct ofl_exp_openflow_mp_reply_stages *)exp)->stages);
+    } else if (exp->header.experimenter_id == OPENFLOW_VENDOR_ID && exp->type == OFP_EXT_MP_TRACE) {
+        free(((struct ofl_exp_openflow_mp_reply_trace *)exp)->records);
+    } else if (exp->header.experimenter_id == OPENFLOW_VENDOR_ID && exp->type == OFP_EXT_MP_COUNTERS) {
+        free(((struct ofl_exp_openflow_mp_reply_counters *)exp)->counters);
+    } else {
+        OFL_LOG_WARN(LOG_MODULE, "Trying to free unknown Openflow Experimenter stats reply.");
+    }
+    free(msg);
+    return 0;
+}
+
+const char *
+ofl_exp_path_mode_name(uint8_t mode) {
+    switch (mode) {
+        case (OFP_PATH_MODE_ARP):          return "arp";
+        case (OFP_PATH_MODE_TCP):          return "tcp";
+        case (OFP_PATH_MODE_TCP_ELEPHANT): return "elephant";
+        case (OFP_PATH_MODE_KEEP):         return "keep";
+        default:                           return "?";
+    }
+}
+
+size_t
+ofl_exp_stage_bucket(uint64_t ns) {
+    size_t e, i;
+
+    if (ns < 4) {
+        return ns;
+    }
+    e = 63 - __builtin_clzll(ns);
+    i = 4 * (e - 1) + ((ns >> (e - 2)) & 3);
+    return i < OFP_EXT_STAGE_BUCKETS ? i : OFP_EXT_STAGE_BUCKETS - 1;
+}
+
+uint64_t
+ofl_exp_stage_bucket_low(size_t i) {
+    if (i < 4) {
+        return i;
+    }
+    return (uint64_t)(4 + i % 4) << (i / 4 - 1);
+}
+
+/* Estimates the value below which 'permille' thousandths of the samples fall.
+ * The
+ * result is the lower bound of the bucket holding that sample, clamped to the
+ * observed minimum and maximum. */
+static uint64_t
+stage_percentile(struct ofl_exp_stage_stats *s, unsigned int permille) {
+    uint64_t rank = (s->count * permille + 999) / 1000;
+    uint64_t seen = 0;
+    uint64_t v = s->max_ns;
+    size_t i;
+
+    for (i = 0; i < OFP_EXT_STAGE_BUCKETS; i++) {
+        seen += s->buckets[i];
+        if (seen >= rank) {
+            v = ofl_exp_stage_bucket_low(i);
+            break;
+        }
+    }
+    return v < s->min_ns ? s->min_ns : v > s->max_ns ? s->max_ns : v;
+}
+
+char *
+ofl_exp_openflow_stats_reply_to_string(struct ofl_msg_multipart_reply_header *msg) {
+    struct ofl_exp_openflow_mp_reply_header *exp = (struct ofl_exp_openflow_mp_reply_header *)msg;
+    char *str;
+    size_t str_size;
+    FILE *stream = open_memstream(&str, &str_size);
+
+    if (exp->header.experimenter_id == OPENFLOW_VENDOR_ID && exp->type == OFP_EXT_MP_STAGES) {
+        struct ofl_exp_openflow_mp_reply_stages *s = (struct ofl_exp_openflow_mp_reply_stages *)exp;
+        size_t i;
+
+        fprintf(stream, "{type=\"stages\", flags=\"0x%"PRIx32"\", timers=\"%s\", stats=[",
+                msg->flags,
+                !(s->flags & OFP_EXT_STAGES_COMPILED) ? "not compiled"
+                : (s->flags & OFP_EXT_STAGES_ENABLED) ? "on" : "off");
+        for (i = 0; i < s->stages_num; i++) {
+            struct ofl_exp_stage_stats *st = &s->stages[i];
+
+            fprintf(stream, "\n  {stage=\"%s\", count=\"%"PRIu64"\"", st->name, st->count);
+            if (st->count > 0) {
+                fprintf(stream, ", avg=\"%"PRIu64"ns\", min=\"%"PRIu64"ns\", "
+                                "p50=\"%"PRIu64"ns\", p90=\"%"PRIu64"ns\", "
+                                "p99=\"%"PRIu64"ns\", p999=\"%"PRIu64"ns\", max=\"%"PRIu64"ns\"",
+                        st->total_ns / st->count, st->min_ns,
+                        stage_percentile(st, 500), stage_percentile(st, 900),
+                        stage_percentile(st, 990), stage_percentile(st, 999),
+                        st->max_ns);
+            }
+            fprintf(stream, "}%s", i + 1 < s->stages_num ? "," : "");
+        }
+        fprintf(stream, "]}");
+    } else if (exp->header.experimenter_id == OPENFLOW_VENDOR_ID && exp->type == OFP_EXT_MP_TRACE) {
+        struct ofl_exp_openflow_mp_reply_trace *t = (struct ofl_exp_openflow_mp_reply_trace *)exp;
+
+        fprintf(stream, "{type=\"trace\", flags=\"0x%"PRIx32"\", trace=\"%s\", "
+                        "size=\"%"PRIu32"\", total=\"%"PRIu64"\", records=\"%zu\"}",
+                msg->flags, (t->flags & OFP_EXT_TRACE_ENABLED) ? "on" : "off",
+                t->size, t->total, t->records_num);
+    } else if (exp->header.experimenter_id == OPENFLOW_VENDOR_ID && exp->type == OFP_EXT_MP_COUNTERS) {
+        struct ofl_exp_openflow_mp_reply_counters *c = (struct ofl_exp_openflow_mp_reply_counters *)exp;
+        size_t i;
+
+        fprintf(stream, "{type=\"counters\", flags=\"0x%"PRIx32"\", stats=[", msg->flags);
+        for (i = 0; i < c->counters_num; i++) {
+            fprintf(stream, "\n  {%s=\"%"PRIu64"\"}%s", c->counters[i].name,
+                    c->counters[i].value, i + 1 < c->counters_num ? "," : "");
+        }
+        fprintf(stream, "]}");
+    } else {
+        OFL_LOG_WARN(LOG_MODULE, "Trying to print unknown Openflow Experimenter stats reply.");
+        fprintf(stream, "{type=\"exp\", exp_id=\"%u\", exp_type=\"%u\"}",
+                exp->header.experimenter_id, exp->type);
+    }
+
+    fclose(stream);
+    return str;
+}
+
+void
+ofl_exp_trace_record_pack(const struct ofl_exp_trace_record *src, struct ofp_ext_trace_record *dst) {
+    dst->time_ns = hton64(src->time_ns);
+    dst->in_port = htonl(src->in_port);
+    dst->port    = htonl(src->port);
+    dst->arg     = htonl(src->arg);
+    dst->tp_src  = htons(src->tp_src);
+    dst->tp_dst  = htons(src->tp_dst);
+    memcpy(dst->eth_src, src->eth_src, OFP_ETH_ALEN);
+    memcpy(dst->eth_dst, src->eth_dst, OFP_ETH_ALEN);
+    dst->event   = src->event;
+    dst->reason  = src->reason;
+    memset(dst->pad, 0x00, sizeof(dst->pad));
+}
+
+void
+ofl_exp_trace_record_unpack(const struct ofp_ext_trace_record *src, struct ofl_exp_trace_record *dst) {
+    dst->time_ns = ntoh64(src->time_ns);
+    dst->in_port = ntohl(src->in_port);
+    dst->port    = ntohl(src->port);
+    dst->arg     = ntohl(src->arg);
+    dst->tp_src  = ntohs(src->tp_src);
+    dst->tp_dst  = ntohs(src->tp_dst);
+    memcpy(dst->eth_src, src->eth_src, OFP_ETH_ALEN);
+    memcpy(dst->eth_dst, src->eth_dst, OFP_ETH_ALEN);
+    dst->event   = src->event;
+    dst->reason  = src->reason;
+}
+
+static const char *
+trace_event_name(uint8_t event) {
+    switch (event) {
+        case (OFP_EXT_TRACE_LEARN):    return "learn";
+        case (OFP_EXT_TRACE_LOOKUP):   return "lookup";
+        case (OFP_EXT_TRACE_PATH_IN):  return "path_in";
+        case (OFP_EXT_TRACE_PATH_OUT): return "path_out";
+        case (OFP_EXT_TRACE_FLOOD):    return "flood";
+        case (OFP_EXT_TRACE_RECOVERY): return "recovery";
+        case (OFP_EXT_TRACE_DROP):     return "drop";
+        default:                       return "?";
+    }
+}
+
+static const char *
+trace_reason_name(uint8_t event, uint8_t reason) {
+    switch (event) {
+        case (OFP_EXT_TRACE_LEARN): {
+            switch (reason) {
+                case (OFP_EXT_TRACE_LEARN_NEW):        return "new";
+                case (OFP_EXT_TRACE_LEARN_MOVE):       return "move";
+                case (OFP_EXT_TRACE_LEARN_BACKUP):     return "backup";
+                case (OFP_EXT_TRACE_LEARN_TCP_NEW):    return "tcp_new";
+                case (OFP_EXT_TRACE_LEARN_TCP_BACKUP): return "tcp_backup";
+            }
+            break;
+        }
+        case (OFP_EXT_TRACE_LOOKUP): {
+            switch (reason) {
+                case (OFP_EXT_TRACE_LOOKUP_MISS): return "miss";
+                case (OFP_EXT_TRACE_LOOKUP_HIT):  return "hit";
+            }
+            break;
+        }
+        case (OFP_EXT_TRACE_RECOVERY): {
+            switch (reason) {
+                case (OFP_EXT_TRACE_RECOVERY_START):     return "start";
+                case (OFP_EXT_TRACE_RECOVERY_DONE):      return "done";
+                case (OFP_EXT_TRACE_RECOVERY_CTRL):      return "ctrl";
+                case (OFP_EXT_TRACE_RECOVERY_DIST):      return "dist";
+                case (OFP_EXT_TRACE_RECOVERY_RX):        return "rx";
+                case (OFP_EXT_TRACE_RECOVERY_PORT_DOWN): return "port_down";
+            }
+            break;
+        }
+        case (OFP_EXT_TRACE_DROP): {
+            switch (reason) {
+                case (OFP_EXT_TRACE_DROP_DUPLICATE):   return "duplicate";
+                case (OFP_EXT_TRACE_DROP_NO_ROUTE):    return "no_route";
+                case (OFP_EXT_TRACE_DROP_INVALID_TTL): return "invalid_ttl";
+                case (OFP_EXT_TRACE_DROP_NO_MATCH):    return "no_match";
+                case (OFP_EXT_TRACE_DROP_FILTERED):    return "filtered";
+            }
+            break;
+        }
+        default: {
+            return NULL;
+        }
+    }
+    return "?";
+}
+
+static void
+trace_print_mac(FILE *stream, const char *name, const uint8_t *mac) {
+    static const uint8_t zero[OFP_ETH_ALEN];
+
+    if (memcmp(mac, zero, OFP_ETH_ALEN) != 0) {
+        fprintf(stream, " %s=%02x:%02x:%02x:%02x:%02x:%02x", name,
+                mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+    }
+}
+
+void
+ofl_exp_trace_print(FILE *stream, const struct ofl_exp_openflow_mp_reply_trace *trace) {
+    size_t i;
+
+    for (i = 0; i < trace->records_num; i++) {
+        const struct ofl_exp_trace_record *r = &trace->records[i];
+        int64_t ago = (int64_t)(trace->now_ns - r->time_ns);
+        uint64_t wall = trace->wall_ns - ago;
+        time_t secs = wall / 1000000000;
+        const char *reason = trace_reason_name(r->event, r->reason);
+        struct tm tm;
+        char when[32];
+
+        localtime_r(&secs, &tm);
+        strftime(when, sizeof when, "%H:%M:%S", &tm);
+        fprintf(stream, "%s.%06"PRIu64" (-%"PRId64".%06"PRId64"s) %s",
+                when, (wall % 1000000000) / 1000,
+                ago / 1000000000, (ago % 1000000000) / 1000,
+                trace_event_name(r->event));
+        if (reason != NULL) {
+            fprintf(stream, "/%s", reason);
+        }
+        fprintf(stream, " in_port=%"PRIu32, r->in_port);
+        if (r->port != 0) {
+            fprintf(stream, " port=%"PRIu32, r->port);
+        }
+        trace_print_mac(stream, "eth_src", r->eth_src);
+        trace_print_mac(stream, "eth_dst", r->eth_dst);
+        if (r->tp_src != 0 || r->tp_dst != 0) {
+            fprintf(stream, " tp=%"PRIu16">%"PRIu16, r->tp_src, r->tp_dst);
+        }
+        if (r->event == OFP_EXT_TRACE_LOOKUP) {
+            fprintf(stream, " table=%"PRIu32, r->arg & 0xff);
+            if (r->reason == OFP_EXT_TRACE_LOOKUP_HIT) {
+                fprintf(stream, " prio=%"PRIu32, r->arg >> 16);
+            }
+        } else if (r->event == OFP_EXT_TRACE_RECOVERY
+                   && r->reason == OFP_EXT_TRACE_RECOVERY_DONE) {
+            fprintf(stream, " after=%"PRIu32"us", r->arg);
+        } else if (r->arg != 0) {
+            fprintf(stream, " arg=%"PRIu32, r->arg);
+        }
+        fprintf(stream, "\n");
+    }
+}
+
+int
+ofl_exp_trace_save(FILE *stream, uint64_t dpid, const struct ofl_exp_openflow_mp_reply_trace *trace) {
+    struct ofp_ext_trace_file_header header;
+    size_t i;
+
+    memcpy(header.magic, OFP_EXT_TRACE_MAGIC, sizeof header.magic);
+    header.datapath_id = hton64(dpid);
+    header.flags       = htonl(trace->flags);
+    header.size        = htonl(trace->size);
+    header.total       = hton64(trace->total);
+    header.now_ns      = hton64(trace->now_ns);
+    header.wall_ns     = hton64(trace->wall_ns);
+    header.n_records   = hton64(trace->records_num);
+    if (fwrite(&header, sizeof header, 1, stream) != 1) {
+        return errno;
+    }
+    for (i = 0; i < trace->records_num; i++) {
+        struct ofp_ext_trace_record r;
+
+        ofl_exp_trace_record_pack(&trace->records[i], &r);
+        if (fwrite(&r, sizeof r, 1, stream) != 1) {
+            return errno;
+        }
+    }
+    return fflush(stream) == EOF ? errno : 0;
+}
+
+int
+ofl_exp_trace_load(FILE *stream, uint64_t *dpid, struct ofl_exp_openflow_mp_reply_trace **trace) {
+    struct ofp_ext_trace_file_header header;
+    struct ofl_exp_openflow_mp_reply_trace *t;
+    uint64_t n;
+    size_t i;
+
+    if (fread(&header, sizeof header, 1, stream) != 1) {
+        return ferror(stream) ? errno : EINVAL;
+    }
+    n = ntoh64(header.n_records);
+    if (memcmp(header.magic, OFP_EXT_TRACE_MAGIC, sizeof header.magic) != 0
+        || n > ntohl(header.size)) {
+        return EINVAL;
+    }
+
+    t = (struct ofl_exp_openflow_mp_reply_trace *)malloc(sizeof(struct ofl_exp_openflow_mp_reply_trace));
+    t->header.header.header.header.type = OFPT_MULTIPART_REPLY;
+    t->header.header.header.type        = OFPMP_EXPERIMENTER;
+    t->header.header.header.flags       = 0x0000;
+    t->header.header.experimenter_id    = OPENFLOW_VENDOR_ID;
+    t->header.header.data_length        = 0;
+    t->header.header.data               = NULL;
+    t->header.type                      = OFP_EXT_MP_TRACE;
+    t->flags       = ntohl(header.flags);
+    t->size        = ntohl(header.size);
+    t->total       = ntoh64(header.total);
+    t->now_ns      = ntoh64(header.now_ns);
+    t->wall_ns     = ntoh64(header.wall_ns);
+    t->records_num = n;
+    t->records     = (struct ofl_exp_trace_record *)malloc(n * sizeof(struct ofl_exp_trace_record));
+    for (i = 0; i < n; i++) {
+        struct ofp_ext_trace_record r;
+
+        if (fread(&r, sizeof r, 1, stream) != 1) {
+            int error = ferror(stream) ? errno : EINVAL;
+
+            ofl_exp_openflow_stats_reply_free((struct ofl_msg_multipart_reply_header *)t);
+            return error;
+        }
+        ofl_exp_trace_record_unpack(&r, &t->records[i]);
+    }
+
+    *dpid  = ntoh64(header.datapath_id);
+    *trace = t;
+    return 0;
+}
@@ -33,8 +33,11 @@
 #define OFL_EXP_OPENFLOW_H 1
 
 
+#include <stdio.h>
+
 #include "../oflib/ofl-structs.h"
 #include "../oflib/ofl-messages.h"
+#include "openflow/openflow-ext.h"
 
 
 struct ofl_exp_openflow_msg_header {
@@ -57,6 +60,99 @@ struct ofl_exp_openflow_msg_set_dp_desc {
     char  *dp_desc;
 };
 
+struct ofl_exp_openflow_msg_set_path_mode {
+    struct ofl_exp_openflow_msg_header   header; /* OFP_EXT_SET_PATH_MODE */
+
+    uint8_t    mode;
+    uint16_t   flags;
+    uint16_t   flags_mask;
+    uint16_t   bt_time;
+    uint16_t   lt_time;
+    uint16_t   tcp_time;
+};
+
+
+struct ofl_exp_openflow_mp_request_header {
+    struct ofl_msg_multipart_request_experimenter   header; /* OPENFLOW_VENDOR_ID */
+
+    uint32_t   type;
+};
+
+struct ofl_exp_openflow_mp_request_stages {
+    struct ofl_exp_openflow_mp_request_header   header; /* OFP_EXT_MP_STAGES */
+
+    uint8_t   command;
+};
+
+struct ofl_exp_openflow_mp_request_trace {
+    struct ofl_exp_openflow_mp_request_header   header; /* OFP_EXT_MP_TRACE */
+
+    uint8_t    command;
+    uint32_t   size;
+};
+
+struct ofl_exp_openflow_mp_request_counters {
+    struct ofl_exp_openflow_mp_request_header   header; /* OFP_EXT_MP_COUNTERS */
+};
+
+struct ofl_exp_openflow_mp_reply_header {
+    struct ofl_msg_multipart_reply_experimenter   header; /* OPENFLOW_VENDOR_ID */
+
+    uint32_t   type;
+};
+
+struct ofl_exp_stage_stats {
+    char       name[OFP_EXT_STAGE_NAME_LEN];
+    uint64_t   count;
+    uint64_t   total_ns;
+    uint64_t   min_ns;
+    uint64_t   max_ns;
+    uint64_t   buckets[OFP_EXT_STAGE_BUCKETS];
+};
+
+struct ofl_exp_openflow_mp_reply_stages {
+    struct ofl_exp_openflow_mp_reply_header   header; /* OFP_EXT_MP_STAGES */
+
+    uint32_t                     flags;
+    size_t                       stages_num;
+    struct ofl_exp_stage_stats  *stages;
+};
+struct ofl_exp_trace_record {
+    uint64_t   time_ns;
+    uint32_t   in_port;
+    uint32_t   port;
+    uint32_t   arg;
+    uint16_t   tp_src;
+    uint16_t   tp_dst;
+    uint8_t    eth_src[OFP_ETH_ALEN];
+    uint8_t    eth_dst[OFP_ETH_ALEN];
+    uint8_t    event;
+    uint8_t    reason;
+};
+
+struct ofl_exp_openflow_mp_reply_trace {
+    struct ofl_exp_openflow_mp_reply_header   header; /* OFP_EXT_MP_TRACE */
+
+    uint32_t                      flags;
+    uint32_t                      size;
+    uint64_t                      total;
+    uint64_t                      now_ns;
+    uint64_t                      wall_ns;
+    size_t                        records_num;
+    struct ofl_exp_trace_record  *records;
+};
+
+struct ofl_exp_counter {
+    char       name[OFP_EXT_COUNTER_NAME_LEN];
+    uint64_t   value;
+};
+
+struct ofl_exp_openflow_mp_reply_counters {
+    struct ofl_exp_openflow_mp_reply_header   header; /* OFP_EXT_MP_COUNTERS */
+
+    size_t                   counters_num;
+    struct ofl_exp_counter  *counters;
+};
 
 
 int
@@ -72,4 +168,64 @@ char *
 ofl_exp_openflow_msg_to_string(struct ofl_msg_experimenter *msg);
 
 
+int
+ofl_exp_openflow_stats_req_pack(struct ofl_msg_multipart_request_header *msg, uint8_t **buf, size_t *buf_len);
+
+ofl_err
+ofl_exp_openflow_stats_req_unpack(struct ofp_multipart_request *os, size_t *len, struct ofl_msg_multipart_request_header **msg);
+
+int
+ofl_exp_openflow_stats_req_free(struct ofl_msg_multipart_request_header *msg);
+
+char *
+ofl_exp_openflow_stats_req_to_string(struct ofl_msg_multipart_request_header *msg);
+
+int
+ofl_exp_openflow_stats_reply_pack(struct ofl_msg_multipart_reply_header *msg, uint8_t **buf, size_t *buf_len);
+
+ofl_err
+ofl_exp_openflow_stats_reply_unpack(struct ofp_multipart_reply *os, size_t *len, struct ofl_msg_multipart_reply_header **msg);
+
+int
+ofl_exp_openflow_stats_reply_free(struct ofl_msg_multipart_reply_header *msg);
+
+char *
+ofl_exp_openflow_stats_reply_to_string(struct ofl_msg_multipart_reply_header *msg);
+
+/* Returns the name of an OFP_PATH_MODE_* mode. */
+const char *
+ofl_exp_path_mode_name(uint8_t mode);
+
+/* Returns the histogram bucket of a sample of 'ns' nanoseconds. */
+size_t
+ofl_exp_stage_bucket(uint64_t ns);
+
+/* Returns the smallest value counted in histogram bucket 'i'. */
+uint64_t
+ofl_exp_stage_bucket_low(size_t i);
+
+/* Converts a trace record to and from network byte order. */
+void
+ofl_exp_trace_record_pack(const struct ofl_exp_trace_record *src, struct ofp_ext_trace_record *dst);
+
+void
+ofl_exp_trace_record_unpack(const struct ofp_ext_trace_record *src, struct ofl_exp_trace_record *dst);
+
+/* Prints the records of a trace, one per line, timed relative to when it was
+ * read and by the wall clock. */
+void
+ofl_exp_trace_print(FILE *stream, const struct ofl_exp_openflow_mp_reply_trace *trace);
+
+/* Writes 'trace' of datapath 'dpid' to 'stream' in the format of struct
+ * ofp_ext_trace_file_header.  Returns 0 or an errno value. */
+int
+ofl_exp_trace_save(FILE *stream, uint64_t dpid, const struct ofl_exp_openflow_mp_reply_trace *trace);
+
+/* Reads a trace written by ofl_exp_trace_save() from 'stream'.  Returns 0 and
+ * a trace to free with ofl_exp_openflow_stats_reply_free(), or an errno
+ * value (EINVAL if the file is not a trace). */
+int
+ofl_exp_trace_load(FILE *stream, uint64_t *dpid, struct ofl_exp_openflow_mp_reply_trace **trace);
+
+
 #endif /* OFL_EXP_OPENFLOW_H */
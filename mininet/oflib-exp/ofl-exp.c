@@ -125,3 +125,149 @@ ofl_exp_msg_to_string(struct ofl_msg_experimenter *msg) {
         }
     }
 }
+
+int
+ofl_exp_stats_req_pack(struct ofl_msg_multipart_request_header *msg, uint8_t **buf, size_t *buf_len) {
+    struct ofl_msg_multipart_request_experimenter *exp = (struct ofl_msg_multipart_request_experimenter *)msg;
+
+    switch (exp->experimenter_id) {
+        case (OPENFLOW_VENDOR_ID): {
+            return ofl_exp_openflow_stats_req_pack(msg, buf, buf_len);
+        }
+        default: {
+            OFL_LOG_WARN(LOG_MODULE, "Trying to pack unknown EXPERIMENTER stats request (%u).", exp->experimenter_id);
+            return -1;
+        }
+    }
+}
+
+ofl_err
+ofl_exp_stats_req_unpack(struct ofp_multipart_request *os, size_t *len, struct ofl_msg_multipart_request_header **msg) {
+    struct ofp_experimenter_multipart_header *exp;
+
+    if (*len < sizeof(struct ofp_experimenter_multipart_header)) {
+        OFL_LOG_WARN(LOG_MODULE, "Received EXPERIMENTER stats request is shorter than ofp_experimenter_multipart_header.");
+        return ofl_error(OFPET_BAD_REQUEST, OFPBRC_BAD_LEN);
+    }
+
+    exp = (struct ofp_experimenter_multipart_header *)os->body;
+
+    switch (ntohl(exp->experimenter)) {
+        case (OPENFLOW_VENDOR_ID): {
+            return ofl_exp_openflow_stats_req_unpack(os, len, msg);
+        }
+        default: {
+            OFL_LOG_WARN(LOG_MODULE, "Trying to unpack unknown EXPERIMENTER stats request (%u).", ntohl(exp->experimenter));
+            return ofl_error(OFPET_BAD_REQUEST, OFPBRC_BAD_EXPERIMENTER);
+        }
+    }
+}
+
+int
+ofl_exp_stats_req_free(struct ofl_msg_multipart_request_header *msg) {
+    struct ofl_msg_multipart_request_experimenter *exp = (struct ofl_msg_multipart_request_experimenter *)msg;
+
+    switch (exp->experimenter_id) {
+        case (OPENFLOW_VENDOR_ID): {
+            return ofl_exp_openflow_stats_req_free(msg);
+        }
+        default: {
+            OFL_LOG_WARN(LOG_MODULE, "Trying to free unknown EXPERIMENTER stats request (%u).", exp->experimenter_id);
+            free(msg);
+            return -1;
+        }
+    }
+}
+
+char *
+ofl_exp_stats_req_to_string(struct ofl_msg_multipart_request_header *msg) {
+    struct ofl_msg_multipart_request_experimenter *exp = (struct ofl_msg_multipart_request_experimenter *)msg;
+
+    switch (exp->experimenter_id) {
+        case (OPENFLOW_VENDOR_ID): {
+            return ofl_exp_openflow_stats_req_to_string(msg);
+        }
+        default: {
+            char *str;
+            size_t str_size;
+            FILE *stream = open_memstream(&str, &str_size);
+            OFL_LOG_WARN(LOG_MODULE, "Trying to convert to string unknown EXPERIMENTER stats request (%u).", exp->experimenter_id);
+            fprintf(stream, "{type=\"exp\", exp_id=\"0x%"PRIx32"\"}", exp->experimenter_id);
+            fclose(stream);
+            return str;
+        }
+    }
+}
+
+int
+ofl_exp_stats_reply_pack(struct ofl_msg_multipart_reply_header *msg, uint8_t **buf, size_t *buf_len) {
+    struct ofl_msg_multipart_reply_experimenter *exp = (struct ofl_msg_multipart_reply_experimenter *)msg;
+
+    switch (exp->experimenter_id) {
+        case (OPENFLOW_VENDOR_ID): {
+            return ofl_exp_openflow_stats_reply_pack(msg, buf, buf_len);
+        }
+        default: {
+            OFL_LOG_WARN(LOG_MODULE, "Trying to pack unknown EXPERIMENTER stats reply (%u).", exp->experimenter_id);
+            return -1;
+        }
+    }
+}
+
+ofl_err
+ofl_exp_stats_reply_unpack(struct ofp_multipart_reply *os, size_t *len, struct ofl_msg_multipart_reply_header **msg) {
+    struct ofp_experimenter_multipart_header *exp;
+
+    if (*len < sizeof(struct ofp_experimenter_multipart_header)) {
+        OFL_LOG_WARN(LOG_MODULE, "Received EXPERIMENTER stats reply is shorter than ofp_experimenter_multipart_header.");
+        return ofl_error(OFPET_BAD_REQUEST, OFPBRC_BAD_LEN);
+    }
+
+    exp = (struct ofp_experimenter_multipart_header *)os->body;
+
+    switch (ntohl(exp->experimenter)) {
+        case (OPENFLOW_VENDOR_ID): {
+            return ofl_exp_openflow_stats_reply_unpack(os, len, msg);
+        }
+        default: {
+            OFL_LOG_WARN(LOG_MODULE, "Trying to unpack unknown EXPERIMENTER stats reply (%u).", ntohl(exp->experimenter));
+            return ofl_error(OFPET_BAD_REQUEST, OFPBRC_BAD_EXPERIMENTER);
+        }
+    }
+}
+
+int
+ofl_exp_stats_reply_free(struct ofl_msg_multipart_reply_header *msg) {
+    struct ofl_msg_multipart_reply_experimenter *exp = (struct ofl_msg_multipart_reply_experimenter *)msg;
+
+    switch (exp->experimenter_id) {
+        case (OPENFLOW_VENDOR_ID): {
+            return ofl_exp_openflow_stats_reply_free(msg);
+        }
+        default: {
+            OFL_LOG_WARN(LOG_MODULE, "Trying to free unknown EXPERIMENTER stats reply (%u).", exp->experimenter_id);
+            free(msg);
+            return -1;
+        }
+    }
+}
+
+char *
+ofl_exp_stats_reply_to_string(struct ofl_msg_multipart_reply_header *msg) {
+    struct ofl_msg_multipart_reply_experimenter *exp = (struct ofl_msg_multipart_reply_experimenter *)msg;
+
+    switch (exp->experimenter_id) {
+        case (OPENFLOW_VENDOR_ID): {
+            return ofl_exp_openflow_stats_reply_to_string(msg);
+        }
+        default: {
+            char *str;
+            size_t str_size;
+            FILE *stream = open_memstream(&str, &str_size);
+            OFL_LOG_WARN(LOG_MODULE, "Trying to convert to string unknown EXPERIMENTER stats reply (%u).", exp->experimenter_id);
+            fprintf(stream, "{type=\"exp\", exp_id=\"0x%"PRIx32"\"}", exp->experimenter_id);
+            fclose(stream);
+            return str;
+        }
+    }
+}
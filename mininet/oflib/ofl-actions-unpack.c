@@ -273,16 +273,15 @@ ofl_actions_unpack(struct ofp_action_header *src, size_t *len, struct ofl_action
         case OFPAT_SET_FIELD: {
             struct ofp_action_set_field *sa;
             struct ofl_action_set_field *da;
+            uint32_t header;
             uint8_t *value;
             
             sa = (struct ofp_action_set_field*) src;
             da = (struct ofl_action_set_field *)malloc(sizeof(struct ofl_action_set_field));
-            da->field = (struct ofl_match_tlv*) malloc(sizeof(struct ofl_match_tlv));
-            
-            memcpy(&da->field->header,sa->field,4);
-            da->field->header = ntohl(da->field->header);
+            memcpy(&header, sa->field, 4);
+            header = ntohl(header);
+            da->field = ofl_structs_match_tlv_new(header, OXM_LENGTH(header));
             value = (uint8_t *) src + sizeof (struct ofp_action_set_field);
-            da->field->value = malloc(OXM_LENGTH(da->field->header));
             /*TODO: need to check if other fields are valid */
             if(da->field->header == OXM_OF_IN_PORT || da->field->header == OXM_OF_IN_PHY_PORT
                                     || da->field->header == OXM_OF_METADATA
@@ -44,8 +44,7 @@ ofl_actions_free(struct ofl_action_header *act, struct ofl_exp *exp) {
     switch (act->type) {
         case OFPAT_SET_FIELD:{
             struct ofl_action_set_field *a = (struct ofl_action_set_field*) act;
-            free(a->field->value);
-            free(a->field);
+            ofl_structs_match_tlv_free(a->field);
             free(a);
             return;
             break;        
@@ -37,6 +37,7 @@
 #include "ofl-structs.h"
 #include "ofl-log.h"
 #include "ofl-utils.h"
+#include "ofpbuf.h"
 #include "openflow/openflow.h"
 
 #define UNUSED __attribute__((__unused__))
@@ -140,23 +141,26 @@ ofl_msg_pack_set_config(struct ofl_msg_set_config *msg, uint8_t **buf, size_t *b
     return 0;
 }
 
-static int
-ofl_msg_pack_packet_in(struct ofl_msg_packet_in *msg, uint8_t **buf, size_t *buf_len) {
+static size_t
+ofl_msg_packet_in_len(struct ofl_msg_packet_in *msg) {
+    return sizeof(struct ofp_packet_in) + ROUND_UP(msg->match->length - 4 ,8) + msg->data_length + 2;
+}
+
+static void
+ofl_msg_packet_in_fill(struct ofl_msg_packet_in *msg, uint8_t *buf) {
     struct ofp_packet_in *packet_in;
     uint8_t *ptr;
 
-    *buf_len = sizeof(struct ofp_packet_in) + ROUND_UP(msg->match->length - 4 ,8) + msg->data_length + 2;
-    *buf     = (uint8_t *)malloc(*buf_len);
-    packet_in = (struct ofp_packet_in *)(*buf);
+    packet_in = (struct ofp_packet_in *)buf;
     packet_in->buffer_id   = htonl(msg->buffer_id);
     packet_in->total_len   = htons(msg->total_len);
     packet_in->reason      =       msg->reason;
     packet_in->table_id    =       msg->table_id;
     packet_in->cookie      = hton64(msg->cookie);
 
-    ptr = (*buf) + (sizeof(struct ofp_packet_in) - 4);
+    ptr = buf + (sizeof(struct ofp_packet_in) - 4);
     ofl_structs_match_pack(msg->match,&(packet_in->match),ptr, NULL);
-    ptr = (*buf) + ROUND_UP((sizeof(struct ofp_packet_in)-4) + msg->match->length,8);
+    ptr = buf + ROUND_UP((sizeof(struct ofp_packet_in)-4) + msg->match->length,8);
     /*padding bytes*/
 
     memset(ptr,0,2);
@@ -164,7 +168,13 @@ ofl_msg_pack_packet_in(struct ofl_msg_packet_in *msg, uint8_t **buf, size_t *buf
     if (msg->data_length > 0) {
         memcpy(ptr + 2 , msg->data, msg->data_length);
     }
+}
 
+static int
+ofl_msg_pack_packet_in(struct ofl_msg_packet_in *msg, uint8_t **buf, size_t *buf_len) {
+    *buf_len = ofl_msg_packet_in_len(msg);
+    *buf     = (uint8_t *)malloc(*buf_len);
+    ofl_msg_packet_in_fill(msg, *buf);
     return 0;
 }
 
@@ -603,19 +613,29 @@ ofl_msg_pack_multipart_reply_desc(struct ofl_msg_reply_desc *msg UNUSED, uint8_t
     return 0;
 }
 
-static int
-ofl_msg_pack_multipart_reply_flow(struct ofl_msg_multipart_reply_flow *msg, uint8_t **buf, size_t *buf_len, struct ofl_exp *exp) {
+static size_t
+ofl_msg_multipart_reply_flow_len(struct ofl_msg_multipart_reply_flow *msg, struct ofl_exp *exp) {
+    return sizeof(struct ofp_multipart_reply) + ofl_structs_flow_stats_ofp_total_len(msg->stats, msg->stats_num, exp);
+}
+
+static void
+ofl_msg_multipart_reply_flow_fill(struct ofl_msg_multipart_reply_flow *msg, uint8_t *buf, struct ofl_exp *exp) {
     struct ofp_multipart_reply *resp;
     size_t i;
     uint8_t * data;
 
-    *buf_len = sizeof(struct ofp_multipart_reply) + ofl_structs_flow_stats_ofp_total_len(msg->stats, msg->stats_num, exp);
-    *buf     = (uint8_t *)malloc(*buf_len);
-    resp = (struct ofp_multipart_reply *)(*buf);
+    resp = (struct ofp_multipart_reply *)buf;
     data = (uint8_t*) resp->body;
     for (i=0; i<msg->stats_num; i++) {
         data += ofl_structs_flow_stats_pack(msg->stats[i], data, exp);
     }
+}
+
+static int
+ofl_msg_pack_multipart_reply_flow(struct ofl_msg_multipart_reply_flow *msg, uint8_t **buf, size_t *buf_len, struct ofl_exp *exp) {
+    *buf_len = ofl_msg_multipart_reply_flow_len(msg, exp);
+    *buf     = (uint8_t *)malloc(*buf_len);
+    ofl_msg_multipart_reply_flow_fill(msg, *buf, exp);
     return 0;
 }
 
@@ -655,21 +675,30 @@ ofl_msg_pack_multipart_reply_table(struct ofl_msg_multipart_reply_table *msg, ui
     return 0;
 }
 
-static int
-ofl_msg_pack_multipart_reply_port(struct ofl_msg_multipart_reply_port *msg, uint8_t **buf, size_t *buf_len) {
+static size_t
+ofl_msg_multipart_reply_port_len(struct ofl_msg_multipart_reply_port *msg) {
+    return sizeof(struct ofp_multipart_reply) + msg->stats_num * sizeof(struct ofp_port_stats);
+}
+
+static void
+ofl_msg_multipart_reply_port_fill(struct ofl_msg_multipart_reply_port *msg, uint8_t *buf) {
     struct ofp_multipart_reply *resp;
     size_t i;
     uint8_t *data;
 
-    *buf_len = sizeof(struct ofp_multipart_reply) + msg->stats_num * sizeof(struct ofp_port_stats);
-    *buf     = (uint8_t *)malloc(*buf_len);
-
-    resp = (struct ofp_multipart_reply *)(*buf);
+    resp = (struct ofp_multipart_reply *)buf;
     data = (uint8_t *)resp->body;
 
     for (i=0; i<msg->stats_num; i++) {
         data += ofl_structs_port_stats_pack(msg->stats[i], (struct ofp_port_stats *)data);
     }
+}
+
+static int
+ofl_msg_pack_multipart_reply_port(struct ofl_msg_multipart_reply_port *msg, uint8_t **buf, size_t *buf_len) {
+    *buf_len = ofl_msg_multipart_reply_port_len(msg);
+    *buf     = (uint8_t *)malloc(*buf_len);
+    ofl_msg_multipart_reply_port_fill(msg, *buf);
     return 0;
 }
 
@@ -844,9 +873,17 @@ ofl_msg_pack_multipart_reply_meter_features(struct ofl_msg_multipart_reply_meter
 }
 
 
+static void
+ofl_msg_multipart_reply_fill_header(struct ofl_msg_multipart_reply_header *msg, uint8_t *buf) {
+    struct ofp_multipart_reply *resp = (struct ofp_multipart_reply *)buf;
+
+    resp->type  = htons(msg->type);
+    resp->flags = htons(msg->flags);
+    memset(resp->pad, 0x00, 4);
+}
+
 static int
 ofl_msg_pack_multipart_reply(struct ofl_msg_multipart_reply_header *msg, uint8_t **buf, size_t *buf_len, struct ofl_exp *exp) {
-    struct ofp_multipart_reply *resp;
     int error;
 
     switch (msg->type) {
@@ -924,10 +961,7 @@ ofl_msg_pack_multipart_reply(struct ofl_msg_multipart_reply_header *msg, uint8_t
     if (error) {
         return error;
     }
-    resp = (struct ofp_multipart_reply *)(*buf);
-    resp->type  = htons(msg->type);
-    resp->flags = htons(msg->flags);
-    memset(resp->pad, 0x00, 4);
+    ofl_msg_multipart_reply_fill_header(msg, *buf);
 
     return 0;
 }
@@ -977,6 +1011,14 @@ ofl_msg_pack_empty(struct ofl_msg_header *msg UNUSED, uint8_t **buf, size_t *buf
 }
 
 
+static void
+ofl_msg_fill_header(struct ofl_msg_header *msg, uint32_t xid, struct ofp_header *oh, size_t len) {
+    oh->version =        OFP_VERSION;
+    oh->type    =        msg->type;
+    oh->length  = htons(len);
+    oh->xid     = htonl(xid);
+}
+
 int
 ofl_msg_pack(struct ofl_msg_header *msg, uint32_t xid, uint8_t **buf, size_t *buf_len, struct ofl_exp *exp) {
     struct ofp_header *oh;
@@ -1120,10 +1162,66 @@ ofl_msg_pack(struct ofl_msg_header *msg, uint32_t xid, uint8_t **buf, size_t *bu
     }
 
     oh = (struct ofp_header *)(*buf);
-    oh->version =        OFP_VERSION;
-    oh->type    =        msg->type;
-    oh->length  = htons(*buf_len);
-    oh->xid     = htonl(xid);
+    ofl_msg_fill_header(msg, xid, oh, *buf_len);
+
+    return 0;
+}
+
+int
+ofl_msg_pack_ofpbuf(struct ofl_msg_header *msg, uint32_t xid, struct ofpbuf *buf, struct ofl_exp *exp) {
+    uint8_t *data;
+    size_t len;
+
+    /* Messages on the packet-in and stats reply paths are sized first and
+     * serialized in place. */
+    if (msg->type == OFPT_PACKET_IN) {
+        len = ofl_msg_packet_in_len((struct ofl_msg_packet_in *)msg);
+        ofpbuf_prealloc_tailroom(buf, len);
+        data = ofpbuf_put_uninit(buf, len);
+        ofl_msg_packet_in_fill((struct ofl_msg_packet_in *)msg, data);
+        ofl_msg_fill_header(msg, xid, (struct ofp_header *)data, len);
+        return 0;
+    }
+    if (msg->type == OFPT_MULTIPART_REPLY) {
+        struct ofl_msg_multipart_reply_header *rep = (struct ofl_msg_multipart_reply_header *)msg;
+
+        if (rep->type == OFPMP_FLOW) {
+            len = ofl_msg_multipart_reply_flow_len((struct ofl_msg_multipart_reply_flow *)msg, exp);
+            ofpbuf_prealloc_tailroom(buf, len);
+            data = ofpbuf_put_uninit(buf, len);
+            ofl_msg_multipart_reply_flow_fill((struct ofl_msg_multipart_reply_flow *)msg, data, exp);
+            ofl_msg_multipart_reply_fill_header(rep, data);
+            ofl_msg_fill_header(msg, xid, (struct ofp_header *)data, len);
+            return 0;
+        }
+        if (rep->type == OFPMP_PORT_STATS) {
+            len = ofl_msg_multipart_reply_port_len((struct ofl_msg_multipart_reply_port *)msg);
+            ofpbuf_prealloc_tailroom(buf, len);
+            data = ofpbuf_put_uninit(buf, len);
+            ofl_msg_multipart_reply_port_fill((struct ofl_msg_multipart_reply_port *)msg, data);
+            ofl_msg_multipart_reply_fill_header(rep, data);
+            ofl_msg_fill_header(msg, xid, (struct ofp_header *)data, len);
+            return 0;
+        }
+    }
 
+    {
+        int error = ofl_msg_pack(msg, xid, &data, &len, exp);
+        if (error) {
+            return error;
+        }
+    }
+    if (buf->size == 0 && !ofpbuf_is_shared(buf)) {
+        /* Adopt the packed message rather than copying it. */
+        uint8_t conn_id = buf->conn_id;
+
+        ofpbuf_uninit(buf);
+        ofpbuf_use(buf, data, len);
+        ofpbuf_put_uninit(buf, len);
+        buf->conn_id = conn_id;
+    } else {
+        ofpbuf_put(buf, data, len);
+        free(data);
+    }
     return 0;
 }
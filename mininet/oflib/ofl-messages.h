@@ -41,6 +41,8 @@
 #include "ofl-structs.h"
 #include "ofl-actions.h"
 
+struct ofpbuf;
+
 
 /****************************************************************************
 + * Message structure definitions.
@@ -485,6 +487,13 @@ struct ofl_msg_queue_get_config_reply {
 int
 ofl_msg_pack(struct ofl_msg_header *msg, uint32_t xid, uint8_t **buf, size_t *buf_len, struct ofl_exp *exp);
 
+/* Packs the message in msg, appending it to the OpenFlow buffer buf. Packet
+ * ins and flow and port stats replies are sized first and serialized directly
+ * into buf; other messages are packed with ofl_msg_pack, and the result is
+ * adopted by buf if it is empty. Returns zero on success. */
+int
+ofl_msg_pack_ofpbuf(struct ofl_msg_header *msg, uint32_t xid, struct ofpbuf *buf, struct ofl_exp *exp);
+
 /* Unpacks the wire format message in buf to a new OFLib message pointed at by
  * msg. If xid is not null, it will hold the transaction ID of the received
  * message. Returns zero on success. In case of experimenter features, the
@@ -40,14 +40,31 @@ ofl_structs_match_init(struct ofl_match *match){
     match->match_fields = (struct hmap) HMAP_INITIALIZER(&match->match_fields);
 }
 
+/* Match fields are small and created in bulk for every flow_mod and packet,
+ * so the value is kept in the same block as the TLV itself. */
+struct ofl_match_tlv *
+ofl_structs_match_tlv_new(uint32_t header, size_t len) {
+    struct ofl_match_tlv *m = xmalloc(sizeof(struct ofl_match_tlv) + len);
+
+    m->header = header;
+    m->value = (uint8_t *)(m + 1);
+    return m;
+}
+
+void
+ofl_structs_match_tlv_free(struct ofl_match_tlv *tlv) {
+    if (tlv->value != (uint8_t *)(tlv + 1)) {
+        free(tlv->value);
+    }
+    free(tlv);
+}
+
 
 void
 ofl_structs_match_put8(struct ofl_match *match, uint32_t header, uint8_t value){
-    struct ofl_match_tlv *m = malloc(sizeof (struct ofl_match_tlv));
     int len = sizeof(uint8_t);
+    struct ofl_match_tlv *m = ofl_structs_match_tlv_new(header, len);
 
-    m->header = header;
-    m->value = malloc(len);
     memcpy(m->value, &value, len);
     hmap_insert(&match->match_fields,&m->hmap_node,hash_int(header, 0));
     match->header.length += len + 4;
@@ -55,11 +72,9 @@ ofl_structs_match_put8(struct ofl_match *match, uint32_t header, uint8_t value){
 
 void
 ofl_structs_match_put8m(struct ofl_match *match, uint32_t header, uint8_t value, uint8_t mask){
-    struct ofl_match_tlv *m = malloc(sizeof (struct ofl_match_tlv));
     int len = sizeof(uint8_t);
+    struct ofl_match_tlv *m = ofl_structs_match_tlv_new(header, len*2);
 
-    m->header = header;
-    m->value = malloc(len*2);
     memcpy(m->value, &value, len);
     memcpy(m->value + len, &mask, len);
     hmap_insert(&match->match_fields,&m->hmap_node,hash_int(header, 0));
@@ -68,11 +83,9 @@ ofl_structs_match_put8m(struct ofl_match *match, uint32_t header, uint8_t value,
 
 void
 ofl_structs_match_put16(struct ofl_match *match, uint32_t header, uint16_t value){
-    struct ofl_match_tlv *m = malloc(sizeof (struct ofl_match_tlv));
     int len = sizeof(uint16_t);
+    struct ofl_match_tlv *m = ofl_structs_match_tlv_new(header, len);
 
-    m->header = header;
-    m->value = malloc(len);
     memcpy(m->value, &value, len);
     hmap_insert(&match->match_fields,&m->hmap_node,hash_int(header, 0));
     match->header.length += len + 4;
@@ -81,11 +94,9 @@ ofl_structs_match_put16(struct ofl_match *match, uint32_t header, uint16_t value
 
 void
 ofl_structs_match_put16m(struct ofl_match *match, uint32_t header, uint16_t value, uint16_t mask){
-    struct ofl_match_tlv *m = malloc(sizeof (struct ofl_match_tlv));
     int len = sizeof(uint16_t);
+    struct ofl_match_tlv *m = ofl_structs_match_tlv_new(header, len*2);
 
-    m->header = header;
-    m->value = malloc(len*2);
     memcpy(m->value, &value, len);
     memcpy(m->value + len, &mask, len);
     hmap_insert(&match->match_fields,&m->hmap_node,hash_int(header, 0));
@@ -94,12 +105,9 @@ ofl_structs_match_put16m(struct ofl_match *match, uint32_t header, uint16_t valu
 
 void
 ofl_structs_match_put32(struct ofl_match *match, uint32_t header, uint32_t value){
-    struct ofl_match_tlv *m = xmalloc(sizeof (struct ofl_match_tlv));
-
     int len = sizeof(uint32_t);
+    struct ofl_match_tlv *m = ofl_structs_match_tlv_new(header, len);
 
-    m->header = header;
-    m->value = malloc(len);
     memcpy(m->value, &value, len);
     hmap_insert(&match->match_fields,&m->hmap_node,hash_int(header, 0));
     match->header.length += len + 4;
@@ -108,11 +116,9 @@ ofl_structs_match_put32(struct ofl_match *match, uint32_t header, uint32_t value
 
 void
 ofl_structs_match_put32m(struct ofl_match *match, uint32_t header, uint32_t value, uint32_t mask){
-    struct ofl_match_tlv *m = malloc(sizeof (struct ofl_match_tlv));
     int len = sizeof(uint32_t);
+    struct ofl_match_tlv *m = ofl_structs_match_tlv_new(header, len*2);
 
-    m->header = header;
-    m->value = malloc(len*2);
     memcpy(m->value, &value, len);
     memcpy(m->value + len, &mask, len);
     hmap_insert(&match->match_fields,&m->hmap_node,hash_int(header, 0));
@@ -122,11 +128,9 @@ ofl_structs_match_put32m(struct ofl_match *match, uint32_t header, uint32_t valu
 
 void
 ofl_structs_match_put64(struct ofl_match *match, uint32_t header, uint64_t value){
-    struct ofl_match_tlv *m = malloc(sizeof (struct ofl_match_tlv));
     int len = sizeof(uint64_t);
+    struct ofl_match_tlv *m = ofl_structs_match_tlv_new(header, len);
 
-    m->header = header;
-    m->value = malloc(len);
     memcpy(m->value, &value, len);
     hmap_insert(&match->match_fields,&m->hmap_node,hash_int(header, 0));
     match->header.length += len + 4;
@@ -135,11 +139,9 @@ ofl_structs_match_put64(struct ofl_match *match, uint32_t header, uint64_t value
 
 void
 ofl_structs_match_put64m(struct ofl_match *match, uint32_t header, uint64_t value, uint64_t mask){
-    struct ofl_match_tlv *m = malloc(sizeof (struct ofl_match_tlv));
     int len = sizeof(uint64_t);
+    struct ofl_match_tlv *m = ofl_structs_match_tlv_new(header, len*2);
 
-    m->header = header;
-    m->value = malloc(len*2);
     memcpy(m->value, &value, len);
     memcpy(m->value + len, &mask, len);
     hmap_insert(&match->match_fields,&m->hmap_node,hash_int(header, 0));
@@ -149,11 +151,9 @@ ofl_structs_match_put64m(struct ofl_match *match, uint32_t header, uint64_t valu
 
 void
 ofl_structs_match_put_pbb_isid(struct ofl_match *match, uint32_t header, uint8_t value[PBB_ISID_LEN]){
-    struct ofl_match_tlv *m = malloc(sizeof (struct ofl_match_tlv));
     int len = OXM_LENGTH(header);
+    struct ofl_match_tlv *m = ofl_structs_match_tlv_new(header, len);
 
-    m->header = header;
-    m->value = malloc(len);
     memcpy(m->value, value, len);
     hmap_insert(&match->match_fields,&m->hmap_node,hash_int(header, 0));
     match->header.length += len + 4;
@@ -162,11 +162,9 @@ ofl_structs_match_put_pbb_isid(struct ofl_match *match, uint32_t header, uint8_t
 
 void
 ofl_structs_match_put_pbb_isidm(struct ofl_match *match, uint32_t header, uint8_t value[PBB_ISID_LEN], uint8_t mask[PBB_ISID_LEN]){
-    struct ofl_match_tlv *m = malloc(sizeof (struct ofl_match_tlv));
     int len = OXM_LENGTH(header);
+    struct ofl_match_tlv *m = ofl_structs_match_tlv_new(header, len*2);
 
-    m->header = header;
-    m->value = malloc(len*2);
     memcpy(m->value, value, len);
     memcpy(m->value + len, mask, len);
     hmap_insert(&match->match_fields,&m->hmap_node,hash_int(header, 0));
@@ -175,11 +173,9 @@ ofl_structs_match_put_pbb_isidm(struct ofl_match *match, uint32_t header, uint8_
 
 void
 ofl_structs_match_put_eth(struct ofl_match *match, uint32_t header, uint8_t value[ETH_ADDR_LEN]){
-    struct ofl_match_tlv *m = malloc(sizeof (struct ofl_match_tlv));
     int len = ETH_ADDR_LEN;
+    struct ofl_match_tlv *m = ofl_structs_match_tlv_new(header, len);
 
-    m->header = header;
-    m->value = malloc(len);
     memcpy(m->value, value, len);
     hmap_insert(&match->match_fields,&m->hmap_node,hash_int(header, 0));
     match->header.length += len + 4;
@@ -188,11 +184,9 @@ ofl_structs_match_put_eth(struct ofl_match *match, uint32_t header, uint8_t valu
 
 void
 ofl_structs_match_put_eth_m(struct ofl_match *match, uint32_t header, uint8_t value[ETH_ADDR_LEN], uint8_t mask[ETH_ADDR_LEN]){
-    struct ofl_match_tlv *m = malloc(sizeof (struct ofl_match_tlv));
     int len = ETH_ADDR_LEN;
+    struct ofl_match_tlv *m = ofl_structs_match_tlv_new(header, len*2);
 
-    m->header = header;
-    m->value = malloc(len*2);
     memcpy(m->value, value, len);
     memcpy(m->value + len, mask, len);
     hmap_insert(&match->match_fields,&m->hmap_node,hash_int(header, 0));
@@ -203,11 +197,9 @@ ofl_structs_match_put_eth_m(struct ofl_match *match, uint32_t header, uint8_t va
 void
 ofl_structs_match_put_ipv6(struct ofl_match *match, uint32_t header, uint8_t value[IPv6_ADDR_LEN]){
 
-    struct ofl_match_tlv *m = malloc(sizeof (struct ofl_match_tlv));
     int len = IPv6_ADDR_LEN;
+    struct ofl_match_tlv *m = ofl_structs_match_tlv_new(header, len);
 
-    m->header = header;
-    m->value = malloc(len);
     memcpy(m->value, value, len);
     hmap_insert(&match->match_fields,&m->hmap_node,hash_int(header, 0));
     match->header.length += len + 4;
@@ -216,11 +208,9 @@ ofl_structs_match_put_ipv6(struct ofl_match *match, uint32_t header, uint8_t val
 
 void
 ofl_structs_match_put_ipv6m(struct ofl_match *match, uint32_t header, uint8_t value[IPv6_ADDR_LEN], uint8_t mask[IPv6_ADDR_LEN]){
-    struct ofl_match_tlv *m = malloc(sizeof (struct ofl_match_tlv));
     int len = IPv6_ADDR_LEN;
+    struct ofl_match_tlv *m = ofl_structs_match_tlv_new(header, len*2);
 
-    m->header = header;
-    m->value = malloc(len*2);
     memcpy(m->value, value, len);
     memcpy(m->value + len, mask, len);
     hmap_insert(&match->match_fields,&m->hmap_node,hash_int(header, 0));
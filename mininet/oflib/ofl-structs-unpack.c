@@ -1143,12 +1143,22 @@ static ofl_err
 ofl_structs_oxm_match_unpack(struct ofp_match* src, uint8_t* buf, size_t *len, struct ofl_match **dst){
 
      int error = 0;
-     struct ofpbuf *b = ofpbuf_new(0);
-     struct ofl_match *m = (struct ofl_match *) malloc(sizeof(struct ofl_match));
+     struct ofl_match *m;
+
+    if (*len < ROUND_UP(ntohs(src->length),8)) {
+        OFL_LOG_WARN(LOG_MODULE, "Received match has invalid length (%u, space left %zu).", ntohs(src->length), *len);
+        return ofl_error(OFPET_BAD_MATCH, OFPBMC_BAD_LEN);
+    }
+     m = (struct ofl_match *) malloc(sizeof(struct ofl_match));
     *len -= ROUND_UP(ntohs(src->length),8);
      if(ntohs(src->length) > sizeof(struct ofp_match)){
-         ofpbuf_put(b, buf, ntohs(src->length) - (sizeof(struct ofp_match) -4)); 
-         error = oxm_pull_match(b, m, ntohs(src->length) - (sizeof(struct ofp_match) -4));
+         /* The OXM fields are pulled straight out of the message. */
+         struct ofpbuf b;
+         size_t oxm_len = ntohs(src->length) - (sizeof(struct ofp_match) -4);
+
+         ofpbuf_use(&b, buf, oxm_len);
+         b.size = oxm_len;
+         error = oxm_pull_match(&b, m, oxm_len);
          m->header.length = ntohs(src->length) - 4;
      }
     else {
@@ -1156,7 +1166,6 @@ ofl_structs_oxm_match_unpack(struct ofp_match* src, uint8_t* buf, size_t *len, s
 		 m->header.type = ntohs(src->type);
          m->match_fields = (struct hmap) HMAP_INITIALIZER(&m->match_fields);	
 	}
-    ofpbuf_delete(b);    
     *dst = m;
     return error;
 }
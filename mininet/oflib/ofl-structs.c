@@ -523,8 +523,7 @@ ofl_structs_free_match(struct ofl_match_header *match, struct ofl_exp *exp) {
                 struct ofl_match *m = (struct ofl_match*) match;
                 struct ofl_match_tlv *tlv, *next;
                 HMAP_FOR_EACH_SAFE(tlv, next, struct ofl_match_tlv, hmap_node, &m->match_fields){
-                    free(tlv->value);
-                    free(tlv);
+                    ofl_structs_match_tlv_free(tlv);
                 }
                 hmap_destroy(&m->match_fields);
                 free(m);
@@ -238,7 +238,8 @@ struct ofl_match_tlv{
 
     struct hmap_node hmap_node;
     uint32_t header;    /* TLV header */
-    uint8_t *value;     /* TLV value */
+    uint8_t *value;     /* TLV value; normally stored right after the
+                           TLV, see ofl_structs_match_tlv_new */
 };
 
 
@@ -363,8 +364,8 @@ struct ofl_meter_band_stats {
     uint64_t byte_band_count;  /* Number of bytes in band. */
 
     /* Token bucket */
-    uint64_t last_fill;
-    uint64_t tokens;
+    uint64_t last_fill; /* monotonic time of the last refill, in ns. */
+    uint64_t tokens;    /* fixed point, see meter_entry.c. */
 };
 
 /* Body of reply to OFPMP_METER request. Meter statistics. */
@@ -406,6 +407,14 @@ struct ofl_meter_features {
 void
 ofl_structs_match_init(struct ofl_match *match);
 
+/* Allocates a TLV with room for a 'len' byte value in the same block. */
+struct ofl_match_tlv *
+ofl_structs_match_tlv_new(uint32_t header, size_t len);
+
+/* Frees a TLV and its value, whether or not the value was stored inline. */
+void
+ofl_structs_match_tlv_free(struct ofl_match_tlv *tlv);
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -563,6 +563,8 @@ oxm_pull_match(struct ofpbuf *buf, struct ofl_match * match_dst, int match_len)
 
     uint32_t header;
     uint8_t *p;
+    size_t n_fields;
+    int left;
     p = ofpbuf_try_pull(buf, match_len);
 
     if (!p) {
@@ -576,6 +578,21 @@ oxm_pull_match(struct ofpbuf *buf, struct ofl_match * match_dst, int match_len)
     /* Initialize the match hashmap */
     ofl_structs_match_init(match_dst);
 
+    /* Walk the entries once without allocating, so that a malformed match
+     * costs nothing and a good one sizes its hash map up front. */
+    n_fields = 0;
+    left = match_len;
+    while ((header = oxm_entry_ok(p + (match_len - left), left)) != 0) {
+        left -= 4 + OXM_LENGTH(header);
+        n_fields++;
+    }
+    if (left) {
+        return ofp_mkerr(OFPET_BAD_MATCH, OFPBMC_BAD_LEN);
+    }
+    if (n_fields > 1) {
+        hmap_reserve(&match_dst->match_fields, n_fields);
+    }
+
     while ((header = oxm_entry_ok(p, match_len)) != 0) {
 
         unsigned length = OXM_LENGTH(header);
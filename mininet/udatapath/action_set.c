@@ -29,6 +29,7 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 #include "action_set.h"
 #include "dp_actions.h"
 #include "datapath.h"
@@ -37,7 +38,6 @@
 #include "oflib/ofl-actions.h"
 #include "oflib/ofl-print.h"
 #include "packet.h"
-#include "list.h"
 #include "util.h"
 #include "vlog.h"
 
@@ -45,21 +45,18 @@
 
 static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(60, 60);
 
-struct action_set_entry;
+/* Number of entries kept in the set itself; the set only allocates for the
+ * entries beyond these. */
+#define ACTION_SET_INLINE 8
 
 struct action_set {
-    struct list     actions;   /* the list of actions in the action set,
-+                                   stored in the order of precedence as defined
-+                                   by the specification. */
-    struct ofl_exp *exp;       /* experimenter callbacks */
-};
-
-struct action_set_entry {
-    struct list                node;
-
-    struct ofl_action_header  *action;  /* these actions point to actions in
-+                                        * flow table entry instructions */
-    int                        order;   /* order of the entry as defined */
+    struct action_set_entry *entries;  /* the actions in the action set,
+                                          stored in the order of precedence as
+                                          defined by the specification. */
+    size_t                   entries_num;
+    size_t                   entries_max;
+    struct action_set_entry  inline_entries[ACTION_SET_INLINE];
+    struct ofl_exp          *exp;      /* experimenter callbacks */
 };
 
 
@@ -98,86 +95,117 @@ action_set_order(struct ofl_action_header *act) {
 struct action_set *
 action_set_create(struct ofl_exp *exp) {
     struct action_set *set = xmalloc(sizeof(struct action_set));
-    list_init(&set->actions);
+    set->entries = set->inline_entries;
+    set->entries_num = 0;
+    set->entries_max = ACTION_SET_INLINE;
     set->exp = exp;
 
     return set;
 }
 
 void action_set_destroy(struct action_set *set) {
-    action_set_clear_actions(set);
+    if (set->entries != set->inline_entries) {
+        free(set->entries);
+    }
     free(set);
 }
 
-static struct action_set_entry *
-action_set_create_entry(struct ofl_action_header *act) {
-    struct action_set_entry *entry;
-
-    entry = xmalloc(sizeof(struct action_set_entry));
-    entry->action = act;
-    entry->order = action_set_order(act);
-
-    return entry;
-}
-
 struct action_set *
 action_set_clone(struct action_set *set) {
-    struct action_set *s = xmalloc(sizeof(struct action_set));
-    struct action_set_entry *entry, *new_entry;
-
-    list_init(&s->actions);
-    s->exp = set->exp;
+    struct action_set *s = action_set_create(set->exp);
+    size_t i;
 
-    LIST_FOR_EACH(entry, struct action_set_entry, node, &set->actions) {
-        new_entry = action_set_create_entry(entry->action);
-        list_push_back(&s->actions, &new_entry->node);
+    for (i = 0; i < set->entries_num; i++) {
+        action_set_write_entries(s, 1, &set->entries[i]);
     }
 
     return s;
 }
 
+/* Returns true if 'new' overwrites 'old' when written to the same set: actions
+ * of the same type overwrite each other, except set field actions, which only
+ * overwrite the same field. */
+static bool
+action_set_entry_replaces(struct action_set_entry *new,
+                          struct action_set_entry *old) {
+    if (new->action->type != old->action->type) {
+        return false;
+    }
+    if (new->action->type == OFPAT_SET_FIELD) {
+        struct ofl_action_set_field *new_act =
+                (struct ofl_action_set_field *)new->action;
+        struct ofl_action_set_field *act =
+                (struct ofl_action_set_field *)old->action;
+
+        return new_act->field->header == act->field->header;
+    }
+    return true;
+}
 
-/* Writes a single action to the action set. Overwrites existing actions with
- * the same type in the set. The list order is based on the precedence defined
- * in the specification. */
+/* Writes a single entry to the 'entries_num' entries at 'entries', which must
+ * have room for one more. Overwrites existing actions with the same type. The
+ * order is based on the precedence defined in the specification. */
 static void
-action_set_write_action(struct action_set *set,
-                        struct ofl_action_header *act) {
-    struct action_set_entry *entry, *new_entry;
-
-    new_entry = action_set_create_entry(act);
-
-    LIST_FOR_EACH(entry, struct action_set_entry, node, &set->actions) {
-        if (entry->action->type == new_entry->action->type) {
-            if(entry->action->type == OFPAT_SET_FIELD){
-                struct ofl_action_set_field *new_act = 
-                        (struct ofl_action_set_field*) new_entry->action;
-                struct ofl_action_set_field *act = 
-                            (struct ofl_action_set_field *) entry->action;
-                if(act->field->header != new_act->field->header){
-                    continue;
-                }     
-            } 
+action_set_entries_write(struct action_set_entry *entries, size_t *entries_num,
+                         struct action_set_entry *new_entry) {
+    size_t i;
+
+    for (i = 0; i < *entries_num; i++) {
+        if (action_set_entry_replaces(new_entry, &entries[i])) {
             /* replace same type of action */
-            list_replace(&new_entry->node, &entry->node);
             /* NOTE: action in entry must not be freed, as it is owned by the
              *       write instruction which added the action to the set */
-            free(entry);
-
+            entries[i] = *new_entry;
             return;
         }
-        if (new_entry->order < entry->order) {
+        if (new_entry->order < entries[i].order) {
             /* insert higher order action before */
-            list_insert(&entry->node, &new_entry->node);
-
-            return;
+            break;
         }
     }
 
-    /* add action to the end of set */
-    list_insert(&entry->node, &new_entry->node);
+    memmove(&entries[i + 1], &entries[i],
+            (*entries_num - i) * sizeof(struct action_set_entry));
+    entries[i] = *new_entry;
+    (*entries_num)++;
 }
 
+size_t
+action_set_compile(size_t actions_num, struct ofl_action_header **actions,
+                   struct action_set_entry *entries) {
+    size_t entries_num = 0;
+    size_t i;
+
+    for (i = 0; i < actions_num; i++) {
+        struct action_set_entry entry = {actions[i],
+                                         action_set_order(actions[i])};
+
+        action_set_entries_write(entries, &entries_num, &entry);
+    }
+    return entries_num;
+}
+
+void
+action_set_write_entries(struct action_set *set, size_t entries_num,
+                         struct action_set_entry *entries) {
+    size_t i;
+
+    for (i = 0; i < entries_num; i++) {
+        if (set->entries_num == set->entries_max) {
+            struct action_set_entry *e;
+
+            set->entries_max *= 2;
+            e = xmalloc(set->entries_max * sizeof(struct action_set_entry));
+            memcpy(e, set->entries,
+                   set->entries_num * sizeof(struct action_set_entry));
+            if (set->entries != set->inline_entries) {
+                free(set->entries);
+            }
+            set->entries = e;
+        }
+        action_set_entries_write(set->entries, &set->entries_num, &entries[i]);
+    }
+}
 
 void
 action_set_write_actions(struct action_set *set,
@@ -186,35 +214,32 @@ action_set_write_actions(struct action_set *set,
     size_t i;
     VLOG_DBG_RL(LOG_MODULE, &rl, "Writing to action set.");
     for (i=0; i<actions_num; i++) {
-        action_set_write_action(set, actions[i]);
+        struct action_set_entry entry = {actions[i],
+                                         action_set_order(actions[i])};
+
+        action_set_write_entries(set, 1, &entry);
     }
     VLOG_DBG_RL(LOG_MODULE, &rl, "%s", action_set_to_string(set));
 }
 
 void
 action_set_clear_actions(struct action_set *set) {
-    struct action_set_entry *entry, *next;
-
-    LIST_FOR_EACH_SAFE(entry, next, struct action_set_entry, node, &set->actions) {
-        list_remove(&entry->node);
-        // NOTE: action in entry must not be freed, as it is owned by the write instruction
-        //       which added the action to the set
-        free(entry);
-    }
+    // NOTE: actions in entries must not be freed, as they are owned by the
+    //       write instructions which added them to the set
+    set->entries_num = 0;
 }
 
 void
 action_set_execute(struct action_set *set, struct packet *pkt, uint64_t cookie) {
-    struct action_set_entry *entry, *next;
+    size_t i;
 
-    LIST_FOR_EACH_SAFE(entry, next, struct action_set_entry, node, &set->actions) {
-        dp_execute_action(pkt, entry->action);
-        list_remove(&entry->node);
-        free(entry);
+    for (i = 0; i < set->entries_num; i++) {
+        dp_execute_action(pkt, set->entries[i].action);
     }
 
     /* Clear the action set in any case. Group processing depend on
      * a clean action-set. Jean II */
+    action_set_clear_actions(set);
     action_set_clear_actions(pkt->action_set);
 
         /* According to the spec. if there was a group action, the output
@@ -258,13 +283,13 @@ action_set_to_string(struct action_set *set) {
 
 void
 action_set_print(FILE *stream, struct action_set *set) {
-    struct action_set_entry *entry;
+    size_t i;
 
     fprintf(stream, "[");
 
-    LIST_FOR_EACH(entry, struct action_set_entry, node, &set->actions) {
-        ofl_action_print(stream, entry->action, set->exp);
-        if (entry->node.next != &set->actions) { fprintf(stream, ", "); }
+    for (i = 0; i < set->entries_num; i++) {
+        ofl_action_print(stream, set->entries[i].action, set->exp);
+        if (i + 1 < set->entries_num) { fprintf(stream, ", "); }
     }
 
     fprintf(stream, "]");
@@ -44,6 +44,14 @@ struct action_set;
 struct datapath;
 struct packet;
 
+/* An action of an action set, with its precedence as defined by the
+ * specification. */
+struct action_set_entry {
+    struct ofl_action_header  *action;  /* these actions point to actions in
+                                         * flow table entry instructions */
+    int                        order;   /* order of the entry as defined */
+};
+
 
 /****************************************************************************
  * Implementation of an action set associated with a datapath packet
@@ -69,6 +77,19 @@ action_set_write_actions(struct action_set *set,
                          struct ofl_action_header **actions);
 
 
+/* Fills 'entries', which must have room for 'actions_num' entries, with the
+ * entries an empty set would hold after writing the given actions, and returns
+ * their number. Used to prepare write actions instructions in advance. */
+size_t
+action_set_compile(size_t actions_num, struct ofl_action_header **actions,
+                   struct action_set_entry *entries);
+
+/* Writes entries prepared by action_set_compile() to the set, overwriting
+ * existing types as action_set_write_actions() does. */
+void
+action_set_write_entries(struct action_set *set, size_t entries_num,
+                         struct action_set_entry *entries);
+
 /* Clears the actions from the set. */
 void
 action_set_clear_actions(struct action_set *set);
@@ -8,6 +8,8 @@ man_MANS += udatapath/ofdatapath.8
 udatapath_ofdatapath_SOURCES = \
 	udatapath/action_set.c \
 	udatapath/action_set.h \
+	udatapath/compiled_actions.c \
+	udatapath/compiled_actions.h \
 	udatapath/crc32.c \
 	udatapath/crc32.h \
 	udatapath/datapath.c \
@@ -20,8 +22,16 @@ udatapath_ofdatapath_SOURCES = \
 	udatapath/dp_control.h \
 	udatapath/dp_exp.c \
 	udatapath/dp_exp.h \
+	udatapath/dp_liveness.c \
+	udatapath/dp_liveness.h \
+	udatapath/dp_pktin.c \
+	udatapath/dp_pktin.h \
 	udatapath/dp_ports.c \
 	udatapath/dp_ports.h \
+	udatapath/dp_stages.c \
+	udatapath/dp_stages.h \
+	udatapath/dp_trace.c \
+	udatapath/dp_trace.h \
 	udatapath/flow_table.c \
 	udatapath/flow_table.h \
 	udatapath/flow_entry.c \
@@ -42,10 +52,12 @@ udatapath_ofdatapath_SOURCES = \
     udatapath/packet_handle_std.h \
 	udatapath/pipeline.c \
 	udatapath/pipeline.h \
+	udatapath/timer_wheel.c \
+	udatapath/timer_wheel.h \
 	udatapath/udatapath.c
 
 udatapath_ofdatapath_LDADD = lib/libopenflow.a oflib/liboflib.a oflib-exp/liboflib_exp.a nbee_link/libnbee_link.a $(SSL_LIBS) $(FAULT_LIBS)
-udatapath_ofdatapath_CPPFLAGS = $(AM_CPPFLAGS)
+udatapath_ofdatapath_CPPFLAGS = $(AM_CPPFLAGS) $(DP_LOG_CPPFLAGS)
 nodist_EXTRA_udatapath_ofdatapath_SOURCES = dummy.cxx
 
 EXTRA_DIST += udatapath/ofdatapath.8.in
@@ -70,6 +82,8 @@ noinst_LIBRARIES += udatapath/libudatapath.a
 udatapath_libudatapath_a_SOURCES = \
 	udatapath/action_set.c \
 	udatapath/action_set.h \
+	udatapath/compiled_actions.c \
+	udatapath/compiled_actions.h \
 	udatapath/crc32.c \
 	udatapath/crc32.h \
 	udatapath/datapath.c \
@@ -82,6 +96,14 @@ udatapath_libudatapath_a_SOURCES = \
 	udatapath/dp_control.h \
 	udatapath/dp_exp.c \
 	udatapath/dp_exp.h \
+	udatapath/dp_liveness.c \
+	udatapath/dp_liveness.h \
+	udatapath/dp_pktin.c \
+	udatapath/dp_pktin.h \
+	udatapath/dp_stages.c \
+	udatapath/dp_stages.h \
+	udatapath/dp_trace.c \
+	udatapath/dp_trace.h \
 	udatapath/flow_table.c \
 	udatapath/flow_table.h \
 	udatapath/flow_entry.c \
@@ -98,9 +120,11 @@ udatapath_libudatapath_a_SOURCES = \
 	udatapath/packet_handle_std.h \
 	udatapath/pipeline.c \
 	udatapath/pipeline.h \
+	udatapath/timer_wheel.c \
+	udatapath/timer_wheel.h \
 	udatapath/udatapath.c
 
-udatapath_libudatapath_a_CPPFLAGS = $(AM_CPPFLAGS)
+udatapath_libudatapath_a_CPPFLAGS = $(AM_CPPFLAGS) $(DP_LOG_CPPFLAGS)
 udatapath_libudatapath_a_CPPFLAGS += -DOF_HW_PLAT -DUDATAPATH_AS_LIB -g -lnbee_link
 
 endif
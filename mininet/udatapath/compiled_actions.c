@@ -0,0 +1,191 @@
+/* Copyright (c) 2011, TrafficLab, Ericsson Research, Hungary
+ * Copyright (c) 2012, CPqD, Brazil 
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Ericsson Research nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <stdlib.h>
+#include "action_set.h"
+#include "compiled_actions.h"
+#include "datapath.h"
+#include "dp_actions.h"
+#include "dp_ports.h"
+#include "group_table.h"
+#include "packet.h"
+#include "util.h"
+#include "vlog.h"
+
+#define LOG_MODULE VLM_dp_acts
+
+static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(60, 60);
+
+/* Compiles an apply actions instruction into ops. */
+static void
+compile_apply(struct compiled_actions *ca, struct datapath *dp,
+              size_t actions_num, struct ofl_action_header **actions) {
+    size_t i;
+
+    ca->ops_num = actions_num;
+    ca->ops = xmalloc(actions_num * sizeof(struct compiled_op));
+
+    for (i = 0; i < actions_num; i++) {
+        struct compiled_op *op = &ca->ops[i];
+
+        switch (actions[i]->type) {
+            case OFPAT_OUTPUT: {
+                struct ofl_action_output *ao = (struct ofl_action_output *)actions[i];
+
+                op->type = COP_OUTPUT;
+                op->u.output.port_no = ao->port;
+                op->u.output.max_len = ao->max_len;
+                /* Port structures of physical ports never move, and are
+                 * left without a device while the port does not exist. */
+                op->u.output.port = ao->port >= 1 && ao->port <= DP_MAX_PORTS
+                                    ? &dp->ports[ao->port] : NULL;
+                break;
+            }
+            case OFPAT_GROUP: {
+                op->type = COP_GROUP;
+                op->u.group_id = ((struct ofl_action_group *)actions[i])->group_id;
+                break;
+            }
+            case OFPAT_SET_QUEUE: {
+                op->type = COP_SET_QUEUE;
+                op->u.queue_id = ((struct ofl_action_set_queue *)actions[i])->queue_id;
+                break;
+            }
+            case OFPAT_SET_FIELD: {
+                op->type = COP_SET_FIELD;
+                op->u.set_field = (struct ofl_action_set_field *)actions[i];
+                break;
+            }
+            case OFPAT_COPY_TTL_OUT:
+            case OFPAT_COPY_TTL_IN:
+            case OFPAT_SET_MPLS_TTL:
+            case OFPAT_DEC_MPLS_TTL:
+            case OFPAT_PUSH_VLAN:
+            case OFPAT_POP_VLAN:
+            case OFPAT_PUSH_MPLS:
+            case OFPAT_POP_MPLS:
+            case OFPAT_SET_NW_TTL:
+            case OFPAT_DEC_NW_TTL:
+            case OFPAT_PUSH_PBB:
+            case OFPAT_POP_PBB:
+            case OFPAT_EXPERIMENTER:
+            default: {
+                op->type = COP_ACTION;
+                op->u.action = actions[i];
+                break;
+            }
+        }
+    }
+}
+
+struct compiled_actions *
+compiled_actions_create(struct datapath *dp, size_t instructions_num,
+                        struct ofl_instruction_header **instructions) {
+    struct compiled_actions *ca;
+    size_t i;
+
+    ca = xcalloc(instructions_num, sizeof(struct compiled_actions));
+
+    for (i = 0; i < instructions_num; i++) {
+        struct ofl_instruction_actions *ia =
+                (struct ofl_instruction_actions *)instructions[i];
+
+        if (instructions[i]->type == OFPIT_APPLY_ACTIONS) {
+            compile_apply(&ca[i], dp, ia->actions_num, ia->actions);
+        } else if (instructions[i]->type == OFPIT_WRITE_ACTIONS) {
+            ca[i].set = xmalloc(ia->actions_num * sizeof(struct action_set_entry));
+            ca[i].set_num = action_set_compile(ia->actions_num, ia->actions,
+                                               ca[i].set);
+        }
+    }
+    return ca;
+}
+
+void
+compiled_actions_destroy(struct compiled_actions *ca, size_t instructions_num) {
+    size_t i;
+
+    for (i = 0; i < instructions_num; i++) {
+        free(ca[i].ops);
+        free(ca[i].set);
+    }
+    free(ca);
+}
+
+void
+compiled_actions_apply(struct compiled_actions *ca, struct packet *pkt,
+                       uint64_t cookie) {
+    size_t i;
+
+    VLOG_DBG_RL(LOG_MODULE, &rl, "Executing compiled action list.");
+
+    for (i = 0; i < ca->ops_num; i++) {
+        struct compiled_op *op = &ca->ops[i];
+
+        switch (op->type) {
+            case COP_OUTPUT: {
+                uint32_t queue = pkt->out_queue;
+
+                pkt->out_queue = 0;
+                if (op->u.output.port == NULL) {
+                    dp_actions_output_port(pkt, op->u.output.port_no, queue,
+                                           op->u.output.max_len, cookie);
+                } else if (pkt->in_port == op->u.output.port_no) {
+                    VLOG_WARN_RL(LOG_MODULE, &rl, "can't directly forward to input port.");
+                } else {
+                    dp_ports_output_port(pkt->dp, pkt->buffer, op->u.output.port,
+                                         op->u.output.port_no, queue);
+                }
+                break;
+            }
+            case COP_GROUP: {
+                /* The group processes a copy of the packet with an empty
+                 * action set; see dp_execute_action_list(). */
+                struct packet *pkt_clone = packet_clone(pkt);
+
+                group_table_execute(pkt_clone->dp->groups, pkt_clone,
+                                    op->u.group_id);
+                break;
+            }
+            case COP_SET_QUEUE: {
+                pkt->out_queue = op->u.queue_id;
+                break;
+            }
+            case COP_SET_FIELD: {
+                dp_actions_set_field(pkt, op->u.set_field);
+                break;
+            }
+            case COP_ACTION: {
+                dp_execute_action(pkt, op->u.action);
+                break;
+            }
+        }
+    }
+}
@@ -0,0 +1,101 @@
+/* Copyright (c) 2011, TrafficLab, Ericsson Research, Hungary
+ * Copyright (c) 2012, CPqD, Brazil 
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Ericsson Research nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef COMPILED_ACTIONS_H
+#define COMPILED_ACTIONS_H 1
+
+#include <stdint.h>
+#include <sys/types.h>
+#include "oflib/ofl-actions.h"
+#include "oflib/ofl-structs.h"
+
+/****************************************************************************
+ * Action lists of flow entry instructions, prepared when the flow is added so
+ * that executing them on a packet needs neither a dispatch on the action type
+ * for the common actions, nor a port lookup for output to physical ports, nor
+ * any allocation.
+ ****************************************************************************/
+
+struct action_set_entry;
+struct datapath;
+struct packet;
+struct sw_port;
+
+enum compiled_op_type {
+    COP_OUTPUT,     /* output action. */
+    COP_GROUP,      /* group action. */
+    COP_SET_QUEUE,  /* set queue action. */
+    COP_SET_FIELD,  /* set field action. */
+    COP_ACTION      /* any other action, run through dp_execute_action(). */
+};
+
+struct compiled_op {
+    enum compiled_op_type type;
+    union {
+        struct {
+            struct sw_port *port;    /* NULL for reserved ports. */
+            uint32_t        port_no;
+            uint16_t        max_len;
+        } output;
+        uint32_t                      group_id;
+        uint32_t                      queue_id;
+        struct ofl_action_set_field  *set_field;
+        struct ofl_action_header     *action;
+    } u;
+};
+
+/* The compiled form of one instruction of a flow entry. Only apply actions
+ * instructions have ops and only write actions instructions have set
+ * entries; both are empty for other instructions. The actions pointed to are
+ * owned by the instruction. */
+struct compiled_actions {
+    size_t                   ops_num;
+    struct compiled_op      *ops;      /* apply actions, in list order. */
+    size_t                   set_num;
+    struct action_set_entry *set;      /* write actions, in action set order. */
+};
+
+/* Compiles the given instructions of a flow entry of 'dp'. Returns an array
+ * with one element per instruction. */
+struct compiled_actions *
+compiled_actions_create(struct datapath *dp, size_t instructions_num,
+                        struct ofl_instruction_header **instructions);
+
+/* Destroys the array returned by compiled_actions_create(). */
+void
+compiled_actions_destroy(struct compiled_actions *ca, size_t instructions_num);
+
+/* Executes the compiled apply actions instruction on the packet, as
+ * dp_execute_action_list() would do with its actions. */
+void
+compiled_actions_apply(struct compiled_actions *ca, struct packet *pkt,
+                       uint64_t cookie);
+
+#endif /* COMPILED_ACTIONS_H */
@@ -41,6 +41,7 @@
 #include <assert.h>
 #include <errno.h>
 #include <inttypes.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
@@ -50,6 +51,7 @@
 #include "ofp.h"
 #include "ofpbuf.h"
 #include "group_table.h"
+#include "hash.h"
 #include "meter_table.h"
 #include "oflib/ofl.h"
 #include "oflib-exp/ofl-exp.h"
@@ -71,11 +73,14 @@
 static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(60, 60);
 
 
-static struct remote *remote_create(struct datapath *dp, struct rconn *rconn, struct rconn *rconn_aux);
-static void remote_run(struct datapath *, struct remote *);
-static void remote_rconn_run(struct datapath *, struct remote *, uint8_t);
+static struct remote *remote_create(struct datapath *dp, struct rconn *rconn, struct pvconn *pvconn_aux);
+static bool remote_run(struct datapath *, struct remote *);
+static bool remote_rconn_run(struct datapath *, struct remote *, uint8_t);
 static void remote_wait(struct remote *);
 static void remote_destroy(struct remote *);
+static struct remote *aux_candidate(struct datapath *, struct pvconn *);
+static void accept_aux(struct datapath *, struct pvconn *);
+static void sched_report(struct dp_sched *);
 
 
 #define MFR_DESC     "Stanford University, Ericsson Research and CPqD Research"
@@ -85,7 +90,10 @@ static void remote_destroy(struct remote *);
 #define SERIAL_NUM   "1"
 
 #define MAIN_CONNECTION 0
-#define PTIN_CONNECTION 1
+/* Packet ins go to the auxiliary connection chosen by their flow. */
+#define ANY_AUX_CONNECTION 0xff
+
+#define SCHED_REPORT_SECS 60
 
 
 /* Callbacks for processing experimenter messages in OFLib. */
@@ -95,11 +103,21 @@ static struct ofl_exp_msg dp_exp_msg =
          .free      = ofl_exp_msg_free,
          .to_string = ofl_exp_msg_to_string};
 
+static struct ofl_exp_stats dp_exp_multipart =
+        {.req_pack        = ofl_exp_stats_req_pack,
+         .req_unpack      = ofl_exp_stats_req_unpack,
+         .req_free        = ofl_exp_stats_req_free,
+         .req_to_string   = ofl_exp_stats_req_to_string,
+         .reply_pack      = ofl_exp_stats_reply_pack,
+         .reply_unpack    = ofl_exp_stats_reply_unpack,
+         .reply_free      = ofl_exp_stats_reply_free,
+         .reply_to_string = ofl_exp_stats_reply_to_string};
+
 static struct ofl_exp dp_exp =
         {.act   = NULL,
          .inst  = NULL,
          .match = NULL,
-         .stats = NULL,
+         .stats = &dp_exp_multipart,
          .msg   = &dp_exp_msg};
 
 /* Generates and returns a random datapath id. */
@@ -132,23 +150,31 @@ dp_new(void) {
 
     dp->generation_id = -1;
 
-    dp->last_timeout = time_now();
     list_init(&dp->remotes);
     dp->listeners = NULL;
     dp->n_listeners = 0;
     dp->listeners_aux = NULL;
     dp->n_listeners_aux = 0;
+    dp->max_aux = REMOTE_AUX_DEFAULT;
 
     memset(dp->ports, 0x00, sizeof (dp->ports));
     dp->local_port = NULL;
 
-    dp->buffers = dp_buffers_create(dp);
+    dp->buffers = dp_buffers_create(dp, DP_BUFFERS_DEFAULT);
+    memset(&dp->sched, 0, sizeof dp->sched);
+    dp->sched.rx_budget = DP_RX_BUDGET_DEFAULT;
+    dp->sched.msg_budget = DP_MSG_BUDGET_DEFAULT;
+    dp->sched.next_report = time_now() + SCHED_REPORT_SECS;
+    dp->pktin = dp_pktin_create(dp);
+    dp->liveness = dp_liveness_create(dp);
+    dp->trace = dp_trace_create(dp);
     dp->pipeline = pipeline_create(dp);
     dp->groups = group_table_create(dp);
     dp->meters = meter_table_create(dp);
 
     list_init(&dp->port_list);
     dp->ports_num = 0;
+    dp->max_mtu = 0;
     dp->max_queues = NETDEV_MAX_QUEUES;
 
     dp->exp = &dp_exp;
@@ -187,37 +213,47 @@ dp_add_pvconn(struct datapath *dp, struct pvconn *pvconn, struct pvconn *pvconn_
 
 void
 dp_run(struct datapath *dp, struct mac_to_port *mac_port, struct mac_to_port *recovery_table, struct table_tcp * tcp_table, uint8_t *puerto_no_disponible, struct timeval * t_ini_recuperacion){
-    time_t now = time_now();
+    struct dp_sched *sched = &dp->sched;
     struct remote *r, *rn;
+    long long int start, now;
+    bool backlog;
     size_t i;
-    if (now != dp->last_timeout) {
-        dp->last_timeout = now;
-        meter_table_add_tokens(dp->meters);
-        pipeline_timeout(dp->pipeline);
+
+    start = time_nsec();
+    if (sched->round_end) {
+        sched->stats.idle_nsec += start - sched->round_end;
     }
-    poll_timer_wait(100);
-    dp_ports_run(dp, mac_port, recovery_table, tcp_table, puerto_no_disponible, t_ini_recuperacion);
+    sched->stats.rounds++;
+
+    /* Flow timeouts are kept in timing wheels, so checking them on every
+     * iteration only costs the entries that are due. */
+    pipeline_timeout(dp->pipeline);
+    dp_buffers_run(dp->buffers);
+    dp_pktin_run(dp->pktin);
+    dp_trace_run(dp->trace);
+    now = time_nsec();
+    sched->stats.other_nsec += now - start;
+    start = now;
+
+    backlog = dp_ports_run(dp, mac_port, recovery_table, tcp_table, puerto_no_disponible, t_ini_recuperacion,
+                           sched->rx_budget);
+    now = time_nsec();
+    sched->stats.data_nsec += now - start;
+    start = now;
 	
     /* Talk to remotes. */
     LIST_FOR_EACH_SAFE (r, rn, struct remote, node, &dp->remotes) {
-        remote_run(dp, r);
+        backlog |= remote_run(dp, r);
     }
 	
 	for (i = 0; i < dp->n_listeners; ) {
         struct pvconn *pvconn = dp->listeners[i];
+        struct pvconn *pvconn_aux = dp->n_listeners_aux ? dp->listeners_aux[i] : NULL;
         struct vconn *new_vconn;
 
         int retval = pvconn_accept(pvconn, OFP_VERSION, &new_vconn);
         if (!retval) {
-            struct rconn * rconn_aux = NULL;
-            if (dp->n_listeners_aux && dp->listeners_aux[i] != NULL) {
-                struct pvconn *pvconn_aux = dp->listeners_aux[i];
-                struct vconn *new_vconn_aux;
-                int retval_aux = pvconn_accept(pvconn_aux, OFP_VERSION, &new_vconn_aux);
-                if (!retval_aux)
-                    rconn_aux = rconn_new_from_vconn("passive_aux", new_vconn_aux);
-            }
-            remote_create(dp, rconn_new_from_vconn("passive", new_vconn), rconn_aux);
+            remote_create(dp, rconn_new_from_vconn("passive", new_vconn), pvconn_aux);
         }
         else if (retval != EAGAIN) {
             VLOG_WARN_RL(LOG_MODULE, &rl, "accept failed (%s)", strerror(retval));
@@ -227,27 +263,141 @@ dp_run(struct datapath *dp, struct mac_to_port *mac_port, struct mac_to_port *re
             }
             continue;
         }
+        if (pvconn_aux != NULL) {
+            accept_aux(dp, pvconn_aux);
+        }
         i++;
     }
+    now = time_nsec();
+    sched->stats.control_nsec += now - start;
+
+    sched->backlog = backlog;
+    if (backlog) {
+        sched->stats.busy_rounds++;
+    }
+    sched->round_end = now;
+    sched_report(sched);
+}
+
+/* Logs where dp_run spent its time since the last report. */
+static void
+sched_report(struct dp_sched *sched) {
+    struct dp_sched_stats *s = &sched->stats;
+    struct dp_sched_stats *o = &sched->reported;
+
+    if (time_now() < sched->next_report) {
+        return;
+    }
+    sched->next_report = time_now() + SCHED_REPORT_SECS;
+
+    if (s->packets != o->packets || s->msgs != o->msgs) {
+        VLOG_INFO(LOG_MODULE, "last %d s: %"PRIu64" rounds (%"PRIu64" busy), "
+                  "%"PRIu64" packets in %"PRIu64" ms, %"PRIu64" messages in "
+                  "%"PRIu64" ms, %"PRIu64" ms timeouts, %"PRIu64" ms idle.",
+                  SCHED_REPORT_SECS, s->rounds - o->rounds,
+                  s->busy_rounds - o->busy_rounds,
+                  s->packets - o->packets,
+                  (s->data_nsec - o->data_nsec) / 1000000,
+                  s->msgs - o->msgs,
+                  (s->control_nsec - o->control_nsec) / 1000000,
+                  (s->other_nsec - o->other_nsec) / 1000000,
+                  (s->idle_nsec - o->idle_nsec) / 1000000);
+    }
+    *o = *s;
 }
 
+/* Returns a remote whose auxiliary connections come from 'pvconn_aux' and
+ * that can take one more, or NULL. Auxiliary connections are assigned to the
+ * remotes of the matching main listener in order of arrival. */
+static struct remote *
+aux_candidate(struct datapath *dp, struct pvconn *pvconn_aux) {
+    struct remote *r;
+
+    LIST_FOR_EACH (r, struct remote, node, &dp->remotes) {
+        if (r->pvconn_aux == pvconn_aux && r->n_aux < dp->max_aux) {
+            return r;
+        }
+    }
+    return NULL;
+}
+
+/* Accepts the pending auxiliary connections on 'pvconn_aux'. Connections
+ * are left pending while no remote can take them. A new connection takes the
+ * lowest free slot, and keeps it, and the auxiliary_id that goes with it, for
+ * as long as it lives. */
 static void
+accept_aux(struct datapath *dp, struct pvconn *pvconn_aux) {
+    struct remote *r;
+
+    while ((r = aux_candidate(dp, pvconn_aux)) != NULL) {
+        struct vconn *new_vconn;
+        int retval = pvconn_accept(pvconn_aux, OFP_VERSION, &new_vconn);
+        size_t i;
+
+        if (retval) {
+            if (retval != EAGAIN) {
+                VLOG_WARN_RL(LOG_MODULE, &rl, "accept of auxiliary connection "
+                             "failed (%s)", strerror(retval));
+            }
+            return;
+        }
+        for (i = 0; r->aux[i].rconn != NULL; i++) {
+            continue;
+        }
+        r->aux[i].rconn = rconn_new_from_vconn("passive_aux", new_vconn);
+        r->aux[i].n_txq = 0;
+        r->n_aux++;
+    }
+}
+
+/* Returns true if the remote has more messages or dump replies pending than
+ * its budget allowed for. */
+static bool
 remote_run(struct datapath *dp, struct remote *r)
 {
-    remote_rconn_run(dp, r, MAIN_CONNECTION);
+    bool backlog;
+    size_t i;
+
+    backlog = remote_rconn_run(dp, r, MAIN_CONNECTION);
 	
     if (!rconn_is_alive(r->rconn)) {
         remote_destroy(r);
-        return;
+        return false;
     }
 
-    if (r->rconn_aux == NULL || !rconn_is_alive(r->rconn_aux))
-        return;
-	
-	remote_rconn_run(dp, r, PTIN_CONNECTION);
+    for (i = 0; i < REMOTE_MAX_AUX; i++) {
+        if (r->aux[i].rconn == NULL) {
+            continue;
+        }
+        if (!rconn_is_alive(r->aux[i].rconn)) {
+            /* Free the slot; the other connections keep theirs. A dump
+             * answering a request of this connection has nowhere to go. */
+            if (r->cb_dump && r->cb_conn_id == i + 1) {
+                r->cb_done(r->cb_aux);
+                r->cb_dump = NULL;
+            }
+            rconn_destroy(r->aux[i].rconn);
+            r->aux[i].rconn = NULL;
+            r->n_aux--;
+            continue;
+        }
+        backlog |= remote_rconn_run(dp, r, i + 1);
+    }
+    return backlog;
 }
 
-static void
+/* Returns the tx queue length of the connection the dump of 'r' replies to,
+ * chosen as in send_openflow_buffer_to_remote(). */
+static int
+remote_dump_n_txq(const struct remote *r) {
+    if (r->cb_conn_id != MAIN_CONNECTION && r->cb_conn_id <= REMOTE_MAX_AUX
+        && r->aux[r->cb_conn_id - 1].rconn != NULL) {
+        return r->aux[r->cb_conn_id - 1].n_txq;
+    }
+    return r->n_txq;
+}
+
+static bool
 remote_rconn_run(struct datapath *dp, struct remote *r, uint8_t conn_id) {
     struct rconn *rconn = NULL;
     ofl_err error;
@@ -255,13 +405,15 @@ remote_rconn_run(struct datapath *dp, struct remote *r, uint8_t conn_id) {
     rconn = NULL;
     if (conn_id == MAIN_CONNECTION)
         rconn = r->rconn;
-    else if (conn_id == PTIN_CONNECTION)
-        rconn = r->rconn_aux;
+    else
+        rconn = r->aux[conn_id - 1].rconn;
 
     rconn_run(rconn);
     /* Do some remote processing, but cap it at a reasonable amount so that
-     * other processing doesn't starve. */
-    for (i = 0; i < 50; i++) {
+     * other processing doesn't starve. Flow mods received in one run are
+     * installed as a batch. */
+    pipeline_batch_begin(dp->pipeline);
+    for (i = 0; i < dp->sched.msg_budget; i++) {
         if (!r->cb_dump) {
             struct ofpbuf *buffer;
 
@@ -293,9 +445,10 @@ remote_rconn_run(struct datapath *dp, struct remote *r, uint8_t conn_id) {
                     dp_send_message(dp, (struct ofl_msg_header *)&err, &sender);
                 }
                 ofpbuf_delete(buffer);
+                dp->sched.stats.msgs++;
             }
         } else {
-            if (r->n_txq < TXQ_LIMIT) {
+            if (remote_dump_n_txq(r) < TXQ_LIMIT) {
                 int error = r->cb_dump(dp, r->cb_aux);
                 if (error <= 0) {
                     if (error) {
@@ -310,17 +463,44 @@ remote_rconn_run(struct datapath *dp, struct remote *r, uint8_t conn_id) {
             }
         }
     }
+    pipeline_batch_end(dp->pipeline);
+    return i == dp->sched.msg_budget;
+}
+
+void
+remote_start_dump(struct datapath *dp, const struct sender *sender,
+                  int (*dump)(struct datapath *, void *),
+                  void (*done)(void *),
+                  void *aux) {
+    struct remote *remote = sender->remote;
+
+    if (remote == NULL || remote->cb_dump != NULL) {
+        /* Only one dump runs in the background; this one can not wait. */
+        while (dump(dp, aux) > 0) {
+            continue;
+        }
+        done(aux);
+        return;
+    }
+    remote->cb_dump = dump;
+    remote->cb_done = done;
+    remote->cb_aux  = aux;
+    remote->cb_conn_id = sender->conn_id;
 }
 
 static void
 remote_wait(struct remote *r)
 {
+    size_t i;
+
     rconn_run_wait(r->rconn);
     rconn_recv_wait(r->rconn);
 
-    if (r->rconn_aux) {
-        rconn_run_wait(r->rconn_aux);
-        rconn_recv_wait(r->rconn_aux);
+    for (i = 0; i < REMOTE_MAX_AUX; i++) {
+        if (r->aux[i].rconn != NULL) {
+            rconn_run_wait(r->aux[i].rconn);
+            rconn_recv_wait(r->aux[i].rconn);
+        }
     }
 }
 
@@ -328,12 +508,16 @@ static void
 remote_destroy(struct remote *r)
 {
     if (r) {
+        size_t i;
+
         if (r->cb_dump && r->cb_done) {
              r->cb_done(r->cb_aux);
         }
         list_remove(&r->node);
-        if (r->rconn_aux != NULL) {
-            rconn_destroy(r->rconn_aux);
+        for (i = 0; i < REMOTE_MAX_AUX; i++) {
+            if (r->aux[i].rconn != NULL) {
+                rconn_destroy(r->aux[i].rconn);
+            }
         }
         rconn_destroy(r->rconn);
 	if(r->mp_req_msg != NULL) {
@@ -344,13 +528,15 @@ remote_destroy(struct remote *r)
 }
 
 static struct remote *
-remote_create(struct datapath *dp, struct rconn *rconn, struct rconn *rconn_aux)
+remote_create(struct datapath *dp, struct rconn *rconn, struct pvconn *pvconn_aux)
 {
     size_t i;
     struct remote *remote = xmalloc(sizeof *remote);
     list_push_back(&dp->remotes, &remote->node);
     remote->rconn = rconn;
-    remote->rconn_aux = rconn_aux;
+    remote->pvconn_aux = pvconn_aux;
+    memset(remote->aux, 0, sizeof remote->aux);
+    remote->n_aux = 0;
     remote->cb_dump = NULL;
     remote->n_txq = 0;
     remote->mp_req_msg = NULL;
@@ -379,12 +565,29 @@ dp_wait(struct datapath *dp)
         }
         netdev_recv_wait(p->netdev);
     }
+    netdev_link_wait();
+    dp_liveness_wait(dp->liveness);
+    dp_trace_wait(dp->trace);
     LIST_FOR_EACH (r, struct remote, node, &dp->remotes) {
         remote_wait(r);
     }
     for (i = 0; i < dp->n_listeners; i++) {
         pvconn_wait(dp->listeners[i]);
     }
+    for (i = 0; i < dp->n_listeners_aux; i++) {
+        /* Pending auxiliary connections stay queued while no remote can
+         * take them, so only wait for them when one can. */
+        if (dp->listeners_aux[i] != NULL
+            && aux_candidate(dp, dp->listeners_aux[i]) != NULL) {
+            pvconn_wait(dp->listeners_aux[i]);
+        }
+    }
+    if (dp->sched.backlog) {
+        poll_immediate_wake();
+    } else {
+        /* Wake up now and then for timeouts even when idle. */
+        poll_timer_wait(100);
+    }
 }
 
 void
@@ -427,20 +630,81 @@ dp_set_max_queues(struct datapath *dp, uint32_t max_queues) {
     dp->max_queues = max_queues;
 }
 
+void
+dp_set_max_aux(struct datapath *dp, size_t max_aux) {
+    dp->max_aux = MIN(max_aux, REMOTE_MAX_AUX);
+}
+
+void
+dp_set_budgets(struct datapath *dp, unsigned int rx_budget,
+               unsigned int msg_budget) {
+    dp->sched.rx_budget = rx_budget;
+    dp->sched.msg_budget = msg_budget;
+}
+
+void
+dp_set_buffers_num(struct datapath *dp, size_t buffers_num) {
+    dp_buffers_destroy(dp->buffers);
+    dp->buffers = dp_buffers_create(dp, buffers_num);
+}
+
+
+/* Picks the auxiliary connection for a packet in of the flow with the given
+ * hash, so that the packet ins of a flow keep their order. If that
+ * connection is down or its queue is full, the following ones are tried.
+ * Returns NULL if none can take it. */
+static struct remote_aux *
+remote_aux_for_flow(struct remote *r, uint32_t flow_hash) {
+    size_t skip, start, i;
+
+    if (r->n_aux == 0) {
+        return NULL;
+    }
+    /* Start from the connection the hash picks among those in use. */
+    skip = flow_hash % r->n_aux;
+    for (start = 0; r->aux[start].rconn == NULL || skip-- > 0; start++) {
+        continue;
+    }
+    for (i = 0; i < REMOTE_MAX_AUX; i++) {
+        struct remote_aux *aux = &r->aux[(start + i) % REMOTE_MAX_AUX];
 
+        if (aux->rconn != NULL && rconn_is_connected(aux->rconn)
+            && aux->n_txq < TXQ_LIMIT) {
+            return aux;
+        }
+    }
+    return NULL;
+}
+
+bool
+remote_has_room_for_packet_in(struct remote *r) {
+    return r->n_txq < TXQ_LIMIT || remote_aux_for_flow(r, 0) != NULL;
+}
+
+/* Sends the buffer on the connection its conn_id names; packet ins go to an
+ * auxiliary connection picked by 'flow_hash', or to the main connection if
+ * no auxiliary connection can take them. */
 static int
-send_openflow_buffer_to_remote(struct ofpbuf *buffer, struct remote *remote) {
+send_openflow_buffer_to_remote(struct ofpbuf *buffer, struct remote *remote,
+                               uint32_t flow_hash) {
     struct rconn* rconn = remote->rconn;
+    int *n_txq = &remote->n_txq;
     int retval;
-    if (buffer->conn_id == PTIN_CONNECTION &&
-        remote->rconn != NULL &&
-        remote->rconn_aux != NULL &&
-        rconn_is_connected(remote->rconn) &&
-        rconn_is_connected(remote->rconn_aux)) {
-            rconn = remote->rconn_aux;
+
+    if (buffer->conn_id == ANY_AUX_CONNECTION) {
+        struct remote_aux *aux = remote_aux_for_flow(remote, flow_hash);
+
+        if (aux != NULL) {
+            rconn = aux->rconn;
+            n_txq = &aux->n_txq;
+        }
+    } else if (buffer->conn_id != MAIN_CONNECTION
+               && buffer->conn_id <= REMOTE_MAX_AUX
+               && remote->aux[buffer->conn_id - 1].rconn != NULL) {
+        rconn = remote->aux[buffer->conn_id - 1].rconn;
+        n_txq = &remote->aux[buffer->conn_id - 1].n_txq;
     }
-    retval = rconn_send_with_limit(rconn, buffer, &remote->n_txq,
-                                      TXQ_LIMIT);
+    retval = rconn_send_with_limit(rconn, buffer, n_txq, TXQ_LIMIT);
 
     if (retval) {
         VLOG_WARN_RL(LOG_MODULE, &rl, "send to %s failed: %s",
@@ -450,20 +714,39 @@ send_openflow_buffer_to_remote(struct ofpbuf *buffer, struct remote *remote) {
     return retval;
 }
 
+/* Returns a hash of the match of a packed packet in. The match holds the
+ * header fields of the packet, so all packets of a flow get the same hash. */
+static uint32_t
+packet_in_flow_hash(const struct ofpbuf *buffer) {
+    const struct ofp_packet_in *p = buffer->data;
+    size_t len;
+
+    if (buffer->size < sizeof *p) {
+        return 0;
+    }
+    len = MIN(ntohs(p->match.length),
+              buffer->size - offsetof(struct ofp_packet_in, match));
+    return hash_bytes(&p->match, len, 0);
+}
+
 static int
 send_openflow_buffer(struct datapath *dp, struct ofpbuf *buffer,
                      const struct sender *sender) {
     update_openflow_length(buffer);
     if (sender) {
         /* Send back to the sender. */
-        return send_openflow_buffer_to_remote(buffer, sender->remote);
+        return send_openflow_buffer_to_remote(buffer, sender->remote, 0);
 
     } else {
         /* Broadcast to all remotes. */
         struct remote *r, *prev = NULL;
+        uint32_t flow_hash = 0;
         uint8_t msg_type;
         /* Get the type of the message */
         memcpy(&msg_type,((char* ) buffer->data) + 1, sizeof(uint8_t));
+        if (msg_type == OFPT_PACKET_IN) {
+            flow_hash = packet_in_flow_hash(buffer);
+        }
         LIST_FOR_EACH (r, struct remote, node, &dp->remotes) {
             /* do not send to remotes with slave role apart from port status */
             if (r->role == OFPCR_ROLE_EQUAL || r->role == OFPCR_ROLE_MASTER){
@@ -521,12 +804,14 @@ send_openflow_buffer(struct datapath *dp, struct ofpbuf *buffer,
                 }
             }
             if (prev) {
-                send_openflow_buffer_to_remote(ofpbuf_clone(buffer), prev);
+                /* Remotes share the message rather than copy it. */
+                send_openflow_buffer_to_remote(ofpbuf_share(buffer), prev,
+                                               flow_hash);
             }
             prev = r;
         }
         if (prev) {
-            send_openflow_buffer_to_remote(buffer, prev);
+            send_openflow_buffer_to_remote(buffer, prev, flow_hash);
         } else {
             ofpbuf_delete(buffer);
         }
@@ -538,8 +823,6 @@ int
 dp_send_message(struct datapath *dp, struct ofl_msg_header *msg,
                      const struct sender *sender) {
     struct ofpbuf *ofpbuf;
-    uint8_t *buf;
-    size_t buf_size;
     int error;
 
     if (VLOG_IS_DBG_ENABLED(LOG_MODULE)) {
@@ -548,32 +831,30 @@ dp_send_message(struct datapath *dp, struct ofl_msg_header *msg,
         free(msg_str);
     }
 
-    error = ofl_msg_pack(msg, sender == NULL ? 0 : sender->xid, &buf, &buf_size, dp->exp);
+    ofpbuf = ofpbuf_new(0);
+    error = ofl_msg_pack_ofpbuf(msg, sender == NULL ? 0 : sender->xid, ofpbuf, dp->exp);
     if (error) {
         VLOG_WARN_RL(LOG_MODULE, &rl, "There was an error packing the message!");
+        ofpbuf_delete(ofpbuf);
         return error;
     }
-    ofpbuf = ofpbuf_new(0);
-    ofpbuf_use(ofpbuf, buf, buf_size);
-    ofpbuf_put_uninit(ofpbuf, buf_size);
 
     /* Choose the connection to send the packet to.
        1) By default, we send it to the main connection
        2) If there's an associated sender, send the response to the same
           connection the request came from
-       3) If it's a packet in, use the auxiliary connection
+       3) If it's a packet in, use an auxiliary connection
     */
     ofpbuf->conn_id = MAIN_CONNECTION;
     if (sender != NULL)
         ofpbuf->conn_id = sender->conn_id;
     if (msg->type == OFPT_PACKET_IN)
-        ofpbuf->conn_id = PTIN_CONNECTION;
+        ofpbuf->conn_id = ANY_AUX_CONNECTION;
 
+    /* 'ofpbuf' is consumed, whether or not it could be sent. */
     error = send_openflow_buffer(dp, ofpbuf, sender);
     if (error) {
         VLOG_WARN_RL(LOG_MODULE, &rl, "There was an error sending the message!");
-        /* TODO Zoltan: is delete needed? */
-        ofpbuf_delete(ofpbuf);
         return error;
     }
     return 0;
@@ -587,6 +868,71 @@ dp_handle_set_desc(struct datapath *dp, struct ofl_exp_openflow_msg_set_dp_desc
     return 0;
 }
 
+/* Most counters a counters reply can carry. */
+#define DP_COUNTERS_MAX 32
+
+/* Appends a counter to the reply being built in 'counters'. */
+static void
+add_counter(struct ofl_exp_counter *counters, size_t *n, const char *name,
+            uint64_t value) {
+    assert(*n < DP_COUNTERS_MAX);
+    strncpy(counters[*n].name, name, OFP_EXT_COUNTER_NAME_LEN);
+    counters[*n].value = value;
+    (*n)++;
+}
+
+ofl_err
+dp_handle_counters_request(struct datapath *dp,
+                           struct ofl_exp_openflow_mp_request_counters *msg,
+                           const struct sender *sender) {
+    struct ofl_exp_counter counters[DP_COUNTERS_MAX];
+    struct dp_buffers_stats buffers;
+    struct dp_pktin_stats pktin;
+    struct dp_liveness_stats liveness;
+    size_t n = 0;
+
+    dp_buffers_get_stats(dp->buffers, &buffers);
+    add_counter(counters, &n, "buffers.size", dp_buffers_size(dp->buffers));
+    add_counter(counters, &n, "buffers.used", buffers.used);
+    add_counter(counters, &n, "buffers.saves", buffers.saves);
+    add_counter(counters, &n, "buffers.evictions", buffers.evictions);
+    add_counter(counters, &n, "buffers.save_failures", buffers.save_failures);
+
+    dp_pktin_get_stats(dp->pktin, &pktin);
+    add_counter(counters, &n, "packet_in.sent", pktin.sent);
+    add_counter(counters, &n, "packet_in.reason_drops", pktin.reason_drops);
+    add_counter(counters, &n, "packet_in.port_drops", pktin.port_drops);
+    add_counter(counters, &n, "packet_in.dup_drops", pktin.dup_drops);
+    add_counter(counters, &n, "packet_in.congested_drops", pktin.congested_drops);
+    add_counter(counters, &n, "packet_in.no_controller", pktin.no_controller);
+
+    dp_liveness_get_stats(dp->liveness, &liveness);
+    add_counter(counters, &n, "liveness.tx", liveness.tx);
+    add_counter(counters, &n, "liveness.rx", liveness.rx);
+    add_counter(counters, &n, "liveness.ups", liveness.ups);
+    add_counter(counters, &n, "liveness.downs", liveness.downs);
+    add_counter(counters, &n, "liveness.detect_min_ns", liveness.detect_min);
+    add_counter(counters, &n, "liveness.detect_avg_ns",
+                liveness.downs ? liveness.detect_sum / (long long int) liveness.downs : 0);
+    add_counter(counters, &n, "liveness.detect_max_ns", liveness.detect_max);
+
+    {
+        struct ofl_exp_openflow_mp_reply_counters reply =
+                {{{{{.type = OFPT_MULTIPART_REPLY},
+                    .type = OFPMP_EXPERIMENTER, .flags = 0x0000},
+                   .experimenter_id = OPENFLOW_VENDOR_ID,
+                   .data_length = 0, .data = NULL},
+                  .type = OFP_EXT_MP_COUNTERS},
+                 .counters_num = n,
+                 .counters = counters};
+
+        dp_send_message(dp, (struct ofl_msg_header *)&reply, sender);
+    }
+
+    ofl_msg_free((struct ofl_msg_header *)msg, dp->exp);
+    return 0;
+}
+
 static ofl_err
 dp_check_generation_id(struct datapath *dp, uint64_t new_gen_id){
 
@@ -43,6 +43,9 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include "dp_buffers.h"
+#include "dp_liveness.h"
+#include "dp_pktin.h"
+#include "dp_trace.h"
 #include "dp_ports.h"
 #include "openflow/nicira-ext.h"
 #include "ofpbuf.h"
@@ -64,6 +67,35 @@ struct sender;
  ****************************************************************************/
 
 
+/* dp_run alternates between the data plane (receiving from ports) and the
+ * control plane (remotes and listeners). Each round handles at most
+ * 'rx_budget' packets per port and 'msg_budget' messages per connection;
+ * a round that uses up a budget makes the next one start right away
+ * instead of sleeping in poll. */
+#define DP_RX_BUDGET_DEFAULT   32
+#define DP_MSG_BUDGET_DEFAULT  50
+
+struct dp_sched_stats {
+    uint64_t rounds;            /* Calls to dp_run. */
+    uint64_t busy_rounds;       /* Rounds that used up a budget. */
+    uint64_t packets;           /* Packets received from ports. */
+    uint64_t msgs;              /* Control messages handled. */
+    uint64_t data_nsec;         /* Time spent on ports. */
+    uint64_t control_nsec;      /* Time spent on remotes and listeners. */
+    uint64_t other_nsec;        /* Time spent on timeouts and buffers. */
+    uint64_t idle_nsec;         /* Time between rounds, mostly polling. */
+};
+
+struct dp_sched {
+    unsigned int rx_budget;     /* Packets per port per round. */
+    unsigned int msg_budget;    /* Messages per connection per round. */
+    bool backlog;               /* The last round left work behind. */
+    long long int round_end;    /* time_nsec() when the last round ended. */
+    time_t next_report;
+    struct dp_sched_stats stats;
+    struct dp_sched_stats reported;
+};
+
 struct datapath {
     /* Strings to describe the manufacturer, hardware, and software. This data
      * is queriable through switch stats request. */
@@ -84,11 +116,18 @@ struct datapath {
     size_t n_listeners;
     struct pvconn **listeners_aux;
     size_t n_listeners_aux;
-    
-    time_t last_timeout;
+    size_t max_aux;             /* Auxiliary connections accepted per remote. */
 
     struct dp_buffers *buffers;
 
+    struct dp_sched sched;      /* Budgets and time accounting of dp_run. */
+
+    struct dp_pktin *pktin;     /* Limits on packet in messages. */
+
+    struct dp_liveness *liveness; /* Liveness of the neighbour links. */
+
+    struct dp_trace *trace;     /* Binary trace of datapath events. */
+
     struct pipeline *pipeline;  /* Pipeline with multi-tables. */
 
     struct group_table *groups; /* Group tables */
@@ -104,6 +143,7 @@ struct datapath {
     struct sw_port  *local_port;  /* OFPP_LOCAL port, if any. */
     struct list      port_list; /* All ports, including local_port. */
     size_t           ports_num;
+    int              max_mtu;   /* Largest MTU of the software ports. */
 
     /* Experimenter handling. */
     struct ofl_exp  *exp;
@@ -125,15 +165,30 @@ struct sender {
     uint32_t xid;               /* The OpenFlow transaction ID. */
 };
 
+#define TXQ_LIMIT 128           /* Max number of packets to queue for tx. */
+
+/* Auxiliary connections of a remote. The one at index i has auxiliary_id
+ * i + 1. */
+#define REMOTE_MAX_AUX       16
+#define REMOTE_AUX_DEFAULT   4
+
+struct remote_aux {
+    struct rconn *rconn;
+    int n_txq;                  /* Number of packets queued for tx on rconn. */
+};
+
 /* A connection to a secure channel. */
 struct remote {
     struct list node;
     struct rconn *rconn;
-    struct rconn *rconn_aux;
-    
-#define TXQ_LIMIT 128           /* Max number of packets to queue for tx. */
     int n_txq;                  /* Number of packets queued for tx on rconn. */
 
+    struct pvconn *pvconn_aux;  /* Listener of the auxiliary connections. */
+    /* Auxiliary connection 'i' has auxiliary_id i + 1, and keeps its slot
+     * while it lives; a free slot has a null rconn. */
+    struct remote_aux aux[REMOTE_MAX_AUX];
+    size_t n_aux;               /* Slots in use. */
+
     /* Support for reliable, multi-message replies to requests.
      *
      * If an incoming request needs to have a reliable reply that might
@@ -142,6 +197,7 @@ struct remote {
     int (*cb_dump)(struct datapath *, void *aux);
     void (*cb_done)(void *aux);
     void *cb_aux;
+    uint8_t cb_conn_id;         /* Connection the dump replies to. */
 
     uint32_t role; /*OpenFlow controller role.*/
     struct ofl_async_config config;  /* Asynchronous messages configuration, 
@@ -195,6 +251,36 @@ dp_set_serial_num(struct datapath *dp, char *serial_num);
 void
 dp_set_max_queues(struct datapath *dp, uint32_t max_queues);
 
+/* Sets the number of packet buffers. Packets already buffered are dropped. */
+void
+dp_set_buffers_num(struct datapath *dp, size_t buffers_num);
+
+/* Sets how many auxiliary connections are accepted for each remote. */
+void
+dp_set_max_aux(struct datapath *dp, size_t max_aux);
+
+/* Returns true if the remote has room to queue a packet in, on one of its
+ * auxiliary connections or on the main one. */
+bool
+remote_has_room_for_packet_in(struct remote *r);
+
+/* Sets how many packets per port and how many messages per connection a
+ * round of dp_run handles at most. */
+void
+dp_set_budgets(struct datapath *dp, unsigned int rx_budget,
+               unsigned int msg_budget);
+
+/* Sets up 'dump' to be called, with 'aux', whenever the remote of 'sender'
+ * has room for more replies, until it returns 0 (done) or a negative errno
+ * value; 'done' is called afterwards, or as soon as the connection of
+ * 'sender' goes away. If the remote is already running a dump, the new one
+ * runs to completion right away. */
+void
+remote_start_dump(struct datapath *dp, const struct sender *sender,
+                  int (*dump)(struct datapath *, void *),
+                  void (*done)(void *),
+                  void *aux);
+
 
 /* Sends the given OFLib message to the connection represented by sender,
  * or to all open connections, if sender is null. */
@@ -209,6 +295,12 @@ ofl_err
 dp_handle_set_desc(struct datapath *dp, struct ofl_exp_openflow_msg_set_dp_desc *msg,
                                             const struct sender *sender);
 
+/* Handles a datapath counters (openflow experimenter multipart) request */
+ofl_err
+dp_handle_counters_request(struct datapath *dp,
+                           struct ofl_exp_openflow_mp_request_counters *msg,
+                           const struct sender *sender);
+
 /* Handles a role request message */
 ofl_err
 dp_handle_role_request(struct datapath *dp, struct ofl_msg_role_request *msg,
@@ -36,6 +36,7 @@
 #include "dp_exp.h"
 #include "dp_actions.h"
 #include "dp_buffers.h"
+#include "dp_pktin.h"
 #include "datapath.h"
 #include "oflib/ofl.h"
 #include "oflib/ofl-actions.h"
@@ -56,7 +57,8 @@ static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(60, 60);
  * or invalidated by the actions. Also if the buffer might be reallocated,
  * e.g. because of a push action, the action implementations must make sure
  * that any internal pointers of the handler structures are also updated, or
- * invalidated.
+ * invalidated. Since packet data is shared between clones, every action
+ * modifying the packet must call packet_make_writable() first.
  */
 
 /* Executes an output action. */
@@ -69,19 +71,38 @@ output(struct packet *pkt, struct ofl_action_output *action) {
     }
 }
 
+/* Stores 'len' bytes at 'value' as the new value of the match field 'header'
+ * extracted from the packet, if the packet has that field. */
+static void
+set_field_update_match(struct packet_handle_std *handle, uint32_t header,
+                       uint8_t *value, size_t len) {
+    struct ofl_match_tlv *f;
+
+    HMAP_FOR_EACH_WITH_HASH(f, struct ofl_match_tlv, hmap_node,
+                            hash_int(header, 0), &handle->match.match_fields) {
+        if (f->header == header) {
+            memcpy(f->value, value, len);
+        }
+    }
+}
+
 /* Executes a set field action.
-TODO: if we use the the index structure to the packet fields
-revalidation is not needed  */
+ * The field is rewritten in place at the offsets of the parsed packet, the
+ * checksums are updated incrementally, and so is the field in the match of
+ * the handler. Only fields that change how the rest of the packet is parsed
+ * leave the handler to be revalidated. */
 
 static void
 set_field(struct packet *pkt, struct ofl_action_set_field *act )
 {
     packet_handle_std_validate(pkt->handle_std);
+    packet_make_writable(pkt);
     if (pkt->handle_std->valid)
     {
+        bool reparse = false;
+
         /*Field existence is guaranteed by the
         field pre-requisite on matching */
-        fprintf(stderr, "Header %d\n", OXM_FIELD(act->field->header));
         switch(act->field->header){
             case OXM_OF_ETH_DST:{
                 memcpy(pkt->handle_std->proto->eth->eth_dst,
@@ -96,16 +117,20 @@ set_field(struct packet *pkt, struct ofl_action_set_field *act )
             case OXM_OF_ETH_TYPE:{
                 uint16_t v = *((uint16_t*) act->field->value);
                 pkt->handle_std->proto->eth->eth_type = htons(v);
+                reparse = true;
                 break;
             }
             case OXM_OF_VLAN_VID:{
                 struct vlan_header *vlan =  pkt->handle_std->proto->vlan;
                 /* VLAN existence is no guaranteed by match prerquisite*/
                 if(vlan != NULL){
-                    uint16_t v = (*(uint16_t*)act->field->value);
-                    vlan->vlan_tci = htons((ntohs(vlan->vlan_tci) & ~VLAN_VID_MASK) | (v & VLAN_VID_MASK));
+                    uint16_t v = (*(uint16_t*)act->field->value) & VLAN_VID_MASK;
+                    vlan->vlan_tci = htons((ntohs(vlan->vlan_tci) & ~VLAN_VID_MASK) | v);
+                    /* The match holds the VID without the OFPVID_PRESENT bit */
+                    set_field_update_match(pkt->handle_std, OXM_OF_VLAN_VID,
+                                           (uint8_t *)&v, sizeof v);
                 }
-                break;
+                return;
             }
             case OXM_OF_VLAN_PCP:{
                 struct vlan_header *vlan = pkt->handle_std->proto->vlan;
@@ -113,8 +138,8 @@ set_field(struct packet *pkt, struct ofl_action_set_field *act )
                 if(vlan != NULL){
                     vlan->vlan_tci = (vlan->vlan_tci & ~htons(VLAN_PCP_MASK))
                                     | htons(*act->field->value << VLAN_PCP_SHIFT);
-                    break;
                 }
+                break;
             }
             case OXM_OF_IP_DSCP:{
                 if (pkt->handle_std->proto->ipv4){
@@ -160,6 +185,7 @@ set_field(struct packet *pkt, struct ofl_action_set_field *act )
                 new_val =  htons((ipv4->ip_ttl << 8) + proto);
                 ipv4->ip_csum = recalc_csum16(ipv4->ip_csum, old_val, new_val);
                 ipv4->ip_proto = proto;
+                reparse = true;
                 break;
             }
             case OXM_OF_IPV4_SRC:{
@@ -266,6 +292,8 @@ set_field(struct packet *pkt, struct ofl_action_set_field *act )
                     new_val =  htons((icmp_type << 8) + icmp_header->icmp_code);
                     icmp_header->icmp_csum = recalc_csum16(icmp_header->icmp_csum , old_val, new_val);
                     icmp_header->icmp_type = *act->field->value;
+                    /* The ICMPv6 type decides the ND fields */
+                    reparse = act->field->header == OXM_OF_ICMPV6_TYPE;
                 break;
             }
             case OXM_OF_ICMPV4_CODE:
@@ -282,7 +310,7 @@ set_field(struct packet *pkt, struct ofl_action_set_field *act )
 			/*Modificacion UAH*/
 			//TCP PATH
 			case OXM_OF_PATH_OP: {
-				pkt->handle_std->proto->path->op = htons(*((uint16_t*) act->field->value));
+				pkt->handle_std->proto->path->op = *act->field->value;
 				break;
 			}
 			case OXM_OF_PATH_MAC_DST:{
@@ -309,11 +337,11 @@ set_field(struct packet *pkt, struct ofl_action_set_field *act )
 				break;
 			}
 			case OXM_OF_PATH_SECUENCE: {
-				pkt->handle_std->proto->path->secuence = htons(*((uint32_t*) act->field->value));
+				pkt->handle_std->proto->path->secuence = htonl(*((uint32_t*) act->field->value));
 				break;
 			}
 			case OXM_OF_PATH_SALTOS: {
-				pkt->handle_std->proto->path->secuence = htons(*((uint16_t*) act->field->value));
+				pkt->handle_std->proto->path->contador = *act->field->value;
 				break;
 			}
 			//ARP PATH CAMINOS
@@ -519,6 +547,7 @@ set_field(struct packet *pkt, struct ofl_action_set_field *act )
                 struct mpls_header *mpls = pkt->handle_std->proto->mpls;
                 mpls->fields = (mpls->fields & ~ntohl(MPLS_S_MASK))
                 | ntohl((*act->field->value << MPLS_S_SHIFT) & MPLS_S_MASK);
+                reparse = true;
                 break;
             }
             case OXM_OF_PBB_ISID :{
@@ -526,31 +555,38 @@ set_field(struct packet *pkt, struct ofl_action_set_field *act )
                 uint8_t* pbb_isid;
                 pbb_isid = act->field->value; 
                 pbb->id = (pbb->id & 0xFF) | ((pbb_isid[2] << 24) | (pbb_isid[1] << 16) | (pbb_isid[1] << 8));                 
+                reparse = true;
                 break;
             }
             case OXM_OF_TUNNEL_ID :{
-                struct  ofl_match_tlv *f;
-                HMAP_FOR_EACH_WITH_HASH(f, struct ofl_match_tlv,
-                    hmap_node, hash_int(OXM_OF_TUNNEL_ID, 0), &(pkt)->handle_std->match.match_fields){
-                    uint64_t *tunnel_id = (uint64_t*) f->value;
-                    *tunnel_id = *((uint64_t*) act->field->value);
-                }
+                /* The tunnel id only lives in the match */
                 break;
             }
             default:
                 VLOG_WARN_RL(LOG_MODULE, &rl, "Trying to set unknow field.");
-                break;
+                return;
+        }
+        if (reparse) {
+            pkt->handle_std->valid = false;
+        } else {
+            set_field_update_match(pkt->handle_std, act->field->header,
+                     act->field->value, OXM_LENGTH(act->field->header));
         }
-        pkt->handle_std->valid = false;
         return;
     }
 
 }
 
+void
+dp_actions_set_field(struct packet *pkt, struct ofl_action_set_field *act) {
+    set_field(pkt, act);
+}
+
 /* Executes copy ttl out action.*/
 static void
 copy_ttl_out(struct packet *pkt, struct ofl_action_header *act UNUSED) {
     packet_handle_std_validate(pkt->handle_std);
+    packet_make_writable(pkt);
     if (pkt->handle_std->proto->mpls != NULL) {
         struct mpls_header *mpls = pkt->handle_std->proto->mpls;        
         if ((ntohl(mpls->fields) & MPLS_S_MASK) == 0) {
@@ -584,6 +620,7 @@ copy_ttl_out(struct packet *pkt, struct ofl_action_header *act UNUSED) {
 static void
 copy_ttl_in(struct packet *pkt, struct ofl_action_header *act UNUSED) {
     packet_handle_std_validate(pkt->handle_std);
+    packet_make_writable(pkt);
     if (pkt->handle_std->proto->mpls != NULL) {
         struct mpls_header *mpls = pkt->handle_std->proto->mpls;
 
@@ -625,6 +662,7 @@ static void
 push_vlan(struct packet *pkt, struct ofl_action_push *act) {
     // TODO Zoltan: if 802.3, check if new length is still valid
     packet_handle_std_validate(pkt->handle_std);
+    packet_make_writable(pkt);
     if (pkt->handle_std->proto->eth != NULL) {
         struct eth_header  *eth,  *new_eth;
         struct snap_header *snap, *new_snap;
@@ -696,6 +734,7 @@ push_vlan(struct packet *pkt, struct ofl_action_push *act) {
 static void
 pop_vlan(struct packet *pkt, struct ofl_action_header *act UNUSED) {
     packet_handle_std_validate(pkt->handle_std);
+    packet_make_writable(pkt);
     if (pkt->handle_std->proto->eth != NULL && pkt->handle_std->proto->vlan != NULL) {
         struct eth_header *eth = pkt->handle_std->proto->eth;
         struct snap_header *eth_snap = pkt->handle_std->proto->eth_snap;
@@ -728,6 +767,7 @@ pop_vlan(struct packet *pkt, struct ofl_action_header *act UNUSED) {
 static void
 set_mpls_ttl(struct packet *pkt, struct ofl_action_mpls_ttl *act) {
     packet_handle_std_validate(pkt->handle_std);
+    packet_make_writable(pkt);
     if (pkt->handle_std->proto->mpls != NULL) {
         struct mpls_header *mpls = pkt->handle_std->proto->mpls;
 
@@ -742,6 +782,7 @@ set_mpls_ttl(struct packet *pkt, struct ofl_action_mpls_ttl *act) {
 static void
 dec_mpls_ttl(struct packet *pkt, struct ofl_action_header *act UNUSED) {
     packet_handle_std_validate(pkt->handle_std);
+    packet_make_writable(pkt);
     if (pkt->handle_std->proto->mpls != NULL) {
         struct mpls_header *mpls = pkt->handle_std->proto->mpls;
 
@@ -760,6 +801,7 @@ static void
 push_mpls(struct packet *pkt, struct ofl_action_push *act) {
     // TODO Zoltan: if 802.3, check if new length is still valid
     packet_handle_std_validate(pkt->handle_std);
+    packet_make_writable(pkt);
     if (pkt->handle_std->proto->eth != NULL) {
         struct eth_header  *eth,  *new_eth;
         struct snap_header *snap, *new_snap;
@@ -862,6 +904,7 @@ push_mpls(struct packet *pkt, struct ofl_action_push *act) {
 static void
 pop_mpls(struct packet *pkt, struct ofl_action_pop_mpls *act) {
     packet_handle_std_validate(pkt->handle_std);
+    packet_make_writable(pkt);
     if (pkt->handle_std->proto->eth != NULL && pkt->handle_std->proto->mpls != NULL) {
         struct eth_header *eth = pkt->handle_std->proto->eth;
         struct snap_header *snap = pkt->handle_std->proto->eth_snap;
@@ -901,6 +944,7 @@ static void
 push_pbb(struct packet *pkt, struct ofl_action_push *act) {
     // TODO Zoltan: if 802.3, check if new length is still valid
     packet_handle_std_validate(pkt->handle_std);
+    packet_make_writable(pkt);
     if (pkt->handle_std->proto->eth != NULL) {
         struct eth_header  *eth,  *new_eth;
         struct snap_header *snap, *new_snap;
@@ -979,6 +1023,7 @@ push_pbb(struct packet *pkt, struct ofl_action_push *act) {
 static void
 pop_pbb(struct packet *pkt, struct ofl_action_header *act UNUSED) {
     packet_handle_std_validate(pkt->handle_std);
+    packet_make_writable(pkt);
     if (pkt->handle_std->proto->eth != NULL && pkt->handle_std->proto->pbb != NULL) {
         struct eth_header *eth = pkt->handle_std->proto->eth;
         struct pbb_header *pbb = pkt->handle_std->proto->pbb;
@@ -1015,6 +1060,7 @@ TODO Set IPv6 hop limit*/
 static void
 set_nw_ttl(struct packet *pkt, struct ofl_action_set_nw_ttl *act) {
     packet_handle_std_validate(pkt->handle_std);
+    packet_make_writable(pkt);
     if (pkt->handle_std->proto->ipv4 != NULL) {
         struct ip_header *ipv4 = pkt->handle_std->proto->ipv4;
 
@@ -1036,6 +1082,7 @@ TODO Dec IPv6 hop limit*/
 static void
 dec_nw_ttl(struct packet *pkt, struct ofl_action_header *act UNUSED) {
     packet_handle_std_validate(pkt->handle_std);
+    packet_make_writable(pkt);
     if (pkt->handle_std->proto->ipv4 != NULL) {
 
         struct ip_header *ipv4 = pkt->handle_std->proto->ipv4;
@@ -1217,6 +1264,9 @@ dp_actions_output_port(struct packet *pkt, uint32_t out_port, uint32_t out_queue
             msg.header.type = OFPT_PACKET_IN;
             msg.total_len   = pkt->buffer->size;
             msg.reason = pkt->handle_std->table_miss? OFPR_NO_MATCH:OFPR_ACTION;
+            if (!dp_pktin_admit(pkt->dp->pktin, pkt, msg.reason)) {
+                break;
+            }
             msg.table_id = pkt->table_id;
             msg.data        = pkt->buffer->data;
             msg.cookie = cookie;
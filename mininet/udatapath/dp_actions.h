@@ -47,6 +47,9 @@ void
 dp_execute_action(struct packet *pkt,
                   struct ofl_action_header *action);
 
+/* Executes a set field action on the given packet. */
+void
+dp_actions_set_field(struct packet *pkt, struct ofl_action_set_field *act);
 
 /* Executes the list of action on the given packet. */
 void
@@ -37,10 +37,13 @@
  * Author: Zoltán Lajos Kis <zoltan.lajos.kis@ericsson.com>
  */
 
+#include <inttypes.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
 
 #include "dp_buffers.h"
+#include "list.h"
 #include "timeval.h"
 #include "packet.h"
 #include "vlog.h"
@@ -54,17 +57,17 @@ static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(60, 60);
  * into a buffer number (low bits) and a cookie (high bits).  The buffer number
  * is an index into an array of buffers.  The cookie distinguishes between
  * different packets that have occupied a single buffer.  Thus, the more
- * buffers we have, the lower-quality the cookie... */
-#define PKT_BUFFER_BITS 8
-#define PKT_COOKIE_BITS (32 - PKT_BUFFER_BITS)
-
-#define N_PKT_BUFFERS (1 << PKT_BUFFER_BITS)
-#define PKT_BUFFER_MASK (N_PKT_BUFFERS - 1)
-
+ * buffers we have, the lower-quality the cookie... The number of buffers is
+ * rounded up to a power of two, so the buffer number is a mask of the ID. */
+#define PKT_BUFFER_MAX_BITS 16
 
 #define OVERWRITE_SECS  1
 
+/* Interval between reports of the buffer statistics, if they changed. */
+#define REPORT_SECS     60
+
 struct packet_buffer {
+    struct list    node;    /* in the free or the used list. */
     struct packet *pkt;
     uint32_t       cookie;
     time_t         timeout;
@@ -78,35 +81,110 @@ struct packet_buffer {
 
 struct dp_buffers {
     struct datapath       *dp;
-    size_t                 buffer_idx;
     size_t                 buffers_num;
-    struct packet_buffer   buffers[N_PKT_BUFFERS];
+    unsigned int           buffer_bits;
+    uint32_t               buffer_mask;
+    struct packet_buffer  *buffers;     /* pool of buffers_num buffers. */
+    struct list            free;        /* unused buffers. */
+    struct list            used;        /* used buffers, oldest first. */
+    struct dp_buffers_stats stats;
+    struct dp_buffers_stats reported;   /* stats at the last report. */
+    time_t                 next_report;
 };
 
 
 struct dp_buffers *
-dp_buffers_create(struct datapath *dp) {
+dp_buffers_create(struct datapath *dp, size_t buffers_num) {
     struct dp_buffers *dpb = xmalloc(sizeof(struct dp_buffers));
     size_t i;
 
     dpb->dp          = dp;
-    dpb->buffer_idx  = (size_t)-1;
-    dpb->buffers_num = N_PKT_BUFFERS;
+    dpb->buffer_bits = 1;
+    while ((1u << dpb->buffer_bits) < buffers_num &&
+           dpb->buffer_bits < PKT_BUFFER_MAX_BITS) {
+        dpb->buffer_bits++;
+    }
+    dpb->buffers_num = 1u << dpb->buffer_bits;
+    dpb->buffer_mask = dpb->buffers_num - 1;
+    dpb->buffers     = xmalloc(dpb->buffers_num * sizeof(struct packet_buffer));
 
-    for (i=0; i<N_PKT_BUFFERS; i++) {
+    list_init(&dpb->free);
+    list_init(&dpb->used);
+    for (i=0; i<dpb->buffers_num; i++) {
         dpb->buffers[i].pkt     = NULL;
         dpb->buffers[i].cookie  = UINT32_MAX;
         dpb->buffers[i].timeout = 0;
+        list_push_back(&dpb->free, &dpb->buffers[i].node);
     }
+    memset(&dpb->stats, 0x00, sizeof(struct dp_buffers_stats));
+    dpb->reported = dpb->stats;
+    dpb->next_report = time_now() + REPORT_SECS;
 
     return dpb;
 }
 
+void
+dp_buffers_destroy(struct dp_buffers *dpb) {
+    struct packet_buffer *p;
+
+    LIST_FOR_EACH (p, struct packet_buffer, node, &dpb->used) {
+        p->pkt->buffer_id = NO_BUFFER;
+        packet_destroy(p->pkt);
+    }
+    free(dpb->buffers);
+    free(dpb);
+}
+
 size_t
 dp_buffers_size(struct dp_buffers *dpb) {
     return dpb->buffers_num;
 }
 
+void
+dp_buffers_get_stats(struct dp_buffers *dpb, struct dp_buffers_stats *stats) {
+    *stats = dpb->stats;
+}
+
+void
+dp_buffers_run(struct dp_buffers *dpb) {
+    if (time_now() < dpb->next_report) {
+        return;
+    }
+    dpb->next_report = time_now() + REPORT_SECS;
+
+    if (dpb->stats.saves != dpb->reported.saves) {
+        VLOG_INFO(LOG_MODULE, "%zu/%zu buffers in use; %"PRIu64" saved, "
+                  "%"PRIu64" evicted, %"PRIu64" failed in the last %d s.",
+                  dpb->stats.used, dpb->buffers_num,
+                  dpb->stats.saves - dpb->reported.saves,
+                  dpb->stats.evictions - dpb->reported.evictions,
+                  dpb->stats.save_failures - dpb->reported.save_failures,
+                  REPORT_SECS);
+        dpb->reported = dpb->stats;
+    }
+}
+
+/* Returns the buffer the ID refers to, or NULL if the packet it referred to
+ * is no longer there. */
+static struct packet_buffer *
+lookup(struct dp_buffers *dpb, uint32_t id) {
+    struct packet_buffer *p = &dpb->buffers[id & dpb->buffer_mask];
+
+    if (p->pkt != NULL && p->cookie == id >> dpb->buffer_bits) {
+        return p;
+    }
+    return NULL;
+}
+
+/* Returns the buffer to the pool. */
+static void
+release(struct dp_buffers *dpb, struct packet_buffer *p) {
+    p->pkt = NULL;
+    list_remove(&p->node);
+    list_push_front(&dpb->free, &p->node);
+    dpb->stats.used--;
+}
+
 uint32_t
 dp_buffers_save(struct dp_buffers *dpb, struct packet *pkt) {
     struct packet_buffer *p;
@@ -119,24 +197,34 @@ dp_buffers_save(struct dp_buffers *dpb, struct packet *pkt) {
         }
     }
 
-    dpb->buffer_idx = (dpb->buffer_idx + 1) & PKT_BUFFER_MASK;
-
-    p = &dpb->buffers[dpb->buffer_idx];
-    if (p->pkt != NULL) {
+    if (list_is_empty(&dpb->free)) {
+        /* Reuse the least recently saved buffer, unless the controller may
+         * still be about to refer to it. */
+        p = CONTAINER_OF(list_front(&dpb->used), struct packet_buffer, node);
         if (time_now() < p->timeout) {
+            dpb->stats.save_failures++;
+            VLOG_WARN_RL(LOG_MODULE, &rl, "All %zu buffers in use, sending full packet "
+                         "(%"PRIu64" failures).", dpb->buffers_num, dpb->stats.save_failures);
             return NO_BUFFER;
-        } else {
-            p->pkt->buffer_id = NO_BUFFER;
-            packet_destroy(p->pkt);
         }
+        p->pkt->buffer_id = NO_BUFFER;
+        packet_destroy(p->pkt);
+        release(dpb, p);
+        dpb->stats.evictions++;
     }
+
+    p = CONTAINER_OF(list_pop_front(&dpb->free), struct packet_buffer, node);
+    list_push_back(&dpb->used, &p->node);
+    dpb->stats.used++;
+    dpb->stats.saves++;
+
     /* Don't use maximum cookie value since the all-bits-1 id is
      * special. */
-    if (++p->cookie >= (1u << PKT_COOKIE_BITS) - 1)
+    if (++p->cookie >= (1u << (32 - dpb->buffer_bits)) - 1)
         p->cookie = 0;
     p->pkt = pkt;
     p->timeout = time_now() + OVERWRITE_SECS;
-    id = dpb->buffer_idx | (p->cookie << PKT_BUFFER_BITS);
+    id = (p - dpb->buffers) | (p->cookie << dpb->buffer_bits);
 
     pkt->buffer_id  = id;
 
@@ -148,16 +236,16 @@ dp_buffers_retrieve(struct dp_buffers *dpb, uint32_t id) {
     struct packet *pkt = NULL;
     struct packet_buffer *p;
 
-    p = &dpb->buffers[id & PKT_BUFFER_MASK];
-    if (p->cookie == id >> PKT_BUFFER_BITS && p->pkt != NULL) {
+    p = lookup(dpb, id);
+    if (p != NULL) {
         pkt = p->pkt;
         pkt->buffer_id = NO_BUFFER;
         pkt->packet_out = false;
 
-        p->pkt = NULL;
+        release(dpb, p);
     } else {
         VLOG_WARN_RL(LOG_MODULE, &rl, "cookie mismatch: %x != %x\n",
-                          id >> PKT_BUFFER_BITS, p->cookie);
+                          id >> dpb->buffer_bits, dpb->buffers[id & dpb->buffer_mask].cookie);
     }
 
     return pkt;
@@ -167,9 +255,8 @@ bool
 dp_buffers_is_alive(struct dp_buffers *dpb, uint32_t id) {
     struct packet_buffer *p;
 
-    p = &dpb->buffers[id & PKT_BUFFER_MASK];
-    return ((p->cookie == id >> PKT_BUFFER_BITS) &&
-            (time_now() < p->timeout));
+    p = lookup(dpb, id);
+    return (p != NULL && time_now() < p->timeout);
 }
 
 
@@ -177,13 +264,13 @@ void
 dp_buffers_discard(struct dp_buffers *dpb, uint32_t id, bool destroy) {
     struct packet_buffer *p;
 
-    p = &dpb->buffers[id & PKT_BUFFER_MASK];
+    p = lookup(dpb, id);
 
-    if (p->cookie == id >> PKT_BUFFER_BITS) {
+    if (p != NULL) {
         if (destroy) {
             p->pkt->buffer_id = NO_BUFFER;
             packet_destroy(p->pkt);
         }
-        p->pkt = NULL;
+        release(dpb, p);
     }
 }
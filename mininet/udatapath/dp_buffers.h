@@ -48,6 +48,9 @@
 /* Constant for representing "no buffer" */
 #define NO_BUFFER 0xffffffff
 
+/* Default number of buffers. */
+#define DP_BUFFERS_DEFAULT 256
+
 /****************************************************************************
  * Datapath buffers for storing packets for packet in messages.
  ****************************************************************************/
@@ -55,14 +58,34 @@
 struct datapath;
 struct packet;
 
-/* Creates a set of buffers */
+struct dp_buffers_stats {
+    size_t   used;          /* buffers currently holding a packet. */
+    uint64_t saves;         /* packets saved. */
+    uint64_t evictions;     /* packets dropped to make room for new ones. */
+    uint64_t save_failures; /* packets that could not be saved. */
+};
+
+/* Creates a set of buffers. The number of buffers is rounded up to a power
+ * of two between 2 and 65536. */
 struct dp_buffers *
-dp_buffers_create(struct datapath *dp);
+dp_buffers_create(struct datapath *dp, size_t buffers_num);
+
+/* Destroys the buffers, along with the packets they hold. */
+void
+dp_buffers_destroy(struct dp_buffers *dpb);
 
 /* Returns the number of buffers */
 size_t
 dp_buffers_size(struct dp_buffers *dpb);
 
+/* Returns the occupancy and counters of the buffers. */
+void
+dp_buffers_get_stats(struct dp_buffers *dpb, struct dp_buffers_stats *stats);
+
+/* Periodically logs the statistics of the buffers. */
+void
+dp_buffers_run(struct dp_buffers *dpb);
+
 /* Saves the packet into the buffer. Returns the saved buffer ID, or NO_BUFFER
  * if saving was not possible. */
 uint32_t
@@ -33,7 +33,10 @@
 #include <string.h>
 #include "datapath.h"
 #include "dp_exp.h"
+#include "dp_stages.h"
+#include "dp_trace.h"
 #include "packet.h"
+#include "pipeline.h"
 #include "oflib/ofl.h"
 #include "oflib/ofl-actions.h"
 #include "oflib/ofl-structs.h"
@@ -60,11 +63,35 @@ dp_exp_inst(struct packet *pkt UNUSED, struct ofl_instruction_experimenter *inst
 }
 
 ofl_err
-dp_exp_stats(struct datapath *dp UNUSED,
+dp_exp_stats(struct datapath *dp,
                                   struct ofl_msg_multipart_request_experimenter *msg,
-                                  const struct sender *sender UNUSED) {
-	VLOG_WARN_RL(LOG_MODULE, &rl, "Trying to handle unknown experimenter stats (%u).", msg->experimenter_id);
-    return ofl_error(OFPET_BAD_REQUEST, OFPBRC_BAD_EXPERIMENTER);
+                                  const struct sender *sender) {
+
+    switch (msg->experimenter_id) {
+        case (OPENFLOW_VENDOR_ID): {
+            struct ofl_exp_openflow_mp_request_header *exp = (struct ofl_exp_openflow_mp_request_header *)msg;
+
+            switch (exp->type) {
+                case (OFP_EXT_MP_STAGES): {
+                    return dp_stages_handle_request(dp, (struct ofl_exp_openflow_mp_request_stages *)msg, sender);
+                }
+                case (OFP_EXT_MP_TRACE): {
+                    return dp_trace_handle_request(dp, (struct ofl_exp_openflow_mp_request_trace *)msg, sender);
+                }
+                case (OFP_EXT_MP_COUNTERS): {
+                    return dp_handle_counters_request(dp, (struct ofl_exp_openflow_mp_request_counters *)msg, sender);
+                }
+                default: {
+                    VLOG_WARN_RL(LOG_MODULE, &rl, "Trying to handle unknown experimenter stats type (%u).", exp->type);
+                    return ofl_error(OFPET_BAD_REQUEST, OFPBRC_BAD_EXP_TYPE);
+                }
+            }
+        }
+        default: {
+            VLOG_WARN_RL(LOG_MODULE, &rl, "Trying to handle unknown experimenter stats (%u).", msg->experimenter_id);
+            return ofl_error(OFPET_BAD_REQUEST, OFPBRC_BAD_EXPERIMENTER);
+        }
+    }
 }
 
 
@@ -87,6 +114,9 @@ dp_exp_message(struct datapath *dp,
                 case (OFP_EXT_SET_DESC): {
                     return dp_handle_set_desc(dp, (struct ofl_exp_openflow_msg_set_dp_desc *)msg, sender);
                 }
+                case (OFP_EXT_SET_PATH_MODE): {
+                    return pipeline_handle_set_path_mode(dp->pipeline, (struct ofl_exp_openflow_msg_set_path_mode *)msg, sender);
+                }
                 default: {
                 	VLOG_WARN_RL(LOG_MODULE, &rl, "Trying to handle unknown experimenter type (%u).", exp->type);
                     return ofl_error(OFPET_BAD_REQUEST, OFPBRC_BAD_EXPERIMENTER);
@@ -0,0 +1,286 @@
+/* Copyright (c) 2011, TrafficLab, Ericsson Research, Hungary
+ * Copyright (c) 2012, CPqD, Brazil 
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Ericsson Research nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <arpa/inet.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "datapath.h"
+#include "dp_liveness.h"
+#include "dp_ports.h"
+#include "packet.h"
+#include "packets.h"
+#include "poll-loop.h"
+#include "random.h"
+#include "timeval.h"
+#include "util.h"
+#include "vlog.h"
+
+#define LOG_MODULE VLM_dp_live
+
+#define NSEC_PER_MSEC 1000000LL
+
+/* Interval between reports of the counters, if they changed. */
+#define REPORT_SECS     60
+
+/* Interval of the hellos on ports without a neighbour. */
+#define SLOW_MSEC       1000
+
+/* Interval assumed for neighbours that do not advertise one, i.e. switches
+ * still sending the old hello every 10 s. */
+#define LEGACY_MSEC     10000
+
+/* The hello payload starts with this magic and the time until the sender's
+ * next hello in ms, both in network byte order. Older switches leave it
+ * uninitialized. */
+#define HELLO_MAGIC     0x4c495645 /* "LIVE" */
+
+struct liveness_session {
+    bool          up;        /* hellos are being heard. */
+    bool          changed;   /* 'up' not yet reported by dp_liveness_run(). */
+    long long int next_tx;   /* time of the next hello, in ns. */
+    long long int last_rx;   /* time of the last hello heard, in ns. */
+    long long int detect;    /* time without hellos before down, in ns. */
+};
+
+struct dp_liveness {
+    struct datapath         *dp;
+    struct packet           *hello;    /* built when the first one is sent. */
+    unsigned int             interval; /* in ms, 0 if detection is off. */
+    unsigned int             mult;
+
+    struct liveness_session  sessions[DP_MAX_PORTS + 1];
+
+    struct dp_liveness_stats stats;
+    struct dp_liveness_stats reported;
+    time_t                   next_report;
+};
+
+struct dp_liveness *
+dp_liveness_create(struct datapath *dp) {
+    struct dp_liveness *l = xmalloc(sizeof(struct dp_liveness));
+
+    memset(l, 0, sizeof(struct dp_liveness));
+    l->dp = dp;
+    l->interval = DP_LIVENESS_INTERVAL_DEFAULT;
+    l->mult = DP_LIVENESS_MULT_DEFAULT;
+    l->next_report = time_now() + REPORT_SECS;
+    return l;
+}
+
+void
+dp_liveness_destroy(struct dp_liveness *l) {
+    if (l->hello != NULL) {
+        packet_destroy(l->hello);
+    }
+    free(l);
+}
+
+void
+dp_liveness_set(struct dp_liveness *l, unsigned int msec, unsigned int mult) {
+    l->interval = msec;
+    l->mult = MAX(mult, 1);
+}
+
+/* Sends the UAH hello on 'port_no', stamped with the interval until the next
+ * one. The hello is built the first time, once the datapath has ports. */
+static void
+send_hello(struct dp_liveness *l, uint32_t port_no, unsigned int msec) {
+    uint32_t stamp[2];
+
+    if (l->hello == NULL) {
+        if (l->dp->ports[1].conf == NULL) {
+            return;
+        }
+        l->hello = packet_hello_create(l->dp, 0, true);
+    }
+    stamp[0] = htonl(HELLO_MAGIC);
+    stamp[1] = htonl(msec);
+    memcpy((uint8_t *)l->hello->buffer->data + ETH_HEADER_LEN,
+           stamp, sizeof stamp);
+    dp_ports_output(l->dp, l->hello->buffer, port_no, 0);
+    l->stats.tx++;
+}
+
+/* Returns the time until the next hello, between 75% and 100% of 'msec' so
+ * that neighbours do not synchronize. */
+static long long int
+jitter(unsigned int msec) {
+    long long int nsec = msec * NSEC_PER_MSEC;
+
+    return nsec - nsec * random_range(26) / 100;
+}
+
+void
+dp_liveness_rx(struct dp_liveness *l, struct packet *pkt) {
+    struct liveness_session *s;
+    unsigned int peer_msec = LEGACY_MSEC;
+    long long int now;
+
+    if (pkt->in_port == 0 || pkt->in_port > DP_MAX_PORTS) {
+        return;
+    }
+    s = &l->sessions[pkt->in_port];
+    now = time_nsec();
+    l->stats.rx++;
+
+    if (pkt->buffer->size >= ETH_HEADER_LEN + 2 * sizeof(uint32_t)) {
+        uint32_t stamp[2];
+
+        memcpy(stamp, (uint8_t *)pkt->buffer->data + ETH_HEADER_LEN,
+               sizeof stamp);
+        if (ntohl(stamp[0]) == HELLO_MAGIC && ntohl(stamp[1]) != 0) {
+            peer_msec = ntohl(stamp[1]);
+        }
+    }
+    s->detect = (long long int) peer_msec * l->mult * NSEC_PER_MSEC;
+    s->last_rx = now;
+
+    if (!s->up) {
+        s->up = true;
+        s->changed = true;
+        /* Let the neighbour hear the fast hellos right away. */
+        s->next_tx = now;
+        l->stats.ups++;
+    }
+}
+
+static void
+session_down(struct dp_liveness *l, struct liveness_session *s,
+             uint32_t port_no, long long int now) {
+    struct dp_liveness_stats *st = &l->stats;
+    long long int t = now - s->last_rx;
+
+    s->up = false;
+    s->changed = true;
+    st->downs++;
+    st->detect_sum += t;
+    if (st->downs == 1 || t < st->detect_min) {
+        st->detect_min = t;
+    }
+    if (t > st->detect_max) {
+        st->detect_max = t;
+    }
+    VLOG_WARN(LOG_MODULE, "Port %u: no hello for %lld ms, neighbour down.",
+              port_no, t / NSEC_PER_MSEC);
+}
+
+static void
+report(struct dp_liveness *l) {
+    struct dp_liveness_stats *s = &l->stats;
+    struct dp_liveness_stats *o = &l->reported;
+
+    if (time_now() < l->next_report) {
+        return;
+    }
+    l->next_report = time_now() + REPORT_SECS;
+
+    if (s->ups != o->ups || s->downs != o->downs) {
+        VLOG_INFO(LOG_MODULE, "%"PRIu64" hellos sent, %"PRIu64" received; "
+                  "%"PRIu64" neighbours up, %"PRIu64" down in the last %d s.",
+                  s->tx - o->tx, s->rx - o->rx, s->ups - o->ups,
+                  s->downs - o->downs, REPORT_SECS);
+    }
+    if (s->downs != o->downs) {
+        VLOG_INFO(LOG_MODULE, "Detection time min %lld ms, avg %lld ms, "
+                  "max %lld ms over %"PRIu64" failures.",
+                  s->detect_min / NSEC_PER_MSEC,
+                  s->detect_sum / (long long int) s->downs / NSEC_PER_MSEC,
+                  s->detect_max / NSEC_PER_MSEC, s->downs);
+    }
+    *o = *s;
+}
+
+void
+dp_liveness_run(struct dp_liveness *l, dp_liveness_cb *cb, void *aux) {
+    struct sw_port *p;
+    long long int now = time_nsec();
+
+    LIST_FOR_EACH (p, struct sw_port, node, &l->dp->port_list) {
+        uint32_t port_no = p->stats->port_no;
+        struct liveness_session *s;
+
+        if (port_no == 0 || port_no > DP_MAX_PORTS) {
+            continue;
+        }
+        s = &l->sessions[port_no];
+
+        if (s->up && l->interval != 0 && now - s->last_rx > s->detect) {
+            session_down(l, s, port_no, now);
+        }
+        if (s->changed) {
+            s->changed = false;
+            cb(p, s->up, aux);
+        }
+        if (now >= s->next_tx) {
+            unsigned int msec = (s->up && l->interval != 0 ? l->interval
+                                 : SLOW_MSEC);
+
+            send_hello(l, port_no, msec);
+            s->next_tx = now + jitter(msec);
+        }
+    }
+    report(l);
+}
+
+void
+dp_liveness_wait(struct dp_liveness *l) {
+    struct sw_port *p;
+    long long int next = LLONG_MAX;
+
+    LIST_FOR_EACH (p, struct sw_port, node, &l->dp->port_list) {
+        uint32_t port_no = p->stats->port_no;
+        struct liveness_session *s;
+
+        if (port_no == 0 || port_no > DP_MAX_PORTS) {
+            continue;
+        }
+        s = &l->sessions[port_no];
+        next = MIN(next, s->next_tx);
+        if (s->up && l->interval != 0) {
+            next = MIN(next, s->last_rx + s->detect + 1);
+        }
+    }
+    if (next != LLONG_MAX) {
+        long long int wait = next - time_nsec();
+
+        poll_timer_wait(wait <= 0 ? 0
+                        : (int) ((wait + NSEC_PER_MSEC - 1) / NSEC_PER_MSEC));
+    }
+}
+
+void
+dp_liveness_get_stats(struct dp_liveness *l, struct dp_liveness_stats *stats) {
+    *stats = l->stats;
+}
@@ -0,0 +1,98 @@
+/* Copyright (c) 2011, TrafficLab, Ericsson Research, Hungary
+ * Copyright (c) 2012, CPqD, Brazil 
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Ericsson Research nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef DP_LIVENESS_H
+#define DP_LIVENESS_H 1
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/****************************************************************************
+ * Liveness of the links towards neighbour switches, in the manner of BFD.
+ * Each port sends the UAH hello on its own timer, with jitter, and a port on
+ * which hellos are heard is declared down when none arrives for a number of
+ * the sender's intervals. Ports that never heard a hello, e.g. those towards
+ * hosts, are not monitored and only get hellos at a slow rate.
+ ****************************************************************************/
+
+#define DP_LIVENESS_INTERVAL_DEFAULT 100 /* ms between hellos. */
+#define DP_LIVENESS_MULT_DEFAULT     3   /* intervals missed before down. */
+
+struct datapath;
+struct packet;
+struct sw_port;
+
+struct dp_liveness_stats {
+    uint64_t      tx;          /* hellos sent. */
+    uint64_t      rx;          /* hellos received. */
+    uint64_t      ups;         /* sessions that came up. */
+    uint64_t      downs;       /* sessions declared down. */
+    /* Time from the last hello heard until a session was declared down, in
+     * ns. This bounds the time from a failure to its detection. */
+    long long int detect_min;
+    long long int detect_max;
+    long long int detect_sum;
+};
+
+/* Called by dp_liveness_run() when the session of a port goes up or down. */
+typedef void dp_liveness_cb(struct sw_port *, bool up, void *aux);
+
+/* Creates the liveness sessions of the datapath. */
+struct dp_liveness *
+dp_liveness_create(struct datapath *dp);
+
+void
+dp_liveness_destroy(struct dp_liveness *l);
+
+/* Sends hellos every 'msec' milliseconds on ports with a neighbour, and
+ * declares a neighbour down after 'mult' of its own intervals without a
+ * hello. */
+void
+dp_liveness_set(struct dp_liveness *l, unsigned int msec, unsigned int mult);
+
+/* Records a hello received on the in_port of 'pkt'. */
+void
+dp_liveness_rx(struct dp_liveness *l, struct packet *pkt);
+
+/* Sends the hellos that are due, and calls 'cb' for every session that went
+ * up or down since the last call. */
+void
+dp_liveness_run(struct dp_liveness *l, dp_liveness_cb *cb, void *aux);
+
+/* Arranges for poll_block() to wake up when dp_liveness_run() has work. */
+void
+dp_liveness_wait(struct dp_liveness *l);
+
+/* Returns the counters of the sessions. */
+void
+dp_liveness_get_stats(struct dp_liveness *l, struct dp_liveness_stats *stats);
+
+
+#endif /* DP_LIVENESS_H */
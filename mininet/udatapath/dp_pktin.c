@@ -0,0 +1,268 @@
+/* Copyright (c) 2011, TrafficLab, Ericsson Research, Hungary
+ * Copyright (c) 2012, CPqD, Brazil 
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Ericsson Research nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "datapath.h"
+#include "dp_pktin.h"
+#include "hash.h"
+#include "packet.h"
+#include "packets.h"
+#include "timeval.h"
+#include "util.h"
+#include "vlog.h"
+#include "openflow/openflow.h"
+
+#define LOG_MODULE VLM_dp_pktin
+
+#define NSEC_PER_SEC 1000000000LL
+
+/* Interval between reports of the counters, if they changed. */
+#define REPORT_SECS     60
+
+/* Number of slots of the duplicate filter. A slot remembers the last packet
+ * in that hashed into it; collisions only make the filter forget. */
+#define DUP_SLOTS_BITS  10
+#define DUP_SLOTS       (1 << DUP_SLOTS_BITS)
+
+/* Reasons beyond OFPR_INVALID_TTL share the last bucket. */
+#define N_REASONS       (OFPR_INVALID_TTL + 1)
+
+/* Token bucket kept in nanoseconds of credit, refilled lazily. */
+struct pktin_bucket {
+    long long int credit;
+    long long int last;
+};
+
+struct pktin_limit {
+    long long int cost;       /* credit used by a message, 0 if unlimited. */
+    long long int capacity;   /* credit of a full bucket. */
+};
+
+struct dup_slot {
+    uint32_t      hash;
+    long long int until;
+};
+
+struct dp_pktin {
+    struct datapath      *dp;
+
+    struct pktin_limit    reason_limit;
+    struct pktin_bucket   reasons[N_REASONS];
+
+    /* Ports beyond DP_MAX_PORTS, e.g. OFPP_LOCAL, share bucket 0. */
+    struct pktin_limit    port_limit;
+    struct pktin_bucket   ports[DP_MAX_PORTS + 1];
+
+    long long int         dup_window;  /* in ns, 0 if disabled. */
+    struct dup_slot      *dups;
+
+    struct dp_pktin_stats stats;
+    struct dp_pktin_stats reported;
+    time_t                next_report;
+};
+
+struct dp_pktin *
+dp_pktin_create(struct datapath *dp) {
+    struct dp_pktin *pin = xmalloc(sizeof(struct dp_pktin));
+
+    memset(pin, 0, sizeof(struct dp_pktin));
+    pin->dp = dp;
+    pin->next_report = time_now() + REPORT_SECS;
+    return pin;
+}
+
+static void
+set_limit(struct pktin_limit *limit, struct pktin_bucket *buckets,
+          size_t n_buckets, unsigned int rate, unsigned int burst) {
+    size_t i;
+
+    if (rate == 0) {
+        limit->cost = 0;
+        return;
+    }
+    limit->cost = NSEC_PER_SEC / rate;
+    limit->capacity = limit->cost * MAX(burst, 1);
+    for (i = 0; i < n_buckets; i++) {
+        buckets[i].credit = limit->capacity;
+        buckets[i].last = 0;
+    }
+}
+
+void
+dp_pktin_set_reason_rate(struct dp_pktin *pin, unsigned int rate,
+                         unsigned int burst) {
+    set_limit(&pin->reason_limit, pin->reasons, N_REASONS, rate, burst);
+}
+
+void
+dp_pktin_set_port_rate(struct dp_pktin *pin, unsigned int rate,
+                       unsigned int burst) {
+    set_limit(&pin->port_limit, pin->ports, DP_MAX_PORTS + 1, rate, burst);
+}
+
+void
+dp_pktin_set_dup_window(struct dp_pktin *pin, unsigned int msec) {
+    pin->dup_window = (long long int) msec * 1000000;
+    if (msec != 0 && pin->dups == NULL) {
+        pin->dups = xmalloc(DUP_SLOTS * sizeof *pin->dups);
+    }
+    if (pin->dups != NULL) {
+        memset(pin->dups, 0, DUP_SLOTS * sizeof *pin->dups);
+    }
+}
+
+/* Refills the bucket for the time passed since its last use, and returns
+ * true if it has credit for one more message. The credit is only taken by
+ * bucket_take(), so that a message dropped by a later check does not use up
+ * the earlier buckets. */
+static bool
+bucket_check(const struct pktin_limit *limit, struct pktin_bucket *b,
+             long long int now) {
+    if (limit->cost == 0) {
+        return true;
+    }
+    if (b->last != 0) {
+        long long int credit = b->credit + (now - b->last);
+        b->credit = MIN(credit, limit->capacity);
+    }
+    b->last = now;
+    return b->credit >= limit->cost;
+}
+
+static void
+bucket_take(const struct pktin_limit *limit, struct pktin_bucket *b) {
+    b->credit -= limit->cost;
+}
+
+/* Returns true if some controller would accept a packet in now. Sets
+ * '*connected' to whether any controller takes packet ins at all. */
+static bool
+controller_has_room(struct datapath *dp, bool *connected) {
+    struct remote *r;
+
+    *connected = false;
+    LIST_FOR_EACH (r, struct remote, node, &dp->remotes) {
+        if (r->role != OFPCR_ROLE_SLAVE) {
+            *connected = true;
+            if (remote_has_room_for_packet_in(r)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+bool
+dp_pktin_admit(struct dp_pktin *pin, struct packet *pkt, uint8_t reason) {
+    struct pktin_bucket *rb, *pb;
+    struct dup_slot *slot = NULL;
+    uint32_t hash = 0;
+    long long int now;
+    bool connected;
+
+    if (!controller_has_room(pin->dp, &connected)) {
+        if (connected) {
+            pin->stats.congested_drops++;
+        } else {
+            pin->stats.no_controller++;
+        }
+        return false;
+    }
+    if (pin->reason_limit.cost == 0 && pin->port_limit.cost == 0
+        && pin->dup_window == 0) {
+        pin->stats.sent++;
+        return true;
+    }
+
+    now = time_nsec();
+    rb = &pin->reasons[MIN(reason, N_REASONS - 1)];
+    pb = &pin->ports[pkt->in_port <= DP_MAX_PORTS ? pkt->in_port : 0];
+
+    if (!bucket_check(&pin->reason_limit, rb, now)) {
+        pin->stats.reason_drops++;
+        return false;
+    }
+    if (!bucket_check(&pin->port_limit, pb, now)) {
+        pin->stats.port_drops++;
+        return false;
+    }
+    if (pin->dup_window != 0 && pkt->buffer->size >= ETH_ADDR_LEN * 2) {
+        /* Destination and source MAC are the first 12 bytes. */
+        hash = hash_bytes(pkt->buffer->data, ETH_ADDR_LEN * 2,
+                          (pkt->in_port << 8) | reason);
+        slot = &pin->dups[hash & (DUP_SLOTS - 1)];
+        if (slot->hash == hash && now < slot->until) {
+            pin->stats.dup_drops++;
+            return false;
+        }
+    }
+
+    bucket_take(&pin->reason_limit, rb);
+    bucket_take(&pin->port_limit, pb);
+    if (slot != NULL) {
+        slot->hash = hash;
+        slot->until = now + pin->dup_window;
+    }
+    pin->stats.sent++;
+    return true;
+}
+
+void
+dp_pktin_get_stats(struct dp_pktin *pin, struct dp_pktin_stats *stats) {
+    *stats = pin->stats;
+}
+
+void
+dp_pktin_run(struct dp_pktin *pin) {
+    struct dp_pktin_stats *s = &pin->stats;
+    struct dp_pktin_stats *o = &pin->reported;
+
+    if (time_now() < pin->next_report) {
+        return;
+    }
+    pin->next_report = time_now() + REPORT_SECS;
+
+    if (s->reason_drops != o->reason_drops || s->port_drops != o->port_drops
+        || s->dup_drops != o->dup_drops
+        || s->congested_drops != o->congested_drops) {
+        VLOG_INFO(LOG_MODULE, "%"PRIu64" packet ins sent; dropped %"PRIu64
+                  " over reason rate, %"PRIu64" over port rate, %"PRIu64
+                  " duplicates, %"PRIu64" congested in the last %d s.",
+                  s->sent - o->sent, s->reason_drops - o->reason_drops,
+                  s->port_drops - o->port_drops, s->dup_drops - o->dup_drops,
+                  s->congested_drops - o->congested_drops, REPORT_SECS);
+    }
+    *o = *s;
+}
@@ -0,0 +1,90 @@
+/* Copyright (c) 2011, TrafficLab, Ericsson Research, Hungary
+ * Copyright (c) 2012, CPqD, Brazil 
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Ericsson Research nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef DP_PKTIN_H
+#define DP_PKTIN_H 1
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/****************************************************************************
+ * Admission control for packet in messages. Packets are checked before they
+ * are buffered and packed, so that a storm towards the controller costs as
+ * little as possible. All limits are disabled by default.
+ ****************************************************************************/
+
+struct datapath;
+struct packet;
+
+struct dp_pktin_stats {
+    uint64_t sent;            /* packet ins admitted. */
+    uint64_t reason_drops;    /* over the rate of their reason. */
+    uint64_t port_drops;      /* over the rate of their in_port. */
+    uint64_t dup_drops;       /* repeated within the duplicate window. */
+    uint64_t congested_drops; /* no controller had room for them. */
+    uint64_t no_controller;   /* not sent, no controller takes them. */
+};
+
+/* Creates the packet in limiter of the datapath. */
+struct dp_pktin *
+dp_pktin_create(struct datapath *dp);
+
+/* Limits packet ins of each reason to 'rate' per second, allowing bursts of
+ * 'burst' messages. A rate of 0 removes the limit. */
+void
+dp_pktin_set_reason_rate(struct dp_pktin *pin, unsigned int rate,
+                         unsigned int burst);
+
+/* Limits packet ins from each in_port to 'rate' per second, allowing bursts
+ * of 'burst' messages. A rate of 0 removes the limit. */
+void
+dp_pktin_set_port_rate(struct dp_pktin *pin, unsigned int rate,
+                       unsigned int burst);
+
+/* Drops packet ins with the same reason, in_port and Ethernet addresses as
+ * one admitted less than 'msec' milliseconds earlier. 0 disables it. */
+void
+dp_pktin_set_dup_window(struct dp_pktin *pin, unsigned int msec);
+
+/* Returns true if a packet in for 'pkt' with the given reason may be sent,
+ * false if it should be dropped. */
+bool
+dp_pktin_admit(struct dp_pktin *pin, struct packet *pkt, uint8_t reason);
+
+/* Returns the counters of the limiter. */
+void
+dp_pktin_get_stats(struct dp_pktin *pin, struct dp_pktin_stats *stats);
+
+/* Periodically logs the counters of the limiter. */
+void
+dp_pktin_run(struct dp_pktin *pin);
+
+
+#endif /* DP_PKTIN_H */
@@ -43,6 +43,7 @@
 #include <inttypes.h>
 #include "dp_exp.h"
 #include "dp_ports.h"
+#include "dp_stages.h"
 #include "datapath.h"
 #include "packets.h"
 #include "pipeline.h"
@@ -172,7 +173,6 @@ hw_packet_in(of_port_t port_no, of_packet_t *packet, int reason,
     buffer = ofpbuf_new(headroom + hard_header + packet->length + tail_room);
     if (buffer == NULL) {
         VLOG_WARN(LOG_MODULE, "Could not alloc ofpbuf on hw pkt in\n");
-        fprintf(stderr, "Could not alloc ofpbuf on hw pkt in\n");
     } else {
         buffer->data = (char*)buffer->data + headroom;
         buffer->size = packet->length;
@@ -226,11 +226,117 @@ process_buffer(struct datapath *dp, struct sw_port *p, struct ofpbuf *buffer, st
     pipeline_process_Uah(dp->pipeline, pkt, mac_port, recovery_table, tcp_table, puerto_no_disponible, t_ini_recuperacion); //modificacion UAH
 }
 
-void
-dp_ports_run(struct datapath *dp, struct mac_to_port *mac_port,  struct mac_to_port *recovery_table, struct table_tcp * tcp_table, uint8_t *puerto_no_disponible, struct timeval * t_ini_recuperacion) {
+/* Recomputes the largest MTU of the software ports, which sizes the buffer
+ * shared by all (idle) interfaces in dp_ports_run(). */
+static void
+update_max_mtu(struct datapath *dp) {
+    struct sw_port *p;
+    int max_mtu = 0;
+
+    LIST_FOR_EACH (p, struct sw_port, node, &dp->port_list) {
+        int mtu;
+
+        if (IS_HW_PORT(p)) {
+            continue;
+        }
+        mtu = netdev_get_mtu(p->netdev);
+        if (mtu > max_mtu) {
+            max_mtu = mtu;
+        }
+    }
+    dp->max_mtu = max_mtu;
+}
+
+struct port_link_ctx {
+    struct datapath    *dp;
+    struct mac_to_port *mac_port;
+    struct table_tcp   *tcp_table;
+    uint8_t            *puerto_no_disponible;
+    struct timeval     *t_ini_recuperacion;
+};
+
+/* Recomputes the live flag of 'p' after a change of its link or neighbour,
+ * notifies the controllers and, when the port stopped being live, lets the
+ * ARP-Path/TCP-Path recovery start right away. */
+static void
+port_state_changed(struct port_link_ctx *ctx, struct sw_port *p,
+                   uint32_t old_state) {
+    struct datapath *dp = ctx->dp;
+
+    dp_port_live_update(p);
+    if (p->conf->state == old_state) {
+        return;
+    }
+    if ((old_state & OFPPS_LIVE) && !(p->conf->state & OFPPS_LIVE)) {
+        pipeline_port_down(dp->pipeline, p->stats->port_no, ctx->mac_port,
+                           ctx->tcp_table, ctx->puerto_no_disponible,
+                           ctx->t_ini_recuperacion);
+    }
+    {
+    struct ofl_msg_port_status msg =
+            {{.type = OFPT_PORT_STATUS},
+             .reason = OFPPR_MODIFY, .desc = p->conf};
+
+        dp_send_message(dp, (struct ofl_msg_header *)&msg, NULL/*sender*/);
+    }
+}
+
+/* Called by netdev_link_run() for each link or MTU change. */
+static void
+port_link_changed(struct netdev *netdev, enum netdev_link_state state,
+                  void *ctx_) {
+    struct port_link_ctx *ctx = ctx_;
+    struct datapath *dp = ctx->dp;
+    struct sw_port *p;
+
+    LIST_FOR_EACH (p, struct sw_port, node, &dp->port_list) {
+        uint32_t old_state;
+
+        if (p->netdev != netdev) {
+            continue;
+        }
+        update_max_mtu(dp);
+        if (state == NETDEV_LINK_NO_CHANGE) {
+            return;
+        }
+
+        old_state = p->conf->state;
+        if (state == NETDEV_LINK_UP) {
+            p->conf->state &= ~OFPPS_LINK_DOWN;
+        } else {
+            p->conf->state |= OFPPS_LINK_DOWN;
+        }
+        if ((p->conf->state ^ old_state) & OFPPS_LINK_DOWN) {
+            VLOG_INFO(LOG_MODULE, "Port %u (%s) link %s.", p->stats->port_no,
+                      netdev_get_name(netdev),
+                      state == NETDEV_LINK_UP ? "up" : "down");
+        }
+        port_state_changed(ctx, p, old_state);
+        return;
+    }
+}
+
+/* Called by dp_liveness_run() when the neighbour on a port appears or stops
+ * sending hellos. */
+static void
+port_liveness_changed(struct sw_port *p, bool up, void *ctx_) {
+    uint32_t old_state = p->conf->state;
+
+    if (up) {
+        p->flags &= ~SWP_LIVENESS_DOWN;
+    } else {
+        p->flags |= SWP_LIVENESS_DOWN;
+    }
+    port_state_changed(ctx_, p, old_state);
+}
+
+bool
+dp_ports_run(struct datapath *dp, struct mac_to_port *mac_port,  struct mac_to_port *recovery_table, struct table_tcp * tcp_table, uint8_t *puerto_no_disponible, struct timeval * t_ini_recuperacion,
+             unsigned int budget) {
     // static, so an unused buffer can be reused at the dp_ports_run call
     static struct ofpbuf *buffer = NULL;
-    int max_mtu = 0;
+    int max_mtu;
+    bool backlog = false;
 
     struct sw_port *p, *pn;
 
@@ -248,52 +354,59 @@ dp_ports_run(struct datapath *dp, struct mac_to_port *mac_port,  struct mac_to_p
         }
     }
 #endif
-    // find largest MTU on our interfaces
-    // buffer is shared among all (idle) interfaces...
-    LIST_FOR_EACH_SAFE (p, pn, struct sw_port, node, &dp->port_list) {        
-        const int mtu = netdev_get_mtu(p->netdev);
-        if (IS_HW_PORT(p)) 
-            continue;
-        if (mtu > max_mtu)
-            max_mtu = mtu;
+    /* Link and MTU changes are pushed by the kernel, and hellos are sent on
+     * their own timers, so nothing is queried per port here. */
+    {
+        struct port_link_ctx ctx = {dp, mac_port, tcp_table,
+                                    puerto_no_disponible, t_ini_recuperacion};
+        netdev_link_run(port_link_changed, &ctx);
+        dp_liveness_run(dp->liveness, port_liveness_changed, &ctx);
+    }
+    max_mtu = dp->max_mtu;
+    if (buffer != NULL
+        && ofpbuf_tailroom(buffer) < (size_t) (VLAN_ETH_HEADER_LEN + max_mtu)) {
+        ofpbuf_delete(buffer);
+        buffer = NULL;
     }
 
-	
     LIST_FOR_EACH_SAFE (p, pn, struct sw_port, node, &dp->port_list) {
+        unsigned int n;
         int error;
-        /* Check for interface state change */
-        enum netdev_link_state link_state = netdev_link_state(p->netdev);
-        if (link_state == NETDEV_LINK_UP){
-            p->conf->state &= ~OFPPS_LINK_DOWN;
-            dp_port_live_update(p);
-        }
-        else if (link_state == NETDEV_LINK_DOWN){
-            p->conf->state |= OFPPS_LINK_DOWN;
-            dp_port_live_update(p);
-        }
+        uint64_t start;
 
         if (IS_HW_PORT(p)) {
             continue;
         }
-        if (buffer == NULL) {
-            /* Allocate buffer with some headroom to add headers in forwarding
-             * to the controller or adding a vlan tag, plus an extra 2 bytes to
-             * allow IP headers to be aligned on a 4-byte boundary.  */
-            const int headroom = 128 + 2;
-            buffer = ofpbuf_new_with_headroom(VLAN_ETH_HEADER_LEN + max_mtu, headroom);
-        }
-        error = netdev_recv(p->netdev, buffer, VLAN_ETH_HEADER_LEN + max_mtu);
-        if (!error) {
+        for (n = 0; n < budget; n++) {
+            if (buffer == NULL) {
+                /* Allocate buffer with some headroom to add headers in forwarding
+                 * to the controller or adding a vlan tag, plus an extra 2 bytes to
+                 * allow IP headers to be aligned on a 4-byte boundary.  */
+                const int headroom = 128 + 2;
+                buffer = ofpbuf_new_with_headroom(VLAN_ETH_HEADER_LEN + max_mtu, headroom);
+            }
+            start = dp_stage_begin();
+            error = netdev_recv(p->netdev, buffer, VLAN_ETH_HEADER_LEN + max_mtu);
+            if (error) {
+                if (error != EAGAIN) {
+                    VLOG_ERR_RL(LOG_MODULE, &rl, "error receiving data from %s: %s",
+                                netdev_get_name(p->netdev), strerror(error));
+                }
+                break;
+            }
+            dp_stage_end(DP_STAGE_RECV, start);
             p->stats->rx_packets++;
             p->stats->rx_bytes += buffer->size;
             // process_buffer takes ownership of ofpbuf buffer
             process_buffer(dp, p, buffer, mac_port,recovery_table, tcp_table, puerto_no_disponible, t_ini_recuperacion); 
             buffer = NULL;
-        } else if (error != EAGAIN) {
-            VLOG_ERR_RL(LOG_MODULE, &rl, "error receiving data from %s: %s",
-                        netdev_get_name(p->netdev), strerror(error));
+        }
+        dp->sched.stats.packets += n;
+        if (n == budget) {
+            backlog = true;
         }
     }
+    return backlog;
 }
 
 /* Returns the speed value in kbps of the highest bit set in the bitfield. */
@@ -439,6 +552,7 @@ new_port(struct datapath *dp, struct sw_port *port, uint32_t port_no,
 
     list_push_back(&dp->port_list, &port->node);
     dp->ports_num++;
+    update_max_mtu(dp);
 
     {
     /* Notify the controllers that this port has been added */
@@ -461,7 +575,7 @@ dp_ports_add(struct datapath *dp, const char *port_name)
     int rc = 0;
     struct sw_port *port;
 
-    fprintf(stderr, "Adding port %s. hw_drv is %p\n", port_name, dp->hw_drv);
+    VLOG_INFO(LOG_MODULE, "Adding port %s. hw_drv is %p", port_name, dp->hw_drv);
     if (dp->hw_drv && dp->hw_drv->port_add) {
         port_no = dp->hw_drv->port_add(dp->hw_drv, -1, port_name);
         if (port_no >= 0) {
@@ -471,8 +585,8 @@ dp_ports_add(struct datapath *dp, const char *port_name)
                           port_name, port_no);
                 rc = -1;
             } else {
-                fprintf(stderr, "Adding HW port %s as OF port number %d\n",
-                       port_name, port_no);
+                VLOG_INFO(LOG_MODULE, "Adding HW port %s as OF port number %d",
+                          port_name, port_no);
                 /* FIXME: Determine and record HW addr, etc */
                 port->flags |= SWP_USED | SWP_HW_DRV_PORT;
                 port->dp = dp;
@@ -576,12 +690,22 @@ dp_ports_lookup_queue(struct sw_port *p, uint32_t queue_id)
 void
 dp_ports_output(struct datapath *dp, struct ofpbuf *buffer, uint32_t out_port,
               uint32_t queue_id)
+{
+    dp_ports_output_port(dp, buffer, NULL, out_port, queue_id);
+}
+
+void
+dp_ports_output_port(struct datapath *dp, struct ofpbuf *buffer,
+                     struct sw_port *p, uint32_t out_port, uint32_t queue_id)
 {
     uint16_t class_id;
     struct sw_queue * q;
-    struct sw_port *p;
+    uint64_t start;
+    int error;
 
-    p = dp_ports_lookup(dp, out_port);
+    if (p == NULL) {
+        p = dp_ports_lookup(dp, out_port);
+    }
 
     /* FIXME:  Needs update for queuing */
     #if defined(OF_HW_PLAT) && !defined(USE_NETDEV)
@@ -625,7 +749,10 @@ dp_ports_output(struct datapath *dp, struct ofpbuf *buffer, uint32_t out_port,
                 }
             }
 
-            if (!netdev_send(p->netdev, buffer, class_id)) {
+            start = dp_stage_begin();
+            error = netdev_send(p->netdev, buffer, class_id);
+            dp_stage_end(DP_STAGE_XMIT, start);
+            if (!error) {
                 p->stats->tx_packets++;
                 p->stats->tx_bytes += buffer->size;
                 if (q != NULL) {
@@ -712,7 +839,8 @@ void
 dp_port_live_update(struct sw_port *p) {
 
   if((p->conf->state & OFPPS_LINK_DOWN)
-     || (p->conf->config & OFPPC_PORT_DOWN)) {
+     || (p->conf->config & OFPPC_PORT_DOWN)
+     || (p->flags & SWP_LIVENESS_DOWN)) {
       /* Port not live */
       p->conf->state &= ~OFPPS_LIVE;
   } else {
@@ -721,10 +849,72 @@ dp_port_live_update(struct sw_port *p) {
   }
 }
 
+/* Stats of all ports are sent through the remote's dump callback, in replies
+ * of up to PORT_STATS_DUMP_NUM ports, by ascending port number. */
+#define PORT_STATS_DUMP_NUM 64
+
+struct port_stats_dump {
+    struct ofl_msg_multipart_request_port *msg;
+    struct sender                          sender;
+    struct datapath                       *dp;
+    uint32_t                               last_port_no; /* last port sent. */
+};
+
+/* Returns the port with the lowest number above port_no, if any. */
+static struct sw_port *
+port_after(struct datapath *dp, uint32_t port_no) {
+    struct sw_port *port, *next = NULL;
+
+    LIST_FOR_EACH(port, struct sw_port, node, &dp->port_list) {
+        if (port->stats->port_no > port_no &&
+            (next == NULL || port->stats->port_no < next->stats->port_no)) {
+            next = port;
+        }
+    }
+    return next;
+}
+
+static int
+port_stats_dump(struct datapath *dp, void *dump_) {
+    struct port_stats_dump *dump = dump_;
+    struct sw_port *port;
+    bool more;
+
+    struct ofl_msg_multipart_reply_port reply =
+            {{{.type = OFPT_MULTIPART_REPLY},
+              .type = OFPMP_PORT_STATS, .flags = 0x0000},
+             .stats_num   = 0,
+             .stats       = NULL};
+
+    reply.stats = xmalloc(sizeof(struct ofl_port_stats *) * PORT_STATS_DUMP_NUM);
+    while (reply.stats_num < PORT_STATS_DUMP_NUM &&
+           (port = port_after(dp, dump->last_port_no)) != NULL) {
+        dp_port_stats_update(port);
+        reply.stats[reply.stats_num++] = port->stats;
+        dump->last_port_no = port->stats->port_no;
+    }
+    more = port_after(dp, dump->last_port_no) != NULL;
+    if (more) {
+        reply.header.flags = OFPMPF_REPLY_MORE;
+    }
+
+    dp_send_message(dp, (struct ofl_msg_header *)&reply, &dump->sender);
+    free(reply.stats);
+    return more ? 1 : 0;
+}
+
+static void
+port_stats_dump_done(void *dump_) {
+    struct port_stats_dump *dump = dump_;
+
+    ofl_msg_free((struct ofl_msg_header *)dump->msg, dump->dp->exp);
+    free(dump);
+}
+
 ofl_err
 dp_ports_handle_stats_request_port(struct datapath *dp,
                                   struct ofl_msg_multipart_request_port *msg,
-                                  const struct sender *sender UNUSED) {
+                                  const struct sender *sender) {
     struct sw_port *port;
 
     struct ofl_msg_multipart_reply_port reply =
@@ -734,16 +924,14 @@ dp_ports_handle_stats_request_port(struct datapath *dp,
              .stats       = NULL};
 
     if (msg->port_no == OFPP_ANY) {
-        size_t i = 0;
-
-        reply.stats_num = dp->ports_num;
-        reply.stats     = xmalloc(sizeof(struct ofl_port_stats *) * dp->ports_num);
+        struct port_stats_dump *dump = xmalloc(sizeof(struct port_stats_dump));
 
-        LIST_FOR_EACH(port, struct sw_port, node, &dp->port_list) {
-            dp_port_stats_update(port);
-            reply.stats[i] = port->stats;
-            i++;
-        }
+        dump->msg = msg;
+        dump->sender = *sender;
+        dump->dp = dp;
+        dump->last_port_no = 0;
+        remote_start_dump(dp, sender, port_stats_dump, port_stats_dump_done, dump);
+        return 0;
 
     } else {
         port = dp_ports_lookup(dp, msg->port_no);
@@ -1166,6 +1354,8 @@ int mac_to_port_add_hello(struct mac_to_port *mac_port, struct packet *pkt, uint
 	nuevo_elemento->time_entry = time_msec() + time * 1000;
 	memcpy(nuevo_elemento->Mac, pkt->handle_std->proto->eth->eth_src, ETH_ADDR_LEN);
 	memcpy(&(nuevo_elemento->vecino), ofpbuf_at_assert(pkt->buffer, pkt->buffer->size - sizeof(uint8_t) , sizeof(uint8_t)), sizeof(uint8_t));
+	nuevo_elemento->port_backup = 0;
+	nuevo_elemento->nueva_ronda = 0;
 	nuevo_elemento->next = NULL;
 
 	if(mac_port->inicio == NULL)
@@ -1191,6 +1381,8 @@ int mac_to_port_add(struct mac_to_port *mac_port, uint8_t Mac[ETH_ADDR_LEN], uin
 	nuevo_elemento->time_entry = time_msec() + time * 1000;
 	memcpy(nuevo_elemento->Mac, Mac, ETH_ADDR_LEN);
 	nuevo_elemento->vecino = 0;
+	nuevo_elemento->port_backup = 0;
+	nuevo_elemento->nueva_ronda = 0;
 	nuevo_elemento->next = NULL;
 
 	if(mac_port->inicio == NULL)
@@ -1215,6 +1407,8 @@ int mac_to_port_add_arp_table(struct mac_to_port *mac_port, uint8_t Mac[ETH_ADDR
 	nuevo_elemento->time_entry = time_msec() + (time * 1000);
 	memcpy(nuevo_elemento->Mac, Mac, ETH_ADDR_LEN);
 	nuevo_elemento->vecino = is_neighbor(pkt);
+	nuevo_elemento->port_backup = 0;
+	nuevo_elemento->nueva_ronda = 0;
 	
 	if(mac_port->num_element == 0)
 	{
@@ -1237,6 +1431,11 @@ int mac_to_port_update(struct mac_to_port *mac_port, uint8_t Mac[ETH_ADDR_LEN],
 	{
 		if(memcmp(aux->Mac, Mac, ETH_ADDR_LEN) == 0)
 		{
+			if (aux->port_in != port_in)
+			{
+				aux->port_backup = 0;
+				aux->nueva_ronda = 0;
+			}
 			aux->port_in = port_in;
 			if (marca_tiempo_msec > aux->time_entry)
 				aux->time_entry = marca_tiempo_msec; 
@@ -1391,6 +1590,97 @@ int mac_to_port_delete_port(struct mac_to_port *mac_port, int port)
 	return 0;
 }
 
+/* Puerto alternativo (fast failover): cuando llega por el puerto principal
+ * una nueva copia de una trama difundida desde Mac, la primera copia duplicada
+ * que llegue despues por otro puerto pasa a ser el puerto alternativo, ya que
+ * es el siguiente camino mas rapido hacia Mac. */
+int mac_to_port_new_round(struct mac_to_port *mac_port, uint8_t Mac[ETH_ADDR_LEN])
+{
+	struct mac_port_time *aux = mac_port->inicio;
+
+	while(aux != NULL)
+	{
+		if(memcmp(aux->Mac, Mac, ETH_ADDR_LEN) == 0)
+		{
+			aux->nueva_ronda = 1;
+			return 0;
+		}
+		aux = aux->next;
+	}
+	return -1;
+}
+
+int mac_to_port_add_backup(struct mac_to_port *mac_port, uint8_t Mac[ETH_ADDR_LEN], uint16_t port)
+{
+	struct mac_port_time *aux = mac_port->inicio;
+
+	while(aux != NULL)
+	{
+		if(memcmp(aux->Mac, Mac, ETH_ADDR_LEN) == 0)
+		{
+			if (aux->port_in == port || (aux->port_backup != 0 && aux->nueva_ronda == 0))
+				return 1;
+			aux->port_backup = port;
+			aux->nueva_ronda = 0;
+			return 0;
+		}
+		aux = aux->next;
+	}
+	return -1;
+}
+
+static int puerto_vivo(struct datapath *dp, int port)
+{
+	return port > 0 && port <= DP_MAX_PORTS && dp->ports[port].conf != NULL
+		&& (dp->ports[port].conf->state & OFPPS_LIVE);
+}
+
+/* Cambia la entrada de Mac a su puerto alternativo si esta vivo. Devuelve el
+ * nuevo puerto o -1. */
+int mac_to_port_failover(struct mac_to_port *mac_port, struct datapath *dp, uint8_t Mac[ETH_ADDR_LEN])
+{
+	struct mac_port_time *aux = mac_port->inicio;
+
+	while(aux != NULL)
+	{
+		if(memcmp(aux->Mac, Mac, ETH_ADDR_LEN) == 0)
+		{
+			if (!puerto_vivo(dp, aux->port_backup))
+				return -1;
+			aux->port_in = aux->port_backup;
+			aux->port_backup = 0;
+			aux->nueva_ronda = 0;
+			return aux->port_in;
+		}
+		aux = aux->next;
+	}
+	return -1;
+}
+
+/* Pasa a su puerto alternativo todas las entradas aprendidas por port que
+ * tengan uno vivo, y olvida los alternativos que apuntan a port. Devuelve el
+ * numero de entradas cambiadas. */
+int mac_to_port_failover_port(struct mac_to_port *mac_port, struct datapath *dp, int port)
+{
+	struct mac_port_time *aux = mac_port->inicio;
+	int cambiadas = 0;
+
+	while(aux != NULL)
+	{
+		if (aux->port_in == port && aux->vecino == 0 && puerto_vivo(dp, aux->port_backup))
+		{
+			aux->port_in = aux->port_backup;
+			aux->port_backup = 0;
+			aux->nueva_ronda = 0;
+			cambiadas++;
+		}
+		else if (aux->port_backup == port)
+			aux->port_backup = 0;
+		aux = aux->next;
+	}
+	return cambiadas;
+}
+
 int select_packet_tcp_path(struct packet * pkt, struct table_tcp * tcp_table, int puerto_mac, int TCP_TIME)
 {
 	uint8_t op = 1;
@@ -1427,6 +1717,7 @@ void encapsulate_path_request_tcp(struct packet *pkt)
 	{
 		if (TCP_FLAGS(pkt->handle_std->proto->tcp->tcp_ctl) == TCP_SYN)
 		{
+			packet_make_writable(pkt);
 			pkt->handle_std->proto->path = xmalloc(sizeof(struct path_header));
 			memcpy(pkt->handle_std->proto->path->mac_dst, pkt->handle_std->proto->eth->eth_dst, ETH_ADDR_LEN);
 			pkt->handle_std->proto->path->tcp_src = pkt->handle_std->proto->tcp->tcp_src;
@@ -1472,7 +1763,10 @@ void desencapsulate_path_request_tcp(struct packet *pkt, int op)
 	uint32_t nyapa = 0x00000000;
 
 	struct tcp_header * tcp;
-	struct ofpbuf *b = ofpbuf_new(pkt->buffer->size-sizeof(uint8_t)-ETH_ADDR_LEN-sizeof(uint16_t)-sizeof(uint32_t)-sizeof(uint8_t));
+	struct ofpbuf *b;
+
+	packet_make_writable(pkt);
+	b = ofpbuf_new(pkt->buffer->size-sizeof(uint8_t)-ETH_ADDR_LEN-sizeof(uint16_t)-sizeof(uint32_t)-sizeof(uint8_t));
 
 	tcp = xmalloc(sizeof(struct tcp_header));
 	tcp->tcp_src  = pkt->handle_std->proto->path->tcp_src;
@@ -1493,6 +1787,7 @@ void desencapsulate_path_request_tcp(struct packet *pkt, int op)
 	pkt->handle_std->proto->path = NULL;
 		
 	ofpbuf_put(b, pkt->buffer->data, pkt->buffer->size - sizeof(uint8_t) - ETH_ADDR_LEN - sizeof(uint16_t) - sizeof(uint32_t) - sizeof(uint8_t));
+	ofpbuf_delete(pkt->buffer);
 	pkt-> buffer = b;
 	
 	pkt->handle_std->valid=false;
@@ -1590,6 +1885,8 @@ int table_tcp_add(struct table_tcp *tcp_table, uint8_t Mac_src[ETH_ADDR_LEN], ui
         nuevo_elemento->port_src = port_src;
         nuevo_elemento->port_dst = port_dst;
         nuevo_elemento->port_out = 0; 
+        nuevo_elemento->port_in_backup = 0;
+        nuevo_elemento->nueva_ronda = 0;
 
         if (tcp_table->inicio == NULL) 
 	{
@@ -1856,6 +2153,83 @@ int table_tcp_delete_timeout(struct table_tcp *tcp_table)
 	return 0;
 }
 
+/* Igual que mac_to_port_new_round() para las conexiones TCP-Path: una nueva
+ * peticion llegada por el puerto principal abre una ronda, y su primera copia
+ * duplicada por otro puerto sustituye al puerto alternativo. */
+int table_tcp_new_round(struct table_tcp *tcp_table, uint8_t Mac_src[ETH_ADDR_LEN], uint8_t Mac_dst[ETH_ADDR_LEN],
+        uint16_t port_src, uint16_t port_dst)
+{
+	struct table_tcp_time *aux = tcp_table->inicio;
+	struct cmp_table_tcp directo;
+
+	memcpy(directo.Mac_src, Mac_src, ETH_ADDR_LEN);
+	memcpy(directo.Mac_dst, Mac_dst, ETH_ADDR_LEN);
+	directo.port_src = port_src;
+	directo.port_dst = port_dst;
+
+	while(aux != NULL)
+	{
+		if(memcmp(aux, &directo, (2*ETH_ADDR_LEN+4)) == 0)
+		{
+			aux->nueva_ronda = 1;
+			return 0;
+		}
+		aux = aux->next;
+	}
+	return -1;
+}
+
+/* Guarda port como alternativo para ir al src de la conexion si llega por el
+ * una copia duplicada de la peticion y aun no hay ninguno, o si es la primera
+ * copia de una nueva ronda. */
+int table_tcp_add_backup(struct table_tcp *tcp_table, uint8_t Mac_src[ETH_ADDR_LEN], uint8_t Mac_dst[ETH_ADDR_LEN],
+        uint16_t port_src, uint16_t port_dst, uint16_t port)
+{
+	struct table_tcp_time *aux = tcp_table->inicio;
+	struct cmp_table_tcp directo;
+
+	memcpy(directo.Mac_src, Mac_src, ETH_ADDR_LEN);
+	memcpy(directo.Mac_dst, Mac_dst, ETH_ADDR_LEN);
+	directo.port_src = port_src;
+	directo.port_dst = port_dst;
+
+	while(aux != NULL)
+	{
+		if(memcmp(aux, &directo, (2*ETH_ADDR_LEN+4)) == 0)
+		{
+			if (aux->port_in == port || (aux->port_in_backup != 0 && aux->nueva_ronda == 0))
+				return 1;
+			aux->port_in_backup = port;
+			aux->nueva_ronda = 0;
+			return 0;
+		}
+		aux = aux->next;
+	}
+	return -1;
+}
+
+/* Igual que mac_to_port_failover_port() para las conexiones TCP-Path. */
+int table_tcp_failover_port(struct table_tcp *tcp_table, struct datapath *dp, int port)
+{
+	struct table_tcp_time *aux = tcp_table->inicio;
+	int cambiadas = 0;
+
+	while(aux != NULL)
+	{
+		if (aux->port_in == port && puerto_vivo(dp, aux->port_in_backup))
+		{
+			aux->port_in = aux->port_in_backup;
+			aux->port_in_backup = 0;
+			aux->nueva_ronda = 0;
+			cambiadas++;
+		}
+		else if (aux->port_in_backup == port)
+			aux->port_in_backup = 0;
+		aux = aux->next;
+	}
+	return cambiadas;
+}
+
 int tcp_delete_port(struct table_tcp *tcp_table, uint8_t Mac_src[ETH_ADDR_LEN], uint8_t Mac_dst[ETH_ADDR_LEN],
         uint16_t port_src, uint16_t port_dst)
 {
@@ -1945,6 +2319,7 @@ void keep_arp_path(struct packet * pkt, struct mac_to_port *mac_port)
 
 void encapsulate_arp_path(struct packet *pkt)
 {
+	packet_make_writable(pkt);
 	pkt->handle_std->proto->arppath = xmalloc(sizeof(struct arp_path_header));
 	pkt->handle_std->proto->arppath->ar_hrd = pkt->handle_std->proto->arp->ar_hrd;
 	pkt->handle_std->proto->arppath->ar_pro = pkt->handle_std->proto->arp->ar_pro;
@@ -1964,6 +2339,7 @@ void encapsulate_arp_path(struct packet *pkt)
 }
 void desencapsulate_arp_path(struct packet *pkt)
 {
+	packet_make_writable(pkt);
 	pkt->handle_std->proto->arp = xmalloc(sizeof(struct arp_eth_header));
 	pkt->handle_std->proto->arp->ar_hrd = pkt->handle_std->proto->arppath->ar_hrd;
 	pkt->handle_std->proto->arp->ar_pro = pkt->handle_std->proto->arppath->ar_pro;
@@ -1989,6 +2365,7 @@ void desencapsulate_arp_path(struct packet *pkt)
 
 void keep_id_switch(struct packet *pkt, int id)
 {
+	packet_make_writable(pkt);
 	if (pkt->buffer->size < 64) 
 	{
 		pkt->handle_std->proto->arppath->arpt_sw1 = id;
@@ -2045,6 +2422,7 @@ void keep_id_switch(struct packet *pkt, int id)
 
 void switch_track_tcp(struct packet *pkt)
 {
+	packet_make_writable(pkt);
 	memcpy(&(pkt->handle_std->proto->path->contador), 
 		ofpbuf_at(pkt->buffer, (pkt->buffer->size - sizeof(uint8_t)), sizeof(uint8_t)), 
 		sizeof(uint8_t));
@@ -75,6 +75,7 @@ struct sw_queue {
 enum sw_port_flags {
     SWP_USED             = 1 << 0,    /* Is port being used */
     SWP_HW_DRV_PORT      = 1 << 1,    /* Port controlled by HW driver */
+    SWP_LIVENESS_DOWN    = 1 << 2,    /* Neighbour stopped sending hellos */
 };
 #if defined(OF_HW_PLAT) && !defined(USE_NETDEV)
 #define IS_HW_PORT(p) ((p)->flags & SWP_HW_DRV_PORT)
@@ -119,6 +120,8 @@ struct mac_port_time{
         uint8_t  Mac[ETH_ADDR_LEN];
         uint16_t port_in;
 		uint8_t	vecino;
+		uint16_t port_backup;	// mejor puerto alternativo (copias duplicadas), 0 si no hay
+		uint8_t nueva_ronda;	// la siguiente copia duplicada sustituye a port_backup
         uint64_t time_entry;
         struct mac_port_time *next;
 };
@@ -142,6 +145,8 @@ struct table_tcp_time{
         uint16_t port_dst; //puerto destino tcp
         uint16_t port_in;	// puerto entrada para ir al src
 		uint16_t port_out;	// puerto entrada para ir al dst
+		uint16_t port_in_backup;	// puerto alternativo para ir al src, 0 si no hay
+		uint8_t nueva_ronda;	// la siguiente copia duplicada sustituye a port_in_backup
 		uint64_t time_entry;
         struct table_tcp_time *next;      
 };
@@ -172,10 +177,12 @@ dp_ports_add(struct datapath *dp, const char *netdev);
 int
 dp_ports_add_local(struct datapath *dp, const char *netdev);
 
-/* Receives datapath packets, and runs them through the pipeline. */
-void
+/* Receives up to 'budget' packets from each port, and runs them through the
+ * pipeline. Returns true if some port may have more packets waiting. */
+bool
 dp_ports_run(struct datapath *dp, struct mac_to_port *mac_port,  
-        struct mac_to_port *recovery_table, struct table_tcp * tcp_table, uint8_t *puerto_no_disponible, struct timeval * t_ini_recuperacion);
+        struct mac_to_port *recovery_table, struct table_tcp * tcp_table, uint8_t *puerto_no_disponible, struct timeval * t_ini_recuperacion,
+        unsigned int budget);
 
 /* Returns the given port. */
 struct sw_port *
@@ -190,6 +197,13 @@ void
 dp_ports_output(struct datapath *dp, struct ofpbuf *buffer, uint32_t out_port,
               uint32_t queue_id);
 
+/* Outputs a datapath packet on port number 'out_port'. 'p' is that port, if
+ * the caller already looked it up, or NULL to look it up here. It may be a
+ * port without a device. */
+void
+dp_ports_output_port(struct datapath *dp, struct ofpbuf *buffer,
+                     struct sw_port *p, uint32_t out_port, uint32_t queue_id);
+
 /* Outputs a datapath packet on all ports except for in_port. If flood is set,
  * packet is not sent out on ports with flooding disabled. */
 int
@@ -249,6 +263,10 @@ int mac_to_port_check_timeout(struct mac_to_port *mac_port, uint8_t Mac[ETH_ADDR
 int mac_to_port_delete_timeout(struct mac_to_port *mac_port);
 void visualizar_tabla(struct mac_to_port *mac_port, int64_t id_datapath);
 int mac_to_port_delete_port(struct mac_to_port *mac_port, int port);
+int mac_to_port_new_round(struct mac_to_port *mac_port, uint8_t Mac[ETH_ADDR_LEN]);
+int mac_to_port_add_backup(struct mac_to_port *mac_port, uint8_t Mac[ETH_ADDR_LEN], uint16_t port);
+int mac_to_port_failover(struct mac_to_port *mac_port, struct datapath *dp, uint8_t Mac[ETH_ADDR_LEN]);
+int mac_to_port_failover_port(struct mac_to_port *mac_port, struct datapath *dp, int port);
 void encapsulate_path_request_tcp(struct packet *pkt);
 void desencapsulate_path_request_tcp(struct packet *pkt, int op);
 int select_packet_tcp_path(struct packet * pkt, struct table_tcp * tcp_table, int puerto_mac, int TCP_TIME);
@@ -272,6 +290,11 @@ int table_tcp_found_port(struct table_tcp *tcp_table, uint8_t Mac_src[ETH_ADDR_L
 int table_tcp_found_port_in(struct table_tcp *tcp_table, uint8_t Mac_src[ETH_ADDR_LEN], uint8_t Mac_dst[ETH_ADDR_LEN],
         uint16_t port_src, uint16_t port_dst);
 int table_tcp_delete_timeout(struct table_tcp *tcp_table);
+int table_tcp_new_round(struct table_tcp *tcp_table, uint8_t Mac_src[ETH_ADDR_LEN], uint8_t Mac_dst[ETH_ADDR_LEN],
+        uint16_t port_src, uint16_t port_dst);
+int table_tcp_add_backup(struct table_tcp *tcp_table, uint8_t Mac_src[ETH_ADDR_LEN], uint8_t Mac_dst[ETH_ADDR_LEN],
+        uint16_t port_src, uint16_t port_dst, uint16_t port);
+int table_tcp_failover_port(struct table_tcp *tcp_table, struct datapath *dp, int port);
 int tcp_delete_port(struct table_tcp *tcp_table, uint8_t Mac_src[ETH_ADDR_LEN], uint8_t Mac_dst[ETH_ADDR_LEN],
         uint16_t port_src, uint16_t port_dst);
 void visualizar_tabla_tcp(struct table_tcp *tcp, int64_t id_datapath);
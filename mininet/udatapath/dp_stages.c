@@ -0,0 +1,205 @@
+/* Copyright (c) 2011, TrafficLab, Ericsson Research, Hungary
+ * Copyright (c) 2012, CPqD, Brazil 
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Ericsson Research nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+#include "datapath.h"
+#include "dp_stages.h"
+#include "oflib/ofl-messages.h"
+#include "oflib-exp/ofl-exp-openflow.h"
+#include "openflow/openflow-ext.h"
+#include "vlog.h"
+
+#define LOG_MODULE VLM_dp_stages
+
+static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(60, 60);
+
+#ifdef DP_STAGE_TIMERS
+
+/* Time spent comparing the TSC against the monotonic clock. */
+#define CALIBRATE_NSEC 10000000
+
+bool dp_stages_enabled;
+bool dp_stages_tsc;
+
+static const char *stage_names[DP_STAGE_COUNT] = {
+    [DP_STAGE_RECV]     = "recv",
+    [DP_STAGE_PARSE]    = "parse",
+    [DP_STAGE_LOOKUP]   = "lookup",
+    [DP_STAGE_ARP_PATH] = "arp_path",
+    [DP_STAGE_TCP_PATH] = "tcp_path",
+    [DP_STAGE_ACTIONS]  = "actions",
+    [DP_STAGE_XMIT]     = "xmit",
+};
+
+static bool calibrated;
+static double ns_per_tick = 1.0;
+static struct ofl_exp_stage_stats hists[DP_STAGE_COUNT];
+
+static uint64_t
+monotonic_nsec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Switches to the TSC if it ticks at a constant rate, and measures that rate
+ * against the monotonic clock. */
+static void
+calibrate(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned int eax, ebx, ecx, edx;
+
+    if (__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) && (edx & (1 << 8))) {
+        uint64_t ns0, ns1, tsc0, tsc1;
+
+        dp_stages_tsc = true;
+        ns0 = monotonic_nsec();
+        tsc0 = dp_stages_clock();
+        do {
+            ns1 = monotonic_nsec();
+        } while (ns1 - ns0 < CALIBRATE_NSEC);
+        tsc1 = dp_stages_clock();
+        ns_per_tick = (double) (ns1 - ns0) / (tsc1 - tsc0);
+        VLOG_INFO(LOG_MODULE, "timing stages with the TSC at %.3f GHz.",
+                  1 / ns_per_tick);
+    }
+#endif
+    if (!dp_stages_tsc) {
+        VLOG_INFO(LOG_MODULE, "timing stages with clock_gettime().");
+    }
+    calibrated = true;
+}
+
+void
+dp_stages_record(enum dp_stage stage, uint64_t ticks)
+{
+    struct ofl_exp_stage_stats *h = &hists[stage];
+    uint64_t ns = dp_stages_tsc ? (uint64_t) (ticks * ns_per_tick) : ticks;
+
+    if (h->count == 0 || ns < h->min_ns) {
+        h->min_ns = ns;
+    }
+    if (ns > h->max_ns) {
+        h->max_ns = ns;
+    }
+    h->count++;
+    h->total_ns += ns;
+    h->buckets[ofl_exp_stage_bucket(ns)]++;
+}
+
+bool
+dp_stages_set_enabled(bool enabled)
+{
+    if (enabled && !calibrated) {
+        calibrate();
+    }
+    dp_stages_enabled = enabled;
+    return true;
+}
+
+#else
+
+bool
+dp_stages_set_enabled(bool enabled UNUSED)
+{
+    return false;
+}
+
+#endif /* DP_STAGE_TIMERS */
+
+ofl_err
+dp_stages_handle_request(struct datapath *dp,
+                         struct ofl_exp_openflow_mp_request_stages *msg,
+                         const struct sender *sender)
+{
+    struct ofl_exp_stage_stats stages[DP_STAGE_COUNT];
+    uint32_t flags = 0;
+    size_t stages_num = 0;
+
+    switch (msg->command) {
+        case OFP_EXT_STAGES_GET:
+        case OFP_EXT_STAGES_CLEAR: {
+            break;
+        }
+        case OFP_EXT_STAGES_ENABLE:
+        case OFP_EXT_STAGES_DISABLE: {
+            if (!dp_stages_set_enabled(msg->command == OFP_EXT_STAGES_ENABLE)) {
+                VLOG_WARN_RL(LOG_MODULE, &rl, "Stage timers are not compiled in.");
+            }
+            break;
+        }
+        default: {
+            VLOG_WARN_RL(LOG_MODULE, &rl, "Unknown stage timers command (%u).", msg->command);
+            return ofl_error(OFPET_BAD_REQUEST, OFPBRC_BAD_EXP_TYPE);
+        }
+    }
+
+#ifdef DP_STAGE_TIMERS
+    flags |= OFP_EXT_STAGES_COMPILED;
+    if (dp_stages_enabled) {
+        flags |= OFP_EXT_STAGES_ENABLED;
+    }
+    memcpy(stages, hists, sizeof(stages));
+    for (stages_num = 0; stages_num < DP_STAGE_COUNT; stages_num++) {
+        strncpy(stages[stages_num].name, stage_names[stages_num],
+                OFP_EXT_STAGE_NAME_LEN);
+    }
+    if (msg->command == OFP_EXT_STAGES_CLEAR) {
+        memset(hists, 0, sizeof(hists));
+    }
+#endif
+
+    {
+        struct ofl_exp_openflow_mp_reply_stages reply =
+                {{{{{.type = OFPT_MULTIPART_REPLY},
+                    .type = OFPMP_EXPERIMENTER, .flags = 0x0000},
+                   .experimenter_id = OPENFLOW_VENDOR_ID,
+                   .data_length = 0, .data = NULL},
+                  .type = OFP_EXT_MP_STAGES},
+                 .flags = flags,
+                 .stages_num = stages_num,
+                 .stages = stages};
+
+        dp_send_message(dp, (struct ofl_msg_header *)&reply, sender);
+    }
+
+    ofl_msg_free((struct ofl_msg_header *)msg, dp->exp);
+    return 0;
+}
@@ -0,0 +1,138 @@
+/* Copyright (c) 2011, TrafficLab, Ericsson Research, Hungary
+ * Copyright (c) 2012, CPqD, Brazil 
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Ericsson Research nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef DP_STAGES_H
+#define DP_STAGES_H 1
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include "compiler.h"
+#include "oflib/ofl-messages.h"
+
+/****************************************************************************
+ * Per-stage latency histograms of the packet path. With --enable-stage-timers
+ * every stage below is timed with the TSC (or clock_gettime() where the TSC
+ * is not invariant) and the samples are kept in log-linear histograms, read
+ * with "dpctl stats-stages". Timing is off until switched on with the
+ * --stage-timers option or "dpctl stats-stages on". Without the configure
+ * option the probes compile to nothing.
+ *
+ * Stages nest: the action, ARP-Path and TCP-Path stages include the
+ * transmits they trigger.
+ ****************************************************************************/
+
+enum dp_stage {
+    DP_STAGE_RECV,      /* netdev_recv() of one packet. */
+    DP_STAGE_PARSE,     /* header parsing into the packet match. */
+    DP_STAGE_LOOKUP,    /* one flow table lookup. */
+    DP_STAGE_ARP_PATH,  /* pipeline_arp_path(). */
+    DP_STAGE_TCP_PATH,  /* pipeline_tcp_path(). */
+    DP_STAGE_ACTIONS,   /* instructions of one flow entry, or the action set. */
+    DP_STAGE_XMIT,      /* netdev_send() of one packet. */
+
+    DP_STAGE_COUNT
+};
+
+struct datapath;
+struct sender;
+struct ofl_exp_openflow_mp_request_stages;
+
+#ifdef DP_STAGE_TIMERS
+
+extern bool dp_stages_enabled;
+extern bool dp_stages_tsc;
+
+void
+dp_stages_record(enum dp_stage stage, uint64_t ticks);
+
+static inline uint64_t
+dp_stages_clock(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    if (dp_stages_tsc) {
+        uint32_t lo, hi;
+
+        __asm__ __volatile__("rdtsc" : "=a" (lo), "=d" (hi));
+        return ((uint64_t) hi << 32) | lo;
+    }
+#endif
+    {
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+    }
+}
+
+/* Returns the start of a stage, to be passed to dp_stage_end(), or 0 if the
+ * timers are off. */
+static inline uint64_t
+dp_stage_begin(void)
+{
+    return dp_stages_enabled ? dp_stages_clock() : 0;
+}
+
+/* Charges the time since 'start' to 'stage'. */
+static inline void
+dp_stage_end(enum dp_stage stage, uint64_t start)
+{
+    if (start != 0) {
+        dp_stages_record(stage, dp_stages_clock() - start);
+    }
+}
+
+#else
+
+static inline uint64_t
+dp_stage_begin(void)
+{
+    return 0;
+}
+
+static inline void
+dp_stage_end(enum dp_stage stage UNUSED, uint64_t start UNUSED)
+{
+}
+
+#endif /* DP_STAGE_TIMERS */
+
+/* Switches the timers on or off. Returns false if they are compiled out. */
+bool
+dp_stages_set_enabled(bool enabled);
+
+/* Handles an OFP_EXT_MP_STAGES request. */
+ofl_err
+dp_stages_handle_request(struct datapath *dp,
+                         struct ofl_exp_openflow_mp_request_stages *msg,
+                         const struct sender *sender);
+
+
+#endif /* DP_STAGES_H */
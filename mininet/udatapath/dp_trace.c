@@ -0,0 +1,315 @@
+/* Copyright (c) 2011, TrafficLab, Ericsson Research, Hungary
+ * Copyright (c) 2012, CPqD, Brazil 
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Ericsson Research nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <arpa/inet.h>
+#include <assert.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "datapath.h"
+#include "dirs.h"
+#include "dp_trace.h"
+#include "packet.h"
+#include "packet_handle_std.h"
+#include "packets.h"
+#include "signals.h"
+#include "timeval.h"
+#include "util.h"
+#include "vlog.h"
+
+#define LOG_MODULE VLM_dp_trace
+
+static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(60, 60);
+
+/* Records sent in each reply of a dump. */
+#define TRACE_DUMP_NUM 1024
+
+struct dp_trace *
+dp_trace_create(struct datapath *dp) {
+    struct dp_trace *t = xmalloc(sizeof(struct dp_trace));
+
+    t->dp = dp;
+    t->enabled = false;
+    t->ring = NULL;
+    t->mask = 0;
+    t->head = 0;
+    t->file_name = xasprintf("%s/ofdatapath.trace", ofp_rundir);
+    t->dump_signal = signal_register(SIGUSR1);
+    dp_trace_set_size(t, DP_TRACE_SIZE_DEFAULT);
+    return t;
+}
+
+void
+dp_trace_destroy(struct dp_trace *t) {
+    free(t->ring);
+    free(t->file_name);
+    free(t);
+}
+
+void
+dp_trace_set_size(struct dp_trace *t, uint32_t size) {
+    uint32_t n = 1;
+
+    assert(size <= DP_TRACE_SIZE_MAX);
+    while (n < size) {
+        n <<= 1;
+    }
+    free(t->ring);
+    t->ring = xmalloc(n * sizeof(struct ofl_exp_trace_record));
+    t->mask = n - 1;
+    t->head = 0;
+}
+
+void
+dp_trace_set_enabled(struct dp_trace *t, bool enabled) {
+    t->enabled = enabled;
+}
+
+void
+dp_trace_set_file(struct dp_trace *t, const char *file_name) {
+    free(t->file_name);
+    t->file_name = xstrdup(file_name);
+}
+
+void
+dp_trace_clear(struct dp_trace *t) {
+    t->head = 0;
+}
+
+static struct ofl_exp_trace_record *
+trace_next(struct dp_trace *t, uint8_t event, uint8_t reason,
+           uint32_t port, uint32_t arg) {
+    struct ofl_exp_trace_record *r = &t->ring[t->head++ & t->mask];
+
+    r->time_ns = time_nsec();
+    r->event   = event;
+    r->reason  = reason;
+    r->port    = port;
+    r->arg     = arg;
+    return r;
+}
+
+void
+dp_trace_record_pkt(struct dp_trace *t, uint8_t event, uint8_t reason,
+                    struct packet *pkt, uint32_t port, uint32_t arg) {
+    struct ofl_exp_trace_record *r = trace_next(t, event, reason, port, arg);
+    struct protocols_std *proto = NULL;
+
+    r->in_port = pkt->in_port;
+    if (pkt->buffer->size >= ETH_HEADER_LEN) {
+        struct eth_header *eth = pkt->buffer->data;
+
+        memcpy(r->eth_src, eth->eth_src, OFP_ETH_ALEN);
+        memcpy(r->eth_dst, eth->eth_dst, OFP_ETH_ALEN);
+    } else {
+        memset(r->eth_src, 0x00, OFP_ETH_ALEN);
+        memset(r->eth_dst, 0x00, OFP_ETH_ALEN);
+    }
+
+    /* Only headers parsed already; tracing does not parse packets. */
+    if (pkt->handle_std != NULL && pkt->handle_std->valid) {
+        proto = pkt->handle_std->proto;
+    }
+    if (proto != NULL && proto->tcp != NULL) {
+        r->tp_src = ntohs(proto->tcp->tcp_src);
+        r->tp_dst = ntohs(proto->tcp->tcp_dst);
+    } else if (proto != NULL && proto->path != NULL) {
+        r->tp_src = ntohs(proto->path->tcp_src);
+        r->tp_dst = ntohs(proto->path->tcp_dst);
+    } else {
+        r->tp_src = 0;
+        r->tp_dst = 0;
+    }
+}
+
+void
+dp_trace_record_port(struct dp_trace *t, uint8_t event, uint8_t reason,
+                     uint32_t in_port, uint32_t port, uint32_t arg) {
+    struct ofl_exp_trace_record *r = trace_next(t, event, reason, port, arg);
+
+    r->in_port = in_port;
+    r->tp_src = 0;
+    r->tp_dst = 0;
+    memset(r->eth_src, 0x00, OFP_ETH_ALEN);
+    memset(r->eth_dst, 0x00, OFP_ETH_ALEN);
+}
+
+/* Fills in the state of the trace in 'reply', and copies the records in the
+ * ring into it, oldest first, if 'records' is true. */
+static void
+trace_snapshot(struct dp_trace *t, struct ofl_exp_openflow_mp_reply_trace *reply,
+               bool records) {
+    uint64_t size = (uint64_t)t->mask + 1;
+    uint64_t first = t->head > size ? t->head - size : 0;
+    struct timeval now;
+    uint64_t i;
+
+    gettimeofday(&now, NULL);
+    reply->flags       = t->enabled ? OFP_EXT_TRACE_ENABLED : 0;
+    reply->size        = size;
+    reply->total       = t->head;
+    reply->now_ns      = time_nsec();
+    reply->wall_ns     = (uint64_t)now.tv_sec * 1000000000 + now.tv_usec * 1000;
+    reply->records_num = records ? t->head - first : 0;
+    reply->records     = xmalloc(reply->records_num * sizeof(struct ofl_exp_trace_record));
+    for (i = 0; i < reply->records_num; i++) {
+        reply->records[i] = t->ring[(first + i) & t->mask];
+    }
+}
+
+static void
+trace_write_file(struct dp_trace *t) {
+    struct ofl_exp_openflow_mp_reply_trace snap;
+    FILE *file;
+    int error;
+
+    file = fopen(t->file_name, "w");
+    if (file == NULL) {
+        VLOG_WARN_RL(LOG_MODULE, &rl, "%s: open failed (%s)",
+                     t->file_name, strerror(errno));
+        return;
+    }
+    trace_snapshot(t, &snap, true);
+    error = ofl_exp_trace_save(file, t->dp->id, &snap);
+    if (fclose(file) != 0 && error == 0) {
+        error = errno;
+    }
+    if (error) {
+        VLOG_WARN_RL(LOG_MODULE, &rl, "%s: write failed (%s)",
+                     t->file_name, strerror(error));
+    } else {
+        VLOG_INFO(LOG_MODULE, "wrote %zu trace records to %s.",
+                  snap.records_num, t->file_name);
+    }
+    free(snap.records);
+}
+
+void
+dp_trace_run(struct dp_trace *t) {
+    if (signal_poll(t->dump_signal)) {
+        trace_write_file(t);
+    }
+}
+
+void
+dp_trace_wait(struct dp_trace *t) {
+    signal_wait(t->dump_signal);
+}
+
+struct trace_dump {
+    struct sender                             sender;
+    struct ofl_exp_openflow_mp_reply_trace    snap;
+    size_t                                    sent;  /* records sent. */
+};
+
+static int
+trace_dump(struct datapath *dp, void *dump_) {
+    struct trace_dump *dump = dump_;
+    struct ofl_exp_openflow_mp_reply_trace reply = dump->snap;
+    size_t left = dump->snap.records_num - dump->sent;
+    bool more = left > TRACE_DUMP_NUM;
+
+    reply.records     = dump->snap.records + dump->sent;
+    reply.records_num = more ? TRACE_DUMP_NUM : left;
+    if (more) {
+        reply.header.header.header.flags = OFPMPF_REPLY_MORE;
+    }
+    dp_send_message(dp, (struct ofl_msg_header *)&reply, &dump->sender);
+    dump->sent += reply.records_num;
+    return more ? 1 : 0;
+}
+
+static void
+trace_dump_done(void *dump_) {
+    struct trace_dump *dump = dump_;
+
+    free(dump->snap.records);
+    free(dump);
+}
+
+ofl_err
+dp_trace_handle_request(struct datapath *dp,
+                        struct ofl_exp_openflow_mp_request_trace *msg,
+                        const struct sender *sender) {
+    struct dp_trace *t = dp->trace;
+    struct trace_dump *dump;
+
+    switch (msg->command) {
+        case OFP_EXT_TRACE_GET: {
+            break;
+        }
+        case OFP_EXT_TRACE_ENABLE: {
+            if (msg->size > DP_TRACE_SIZE_MAX) {
+                VLOG_WARN_RL(LOG_MODULE, &rl, "Trace size too large (%"PRIu32").", msg->size);
+                return ofl_error(OFPET_BAD_REQUEST, OFPBRC_BAD_LEN);
+            }
+            if (msg->size != 0) {
+                dp_trace_set_size(t, msg->size);
+            }
+            dp_trace_set_enabled(t, true);
+            break;
+        }
+        case OFP_EXT_TRACE_DISABLE: {
+            dp_trace_set_enabled(t, false);
+            break;
+        }
+        case OFP_EXT_TRACE_CLEAR: {
+            dp_trace_clear(t);
+            break;
+        }
+        default: {
+            VLOG_WARN_RL(LOG_MODULE, &rl, "Unknown trace command (%u).", msg->command);
+            return ofl_error(OFPET_BAD_REQUEST, OFPBRC_BAD_EXP_TYPE);
+        }
+    }
+
+    dump = xmalloc(sizeof(struct trace_dump));
+    dump->sender = *sender;
+    dump->sent = 0;
+    dump->snap.header.header.header.header.type = OFPT_MULTIPART_REPLY;
+    dump->snap.header.header.header.type        = OFPMP_EXPERIMENTER;
+    dump->snap.header.header.header.flags       = 0x0000;
+    dump->snap.header.header.experimenter_id    = OPENFLOW_VENDOR_ID;
+    dump->snap.header.header.data_length        = 0;
+    dump->snap.header.header.data               = NULL;
+    dump->snap.header.type                      = OFP_EXT_MP_TRACE;
+    trace_snapshot(t, &dump->snap, msg->command == OFP_EXT_TRACE_GET);
+    ofl_msg_free((struct ofl_msg_header *)msg, dp->exp);
+
+    remote_start_dump(dp, sender, trace_dump, trace_dump_done, dump);
+    return 0;
+}
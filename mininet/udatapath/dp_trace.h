@@ -0,0 +1,133 @@
+/* Copyright (c) 2011, TrafficLab, Ericsson Research, Hungary
+ * Copyright (c) 2012, CPqD, Brazil 
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Ericsson Research nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef DP_TRACE_H
+#define DP_TRACE_H 1
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "oflib/ofl-messages.h"
+#include "oflib-exp/ofl-exp-openflow.h"
+#include "openflow/openflow-ext.h"
+
+/****************************************************************************
+ * Binary trace of datapath events. Learning, lookups, path requests, floods,
+ * recoveries and drops are written as fixed-size records into a ring that
+ * keeps the most recent ones, read with "dpctl dump-trace" or written to a
+ * file on SIGUSR1, and rendered with ofp-trace. The datapath runs in a single
+ * thread, so the ring has one writer and no locks; while tracing is off a
+ * trace point costs one test.
+ ****************************************************************************/
+
+#define DP_TRACE_SIZE_DEFAULT 8192 /* records in the ring. */
+#define DP_TRACE_SIZE_MAX (1 << 20) /* largest ring, 40 MB of records. */
+
+struct datapath;
+struct packet;
+struct sender;
+struct signal;
+
+struct dp_trace {
+    struct datapath              *dp;
+    bool                          enabled;
+    struct ofl_exp_trace_record  *ring;
+    uint32_t                      mask;     /* records in the ring, less 1. */
+    uint64_t                      head;     /* records written since the
+                                               last clear. */
+    char                         *file_name; /* written on SIGUSR1. */
+    struct signal                *dump_signal;
+};
+
+/* Creates the trace of the datapath, with tracing off. */
+struct dp_trace *
+dp_trace_create(struct datapath *dp);
+
+void
+dp_trace_destroy(struct dp_trace *t);
+
+/* Resizes the ring to keep the last 'size' records, rounded up to a power of
+ * two, and clears it. 'size' must not exceed DP_TRACE_SIZE_MAX. */
+void
+dp_trace_set_size(struct dp_trace *t, uint32_t size);
+
+void
+dp_trace_set_enabled(struct dp_trace *t, bool enabled);
+
+/* Sets the file the ring is written to on SIGUSR1. */
+void
+dp_trace_set_file(struct dp_trace *t, const char *file_name);
+
+void
+dp_trace_clear(struct dp_trace *t);
+
+void
+dp_trace_record_pkt(struct dp_trace *t, uint8_t event, uint8_t reason,
+                    struct packet *pkt, uint32_t port, uint32_t arg);
+
+void
+dp_trace_record_port(struct dp_trace *t, uint8_t event, uint8_t reason,
+                     uint32_t in_port, uint32_t port, uint32_t arg);
+
+/* Records 'event' for 'pkt'. 'port' is the port the event refers to, e.g.
+ * the port learnt or the output port, and 'arg' depends on the event. */
+static inline void
+dp_trace_pkt(struct dp_trace *t, uint8_t event, uint8_t reason,
+             struct packet *pkt, uint32_t port, uint32_t arg)
+{
+    if (t->enabled) {
+        dp_trace_record_pkt(t, event, reason, pkt, port, arg);
+    }
+}
+
+/* Records 'event' for no packet in particular. */
+static inline void
+dp_trace_port(struct dp_trace *t, uint8_t event, uint8_t reason,
+              uint32_t in_port, uint32_t port, uint32_t arg)
+{
+    if (t->enabled) {
+        dp_trace_record_port(t, event, reason, in_port, port, arg);
+    }
+}
+
+/* Writes the ring to the trace file if SIGUSR1 was received. */
+void
+dp_trace_run(struct dp_trace *t);
+
+void
+dp_trace_wait(struct dp_trace *t);
+
+/* Handles an OFP_EXT_MP_TRACE request. */
+ofl_err
+dp_trace_handle_request(struct datapath *dp,
+                        struct ofl_exp_openflow_mp_request_trace *msg,
+                        const struct sender *sender);
+
+
+#endif /* DP_TRACE_H */
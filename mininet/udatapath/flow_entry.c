@@ -30,6 +30,7 @@
 
 #include <stdbool.h>
 #include <stdlib.h>
+#include "compiled_actions.h"
 #include "datapath.h"
 #include "dp_actions.h"
 #include "flow_table.h"
@@ -140,12 +141,15 @@ flow_entry_replace_instructions(struct flow_entry *entry,
 
     /* TODO Zoltan: could be done more efficiently, but... */
     del_group_refs(entry);
+    compiled_actions_destroy(entry->compiled, entry->stats->instructions_num);
 
     OFL_UTILS_FREE_ARR_FUN2(entry->stats->instructions, entry->stats->instructions_num,
                             ofl_structs_free_instruction, entry->dp->exp);
 
     entry->stats->instructions_num = instructions_num;
     entry->stats->instructions     = instructions;
+    entry->compiled = compiled_actions_create(entry->dp, instructions_num,
+                                              instructions);
 
     init_group_refs(entry);
 }
@@ -168,7 +172,7 @@ flow_entry_idle_timeout(struct flow_entry *entry) {
     bool timeout;
 
     timeout = (entry->stats->idle_timeout != 0) &&
-              (time_msec() > entry->last_used + entry->stats->idle_timeout * 1000);
+              (time_msec() >= entry->last_used + entry->stats->idle_timeout * 1000);
 
     if (timeout) {
         flow_entry_remove(entry, OFPRR_IDLE_TIMEOUT);
@@ -180,7 +184,7 @@ bool
 flow_entry_hard_timeout(struct flow_entry *entry) {
     bool timeout;
 
-    timeout = (entry->remove_at != 0) && (time_msec() > entry->remove_at);
+    timeout = (entry->remove_at != 0) && (time_msec() >= entry->remove_at);
 
     if (timeout) {
         flow_entry_remove(entry, OFPRR_HARD_TIMEOUT);
@@ -188,6 +192,20 @@ flow_entry_hard_timeout(struct flow_entry *entry) {
     return timeout;
 }
 
+uint64_t
+flow_entry_next_timeout(struct flow_entry *entry) {
+    uint64_t next = entry->remove_at;
+
+    if (entry->stats->idle_timeout != 0) {
+        uint64_t idle_at = entry->last_used + entry->stats->idle_timeout * 1000;
+
+        if (next == 0 || idle_at < next) {
+            next = idle_at;
+        }
+    }
+    return next;
+}
+
 void
 flow_entry_update(struct flow_entry *entry) {
     entry->stats->duration_sec  =  (time_msec() - entry->created) / 1000;
@@ -360,17 +378,19 @@ flow_entry_create(struct datapath *dp, struct flow_table *table, struct ofl_msg_
     entry->stats->match            = mod->match;
     entry->stats->instructions_num = mod->instructions_num;
     entry->stats->instructions     = mod->instructions;
+    entry->compiled = compiled_actions_create(dp, mod->instructions_num,
+                                              mod->instructions);
 
     entry->match = mod->match; /* TODO: MOD MATCH? */
 
+    entry->serial       = 0;
     entry->created      = now;
     entry->remove_at    = mod->hard_timeout == 0 ? 0
                                   : now + mod->hard_timeout * 1000;
     entry->last_used    = now;
     entry->send_removed = ((mod->flags & OFPFF_SEND_FLOW_REM) != 0);
     list_init(&entry->match_node);
-    list_init(&entry->idle_node);
-    list_init(&entry->hard_node);
+    timer_wheel_timer_init(&entry->timeout);
 
     list_init(&entry->group_refs);
     init_group_refs(entry);
@@ -387,6 +407,7 @@ flow_entry_destroy(struct flow_entry *entry) {
     //       flow; but it won't be a problem.
     del_group_refs(entry);
     del_meter_refs(entry);
+    compiled_actions_destroy(entry->compiled, entry->stats->instructions_num);
     ofl_structs_free_flow_stats(entry->stats, entry->dp->exp);
     // assumes it is a standard match
     //free(entry->match);
@@ -407,9 +428,7 @@ flow_entry_remove(struct flow_entry *entry, uint8_t reason) {
         }
     }
 
-    list_remove(&entry->match_node);
-    list_remove(&entry->hard_node);
-    list_remove(&entry->idle_node);
+    flow_table_unlink(entry->table, entry);
     entry->table->stats->active_count--;
     flow_entry_destroy(entry);
 }
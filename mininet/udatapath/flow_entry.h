@@ -39,6 +39,7 @@
 #include "oflib/ofl-structs.h"
 #include "oflib/ofl-messages.h"
 #include "timeval.h"
+#include "timer_wheel.h"
 
 /****************************************************************************
  * Implementation of a flow table entry.
@@ -46,15 +47,18 @@
 
 struct flow_entry {
     struct list              match_node;  /* list nodes in flow table lists. */
-    struct list              hard_node;
-    struct list              idle_node;
+    struct timer_wheel_timer timeout;     /* next hard or idle timeout check. */
+    struct hmap_node         strict_node; /* node in the table's strict index. */
 
     struct datapath         *dp;
     struct flow_table       *table;
     struct ofl_flow_stats   *stats;
+    struct compiled_actions *compiled; /* compiled form of each of the
+                                          instructions in stats. */
     struct ofl_match_header *match; /* Original match structure is stored in stats;
                                        this one is a modified version, which reflects
                                        1.2 matching rules. */
+    uint64_t                 serial;   /* order of insertion into the table. */
     uint64_t                 created;  /* time the entry was created at. */
     uint64_t                 remove_at; /* time the entry should be removed at
                                            due to its hard timeout. */
@@ -97,6 +101,11 @@ flow_entry_idle_timeout(struct flow_entry *entry);
 bool
 flow_entry_hard_timeout(struct flow_entry *entry);
 
+/* Returns the time the entry should be checked for timeouts next, based on
+ * its hard timeout and the last time it was used; 0 if it never times out. */
+uint64_t
+flow_entry_next_timeout(struct flow_entry *entry);
+
 /* Returns true if the flow entry has an output action to the given port. */
 bool
 flow_entry_has_out_port(struct flow_entry *entry, uint32_t port);
@@ -36,6 +36,8 @@
 #include "flow_entry.h"
 #include "oflib/ofl.h"
 #include "oflib/oxm-match.h"
+#include "hash.h"
+#include "match_std.h"
 #include "time.h"
 #include "dp_capabilities.h"
 //#include "packet_handle_std.h"
@@ -83,26 +85,222 @@ struct ofl_action_header actions[] = { {OFPAT_OUTPUT, 4},
 
 #define N_ACTIONS       (sizeof(actions) / sizeof(struct ofl_action_header))
 
-/* When inserting an entry, this function adds the flow entry to the list of
- * hard and idle timeout entries, if appropriate. */
+/* When inserting an entry, this function arms the timeout check of the entry,
+ * if it has a hard or idle timeout. Idle timeouts are not re-armed when the
+ * entry is used; the check re-arms itself if the entry was used meanwhile. */
 static void
 add_to_timeout_lists(struct flow_table *table, struct flow_entry *entry) {
-    if (entry->stats->idle_timeout > 0) {
-        list_insert(&table->idle_entries, &entry->idle_node);
+    uint64_t next = flow_entry_next_timeout(entry);
+
+    if (next > 0) {
+        timer_wheel_add(&table->timeouts, &entry->timeout, next);
+    }
+}
+
+/* Entries are kept in match_entries by descending priority, and entries of the
+ * same priority are contiguous. A bucket points to the first and last entry
+ * of a priority, so new entries can be placed without walking the list. */
+struct flow_priority_bucket {
+    uint16_t      priority;
+    struct list  *first;
+    struct list  *last;
+};
+
+/* Returns the index of the bucket of the given priority, setting 'found'; or
+ * the index a new bucket for the priority should be inserted at. */
+static size_t
+bucket_find(struct flow_table *table, uint16_t priority, bool *found) {
+    size_t low = 0, high = table->n_buckets;
+
+    while (low < high) {
+        size_t mid = (low + high) / 2;
+
+        if (table->buckets[mid].priority == priority) {
+            *found = true;
+            return mid;
+        }
+        if (table->buckets[mid].priority > priority) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    *found = false;
+    return low;
+}
+
+/* Inserts a bucket at index 'idx' of the (sorted) bucket array. */
+static struct flow_priority_bucket *
+bucket_insert(struct flow_table *table, size_t idx, uint16_t priority) {
+    struct flow_priority_bucket *b;
+
+    if (table->n_buckets == table->allocated_buckets) {
+        table->allocated_buckets = table->allocated_buckets == 0 ? 8
+                                     : table->allocated_buckets * 2;
+        table->buckets = xrealloc(table->buckets,
+                           table->allocated_buckets * sizeof *table->buckets);
+    }
+    memmove(&table->buckets[idx + 1], &table->buckets[idx],
+            (table->n_buckets - idx) * sizeof *table->buckets);
+    table->n_buckets++;
+
+    b = &table->buckets[idx];
+    b->priority = priority;
+    b->first = b->last = NULL;
+    return b;
+}
+
+/* Places the entry in match_entries behind the entries of equal priority. */
+static void
+bucket_add_entry(struct flow_table *table, struct flow_entry *entry) {
+    struct flow_priority_bucket *b;
+    bool found;
+    size_t idx = bucket_find(table, entry->stats->priority, &found);
+
+    if (found) {
+        b = &table->buckets[idx];
+        list_insert(b->last->next, &entry->match_node);
+    } else {
+        struct list *before = idx < table->n_buckets ? table->buckets[idx].first
+                                                     : &table->match_entries;
+        list_insert(before, &entry->match_node);
+        b = bucket_insert(table, idx, entry->stats->priority);
+        b->first = &entry->match_node;
+    }
+    b->last = &entry->match_node;
+}
+
+/* Takes the entry out of match_entries. */
+static void
+bucket_remove_entry(struct flow_table *table, struct flow_entry *entry) {
+    struct list *node = &entry->match_node;
+    struct flow_priority_bucket *b;
+    bool found;
+    size_t idx = bucket_find(table, entry->stats->priority, &found);
+
+    b = &table->buckets[idx];
+    if (b->first == node && b->last == node) {
+        memmove(b, b + 1, (table->n_buckets - idx - 1) * sizeof *b);
+        table->n_buckets--;
+    } else if (b->first == node) {
+        b->first = node->next;
+    } else if (b->last == node) {
+        b->last = node->prev;
+    }
+    list_remove(node);
+}
+
+/* Rebuilds the buckets from match_entries. */
+static void
+bucket_rebuild(struct flow_table *table) {
+    struct flow_entry *entry;
+    struct flow_priority_bucket *b = NULL;
+
+    table->n_buckets = 0;
+    LIST_FOR_EACH (entry, struct flow_entry, match_node, &table->match_entries) {
+        if (b == NULL || b->priority != entry->stats->priority) {
+            b = bucket_insert(table, table->n_buckets, entry->stats->priority);
+            b->first = &entry->match_node;
+        }
+        b->last = &entry->match_node;
     }
+}
+
+static uint32_t
+strict_hash(struct ofl_msg_flow_mod *mod) {
+    return hash_int(mod->priority,
+                    match_std_strict_hash((struct ofl_match *)mod->match));
+}
+
+/* Returns the entry strictly matching the flow mod, if there is one. There
+ * can be at most one, as adding an identical entry replaces the old one. */
+static struct flow_entry *
+strict_lookup(struct flow_table *table, struct ofl_msg_flow_mod *mod, uint32_t hash) {
+    struct hmap_node *node;
 
-    if (entry->remove_at > 0) {
-        struct flow_entry *e;
+    /* NOTE: HMAP_FOR_EACH_WITH_HASH relies on the hmap node being the first
+     *       member of the structure, which strict_node is not. */
+    for (node = hmap_first_with_hash(&table->strict_index, hash); node != NULL;
+         node = hmap_next_with_hash(node)) {
+        struct flow_entry *entry = CONTAINER_OF(node, struct flow_entry, strict_node);
 
-        /* hard timeout entries are ordered by the time they should be removed at. */
-        LIST_FOR_EACH (e, struct flow_entry, hard_node, &table->hard_entries) {
-            if (e->remove_at > entry->remove_at) {
-                list_insert(&e->hard_node, &entry->hard_node);
-                return;
+        if (flow_entry_matches(entry, mod, true/*strict*/, false/*check_cookie*/)) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+/* Orders the entries added in batch mode into match_entries. */
+static void
+flush_pending(struct flow_table *table) {
+    struct flow_entry **pending;
+    struct list *pos;
+    size_t i, n;
+
+    if (list_is_empty(&table->pending)) {
+        return;
+    }
+
+    n = list_size(&table->pending);
+    pending = xmalloc(n * sizeof *pending);
+    for (i = 0; i < n; i++) {
+        pending[i] = CONTAINER_OF(list_pop_front(&table->pending),
+                                  struct flow_entry, match_node);
+    }
+    /* Stable insertion sort by descending priority; batches are mostly
+     * installed in priority order already. */
+    for (i = 1; i < n; i++) {
+        struct flow_entry *e = pending[i];
+        size_t j = i;
+
+        while (j > 0 && pending[j - 1]->stats->priority < e->stats->priority) {
+            pending[j] = pending[j - 1];
+            j--;
+        }
+        pending[j] = e;
+    }
+
+    /* Merge into match_entries in a single pass, behind equal priorities. */
+    pos = table->match_entries.next;
+    for (i = 0; i < n; i++) {
+        while (pos != &table->match_entries &&
+               CONTAINER_OF(pos, struct flow_entry, match_node)->stats->priority
+                                                >= pending[i]->stats->priority) {
+            pos = pos->next;
+        }
+        list_insert(pos, &pending[i]->match_node);
+    }
+    free(pending);
+
+    bucket_rebuild(table);
+}
+
+/* Returns true if any entry of the same priority overlaps the flow mod. */
+static bool
+flow_table_overlaps(struct flow_table *table, struct ofl_msg_flow_mod *mod) {
+    struct flow_entry *entry;
+    bool found;
+    size_t idx = bucket_find(table, mod->priority, &found);
+
+    if (found) {
+        struct list *node;
+
+        for (node = table->buckets[idx].first; ; node = node->next) {
+            if (flow_entry_overlaps(CONTAINER_OF(node, struct flow_entry, match_node), mod)) {
+                return true;
             }
+            if (node == table->buckets[idx].last) {
+                break;
+            }
+        }
+    }
+    LIST_FOR_EACH (entry, struct flow_entry, match_node, &table->pending) {
+        if (flow_entry_overlaps(entry, mod)) {
+            return true;
         }
-        list_insert(&e->hard_node, &entry->hard_node);
     }
+    return false;
 }
 
 /* Handles flow mod messages with ADD command. */
@@ -110,30 +308,41 @@ static ofl_err
 flow_table_add(struct flow_table *table, struct ofl_msg_flow_mod *mod, bool check_overlap, bool *match_kept, bool *insts_kept) {
     // Note: new entries will be placed behind those with equal priority
     struct flow_entry *entry, *new_entry;
+    uint32_t hash = strict_hash(mod);
 
-    LIST_FOR_EACH (entry, struct flow_entry, match_node, &table->match_entries) {
-        if (check_overlap && flow_entry_overlaps(entry, mod)) {
-            return ofl_error(OFPET_FLOW_MOD_FAILED, OFPFMFC_OVERLAP);
-        }
+    if (check_overlap && flow_table_overlaps(table, mod)) {
+        return ofl_error(OFPET_FLOW_MOD_FAILED, OFPFMFC_OVERLAP);
+    }
 
-        /* if the entry equals, replace the old one */
-        if (flow_entry_matches(entry, mod, true/*strict*/, false/*check_cookie*/)) {
-            new_entry = flow_entry_create(table->dp, table, mod);
-            *match_kept = true;
-            *insts_kept = true;
+    /* if the entry equals, replace the old one */
+    entry = strict_lookup(table, mod, hash);
+    if (entry != NULL) {
+        bool found;
+        size_t idx = bucket_find(table, mod->priority, &found);
 
-            /* NOTE: no flow removed message should be generated according to spec. */
-            list_replace(&new_entry->match_node, &entry->match_node);
-            list_remove(&entry->hard_node);
-            list_remove(&entry->idle_node);
-            flow_entry_destroy(entry);
-            add_to_timeout_lists(table, new_entry);
-            return 0;
-        }
+        new_entry = flow_entry_create(table->dp, table, mod);
+        new_entry->serial = entry->serial;
+        *match_kept = true;
+        *insts_kept = true;
 
-        if (mod->priority > entry->stats->priority) {
-            break;
+        /* NOTE: no flow removed message should be generated according to spec. */
+        list_replace(&new_entry->match_node, &entry->match_node);
+        if (found) {
+            struct flow_priority_bucket *b = &table->buckets[idx];
+
+            if (b->first == &entry->match_node) {
+                b->first = &new_entry->match_node;
+            }
+            if (b->last == &entry->match_node) {
+                b->last = &new_entry->match_node;
+            }
         }
+        hmap_remove(&table->strict_index, &entry->strict_node);
+        hmap_insert(&table->strict_index, &new_entry->strict_node, hash);
+        timer_wheel_cancel(&table->timeouts, &entry->timeout);
+        flow_entry_destroy(entry);
+        add_to_timeout_lists(table, new_entry);
+        return 0;
     }
 
     if (table->stats->active_count == FLOW_TABLE_MAX_ENTRIES) {
@@ -142,10 +351,16 @@ flow_table_add(struct flow_table *table, struct ofl_msg_flow_mod *mod, bool chec
     table->stats->active_count++;
 
     new_entry = flow_entry_create(table->dp, table, mod);
+    new_entry->serial = table->next_serial++;
     *match_kept = true;
     *insts_kept = true;
 
-    list_insert(&entry->match_node, &new_entry->match_node);
+    if (table->batching) {
+        list_push_back(&table->pending, &new_entry->match_node);
+    } else {
+        bucket_add_entry(table, new_entry);
+    }
+    hmap_insert(&table->strict_index, &new_entry->strict_node, hash);
     add_to_timeout_lists(table, new_entry);
 
     return 0;
@@ -157,6 +372,16 @@ static ofl_err
 flow_table_modify(struct flow_table *table, struct ofl_msg_flow_mod *mod, bool strict, bool *insts_kept) {
     struct flow_entry *entry;
 
+    if (strict) {
+        entry = strict_lookup(table, mod, strict_hash(mod));
+        if (entry != NULL && flow_entry_matches(entry, mod, true, true/*check_cookie*/)) {
+            flow_entry_replace_instructions(entry, mod->instructions_num, mod->instructions);
+            flow_entry_modify_stats(entry, mod);
+            *insts_kept = true;
+        }
+        return 0;
+    }
+
     LIST_FOR_EACH (entry, struct flow_entry, match_node, &table->match_entries) {
         if (flow_entry_matches(entry, mod, strict, true/*check_cookie*/)) {
             flow_entry_replace_instructions(entry, mod->instructions_num, mod->instructions);
@@ -173,6 +398,17 @@ static ofl_err
 flow_table_delete(struct flow_table *table, struct ofl_msg_flow_mod *mod, bool strict) {
     struct flow_entry *entry, *next;
 
+    if (strict) {
+        entry = strict_lookup(table, mod, strict_hash(mod));
+        if (entry != NULL &&
+            (mod->out_port == OFPP_ANY || flow_entry_has_out_port(entry, mod->out_port)) &&
+            (mod->out_group == OFPG_ANY || flow_entry_has_out_group(entry, mod->out_group)) &&
+            flow_entry_matches(entry, mod, true, true/*check_cookie*/)) {
+            flow_entry_remove(entry, OFPRR_DELETE);
+        }
+        return 0;
+    }
+
     LIST_FOR_EACH_SAFE (entry, next, struct flow_entry, match_node, &table->match_entries) {
         if ((mod->out_port == OFPP_ANY || flow_entry_has_out_port(entry, mod->out_port)) &&
             (mod->out_group == OFPG_ANY || flow_entry_has_out_group(entry, mod->out_group)) &&
@@ -184,9 +420,33 @@ flow_table_delete(struct flow_table *table, struct ofl_msg_flow_mod *mod, bool s
     return 0;
 }
 
+void
+flow_table_unlink(struct flow_table *table, struct flow_entry *entry) {
+    flush_pending(table);
+    bucket_remove_entry(table, entry);
+    hmap_remove(&table->strict_index, &entry->strict_node);
+    timer_wheel_cancel(&table->timeouts, &entry->timeout);
+}
+
+void
+flow_table_batch_begin(struct flow_table *table) {
+    table->batching = true;
+}
+
+void
+flow_table_batch_end(struct flow_table *table) {
+    flush_pending(table);
+    table->batching = false;
+}
+
 
 ofl_err
 flow_table_flow_mod(struct flow_table *table, struct ofl_msg_flow_mod *mod, bool *match_kept, bool *insts_kept) {
+    /* Only additions are batched; anything else sees the full table. */
+    if (mod->command != OFPFC_ADD) {
+        flush_pending(table);
+    }
+
     switch (mod->command) {
         case (OFPFC_ADD): {
             bool overlap = ((mod->flags & OFPFF_CHECK_OVERLAP) != 0);
@@ -216,6 +476,7 @@ flow_table_lookup(struct flow_table *table, struct packet *pkt) {
     struct flow_entry *entry;
 
     table->stats->lookup_count++;
+    flush_pending(table);
 
     LIST_FOR_EACH(entry, struct flow_entry, match_node, &table->match_entries) {
         struct ofl_match_header *m;
@@ -254,18 +515,22 @@ flow_table_lookup(struct flow_table *table, struct packet *pkt) {
 
 void
 flow_table_timeout(struct flow_table *table) {
-    struct flow_entry *entry, *next;
+    struct list expired;
+    uint64_t now = time_msec();
 
-    /* NOTE: hard timeout entries are ordered by the time they should be removed at,
-     * so if one is not removed, the rest will not be either. */
-    LIST_FOR_EACH_SAFE (entry, next, struct flow_entry, hard_node, &table->hard_entries) {
-        if (!flow_entry_hard_timeout(entry)) {
-            break;
-        }
-    }
+    flush_pending(table);
+    list_init(&expired);
+    timer_wheel_advance(&table->timeouts, now, &expired);
+
+    while (!list_is_empty(&expired)) {
+        struct flow_entry *entry = CONTAINER_OF(list_front(&expired),
+                                                struct flow_entry, timeout);
 
-    LIST_FOR_EACH_SAFE (entry, next, struct flow_entry, idle_node, &table->idle_entries) {
-        flow_entry_idle_timeout(entry);
+        timer_wheel_cancel(&table->timeouts, &entry->timeout);
+        if (!flow_entry_hard_timeout(entry) && !flow_entry_idle_timeout(entry)) {
+            /* The entry was used since the check was armed. */
+            add_to_timeout_lists(table, entry);
+        }
     }
 }
 
@@ -403,8 +668,14 @@ flow_table_create(struct datapath *dp, uint8_t table_id) {
     table->features->properties_num = flow_table_features(table->features);
 
     list_init(&table->match_entries);
-    list_init(&table->hard_entries);
-    list_init(&table->idle_entries);
+    list_init(&table->pending);
+    hmap_init(&table->strict_index);
+    table->buckets = NULL;
+    table->n_buckets = 0;
+    table->allocated_buckets = 0;
+    table->batching = false;
+    table->next_serial = 0;
+    timer_wheel_init(&table->timeouts, time_msec());
 
     return table;
 }
@@ -413,26 +684,80 @@ void
 flow_table_destroy(struct flow_table *table) {
     struct flow_entry *entry, *next;
 
+    flush_pending(table);
     LIST_FOR_EACH_SAFE (entry, next, struct flow_entry, match_node, &table->match_entries) {
         flow_entry_destroy(entry);
     }
+    hmap_destroy(&table->strict_index);
+    free(table->buckets);
     free(table->features);
     free(table->stats);
     free(table);
 }
 
-void
+/* Returns the first entry after the cursor position. Pending entries must
+ * have been flushed. */
+static struct list *
+cursor_next(struct flow_table *table, struct flow_table_cursor *cursor) {
+    struct list *node;
+    bool found;
+    size_t idx;
+
+    if (!cursor->started) {
+        return table->match_entries.next;
+    }
+
+    idx = bucket_find(table, cursor->priority, &found);
+    if (found) {
+        struct flow_priority_bucket *b = &table->buckets[idx];
+
+        for (node = b->first; ; node = node->next) {
+            if (CONTAINER_OF(node, struct flow_entry, match_node)->serial > cursor->serial) {
+                return node;
+            }
+            if (node == b->last) {
+                return node->next;
+            }
+        }
+    }
+    return idx < table->n_buckets ? table->buckets[idx].first : &table->match_entries;
+}
+
+static void
+cursor_advance(struct flow_table_cursor *cursor, struct flow_entry *entry) {
+    cursor->started = true;
+    cursor->priority = entry->stats->priority;
+    cursor->serial = entry->serial;
+    cursor->visits_left--;
+}
+
+bool
 flow_table_stats(struct flow_table *table, struct ofl_msg_multipart_request_flow *msg,
+                 struct flow_table_cursor *cursor,
                  struct ofl_flow_stats ***stats, size_t *stats_size, size_t *stats_num) {
-    struct flow_entry *entry;
+    struct list *node;
 
-    LIST_FOR_EACH(entry, struct flow_entry, match_node, &table->match_entries) {
+    flush_pending(table);
+
+    for (node = cursor_next(table, cursor); node != &table->match_entries; node = node->next) {
+        struct flow_entry *entry = CONTAINER_OF(node, struct flow_entry, match_node);
+
+        if (cursor->visits_left == 0) {
+            return false;
+        }
         if ((msg->out_port == OFPP_ANY || flow_entry_has_out_port(entry, msg->out_port)) &&
             (msg->out_group == OFPG_ANY || flow_entry_has_out_group(entry, msg->out_group)) &&
             match_std_nonstrict((struct ofl_match *)msg->match,
                                 (struct ofl_match *)entry->stats->match)) {
+            size_t len;
 
             flow_entry_update(entry);
+            len = ofl_structs_flow_stats_ofp_len(entry->stats, table->dp->exp);
+            if (len > cursor->bytes_left && *stats_num > 0) {
+                return false;
+            }
+            cursor->bytes_left -= MIN(len, cursor->bytes_left);
+
             if ((*stats_size) == (*stats_num)) {
                 (*stats) = xrealloc(*stats, (sizeof(struct ofl_flow_stats *)) * (*stats_size) * 2);
                 *stats_size *= 2;
@@ -440,17 +765,29 @@ flow_table_stats(struct flow_table *table, struct ofl_msg_multipart_request_flow
             (*stats)[(*stats_num)] = entry->stats;
             (*stats_num)++;
         }
+        cursor_advance(cursor, entry);
     }
+    return true;
 }
 
-void
+bool
 flow_table_aggregate_stats(struct flow_table *table, struct ofl_msg_multipart_request_flow *msg,
+                           struct flow_table_cursor *cursor,
                            uint64_t *packet_count, uint64_t *byte_count, uint32_t *flow_count) {
-    struct flow_entry *entry;
+    struct list *node;
 
-    LIST_FOR_EACH(entry, struct flow_entry, match_node, &table->match_entries) {
+    flush_pending(table);
+
+    for (node = cursor_next(table, cursor); node != &table->match_entries; node = node->next) {
+        struct flow_entry *entry = CONTAINER_OF(node, struct flow_entry, match_node);
+
+        if (cursor->visits_left == 0) {
+            return false;
+        }
         if ((msg->out_port == OFPP_ANY || flow_entry_has_out_port(entry, msg->out_port)) &&
-            (msg->out_group == OFPG_ANY || flow_entry_has_out_group(entry, msg->out_group))) {
+            (msg->out_group == OFPG_ANY || flow_entry_has_out_group(entry, msg->out_group)) &&
+            match_std_nonstrict((struct ofl_match *)msg->match,
+                                (struct ofl_match *)entry->stats->match)) {
 			
 			if (!entry->no_pkt_count)
             	(*packet_count) += entry->stats->packet_count;
@@ -458,7 +795,8 @@ flow_table_aggregate_stats(struct flow_table *table, struct ofl_msg_multipart_re
 				(*byte_count)   += entry->stats->byte_count;
             (*flow_count)++;
         }
+        cursor_advance(cursor, entry);
     }
-
+    return true;
 }
 
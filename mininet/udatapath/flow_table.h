@@ -35,6 +35,8 @@
 #include "oflib/ofl-structs.h"
 #include "pipeline.h"
 #include "timeval.h"
+#include "timer_wheel.h"
+#include "hmap.h"
 
 
 #define FLOW_TABLE_MAX_ENTRIES 4096
@@ -42,9 +44,12 @@
 
 /****************************************************************************
  * Implementation of a flow table. The current implementation stores flow
- * entries in priority and then insertion order.
+ * entries in priority and then insertion order. Entries are also indexed by
+ * priority and exact match, so strict flow mods do not walk the table.
  ****************************************************************************/
 
+struct flow_priority_bucket;
+
 
 struct flow_table {
     struct datapath           *dp;
@@ -53,10 +58,19 @@ struct flow_table {
     struct ofl_table_stats    *stats;         /* structure storing table statistics. */
     
     struct list               match_entries;  /* list of entries in order. */
-    struct list               hard_entries;   /* list of entries with hard timeout;
-                                                ordered by their timeout times. */
-    struct list               idle_entries;   /* unordered list of entries with
-                                                idle timeout. */
+    struct timer_wheel        timeouts;       /* entries with hard or idle timeout,
+                                                by the time they are checked next. */
+    struct hmap               strict_index;   /* entries by priority and match. */
+    struct flow_priority_bucket *buckets;     /* first and last entry of each
+                                                 priority, by descending priority. */
+    size_t                    n_buckets;
+    size_t                    allocated_buckets;
+
+    uint64_t                  next_serial;    /* serial of the next new entry. */
+
+    bool                      batching;       /* new entries go to 'pending'. */
+    struct list               pending;        /* entries added in batch mode,
+                                                 not yet in match_entries. */
 };
 
 extern uint32_t oxm_ids[];
@@ -74,7 +88,8 @@ flow_table_flow_mod(struct flow_table *table, struct ofl_msg_flow_mod *mod, bool
 struct flow_entry *
 flow_table_lookup(struct flow_table *table, struct packet *pkt);
 
-/* Orders the flow table to check the timeout its flows. */
+/* Orders the flow table to check the timeout its flows. Only the entries
+ * whose timeout check is due are visited. */
 void
 flow_table_timeout(struct flow_table *table);
 
@@ -86,14 +101,43 @@ flow_table_create(struct datapath *dp, uint8_t table_id);
 void
 flow_table_destroy(struct flow_table *table);
 
-/* Collects statistics of the flow entries of the table. */
-void
+/* Position of an incremental walk over the entries of a flow table, along
+ * with the work the walk may still do before yielding. The position is kept
+ * by priority and serial, so it stays valid while the table changes. */
+struct flow_table_cursor {
+    bool     started;     /* false if no entry has been visited yet. */
+    uint16_t priority;    /* priority of the last visited entry. */
+    uint64_t serial;      /* serial of the last visited entry. */
+    size_t   bytes_left;  /* reply space left for flow stats. */
+    size_t   visits_left; /* entries that may still be visited. */
+};
+
+/* Collects statistics of the flow entries of the table, starting after the
+ * cursor. Returns true if the end of the table was reached, or false if the
+ * cursor ran out of visits or reply space first. */
+bool
 flow_table_stats(struct flow_table *table, struct ofl_msg_multipart_request_flow *msg,
+                 struct flow_table_cursor *cursor,
                  struct ofl_flow_stats ***stats, size_t *stats_size, size_t *stats_num);
 
-/* Collects aggregate statistics of the flow entries of the table. */
-void
+/* Collects aggregate statistics of the flow entries of the table, starting
+ * after the cursor. Returns true if the end of the table was reached. */
+bool
 flow_table_aggregate_stats(struct flow_table *table, struct ofl_msg_multipart_request_flow *msg,
+                           struct flow_table_cursor *cursor,
                            uint64_t *packet_count, uint64_t *byte_count, uint32_t *flow_count);
 
+/* Takes the entry out of the table's lists and indices. */
+void
+flow_table_unlink(struct flow_table *table, struct flow_entry *entry);
+
+/* Starts batch mode: added entries are only ordered into the table once
+ * the batch ends, or when something needs to look at the table. */
+void
+flow_table_batch_begin(struct flow_table *table);
+
+/* Ends batch mode, ordering the pending entries in a single pass. */
+void
+flow_table_batch_end(struct flow_table *table);
+
 #endif /* FLOW_TABLE_H */
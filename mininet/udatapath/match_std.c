@@ -310,7 +310,7 @@ packet_match(struct ofl_match *flow_match, struct ofl_match *packet){
 
 static inline bool
 strict_mask8(uint8_t *a, uint8_t *b, uint8_t *am, uint8_t *bm) {
-    return ((am[0] == bm[0]) && ((a[0] ^ b[0]) & am[0])) == 0;
+    return (am[0] == bm[0]) && (((a[0] ^ b[0]) & am[0]) == 0);
 }
 
 static inline bool
@@ -319,7 +319,7 @@ strict_mask16(uint8_t *a, uint8_t *b, uint8_t *am, uint8_t *bm) {
     uint16_t *b1 = (uint16_t *) b;
     uint16_t *mask_a = (uint16_t *) am;
     uint16_t *mask_b = (uint16_t *) bm;
-    return ((*mask_a == *mask_b) && ((*a1 ^ *b1) & (*mask_a))) == 0;
+    return (*mask_a == *mask_b) && (((*a1 ^ *b1) & (*mask_a)) == 0);
 }
 
 static inline bool
@@ -334,7 +334,7 @@ strict_mask32(uint8_t *a, uint8_t *b, uint8_t *am, uint8_t *bm) {
     uint32_t *b1 = (uint32_t *) b;
     uint32_t *mask_a = (uint32_t *) am;
     uint32_t *mask_b = (uint32_t *) bm;
-    return ((*mask_a == *mask_b) && ((*a1 ^ *b1) & (*mask_a))) == 0;
+    return (*mask_a == *mask_b) && (((*a1 ^ *b1) & (*mask_a)) == 0);
 }
 
 static inline bool
@@ -343,7 +343,7 @@ strict_mask_ip(uint8_t *a, uint8_t *b, uint8_t *am, uint8_t *bm) {
     uint32_t *b1 = (uint32_t *) b;
     uint32_t *mask_a = (uint32_t *) am;
     uint32_t *mask_b = (uint32_t *) bm;
-    return ((*mask_a == *mask_b) && ((*a1 ^ *b1) & (*mask_a))) == 0;
+    return (*mask_a == *mask_b) && (((*a1 ^ *b1) & (*mask_a)) == 0);
 }
 
 static inline bool
@@ -358,7 +358,7 @@ strict_mask64(uint8_t *a, uint8_t *b, uint8_t *am, uint8_t *bm) {
     uint64_t *b1 = (uint64_t *) b;
     uint64_t *mask_a = (uint64_t *) am;
     uint64_t *mask_b = (uint64_t *) bm;
-    return ((*mask_a == *mask_b) && ((*a1 ^ *b1) & (*mask_a))) == 0;
+    return (*mask_a == *mask_b) && (((*a1 ^ *b1) & (*mask_a)) == 0);
 }
 
 static inline bool
@@ -574,6 +574,33 @@ nonstrict_mask128(uint8_t *a, uint8_t *b, uint8_t *am, uint8_t *bm) {
            nonstrict_mask64(a+8, b+8, am+8, bm+8);
 }
 
+uint32_t
+match_std_strict_hash(struct ofl_match *m) {
+    struct ofl_match_tlv *f;
+    uint32_t hash = 0;
+
+    /* Field hashes are summed, so the result does not depend on the order of
+     * the fields in the hash map. Bits outside the mask are left out, as
+     * strict matching ignores them. */
+    HMAP_FOR_EACH(f, struct ofl_match_tlv, hmap_node, &m->match_fields) {
+        size_t len = OXM_LENGTH(f->header);
+
+        if (OXM_HASMASK(f->header)) {
+            uint8_t masked[256];
+            size_t i, half = len / 2;
+
+            for (i = 0; i < half; i++) {
+                masked[i] = f->value[i] & f->value[half + i];
+                masked[half + i] = f->value[half + i];
+            }
+            hash += hash_bytes(masked, len, f->header);
+        } else {
+            hash += hash_bytes(f->value, len, f->header);
+        }
+    }
+    return hash;
+}
+
 /* Flow entry (a) matches flow entry (b) non-strictly if (a) matches whenever (b) matches.
  * Thus, flow (a) must not have more match fields than (b) and all match fields in (a) must
  * be equal or narrower in (b).
@@ -49,6 +49,11 @@ packet_match(struct ofl_match *a, struct ofl_match *b);
 bool
 match_std_strict(struct ofl_match *a, struct ofl_match *b);
 
+/* Returns a hash of the match, which is the same for any two matches that
+ * match each other in a strict manner. */
+uint32_t
+match_std_strict_hash(struct ofl_match *m);
+
 /* Returns true if match a matches match b, in a non-strict manner. */
 bool
 match_std_nonstrict(struct ofl_match *a, struct ofl_match *b);
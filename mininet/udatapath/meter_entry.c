@@ -53,6 +53,15 @@ static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(60, 60);
 struct meter_table;
 struct datapath;
 
+/* Tokens are kept in fixed point, so that 'rate' tokens are added every ns:
+ * a token is 10^-9 kbit for OFPMF_KBPS meters, and 10^-9 packets for
+ * OFPMF_PKTPS ones. The bucket of a band holds up to its burst size, or
+ * METER_DEFAULT_BURST_MS worth of its rate if OFPMF_BURST is not set. */
+#define METER_TOKENS_PER_UNIT   1000000000ULL
+#define METER_DEFAULT_BURST_MS  100
+
+static void reset_tokens(struct meter_entry *entry);
+
 /* Node in the list of references to flows, which reference the meter entry. */
 struct flow_ref_entry {
     struct list node;
@@ -130,9 +139,8 @@ meter_entry_create(struct datapath *dp, struct meter_table *table, struct ofl_ms
         entry->stats->band_stats[i] = (struct ofl_meter_band_stats *) xmalloc(sizeof(struct ofl_meter_band_stats));
         entry->stats->band_stats[i]->byte_band_count = 0;
         entry->stats->band_stats[i]->packet_band_count = 0;
-	    entry->stats->band_stats[i]->last_fill = time_msec();
-	    entry->stats->band_stats[i]->tokens = 0;
     }
+    reset_tokens(entry);
 
     list_init(&entry->flow_refs);
 
@@ -163,26 +171,70 @@ meter_entry_destroy(struct meter_entry *entry) {
     free(entry);
 }
 
-static bool
-consume_tokens(struct ofl_meter_band_stats *band, uint16_t meter_flag, struct packet *pkt){
+/* Returns the number of tokens the bucket of the band can hold. */
+static uint64_t
+band_capacity(struct ofl_meter_band_header *band, uint16_t meter_flag) {
+    uint64_t cap;
 
-    if(meter_flag & OFPMF_KBPS){
-        uint32_t pkt_size = pkt->buffer->size * 8;
-        if (band->tokens >= pkt_size) {
-            band->tokens -= pkt_size;
-            return true;
-        } else {
-            return false;
-        }
+    if (meter_flag & OFPMF_BURST) {
+        return (uint64_t)band->burst_size * METER_TOKENS_PER_UNIT;
+    }
+    cap = (uint64_t)band->rate * (METER_TOKENS_PER_UNIT / 1000) * METER_DEFAULT_BURST_MS;
+    /* Always let a full sized frame through. */
+    if (meter_flag & OFPMF_KBPS) {
+        return MAX(cap, (uint64_t)ETH_TOTAL_MAX * 8 * (METER_TOKENS_PER_UNIT / 1000));
+    }
+    return MAX(cap, METER_TOKENS_PER_UNIT);
+}
 
+/* Adds the tokens accumulated since the last refill of the band. */
+static void
+refill_tokens(struct ofl_meter_band_stats *band, struct ofl_meter_band_header *band_header,
+              uint16_t meter_flag, uint64_t now) {
+    uint64_t cap = band_capacity(band_header, meter_flag);
+    uint64_t elapsed = now - band->last_fill;
+
+    band->last_fill = now;
+    if (band->tokens >= cap || band_header->rate == 0) {
+        band->tokens = MIN(band->tokens, cap);
+        return;
     }
-    else if(meter_flag & OFPMF_PKTPS) {       
-        if (band->tokens >= 1000) {
-            band->tokens -= 1000;
-            return true;
-        } else {
-            return false;
-        }
+    /* Saturate before multiplying, so a long idle period can not overflow. */
+    if (elapsed > (cap - band->tokens) / band_header->rate) {
+        band->tokens = cap;
+    } else {
+        band->tokens += elapsed * band_header->rate;
+    }
+}
+
+/* Fills the token buckets of the meter's bands. */
+static void
+reset_tokens(struct meter_entry *entry) {
+    uint64_t now = time_nsec();
+    size_t i;
+
+    for (i = 0; i < entry->stats->meter_bands_num; i++) {
+        entry->stats->band_stats[i]->last_fill = now;
+        entry->stats->band_stats[i]->tokens =
+                band_capacity(entry->config->bands[i], entry->config->flags);
+    }
+}
+
+static bool
+consume_tokens(struct ofl_meter_band_stats *band, uint16_t meter_flag, struct packet *pkt){
+    uint64_t cost;
+
+    if (meter_flag & OFPMF_KBPS) {
+        cost = (uint64_t)pkt->buffer->size * 8 * (METER_TOKENS_PER_UNIT / 1000);
+    } else if (meter_flag & OFPMF_PKTPS) {
+        cost = METER_TOKENS_PER_UNIT;
+    } else {
+        return false;
+    }
+
+    if (band->tokens >= cost) {
+        band->tokens -= cost;
+        return true;
     }
     return false;
 }
@@ -193,9 +245,11 @@ choose_band(struct meter_entry *entry, struct packet *pkt)
 	size_t i;
 	size_t band_index = -1;
 	uint32_t tmp_rate = 0;
+	uint64_t now = time_nsec();
 	for(i = 0; i < entry->stats->meter_bands_num; i++)
 	{
 		struct ofl_meter_band_header *band_header = entry->config->bands[i];
+		refill_tokens(entry->stats->band_stats[i], band_header, entry->config->flags, now);
 		if(!consume_tokens(entry->stats->band_stats[i], entry->config->flags, pkt) && band_header->rate > tmp_rate)
 		{
 			tmp_rate = band_header->rate;
@@ -229,6 +283,7 @@ meter_entry_apply(struct meter_entry *entry, struct packet **pkt){
     		{
                 struct ofl_meter_band_dscp_remark *band_header = (struct ofl_meter_band_dscp_remark *)  entry->config->bands[b];
                 /* Nothing prevent this band to be used for non-IP packets, so filter them out. Jean II */
+                packet_make_writable(*pkt);
                 if ((*pkt)->handle_std->proto->ipv4 != NULL) {
                     // Fetch dscp in ipv4 header
                     struct ip_header *ipv4 = (*pkt)->handle_std->proto->ipv4;
@@ -313,43 +368,3 @@ meter_entry_del_flow_ref(struct meter_entry *entry, struct flow_entry *fe) {
         }
     }
 }
-
-/* Add tokens to the bucket based on elapsed time. */
-void
-refill_bucket(struct meter_entry *entry)
-{
-	size_t i;
-
-    for(i = 0; i < entry->config->meter_bands_num; i++) {
-    	long long int now = time_msec();
-        uint32_t rate;
-        uint32_t burst_size;
-        uint64_t tokens;
-        rate = entry->config->bands[i]->rate * 1000;
-        burst_size = entry->config->bands[i]->burst_size * 1000;
-        tokens =  (now - entry->stats->band_stats[i]->last_fill) *
-                rate  + entry->stats->band_stats[i]->tokens;
-        entry->stats->band_stats[i]->last_fill = now;
-        if (!(entry->config->flags & OFPMF_BURST)){
-            if(entry->config->flags & OFPMF_KBPS && tokens >= 1){
-		        entry->stats->band_stats[i]->tokens = MIN(tokens, rate);
-            }
-            else{
-                if(tokens >= 1000) {
-                    entry->stats->band_stats[i]->tokens = MIN(tokens, rate);
-                }
-            }
-        }
-        else {
-            if(entry->config->flags & OFPMF_KBPS && tokens >= 1 ){
-                    entry->stats->band_stats[i]->tokens = MIN(tokens,burst_size);
-            }
-            else {
-                if(tokens >= 1000) {
-                    entry->stats->band_stats[i]->tokens = MIN(tokens,burst_size);
-                }
-            }
-        }
-   	}
-}
-
@@ -94,7 +94,5 @@ meter_entry_add_flow_ref(struct meter_entry *entry, struct flow_entry *fe);
 void
 meter_entry_del_flow_ref(struct meter_entry *entry, struct flow_entry *fe);
 
-void
-refill_bucket(struct meter_entry *entry);
 
 #endif /* METER_ENTRY_H */
@@ -330,15 +330,5 @@ meter_table_handle_features_request(struct meter_table *table,
     ofl_msg_free((struct ofl_msg_header *)msg, table->dp->exp);
     return 0;                                                
                                   
-}                                  
-
-void 
-meter_table_add_tokens(struct meter_table *table){
-
-    struct meter_entry *entry;
-    HMAP_FOR_EACH(entry, struct meter_entry, node, &table->meter_entries){
-        refill_bucket(entry);
-    }
-
 }
 
@@ -99,8 +99,6 @@ meter_table_handle_features_request(struct meter_table *table,
                                    struct ofl_msg_multipart_request_header *msg UNUSED,
                                   const struct sender *sender); 
 
-void 
-meter_table_add_tokens(struct meter_table *table);
 
 
 #endif /* METER_TABLE_H */
@@ -80,7 +80,9 @@ packet_clone(struct packet *pkt) {
 
     clone = xmalloc(sizeof(struct packet));
     clone->dp         = pkt->dp;
-    clone->buffer     = ofpbuf_clone(pkt->buffer);
+    /* The clone shares the packet data with the original until either of
+     * them is modified; see packet_make_writable(). */
+    clone->buffer     = ofpbuf_share(pkt->buffer);
     clone->in_port    = pkt->in_port;
     /* There is no case we need to keep the action-set, but if it's needed
      * we could add a parameter to the function... Jean II
@@ -104,6 +106,16 @@ packet_clone(struct packet *pkt) {
     return clone;
 }
 
+void
+packet_make_writable(struct packet *pkt) {
+    if (ofpbuf_is_shared(pkt->buffer)) {
+        uint8_t *old_data = pkt->buffer->data;
+
+        ofpbuf_unshare(pkt->buffer);
+        packet_handle_std_rebase(pkt->handle_std, old_data);
+    }
+}
+
 void
 packet_destroy(struct packet *pkt) {
     /* If packet is saved in a buffer, do not destroy it,
@@ -189,11 +201,6 @@ struct packet * packet_hello_create(struct datapath *dp, uint32_t in_port, bool
 }
 
 
-void packet_hello_send(void)
-{
-	dp_actions_output_port(pkt_hello_propio_aoss, OFPP_FLOOD, pkt_hello_propio_aoss->out_queue, pkt_hello_propio_aoss->out_port_max_len, 0xffffffffffffffff);
-}
-
 struct packet * packet_recovery_create(struct datapath *dp, uint32_t in_port, bool packet_out, struct packet * pkt_original, uint8_t opcion)
 {
 	struct packet *pkt = NULL;
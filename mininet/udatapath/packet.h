@@ -78,17 +78,19 @@ packet_to_string(struct packet *pkt);
 void
 packet_destroy(struct packet *pkt);
 
-/* Clones a packet deeply, i.e. all associated structures are also cloned. */
+/* Clones a packet deeply, i.e. all associated structures are also cloned.
+ * The packet data itself is shared copy-on-write with the original. */
 struct packet *
 packet_clone(struct packet *pkt);
 
-/*Modificacion UAH*/
-struct packet *pkt_hello_propio_aoss;
+/* Makes sure the packet data is not shared with any clone, so that it can be
+ * modified in place. Must be called before writing into the buffer. */
+void
+packet_make_writable(struct packet *pkt);
 
+/*Modificacion UAH*/
 struct packet * packet_hello_create(struct datapath *dp, uint32_t in_port, bool packet_out);
 
-void packet_hello_send(void);
-
 struct packet * packet_recovery_create(struct datapath *dp, uint32_t in_port, bool packet_out, struct packet * pkt_original, uint8_t opcion);
 
 void send_packet_recovery(struct datapath *dp, struct packet * pkt_original, uint8_t opcion);
@@ -29,10 +29,12 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <sys/types.h>
 #include <netinet/in.h>
+#include "dp_stages.h"
 #include "packet_handle_std.h"
 #include "packet.h"
 #include "packets.h"
@@ -52,6 +54,8 @@ packet_handle_std_validate(struct packet_handle_std *handle) {
     struct ofl_match_tlv * iter, *next, *f;
     uint64_t metadata = 0;
     uint64_t tunnel_id = 0;
+    uint64_t start;
+    int parsed;
     if(handle->valid)
         return;
     
@@ -66,13 +70,15 @@ packet_handle_std_validate(struct packet_handle_std *handle) {
     }
 
     HMAP_FOR_EACH_SAFE(iter, next, struct ofl_match_tlv, hmap_node, &handle->match.match_fields){
-        free(iter->value);
-        free(iter);
+        ofl_structs_match_tlv_free(iter);
     }
     ofl_structs_match_init(&handle->match);
 
-    if (nblink_packet_parse(handle->pkt->buffer,&handle->match,
-                            handle->proto) < 0)
+    start = dp_stage_begin();
+    parsed = nblink_packet_parse(handle->pkt->buffer,&handle->match,
+                                 handle->proto);
+    dp_stage_end(DP_STAGE_PARSE, start);
+    if (parsed < 0)
         return;
 
     handle->valid = true;
@@ -100,28 +106,94 @@ packet_handle_std_create(struct packet *pkt) {
 	return handle;
 }
 
+/* Copies the protocol pointers of 'src' to 'dst', moving the ones pointing
+ * into the 'size' bytes of packet data at 'old_data' to the same offset in
+ * 'new_data'. Returns false if any pointer refers to memory outside the
+ * packet data. */
+static bool
+proto_rebase(struct protocols_std *dst, struct protocols_std *src,
+             uint8_t *old_data, size_t size, uint8_t *new_data) {
+    bool inside = true;
+
+#define PROTO_REBASE(FIELD)                                                  \
+    if (src->FIELD != NULL && (uint8_t *)src->FIELD >= old_data              \
+                           && (uint8_t *)src->FIELD < old_data + size) {     \
+        dst->FIELD = (void *)(new_data + ((uint8_t *)src->FIELD - old_data));\
+    } else {                                                                 \
+        dst->FIELD = src->FIELD;                                             \
+        inside = inside && src->FIELD == NULL;                               \
+    }
+
+    PROTO_REBASE(eth);
+    PROTO_REBASE(eth_snap);
+    PROTO_REBASE(vlan);
+    PROTO_REBASE(vlan_last);
+    PROTO_REBASE(mpls);
+    PROTO_REBASE(pbb);
+    PROTO_REBASE(ipv4);
+    PROTO_REBASE(ipv6);
+    PROTO_REBASE(arp);
+    PROTO_REBASE(tcp);
+    PROTO_REBASE(udp);
+    PROTO_REBASE(sctp);
+    PROTO_REBASE(icmp);
+    PROTO_REBASE(path);
+    PROTO_REBASE(arppath);
+    PROTO_REBASE(arppath_repair);
+
+#undef PROTO_REBASE
+    return inside;
+}
+
 struct packet_handle_std *
-packet_handle_std_clone(struct packet *pkt, struct packet_handle_std *handle UNUSED) {
+packet_handle_std_clone(struct packet *pkt, struct packet_handle_std *handle) {
     struct packet_handle_std *clone = xmalloc(sizeof(struct packet_handle_std));
+    struct ofl_match_tlv *f;
 
     clone->pkt = pkt;
     clone->proto = xmalloc(sizeof(struct protocols_std));
     hmap_init(&clone->match.match_fields);
     clone->valid = false;
-    // TODO Zoltan: if handle->valid, then match could be memcpy'd, and protocol
-    //              could be offset
-    packet_handle_std_validate(clone);
+    clone->table_miss = handle->table_miss;
+
+    /* A valid handle does not need to be reparsed: the protocol pointers are
+     * moved to the same offset in the new buffer, and the match is copied. */
+    if (!handle->valid || pkt->buffer->size != handle->pkt->buffer->size ||
+        !proto_rebase(clone->proto, handle->proto, handle->pkt->buffer->data,
+                      handle->pkt->buffer->size, pkt->buffer->data)) {
+        packet_handle_std_validate(clone);
+        return clone;
+    }
+
+    clone->match.header = handle->match.header;
+    HMAP_FOR_EACH(f, struct ofl_match_tlv, hmap_node, &handle->match.match_fields) {
+        struct ofl_match_tlv *m = ofl_structs_match_tlv_new(f->header,
+                                                      OXM_LENGTH(f->header));
+
+        memcpy(m->value, f->value, OXM_LENGTH(f->header));
+        hmap_insert(&clone->match.match_fields, &m->hmap_node, f->hmap_node.hash);
+    }
+    clone->valid = true;
 
     return clone;
 }
 
+void
+packet_handle_std_rebase(struct packet_handle_std *handle, uint8_t *old_data) {
+    uint8_t *new_data = handle->pkt->buffer->data;
+
+    if (old_data != new_data) {
+        proto_rebase(handle->proto, handle->proto, old_data,
+                     handle->pkt->buffer->size, new_data);
+    }
+}
+
 void
 packet_handle_std_destroy(struct packet_handle_std *handle) {
 
     struct ofl_match_tlv * iter, *next;
     HMAP_FOR_EACH_SAFE(iter, next, struct ofl_match_tlv, hmap_node, &handle->match.match_fields){
-        free(iter->value);
-        free(iter);
+        ofl_structs_match_tlv_free(iter);
     }
     free(handle->proto);
     hmap_destroy(&handle->match.match_fields);
@@ -88,6 +88,12 @@ packet_handle_std_print(FILE *stream, struct packet_handle_std *handle);
 struct packet_handle_std *
 packet_handle_std_clone(struct packet *pkt, struct packet_handle_std *handle);
 
+/* Moves the protocol pointers of the handler from the packet data that
+ * started at 'old_data' to the current packet data, e.g. after the buffer
+ * was reallocated. The data size must not have changed. */
+void
+packet_handle_std_rebase(struct packet_handle_std *handle, uint8_t *old_data);
+
 /* Revalidates the handler data */
 void
 packet_handle_std_validate(struct packet_handle_std *handle);
@@ -36,11 +36,15 @@
 #include <stdlib.h>
 
 #include "action_set.h"
+#include "compiled_actions.h"
 #include "compiler.h"
 #include "dp_actions.h"
 #include "dp_buffers.h"
 #include "dp_exp.h"
+#include "dp_pktin.h"
 #include "dp_ports.h"
+#include "dp_stages.h"
+#include "dp_trace.h"
 #include "datapath.h"
 #include "packet.h"
 #include "pipeline.h"
@@ -55,14 +59,7 @@
 #include "vlog.h"
 
 #define PUERTO_ELEFANTE 30000
-#define TCP_PATH 0 //indicamos si queremos tcp path TCP_PATH = 0 -> arppath | TCP_PATH = 1 -> tcpppath | TCP_PATH = 2 tcppath for elefant
 #define PATH_RECOVERY 0
-#define controlador 0
-#define recuperacion 0  //controlador activa el envio al controler y recuperacion activa recuperacion
-#define RECOVERY_DIST 1 //indicamos si queremos recuperacion distribuida
-#define BT_TIME 15
-#define LT_TIME 20
-#define TCP_TIME 10 //tiempo lt y bt
 
 #include <pthread.h>
 pthread_mutex_t pkt_tcp_syn = PTHREAD_MUTEX_INITIALIZER; //necesitamos bloquear el proceso mientras encapsulamos (dup)
@@ -77,6 +74,112 @@ static void
 execute_entry(struct pipeline *pl, struct flow_entry *entry,
               struct flow_table **table, struct packet **pkt);
 
+static void recuperacion_inicio(struct pipeline *pl, uint8_t *puerto_no_disponible, struct timeval * t_ini_recuperacion);
+static void recuperacion_fin(struct pipeline *pl, uint8_t *puerto_no_disponible, struct timeval * t_ini_recuperacion);
+
+/* Operaciones de reenvio. Se eligen una sola vez al cambiar la
+ * configuracion (pipeline_set_uah_config), de forma que el camino de cada
+ * paquete no vuelve a comprobar el modo ni las opciones: cada opcion
+ * desactivada apunta a una funcion que no hace nada. */
+struct uah_ops {
+	void (*forward)(struct pipeline *pl, struct packet *pkt, struct mac_to_port *mac_port,
+			struct mac_to_port *recovery_table, struct table_tcp *tcp_table, int TIME_RECOVERY,
+			uint8_t *puerto_no_disponible, struct timeval * t_ini_recuperacion);
+	/* Indica si un paquete TCP debe ir por TCP-Path. */
+	bool (*tcp_select)(struct packet *pkt);
+	/* Copia para el controlador de una trama ARP-Path, o NULL (controlador). */
+	struct packet *(*notify)(struct packet *pkt);
+	/* Trata las tramas de recuperacion; devuelve true si se queda con el
+	 * paquete (recuperacion). */
+	bool (*recovery_rx)(struct pipeline *pl, struct packet *pkt, struct mac_to_port *mac_port,
+			int TIME_RECOVERY);
+	/* Recupera el camino de una conexion TCP-Path que vuelve por su puerto
+	 * de entrada (recuperacion). */
+	void (*tcp_recover_in)(struct pipeline *pl, struct packet *pkt, struct mac_to_port *mac_port,
+			struct mac_to_port *recovery_table, struct table_tcp *tcp_table, int TIME_RECOVERY,
+			uint8_t *puerto_no_disponible, struct timeval * t_ini_recuperacion);
+	/* Paquete TCP-Path sin puerto de salida vivo; devuelve lo que devuelve
+	 * pipeline_tcp_path (recuperacion). */
+	int (*tcp_lost)(struct pipeline *pl, struct packet *pkt, struct mac_to_port *mac_port,
+			struct table_tcp *tcp_table, struct mac_to_port *recovery_table, int TIME_RECOVERY,
+			int puerto_mac, uint8_t *puerto_no_disponible, struct timeval * t_ini_recuperacion);
+	/* Puerto por el que sale un paquete cuyo puerto no esta vivo (fast_failover). */
+	int (*failover)(struct packet *pkt, struct mac_to_port *mac_port, int out_port);
+	/* Paquete ARP-Path cuyo puerto de salida no esta vivo, o -1 si no se
+	 * conoce (recuperacion). */
+	void (*lost)(struct pipeline *pl, struct packet *pkt, struct mac_to_port *mac_port,
+			struct mac_to_port *recovery_table, int TIME_RECOVERY, int out_port,
+			uint8_t *puerto_no_disponible, struct timeval * t_ini_recuperacion);
+	/* Pide el camino perdido al controlador o a los vecinos (recovery_dist). */
+	void (*recover)(struct pipeline *pl, struct packet *pkt, int out_port);
+};
+
+static void uah_forward_arp_path(struct pipeline *pl, struct packet *pkt, struct mac_to_port *mac_port,
+		struct mac_to_port *recovery_table, struct table_tcp *tcp_table, int TIME_RECOVERY,
+		uint8_t *puerto_no_disponible, struct timeval * t_ini_recuperacion);
+static void uah_forward_tcp_path(struct pipeline *pl, struct packet *pkt, struct mac_to_port *mac_port,
+		struct mac_to_port *recovery_table, struct table_tcp *tcp_table, int TIME_RECOVERY,
+		uint8_t *puerto_no_disponible, struct timeval * t_ini_recuperacion);
+static bool uah_tcp_select_none(struct packet *pkt);
+static bool uah_tcp_select_all(struct packet *pkt);
+static bool uah_tcp_select_elefante(struct packet *pkt);
+static struct packet *uah_notify_ctrl(struct packet *pkt);
+static struct packet *uah_notify_none(struct packet *pkt);
+static bool uah_recovery_rx(struct pipeline *pl, struct packet *pkt, struct mac_to_port *mac_port,
+		int TIME_RECOVERY);
+static bool uah_recovery_rx_none(struct pipeline *pl, struct packet *pkt, struct mac_to_port *mac_port,
+		int TIME_RECOVERY);
+static void uah_tcp_recover_in(struct pipeline *pl, struct packet *pkt, struct mac_to_port *mac_port,
+		struct mac_to_port *recovery_table, struct table_tcp *tcp_table, int TIME_RECOVERY,
+		uint8_t *puerto_no_disponible, struct timeval * t_ini_recuperacion);
+static void uah_tcp_recover_in_none(struct pipeline *pl, struct packet *pkt, struct mac_to_port *mac_port,
+		struct mac_to_port *recovery_table, struct table_tcp *tcp_table, int TIME_RECOVERY,
+		uint8_t *puerto_no_disponible, struct timeval * t_ini_recuperacion);
+static int uah_tcp_lost_recover(struct pipeline *pl, struct packet *pkt, struct mac_to_port *mac_port,
+		struct table_tcp *tcp_table, struct mac_to_port *recovery_table, int TIME_RECOVERY,
+		int puerto_mac, uint8_t *puerto_no_disponible, struct timeval * t_ini_recuperacion);
+static int uah_tcp_lost_none(struct pipeline *pl, struct packet *pkt, struct mac_to_port *mac_port,
+		struct table_tcp *tcp_table, struct mac_to_port *recovery_table, int TIME_RECOVERY,
+		int puerto_mac, uint8_t *puerto_no_disponible, struct timeval * t_ini_recuperacion);
+static int uah_failover_backup(struct packet *pkt, struct mac_to_port *mac_port, int out_port);
+static int uah_failover_none(struct packet *pkt, struct mac_to_port *mac_port, int out_port);
+static void uah_lost_recover(struct pipeline *pl, struct packet *pkt, struct mac_to_port *mac_port,
+		struct mac_to_port *recovery_table, int TIME_RECOVERY, int out_port,
+		uint8_t *puerto_no_disponible, struct timeval * t_ini_recuperacion);
+static void uah_lost_none(struct pipeline *pl, struct packet *pkt, struct mac_to_port *mac_port,
+		struct mac_to_port *recovery_table, int TIME_RECOVERY, int out_port,
+		uint8_t *puerto_no_disponible, struct timeval * t_ini_recuperacion);
+static void uah_recover_ctrl(struct pipeline *pl, struct packet *pkt, int out_port);
+static void uah_recover_dist(struct pipeline *pl, struct packet *pkt, int out_port);
+
+static const struct uah_ops uah_ops_arp_path = {
+	.forward    = uah_forward_arp_path,
+	.tcp_select = uah_tcp_select_none,
+};
+
+static const struct uah_ops uah_ops_tcp_path = {
+	.forward    = uah_forward_tcp_path,
+	.tcp_select = uah_tcp_select_all,
+};
+
+static const struct uah_ops uah_ops_tcp_path_elefante = {
+	.forward    = uah_forward_tcp_path,
+	.tcp_select = uah_tcp_select_elefante,
+};
+
+/* Configuracion de ARP-Path/TCP-Path con la que arranca el datapath. */
+static const struct uah_config uah_config_default = {
+	.mode               = UAH_MODE_ARP_PATH,
+	.controlador        = false,
+	.recuperacion       = false,
+	.recovery_dist      = true,
+	.fast_failover      = true,
+	.medir_recuperacion = false,
+	.bt_time            = 15,
+	.lt_time            = 20,
+	.tcp_time           = 10,
+};
+
 struct pipeline *
 pipeline_create(struct datapath *dp) {
     struct pipeline *pl;
@@ -86,10 +189,72 @@ pipeline_create(struct datapath *dp) {
         pl->tables[i] = flow_table_create(dp, i);
     }
     pl->dp = dp;
+    pl->uah_ops = xmalloc(sizeof(struct uah_ops));
+    pipeline_set_uah_config(pl, &uah_config_default);
     nblink_initialize();
     return pl;
 }
 
+void
+pipeline_set_uah_config(struct pipeline *pl, const struct uah_config *cfg) {
+    struct uah_ops *ops = pl->uah_ops;
+
+    pl->uah = *cfg;
+    switch (cfg->mode) {
+        case UAH_MODE_TCP_PATH:          *ops = uah_ops_tcp_path; break;
+        case UAH_MODE_TCP_PATH_ELEFANTE: *ops = uah_ops_tcp_path_elefante; break;
+        case UAH_MODE_ARP_PATH:
+        default:                         *ops = uah_ops_arp_path; break;
+    }
+    ops->notify         = cfg->controlador   ? uah_notify_ctrl     : uah_notify_none;
+    ops->recovery_rx    = cfg->recuperacion  ? uah_recovery_rx     : uah_recovery_rx_none;
+    ops->tcp_recover_in = cfg->recuperacion  ? uah_tcp_recover_in  : uah_tcp_recover_in_none;
+    ops->tcp_lost       = cfg->recuperacion  ? uah_tcp_lost_recover : uah_tcp_lost_none;
+    ops->failover       = cfg->fast_failover ? uah_failover_backup : uah_failover_none;
+    ops->lost           = cfg->recuperacion  ? uah_lost_recover    : uah_lost_none;
+    ops->recover        = cfg->recovery_dist ? uah_recover_dist    : uah_recover_ctrl;
+}
+
+static bool
+uah_flag(const struct ofl_exp_openflow_msg_set_path_mode *msg, uint16_t flag, bool cur) {
+    return (msg->flags_mask & flag) ? (msg->flags & flag) != 0 : cur;
+}
+
+ofl_err
+pipeline_handle_set_path_mode(struct pipeline *pl, struct ofl_exp_openflow_msg_set_path_mode *msg,
+                              const struct sender *sender) {
+    struct uah_config cfg = pl->uah;
+
+    if (sender->remote->role == OFPCR_ROLE_SLAVE) {
+        return ofl_error(OFPET_BAD_REQUEST, OFPBRC_IS_SLAVE);
+    }
+
+    if (msg->mode != OFP_PATH_MODE_KEEP) {
+        if (msg->mode >= OFP_PATH_MODE_COUNT) {
+            VLOG_WARN_RL(LOG_MODULE, &rl, "Unknown path mode (%u).", msg->mode);
+            return ofl_error(OFPET_BAD_REQUEST, OFPBRC_BAD_EXP_TYPE);
+        }
+        cfg.mode = (enum uah_mode)msg->mode;
+    }
+    cfg.controlador        = uah_flag(msg, OFP_PATH_CTRL_NOTIFY, cfg.controlador);
+    cfg.recuperacion       = uah_flag(msg, OFP_PATH_RECOVERY, cfg.recuperacion);
+    cfg.recovery_dist      = uah_flag(msg, OFP_PATH_RECOVERY_DIST, cfg.recovery_dist);
+    cfg.fast_failover      = uah_flag(msg, OFP_PATH_FAST_FAILOVER, cfg.fast_failover);
+    cfg.medir_recuperacion = uah_flag(msg, OFP_PATH_MEASURE_RECOVERY, cfg.medir_recuperacion);
+    if (msg->bt_time != 0)  { cfg.bt_time  = msg->bt_time; }
+    if (msg->lt_time != 0)  { cfg.lt_time  = msg->lt_time; }
+    if (msg->tcp_time != 0) { cfg.tcp_time = msg->tcp_time; }
+
+    pipeline_set_uah_config(pl, &cfg);
+    VLOG_INFO(LOG_MODULE, "Path mode set to %s (ctrl=%d recovery=%d dist=%d failover=%d measure=%d "
+              "bt=%d lt=%d tcp=%d).", ofl_exp_path_mode_name(cfg.mode), cfg.controlador,
+              cfg.recuperacion, cfg.recovery_dist, cfg.fast_failover, cfg.medir_recuperacion,
+              cfg.bt_time, cfg.lt_time, cfg.tcp_time);
+
+    ofl_msg_free((struct ofl_msg_header *)msg, pl->dp->exp);
+    return 0;
+}
+
 static bool
 is_table_miss(struct flow_entry *entry){
     return ((entry->stats->priority) == 0 && (entry->match->length <= 4));
@@ -101,6 +266,10 @@ send_packet_to_controller(struct pipeline *pl, struct packet *pkt, uint8_t table
 
     struct ofl_msg_packet_in msg;
     struct ofl_match *m;
+
+    if (!dp_pktin_admit(pl->dp->pktin, pkt, reason)) {
+        return;
+    }
     msg.header.type = OFPT_PACKET_IN;
     msg.total_len   = pkt->buffer->size;
     msg.reason      = reason;
@@ -134,6 +303,10 @@ send_packet_to_controller_uah(struct pipeline *pl, struct packet *pkt, uint8_t t
 
     struct ofl_msg_packet_in msg;
     struct ofl_match *m;
+
+    if (!dp_pktin_admit(pl->dp->pktin, pkt, reason)) {
+        return;
+    }
     msg.header.type = OFPT_PACKET_IN;
     msg.total_len   = pkt->buffer->size;
     msg.reason      = reason;
@@ -175,6 +348,7 @@ pipeline_process_packet(struct pipeline *pl, struct packet *pkt) {
     }
 
     if (!packet_handle_std_is_ttl_valid(pkt->handle_std)) {
+        dp_trace_pkt(pl->dp->trace, OFP_EXT_TRACE_DROP, OFP_EXT_TRACE_DROP_INVALID_TTL, pkt, 0, 0);
         send_packet_to_controller(pl, pkt, 0/*table_id*/, OFPR_INVALID_TTL);
         packet_destroy(pkt);
         return;
@@ -183,6 +357,7 @@ pipeline_process_packet(struct pipeline *pl, struct packet *pkt) {
     next_table = pl->tables[0];
     while (next_table != NULL) {
         struct flow_entry *entry;
+        uint64_t start;
 
         VLOG_DBG_RL(LOG_MODULE, &rl, "trying table %u.", next_table->stats->table_id);
 
@@ -196,8 +371,12 @@ pipeline_process_packet(struct pipeline *pl, struct packet *pkt) {
             VLOG_DBG_RL(LOG_MODULE, &rl, "searching table entry for packet match: %s.", m);
             free(m);
         }
+        start = dp_stage_begin();
         entry = flow_table_lookup(table, pkt);
+        dp_stage_end(DP_STAGE_LOOKUP, start);
         if (entry != NULL) {
+            dp_trace_pkt(pl->dp->trace, OFP_EXT_TRACE_LOOKUP, OFP_EXT_TRACE_LOOKUP_HIT, pkt, 0,
+                         table->stats->table_id | (uint32_t)entry->stats->priority << 16);
 	        if (VLOG_IS_DBG_ENABLED(LOG_MODULE)) {
                 char *m = ofl_structs_flow_stats_to_string(entry->stats, pkt->dp->exp);
                 VLOG_DBG_RL(LOG_MODULE, &rl, "found matching entry: %s.", m);
@@ -213,13 +392,17 @@ pipeline_process_packet(struct pipeline *pl, struct packet *pkt) {
                /* Cookie field is set 0xffffffffffffffff
                 because we cannot associate it to any
                 particular flow */
+                start = dp_stage_begin();
                 action_set_execute(pkt->action_set, pkt, 0xffffffffffffffff);
+                dp_stage_end(DP_STAGE_ACTIONS, start);
                 return;
             }
 
         } else {
 			/* OpenFlow 1.3 default behavior on a table miss */
 			VLOG_DBG_RL(LOG_MODULE, &rl, "No matching entry found. Dropping packet.");
+			dp_trace_pkt(pl->dp->trace, OFP_EXT_TRACE_LOOKUP, OFP_EXT_TRACE_LOOKUP_MISS, pkt, 0, table->stats->table_id);
+			dp_trace_pkt(pl->dp->trace, OFP_EXT_TRACE_DROP, OFP_EXT_TRACE_DROP_NO_MATCH, pkt, 0, 0);
 			packet_destroy(pkt);
 			return;
         }
@@ -345,37 +528,122 @@ pipeline_handle_table_mod(struct pipeline *pl,
     return 0;
 }
 
-ofl_err
-pipeline_handle_stats_request_flow(struct pipeline *pl,
-                                   struct ofl_msg_multipart_request_flow *msg,
-                                   const struct sender *sender) {
+/* Flow and aggregate stats are collected incrementally, through the remote's
+ * dump callback, so that large tables neither need to be copied at once nor
+ * hold up packet processing. Each call of the callback visits a bounded number
+ * of entries, and flow stats are sent in replies of bounded size. */
+#define STATS_DUMP_VISITS 4096
+#define STATS_DUMP_BYTES  32768
+
+struct flow_stats_dump {
+    struct pipeline                       *pl;
+    struct ofl_msg_multipart_request_flow *msg;
+    struct sender                          sender;
+    size_t                                 table_id;  /* table being visited. */
+    size_t                                 last_table_id;
+    struct flow_table_cursor               cursor;
+    struct ofl_msg_multipart_reply_aggregate aggregate;
+};
+
+static struct flow_stats_dump *
+flow_stats_dump_create(struct pipeline *pl, struct ofl_msg_multipart_request_flow *msg,
+                       const struct sender *sender) {
+    struct flow_stats_dump *dump = xmalloc(sizeof(struct flow_stats_dump));
+    struct ofl_msg_multipart_reply_aggregate aggregate =
+            {{{.type = OFPT_MULTIPART_REPLY},
+              .type = OFPMP_AGGREGATE, .flags = 0x0000},
+              .packet_count = 0,
+              .byte_count   = 0,
+              .flow_count   = 0};
+
+    dump->pl     = pl;
+    dump->msg    = msg;
+    dump->sender = *sender;
+    if (msg->table_id == 0xff) {
+        dump->table_id      = 0;
+        dump->last_table_id = PIPELINE_TABLES - 1;
+    } else {
+        dump->table_id      = msg->table_id;
+        dump->last_table_id = msg->table_id;
+    }
+    dump->cursor.started = false;
+    dump->aggregate = aggregate;
+    return dump;
+}
 
+static int
+flow_stats_dump(struct datapath *dp, void *dump_) {
+    struct flow_stats_dump *dump = dump_;
     struct ofl_flow_stats **stats = xmalloc(sizeof(struct ofl_flow_stats *));
     size_t stats_size = 1;
     size_t stats_num = 0;
-
-    if (msg->table_id == 0xff) {
-        size_t i;
-        for (i=0; i<PIPELINE_TABLES; i++) {
-            flow_table_stats(pl->tables[i], msg, &stats, &stats_size, &stats_num);
+    bool more;
+
+    dump->cursor.bytes_left  = STATS_DUMP_BYTES;
+    dump->cursor.visits_left = STATS_DUMP_VISITS;
+    for (; dump->table_id <= dump->last_table_id; dump->table_id++) {
+        if (!flow_table_stats(dump->pl->tables[dump->table_id], dump->msg, &dump->cursor,
+                              &stats, &stats_size, &stats_num)) {
+            break;
         }
-    } else {
-        flow_table_stats(pl->tables[msg->table_id], msg, &stats, &stats_size, &stats_num);
+        dump->cursor.started = false;
     }
+    more = dump->table_id <= dump->last_table_id;
 
-    {
+    /* The last reply is sent even if empty, to end the multipart reply. */
+    if (stats_num > 0 || !more) {
         struct ofl_msg_multipart_reply_flow reply =
                 {{{.type = OFPT_MULTIPART_REPLY},
-                  .type = OFPMP_FLOW, .flags = 0x0000},
+                  .type = OFPMP_FLOW, .flags = more ? OFPMPF_REPLY_MORE : 0x0000},
                  .stats     = stats,
                  .stats_num = stats_num
                 };
 
-        dp_send_message(pl->dp, (struct ofl_msg_header *)&reply, sender);
+        dp_send_message(dp, (struct ofl_msg_header *)&reply, &dump->sender);
     }
 
     free(stats);
-    ofl_msg_free((struct ofl_msg_header *)msg, pl->dp->exp);
+    return more ? 1 : 0;
+}
+
+static int
+aggregate_stats_dump(struct datapath *dp, void *dump_) {
+    struct flow_stats_dump *dump = dump_;
+
+    dump->cursor.visits_left = STATS_DUMP_VISITS;
+    for (; dump->table_id <= dump->last_table_id; dump->table_id++) {
+        if (!flow_table_aggregate_stats(dump->pl->tables[dump->table_id], dump->msg, &dump->cursor,
+                                        &dump->aggregate.packet_count, &dump->aggregate.byte_count,
+                                        &dump->aggregate.flow_count)) {
+            return 1;
+        }
+        dump->cursor.started = false;
+    }
+
+    dp_send_message(dp, (struct ofl_msg_header *)&dump->aggregate, &dump->sender);
+    return 0;
+}
+
+static void
+flow_stats_dump_done(void *dump_) {
+    struct flow_stats_dump *dump = dump_;
+
+    ofl_msg_free((struct ofl_msg_header *)dump->msg, dump->pl->dp->exp);
+    free(dump);
+}
+
+ofl_err
+pipeline_handle_stats_request_flow(struct pipeline *pl,
+                                   struct ofl_msg_multipart_request_flow *msg,
+                                   const struct sender *sender) {
+    struct flow_stats_dump *dump;
+
+    if (msg->table_id != 0xff && msg->table_id >= PIPELINE_TABLES) {
+        return ofl_error(OFPET_BAD_REQUEST, OFPBRC_BAD_TABLE_ID);
+    }
+
+    dump = flow_stats_dump_create(pl, msg, sender);
+    remote_start_dump(pl->dp, sender, flow_stats_dump, flow_stats_dump_done, dump);
     return 0;
 }
 
@@ -586,29 +854,14 @@ ofl_err
 pipeline_handle_stats_request_aggregate(struct pipeline *pl,
                                   struct ofl_msg_multipart_request_flow *msg,
                                   const struct sender *sender) {
-    struct ofl_msg_multipart_reply_aggregate reply =
-            {{{.type = OFPT_MULTIPART_REPLY},
-              .type = OFPMP_AGGREGATE, .flags = 0x0000},
-              .packet_count = 0,
-              .byte_count   = 0,
-              .flow_count   = 0};
+    struct flow_stats_dump *dump;
 
-    if (msg->table_id == 0xff) {
-        size_t i;
-
-        for (i=0; i<PIPELINE_TABLES; i++) {
-            flow_table_aggregate_stats(pl->tables[i], msg,
-                                       &reply.packet_count, &reply.byte_count, &reply.flow_count);
-        }
-
-    } else {
-        flow_table_aggregate_stats(pl->tables[msg->table_id], msg,
-                                   &reply.packet_count, &reply.byte_count, &reply.flow_count);
+    if (msg->table_id != 0xff && msg->table_id >= PIPELINE_TABLES) {
+        return ofl_error(OFPET_BAD_REQUEST, OFPBRC_BAD_TABLE_ID);
     }
 
-    dp_send_message(pl->dp, (struct ofl_msg_header *)&reply, sender);
-
-    ofl_msg_free((struct ofl_msg_header *)msg, pl->dp->exp);
+    dump = flow_stats_dump_create(pl, msg, sender);
+    remote_start_dump(pl->dp, sender, aggregate_stats_dump, flow_stats_dump_done, dump);
     return 0;
 }
 
@@ -624,6 +877,7 @@ pipeline_destroy(struct pipeline *pl) {
             flow_table_destroy(table);
         }
     }
+    free(pl->uah_ops);
     free(pl);
 }
 
@@ -637,6 +891,24 @@ pipeline_timeout(struct pipeline *pl) {
     }
 }
 
+void
+pipeline_batch_begin(struct pipeline *pl) {
+    int i;
+
+    for (i = 0; i < PIPELINE_TABLES; i++) {
+        flow_table_batch_begin(pl->tables[i]);
+    }
+}
+
+void
+pipeline_batch_end(struct pipeline *pl) {
+    int i;
+
+    for (i = 0; i < PIPELINE_TABLES; i++) {
+        flow_table_batch_end(pl->tables[i]);
+    }
+}
+
 
 /* Executes the instructions associated with a flow entry */
 static void
@@ -653,12 +925,13 @@ execute_entry(struct pipeline *pl, struct flow_entry *entry,
     */
     size_t i;
     struct ofl_instruction_header *inst;
+    uint64_t start = dp_stage_begin();
 
     for (i=0; i < entry->stats->instructions_num; i++) {
         /*Packet was dropped by some instruction or action*/
 
         if(!(*pkt)){
-            return;
+            break;
         }
 
         inst = entry->stats->instructions[i];
@@ -686,13 +959,12 @@ execute_entry(struct pipeline *pl, struct flow_entry *entry,
                 break;
             }
             case OFPIT_WRITE_ACTIONS: {
-                struct ofl_instruction_actions *wa = (struct ofl_instruction_actions *)inst;
-                action_set_write_actions((*pkt)->action_set, wa->actions_num, wa->actions);
+                struct compiled_actions *ca = &entry->compiled[i];
+                action_set_write_entries((*pkt)->action_set, ca->set_num, ca->set);
                 break;
             }
             case OFPIT_APPLY_ACTIONS: {
-                struct ofl_instruction_actions *ia = (struct ofl_instruction_actions *)inst;
-                dp_execute_action_list((*pkt), ia->actions_num, ia->actions, entry->stats->cookie);
+                compiled_actions_apply(&entry->compiled[i], (*pkt), entry->stats->cookie);
                 break;
             }
             case OFPIT_CLEAR_ACTIONS: {
@@ -710,31 +982,45 @@ execute_entry(struct pipeline *pl, struct flow_entry *entry,
             }
         }
     }
+    dp_stage_end(DP_STAGE_ACTIONS, start);
 }
 
 void pipeline_arp_path(struct pipeline *pl, struct packet *pkt, struct mac_to_port *mac_port,
           struct mac_to_port *recovery_table, int TIME_RECOVERY, uint8_t * puerto_no_disponible, struct timeval * t_ini_recuperacion)
 {
         int puerto_mac = 0;
-        struct packet *pkt_to_contro = NULL;
+        struct packet *pkt_to_contro;
 
-	if (controlador == 1 && (pkt->handle_std->proto->eth->eth_type == 1544 || pkt->handle_std->proto->arppath != NULL)) 
-		pkt_to_contro = packet_clone(pkt);
+	pkt_to_contro = pl->uah_ops->notify(pkt);
 		
         puerto_mac = mac_to_port_found_port(mac_port, pkt->handle_std->proto->eth->eth_src);
         if (eth_addr_is_broadcast(pkt->handle_std->proto->eth->eth_dst) || eth_addr_is_multicast(pkt->handle_std->proto->eth->eth_dst))
         {
 			if (puerto_mac == -1)
-				mac_to_port_add_arp_table(mac_port, pkt->handle_std->proto->eth->eth_src, pkt->in_port, BT_TIME, pkt);
+			{
+				mac_to_port_add_arp_table(mac_port, pkt->handle_std->proto->eth->eth_src, pkt->in_port, pl->uah.bt_time, pkt);
+				dp_trace_pkt(pl->dp->trace, OFP_EXT_TRACE_LEARN, OFP_EXT_TRACE_LEARN_NEW, pkt, pkt->in_port, 0);
+			}
 			else if (puerto_mac == pkt->in_port)
-				mac_to_port_time_refresh(mac_port, pkt->handle_std->proto->eth->eth_src, BT_TIME);
+			{
+				mac_to_port_time_refresh(mac_port, pkt->handle_std->proto->eth->eth_src, pl->uah.bt_time);
+				mac_to_port_new_round(mac_port, pkt->handle_std->proto->eth->eth_src);
+			}
 			else if (mac_to_port_check_timeout(mac_port, pkt->handle_std->proto->eth->eth_src) != 0)
-				mac_to_port_update(mac_port, pkt->handle_std->proto->eth->eth_src, pkt->in_port, BT_TIME);
+			{
+				mac_to_port_update(mac_port, pkt->handle_std->proto->eth->eth_src, pkt->in_port, pl->uah.bt_time);
+				dp_trace_pkt(pl->dp->trace, OFP_EXT_TRACE_LEARN, OFP_EXT_TRACE_LEARN_MOVE, pkt, pkt->in_port, puerto_mac);
+			}
 			else
 			{
+				//copia duplicada por otro camino: candidata a puerto alternativo
+				mac_to_port_add_backup(mac_port, pkt->handle_std->proto->eth->eth_src, pkt->in_port);
+				dp_trace_pkt(pl->dp->trace, OFP_EXT_TRACE_LEARN, OFP_EXT_TRACE_LEARN_BACKUP, pkt, pkt->in_port, puerto_mac);
+				dp_trace_pkt(pl->dp->trace, OFP_EXT_TRACE_DROP, OFP_EXT_TRACE_DROP_DUPLICATE, pkt, 0, 0);
 				packet_destroy(pkt);
 				return;
 			}
+			dp_trace_pkt(pl->dp->trace, OFP_EXT_TRACE_FLOOD, 0, pkt, 0, 0);
 			dp_actions_output_port(pkt, OFPP_RANDOM, pkt->out_queue, pkt->out_port_max_len, 0xffffffffffffffff);
         }
         else 
@@ -744,25 +1030,37 @@ void pipeline_arp_path(struct pipeline *pl, struct packet *pkt, struct mac_to_po
 			if(pkt->handle_std->proto->arp != NULL)
 			{
 				if ((pkt->handle_std->proto->arp->ar_op/256) == 2 && puerto_mac == -1)
-					mac_to_port_add_arp_table(mac_port, pkt->handle_std->proto->eth->eth_src, pkt->in_port, LT_TIME, pkt);
+				{
+					mac_to_port_add_arp_table(mac_port, pkt->handle_std->proto->eth->eth_src, pkt->in_port, pl->uah.lt_time, pkt);
+					dp_trace_pkt(pl->dp->trace, OFP_EXT_TRACE_LEARN, OFP_EXT_TRACE_LEARN_NEW, pkt, pkt->in_port, 0);
+				}
 				else if ((pkt->handle_std->proto->arp->ar_op/256) == 2)
 				{
 					if(mac_to_port_check_timeout(mac_port, pkt->handle_std->proto->eth->eth_src) == 1)
-						mac_to_port_update(mac_port, pkt->handle_std->proto->eth->eth_src, pkt->in_port, LT_TIME);
+					{
+						mac_to_port_update(mac_port, pkt->handle_std->proto->eth->eth_src, pkt->in_port, pl->uah.lt_time);
+						dp_trace_pkt(pl->dp->trace, OFP_EXT_TRACE_LEARN, OFP_EXT_TRACE_LEARN_MOVE, pkt, pkt->in_port, puerto_mac);
+					}
 					else
-						mac_to_port_time_refresh(mac_port, pkt->handle_std->proto->eth->eth_src,LT_TIME); 
+						mac_to_port_time_refresh(mac_port, pkt->handle_std->proto->eth->eth_src,pl->uah.lt_time); 
 				}
 			}
 			else if (pkt->handle_std->proto->arppath != NULL)
 			{
 				if(puerto_mac == -1)
-					mac_to_port_add_arp_table(mac_port, pkt->handle_std->proto->eth->eth_src, pkt->in_port, LT_TIME, pkt);
+				{
+					mac_to_port_add_arp_table(mac_port, pkt->handle_std->proto->eth->eth_src, pkt->in_port, pl->uah.lt_time, pkt);
+					dp_trace_pkt(pl->dp->trace, OFP_EXT_TRACE_LEARN, OFP_EXT_TRACE_LEARN_NEW, pkt, pkt->in_port, 0);
+				}
 				else
 				{
 					if(mac_to_port_check_timeout(mac_port, pkt->handle_std->proto->eth->eth_src) == 1)
-						mac_to_port_update(mac_port, pkt->handle_std->proto->eth->eth_src, pkt->in_port, LT_TIME);
+					{
+						mac_to_port_update(mac_port, pkt->handle_std->proto->eth->eth_src, pkt->in_port, pl->uah.lt_time);
+						dp_trace_pkt(pl->dp->trace, OFP_EXT_TRACE_LEARN, OFP_EXT_TRACE_LEARN_MOVE, pkt, pkt->in_port, puerto_mac);
+					}
 					else
-						mac_to_port_time_refresh(mac_port, pkt->handle_std->proto->eth->eth_src,LT_TIME);
+						mac_to_port_time_refresh(mac_port, pkt->handle_std->proto->eth->eth_src,pl->uah.lt_time);
 				}
 			}
 		}
@@ -781,8 +1079,7 @@ struct mac_to_port *recovery_table, struct table_tcp * tcp_table, uint8_t *puert
 {
 	struct flow_table *table, *next_table;
 	int TIME_RECOVERY = 1;
-	
-	struct timeval t_fin_recuperacion; 
+	uint64_t start;
 	
 	if (VLOG_IS_DBG_ENABLED(LOG_MODULE)) {
         char *pkt_str = packet_to_string(pkt);
@@ -791,6 +1088,7 @@ struct mac_to_port *recovery_table, struct table_tcp * tcp_table, uint8_t *puert
     }
 
     if (!packet_handle_std_is_ttl_valid(pkt->handle_std)) {
+        dp_trace_pkt(pl->dp->trace, OFP_EXT_TRACE_DROP, OFP_EXT_TRACE_DROP_INVALID_TTL, pkt, 0, 0);
         send_packet_to_controller(pl, pkt, 0/*table_id*/, OFPR_INVALID_TTL);
         packet_destroy(pkt);
         return;
@@ -802,22 +1100,12 @@ struct mac_to_port *recovery_table, struct table_tcp * tcp_table, uint8_t *puert
 				mac_to_port_update(&neighbor_table, pkt->handle_std->proto->eth->eth_src, pkt->in_port, TIME_RECOVERY);
 			else
 				mac_to_port_add_hello(&neighbor_table, pkt, pkt->in_port, TIME_RECOVERY);
+			dp_liveness_rx(pl->dp->liveness, pkt);
 			packet_destroy(pkt);
 			return;
 	}
-	if (recuperacion == 1)
-	{
-		if (pkt->handle_std->proto->eth->eth_type == 38775&& mac_to_port_check_timeout(mac_port, pkt->handle_std->proto->eth->eth_src) != 0)
-		{
-			apply_recovery(pl, pkt, mac_port, 1, TIME_RECOVERY);
-			return;
-		}
-		if (pkt->handle_std->proto->eth->eth_type == 39031 && mac_to_port_check_timeout(mac_port, pkt->handle_std->proto->eth->eth_src) != 0)
-		{
-			apply_recovery(pl, pkt, mac_port, 2, TIME_RECOVERY);
-			return;
-		}
-	}
+	if (pl->uah_ops->recovery_rx(pl, pkt, mac_port, TIME_RECOVERY))
+		return;
 	next_table = pl->tables[0];
 	while (next_table != NULL)
 	{
@@ -835,19 +1123,20 @@ struct mac_to_port *recovery_table, struct table_tcp * tcp_table, uint8_t *puert
             VLOG_DBG_RL(LOG_MODULE, &rl, "searching table entry for packet match: %s.", m);
             free(m);
         }
+        start = dp_stage_begin();
         entry = flow_table_lookup(table, pkt);
+        dp_stage_end(DP_STAGE_LOOKUP, start);
         if (entry != NULL) {
+            dp_trace_pkt(pl->dp->trace, OFP_EXT_TRACE_LOOKUP, OFP_EXT_TRACE_LOOKUP_HIT, pkt, 0,
+                         table->stats->table_id | (uint32_t)entry->stats->priority << 16);
 			if (VLOG_IS_DBG_ENABLED(LOG_MODULE)) {
                 char *m = ofl_structs_flow_stats_to_string(entry->stats, pkt->dp->exp);
                 VLOG_DBG_RL(LOG_MODULE, &rl, "found matching entry: %s.", m);
                 free(m);
             }
 			//medimos en el caso de fallo anterior en arppath
-			if (recuperacion == 1 && *(puerto_no_disponible) == 1)
-			{
-				gettimeofday(&t_fin_recuperacion, NULL);
-				*(puerto_no_disponible) = 2;
-			}
+			if (*(puerto_no_disponible) == 1)
+				recuperacion_fin(pl, puerto_no_disponible, t_ini_recuperacion);
 			pkt->handle_std->table_miss = is_table_miss(entry);
 			execute_entry(pl, entry, &next_table, &pkt);
 			/* Packet could be destroyed by a meter instruction */
@@ -857,51 +1146,86 @@ struct mac_to_port *recovery_table, struct table_tcp * tcp_table, uint8_t *puert
                /* Cookie field is set 0xffffffffffffffff
                 because we cannot associate it to any
                 particular flow */
+                start = dp_stage_begin();
                 action_set_execute(pkt->action_set, pkt, 0xffffffffffffffff);
+                dp_stage_end(DP_STAGE_ACTIONS, start);
                 return;
             }
 		}
+		else
+			dp_trace_pkt(pl->dp->trace, OFP_EXT_TRACE_LOOKUP, OFP_EXT_TRACE_LOOKUP_MISS, pkt, 0, table->stats->table_id);
 	}
 	if(pkt->handle_std->proto->eth->eth_type == 56710)
 	{
+		dp_trace_pkt(pl->dp->trace, OFP_EXT_TRACE_DROP, OFP_EXT_TRACE_DROP_FILTERED, pkt, 0, 0);
 		packet_destroy(pkt);
 		return ;
 	}
-	if (TCP_PATH == 0)
-	{
-		pipeline_arp_path(pl, pkt, mac_port, recovery_table, TIME_RECOVERY, puerto_no_disponible, t_ini_recuperacion);
-		return;
-	}
-	else if((pkt->handle_std->proto->tcp != NULL || pkt->handle_std->proto->path != NULL) && TCP_PATH != 0)
+	pl->uah_ops->forward(pl, pkt, mac_port, recovery_table, tcp_table, TIME_RECOVERY,
+			puerto_no_disponible, t_ini_recuperacion);
+}
+
+/* Camino rapido del modo ARP-Path: todo el trafico se reenvia por ARP-Path. */
+static void
+uah_forward_arp_path(struct pipeline *pl, struct packet *pkt, struct mac_to_port *mac_port,
+		struct mac_to_port *recovery_table, struct table_tcp *tcp_table UNUSED, int TIME_RECOVERY,
+		uint8_t *puerto_no_disponible, struct timeval * t_ini_recuperacion)
+{
+	uint64_t start;
+
+	start = dp_stage_begin();
+	pipeline_arp_path(pl, pkt, mac_port, recovery_table, TIME_RECOVERY, puerto_no_disponible, t_ini_recuperacion);
+	dp_stage_end(DP_STAGE_ARP_PATH, start);
+}
+
+/* Camino de los modos TCP-Path: los paquetes TCP y PATH pasan por TCP-Path y
+ * el resto (o lo que TCP-Path no resuelve) cae en ARP-Path. */
+static void
+uah_forward_tcp_path(struct pipeline *pl, struct packet *pkt, struct mac_to_port *mac_port,
+		struct mac_to_port *recovery_table, struct table_tcp *tcp_table, int TIME_RECOVERY,
+		uint8_t *puerto_no_disponible, struct timeval * t_ini_recuperacion)
+{
+	uint64_t start;
+	int ret;
+
+	if(pkt->handle_std->proto->tcp != NULL || pkt->handle_std->proto->path != NULL)
 	{	
-		if (recuperacion == 1)
-		{
-			if(pkt->handle_std->proto->tcp != NULL)
-			{
-				if(table_tcp_found_port(tcp_table, pkt->handle_std->proto->eth->eth_dst,
-						pkt->handle_std->proto->eth->eth_src, pkt->handle_std->proto->tcp->tcp_dst,
-						pkt->handle_std->proto->tcp->tcp_src) == pkt->in_port)
-				{
-					recovery_tcp_path(pl, pkt, mac_port, tcp_table, recovery_table,TIME_RECOVERY,
-						pkt->in_port, puerto_no_disponible, t_ini_recuperacion);
-				}
-			}
-			if(pkt->handle_std->proto->path != NULL)
-			{
-				if(table_tcp_found_port(tcp_table, pkt->handle_std->proto->eth->eth_dst,
-						pkt->handle_std->proto->eth->eth_src, pkt->handle_std->proto->path->tcp_dst,
-						pkt->handle_std->proto->path->tcp_src) == pkt->in_port)
-				{
-					recovery_tcp_path(pl, pkt, mac_port, tcp_table, recovery_table,TIME_RECOVERY,
-						pkt->in_port, puerto_no_disponible, t_ini_recuperacion);
-				}
-			}
-		}
-		if(pipeline_tcp_path(pl, pkt, mac_port, tcp_table, recovery_table,TIME_RECOVERY, puerto_no_disponible, t_ini_recuperacion) != 2)
+		pl->uah_ops->tcp_recover_in(pl, pkt, mac_port, recovery_table, tcp_table, TIME_RECOVERY,
+				puerto_no_disponible, t_ini_recuperacion);
+		start = dp_stage_begin();
+		ret = pipeline_tcp_path(pl, pkt, mac_port, tcp_table, recovery_table,TIME_RECOVERY, puerto_no_disponible, t_ini_recuperacion);
+		dp_stage_end(DP_STAGE_TCP_PATH, start);
+		if (ret != 2)
 			return;
 	}
-	pipeline_arp_path(pl, pkt, mac_port, recovery_table, TIME_RECOVERY, puerto_no_disponible, t_ini_recuperacion);
-	return;
+	uah_forward_arp_path(pl, pkt, mac_port, recovery_table, tcp_table, TIME_RECOVERY,
+			puerto_no_disponible, t_ini_recuperacion);
+}
+
+/* Seleccion del trafico TCP que usa TCP-Path en cada modo. */
+static bool
+uah_tcp_select_none(struct packet *pkt UNUSED)
+{
+	return false;
+}
+
+static bool
+uah_tcp_select_all(struct packet *pkt UNUSED)
+{
+	return true;
+}
+
+/* Solo los flujos elefante: ToS marcado o puertos por encima de PUERTO_ELEFANTE. */
+static bool
+uah_tcp_select_elefante(struct packet *pkt)
+{
+	if (pkt->handle_std->proto->ipv4->ip_tos != 0x00)
+		return true;
+	if(TCP_FLAGS(pkt->handle_std->proto->tcp->tcp_ctl) == (TCP_SYN + TCP_ACK))
+		return Found_date_in_pkt(32,OFPXMT_OFB_TCP_SRC, pkt) > PUERTO_ELEFANTE;
+	if(TCP_FLAGS(pkt->handle_std->proto->tcp->tcp_ctl) == TCP_SYN)
+		return Found_date_in_pkt(33,OFPXMT_OFB_TCP_DST, pkt) > PUERTO_ELEFANTE;
+	return false;
 }
 
 int pipeline_tcp_path(struct pipeline *pl, struct packet *pkt, struct mac_to_port *mac_port,
@@ -914,34 +1238,14 @@ int pipeline_tcp_path(struct pipeline *pl, struct packet *pkt, struct mac_to_por
 	
     if(pkt->handle_std->proto->tcp != NULL)
     {
-		if (TCP_PATH == 1)
-			entrar_tcp = 1;
-		else if (TCP_PATH == 2) 
-		{
-			if (pkt->handle_std->proto->ipv4->ip_tos != 0x00)
-				entrar_tcp = 1; 
-			else if(TCP_FLAGS(pkt->handle_std->proto->tcp->tcp_ctl) == (TCP_SYN + TCP_ACK))
-			{
-				if (Found_date_in_pkt(32,OFPXMT_OFB_TCP_SRC, pkt) > PUERTO_ELEFANTE)
-					entrar_tcp = 1; 
-			}
-			else if(TCP_FLAGS(pkt->handle_std->proto->tcp->tcp_ctl) == TCP_SYN)
-			{
-				if (Found_date_in_pkt(33,OFPXMT_OFB_TCP_DST, pkt) > PUERTO_ELEFANTE)
-					entrar_tcp = 1; 
-			}
-			else
-				entrar_tcp = 0; 
-		}
-		else
-			entrar_tcp = 0;
+		entrar_tcp = pl->uah_ops->tcp_select(pkt);
 		
 		if (entrar_tcp == 1)
 		{	
 			if (TCP_FLAGS(pkt->handle_std->proto->tcp->tcp_ctl) == (TCP_SYN + TCP_ACK))
 			{
 				puerto_mac = table_tcp_update_port(tcp_table, pkt->handle_std->proto->eth->eth_src, pkt->handle_std->proto->eth->eth_dst,
-					pkt->handle_std->proto->tcp->tcp_src, pkt->handle_std->proto->tcp->tcp_dst, pkt->in_port, TCP_TIME);
+					pkt->handle_std->proto->tcp->tcp_src, pkt->handle_std->proto->tcp->tcp_dst, pkt->in_port, pl->uah.tcp_time);
 			}
 			else if(TCP_FLAGS(pkt->handle_std->proto->tcp->tcp_ctl) == TCP_SYN)
 			{
@@ -949,20 +1253,34 @@ int pipeline_tcp_path(struct pipeline *pl, struct packet *pkt, struct mac_to_por
 						pkt->handle_std->proto->eth->eth_dst, pkt->handle_std->proto->tcp->tcp_src,
 						pkt->handle_std->proto->tcp->tcp_dst);
 				if(puerto_mac == -1)
+				{
 					table_tcp_add(tcp_table, pkt->handle_std->proto->eth->eth_src, pkt->handle_std->proto->eth->eth_dst,
-						pkt->handle_std->proto->tcp->tcp_src, pkt->handle_std->proto->tcp->tcp_dst, pkt->in_port, TCP_TIME);
+						pkt->handle_std->proto->tcp->tcp_src, pkt->handle_std->proto->tcp->tcp_dst, pkt->in_port, pl->uah.tcp_time);
+					dp_trace_pkt(pl->dp->trace, OFP_EXT_TRACE_LEARN, OFP_EXT_TRACE_LEARN_TCP_NEW, pkt, pkt->in_port, 0);
+				}
 				else if (puerto_mac == pkt->in_port)
+				{
 					table_tcp_update_time(tcp_table, pkt->handle_std->proto->eth->eth_src, pkt->handle_std->proto->eth->eth_dst,
-						pkt->handle_std->proto->tcp->tcp_src, pkt->handle_std->proto->tcp->tcp_dst, TCP_TIME);
+						pkt->handle_std->proto->tcp->tcp_src, pkt->handle_std->proto->tcp->tcp_dst, pl->uah.tcp_time);
+					table_tcp_new_round(tcp_table, pkt->handle_std->proto->eth->eth_src, pkt->handle_std->proto->eth->eth_dst,
+						pkt->handle_std->proto->tcp->tcp_src, pkt->handle_std->proto->tcp->tcp_dst);
+				}
 				else
 				{
+					table_tcp_add_backup(tcp_table, pkt->handle_std->proto->eth->eth_src, pkt->handle_std->proto->eth->eth_dst,
+						pkt->handle_std->proto->tcp->tcp_src, pkt->handle_std->proto->tcp->tcp_dst, pkt->in_port);
+					dp_trace_pkt(pl->dp->trace, OFP_EXT_TRACE_LEARN, OFP_EXT_TRACE_LEARN_TCP_BACKUP, pkt, pkt->in_port, puerto_mac);
+					dp_trace_pkt(pl->dp->trace, OFP_EXT_TRACE_DROP, OFP_EXT_TRACE_DROP_DUPLICATE, pkt, 0, 0);
 					if(pkt != NULL)
 						packet_destroy(pkt); 
 					return 0; 
 				}
 					
 				if (dst_is_neighbor(pkt, mac_port) == 0)
+				{
 					encapsulate_path_request_tcp(pkt);
+					dp_trace_pkt(pl->dp->trace, OFP_EXT_TRACE_PATH_OUT, 0, pkt, 0, 0);
+				}
 				else
 					puerto_mac = mac_to_port_found_port(mac_port, pkt->handle_std->proto->eth->eth_dst);
 			} 		
@@ -975,6 +1293,7 @@ int pipeline_tcp_path(struct pipeline *pl, struct packet *pkt, struct mac_to_por
     }
     else if(pkt->handle_std->proto->path != NULL)
     {
+		dp_trace_pkt(pl->dp->trace, OFP_EXT_TRACE_PATH_IN, pkt->handle_std->proto->path->op, pkt, 0, 0);
 		memcpy(Mac_dst, ofpbuf_at(pkt->buffer, (pkt->buffer->size - ETH_ADDR_LEN - sizeof(uint16_t) - sizeof(uint32_t) - sizeof(uint8_t)), ETH_ADDR_LEN),ETH_ADDR_LEN);
 		puerto_mac = table_tcp_found_port_in(tcp_table, pkt->handle_std->proto->eth->eth_src, Mac_dst, pkt->handle_std->proto->path->tcp_src, pkt->handle_std->proto->path->tcp_dst);
 		if(puerto_mac == -1 || puerto_mac == pkt->in_port)
@@ -982,31 +1301,43 @@ int pipeline_tcp_path(struct pipeline *pl, struct packet *pkt, struct mac_to_por
 			if(dst_is_neighbor(pkt, mac_port) == 0)
 			{
 				if (puerto_mac == -1)
+				{
 					table_tcp_add(tcp_table, pkt->handle_std->proto->eth->eth_src, Mac_dst,
-						pkt->handle_std->proto->path->tcp_src, pkt->handle_std->proto->path->tcp_dst, pkt->in_port, TCP_TIME);
+						pkt->handle_std->proto->path->tcp_src, pkt->handle_std->proto->path->tcp_dst, pkt->in_port, pl->uah.tcp_time);
+					dp_trace_pkt(pl->dp->trace, OFP_EXT_TRACE_LEARN, OFP_EXT_TRACE_LEARN_TCP_NEW, pkt, pkt->in_port, 0);
+				}
 				else
+				{
 					table_tcp_update_time(tcp_table, pkt->handle_std->proto->eth->eth_src, Mac_dst,
-						pkt->handle_std->proto->path->tcp_src, pkt->handle_std->proto->path->tcp_dst, TCP_TIME);
+						pkt->handle_std->proto->path->tcp_src, pkt->handle_std->proto->path->tcp_dst, pl->uah.tcp_time);
+					table_tcp_new_round(tcp_table, pkt->handle_std->proto->eth->eth_src, Mac_dst,
+						pkt->handle_std->proto->path->tcp_src, pkt->handle_std->proto->path->tcp_dst);
+				}
 				switch_track_tcp(pkt);
 			}
 			else 
 			{
-				if (select_packet_tcp_path(pkt, tcp_table, puerto_mac, TCP_TIME) == -1)
+				if (select_packet_tcp_path(pkt, tcp_table, puerto_mac, pl->uah.tcp_time) == -1)
 					return 0; 
 				puerto_mac = mac_to_port_found_port(mac_port, pkt->handle_std->proto->eth->eth_dst);
 			}
 		}
 		else
 		{
+			table_tcp_add_backup(tcp_table, pkt->handle_std->proto->eth->eth_src, Mac_dst,
+				pkt->handle_std->proto->path->tcp_src, pkt->handle_std->proto->path->tcp_dst, pkt->in_port);
+			dp_trace_pkt(pl->dp->trace, OFP_EXT_TRACE_LEARN, OFP_EXT_TRACE_LEARN_TCP_BACKUP, pkt, pkt->in_port, puerto_mac);
+			dp_trace_pkt(pl->dp->trace, OFP_EXT_TRACE_DROP, OFP_EXT_TRACE_DROP_DUPLICATE, pkt, 0, 0);
 			if(pkt != NULL)
 				packet_destroy(pkt); 
 			return 0; 
 		}
     }
-    mac_to_port_time_refresh(mac_port, pkt->handle_std->proto->eth->eth_src,LT_TIME);
+    mac_to_port_time_refresh(mac_port, pkt->handle_std->proto->eth->eth_src,pl->uah.lt_time);
     	
     if (eth_addr_is_broadcast(pkt->handle_std->proto->eth->eth_dst) || eth_addr_is_multicast(pkt->handle_std->proto->eth->eth_dst))
     {
+		dp_trace_pkt(pl->dp->trace, OFP_EXT_TRACE_FLOOD, 0, pkt, 0, 0);
 		dp_actions_output_port(pkt, OFPP_RANDOM, pkt->out_queue, pkt->out_port_max_len, 0xffffffffffffffff);
 		if (pkt != NULL)
 			packet_destroy(pkt); 
@@ -1016,18 +1347,14 @@ int pipeline_tcp_path(struct pipeline *pl, struct packet *pkt, struct mac_to_por
 		if(pkt->handle_std->proto->tcp != NULL)
 			table_tcp_update_time(tcp_table, pkt->handle_std->proto->eth->eth_dst,
 				pkt->handle_std->proto->eth->eth_src, pkt->handle_std->proto->tcp->tcp_dst,
-				pkt->handle_std->proto->tcp->tcp_src, TCP_TIME);
+				pkt->handle_std->proto->tcp->tcp_src, pl->uah.tcp_time);
 		dp_actions_output_port(pkt, puerto_mac, pkt->out_queue, pkt->out_port_max_len, 0xffffffffffffffff);
 		if (pkt != NULL)
 			packet_destroy(pkt);
     }
-    else if ( recuperacion == 1 )
-    {
-		recovery_tcp_path(pl, pkt, mac_port, tcp_table, recovery_table, TIME_RECOVERY, puerto_mac, puerto_no_disponible, t_ini_recuperacion);
-		if (pkt != NULL)
-			packet_destroy(pkt); 
-		return 0; 
-    }
+    else
+		return pl->uah_ops->tcp_lost(pl, pkt, mac_port, tcp_table, recovery_table, TIME_RECOVERY,
+				puerto_mac, puerto_no_disponible, t_ini_recuperacion);
     return 1;
 }
 
@@ -1041,7 +1368,7 @@ int recovery_tcp_path(struct pipeline * pl, struct packet * pkt,struct mac_to_po
 		desencapsulate_path_request_tcp(pkt,pkt->handle_std->proto->path->op);
 	port_src = pkt->handle_std->proto->tcp->tcp_src;
 	out_port = mac_to_port_found_port(mac_port, pkt->handle_std->proto->eth->eth_dst);
-	if(out_port != -1 && (pkt->dp->ports[out_port].conf->state == OFPPS_LIVE || recuperacion == 0) && puerto_mac != out_port)
+	if(out_port != -1 && pkt->dp->ports[out_port].conf->state == OFPPS_LIVE && puerto_mac != out_port)
 		arp_path_send_unicast(pl, pkt, mac_port, recovery_table, TIME_RECOVERY, out_port, puerto_no_disponible, t_ini_recuperacion);
 	else
 	{
@@ -1051,7 +1378,7 @@ int recovery_tcp_path(struct pipeline * pl, struct packet * pkt,struct mac_to_po
 		{
 			out_port = table_tcp_found_port(tcp_table, pkt->handle_std->proto->eth->eth_src,
 					pkt->handle_std->proto->eth->eth_dst, port_src, port_dst);
-			if(out_port != -1 && (pl->dp->ports[out_port].conf->state == OFPPS_LIVE || recuperacion == 0))
+			if(out_port != -1 && pl->dp->ports[out_port].conf->state == OFPPS_LIVE)
 			{
 				dp_actions_output_port(pkt, out_port, pkt->out_queue, pkt->out_port_max_len, 0xffffffffffffffff);
 				if (pkt != NULL)
@@ -1061,62 +1388,236 @@ int recovery_tcp_path(struct pipeline * pl, struct packet * pkt,struct mac_to_po
 	}
 	return 1;
 }
+static void recuperacion_inicio(struct pipeline *pl, uint8_t *puerto_no_disponible, struct timeval * t_ini_recuperacion)
+{
+	dp_trace_port(pl->dp->trace, OFP_EXT_TRACE_RECOVERY, OFP_EXT_TRACE_RECOVERY_START, 0, 0, 0);
+	gettimeofday(t_ini_recuperacion, NULL);
+	*(puerto_no_disponible) = 1;
+}
+
+/* Termina la medida del tiempo de recuperacion. En modo MEDIR_RECUPERACION se
+ * registra y se vuelve a medir la siguiente caida. */
+static void recuperacion_fin(struct pipeline *pl, uint8_t *puerto_no_disponible, struct timeval * t_ini_recuperacion)
+{
+	struct timeval t_fin_recuperacion;
+
+	gettimeofday(&t_fin_recuperacion, NULL);
+	dp_trace_port(pl->dp->trace, OFP_EXT_TRACE_RECOVERY, OFP_EXT_TRACE_RECOVERY_DONE, 0, 0,
+			timeval_diff_uah(&t_fin_recuperacion, t_ini_recuperacion));
+	if (pl->uah.medir_recuperacion)
+	{
+		VLOG_INFO(LOG_MODULE, "recuperacion completada en %.3f ms",
+				timeval_diff_uah(&t_fin_recuperacion, t_ini_recuperacion) / 1000);
+		*(puerto_no_disponible) = 0;
+	}
+	else
+		*(puerto_no_disponible) = 2;
+}
+
+/* Envia 'pkt' por 'out_port', que esta vivo o no hay recuperacion. */
+static void
+arp_path_output(struct pipeline *pl, struct packet *pkt, struct mac_to_port *mac_port, int out_port,
+		uint8_t *puerto_no_disponible, struct timeval * t_ini_recuperacion)
+{
+	if ((*puerto_no_disponible) == 1)
+		recuperacion_fin(pl, puerto_no_disponible, t_ini_recuperacion);
+	mac_to_port_time_refresh(mac_port, pkt->handle_std->proto->eth->eth_dst,pl->uah.lt_time);
+	dp_actions_output_port(pkt,out_port,pkt->out_queue, pkt->out_port_max_len, 0xffffffffffffffff);
+}
+
 int arp_path_send_unicast(struct pipeline * pl, struct packet * pkt, struct mac_to_port * mac_port,
         struct mac_to_port * recovery_table, int TIME_RECOVERY, int out_port, uint8_t * puerto_no_disponible, struct timeval * t_ini_recuperacion)
 {
-	struct timeval t_fin_recuperacion;
+	if (out_port != -1 && pkt->dp->ports[out_port].conf->state != OFPPS_LIVE)
+		out_port = pl->uah_ops->failover(pkt, mac_port, out_port);
+	if (out_port != -1 && pkt->dp->ports[out_port].conf->state == OFPPS_LIVE)
+		arp_path_output(pl, pkt, mac_port, out_port, puerto_no_disponible, t_ini_recuperacion);
+	else
+		pl->uah_ops->lost(pl, pkt, mac_port, recovery_table, TIME_RECOVERY, out_port,
+				puerto_no_disponible, t_ini_recuperacion);
+	return 0;
+}
 
-	if (out_port != -1)
+/* Funciones de las opciones de reenvio; ver struct uah_ops. */
+
+static struct packet *
+uah_notify_ctrl(struct packet *pkt)
+{
+	if (pkt->handle_std->proto->eth->eth_type == 1544 || pkt->handle_std->proto->arppath != NULL)
+		return packet_clone(pkt);
+	return NULL;
+}
+
+static struct packet *
+uah_notify_none(struct packet *pkt UNUSED)
+{
+	return NULL;
+}
+
+static bool
+uah_recovery_rx(struct pipeline *pl, struct packet *pkt, struct mac_to_port *mac_port, int TIME_RECOVERY)
+{
+	if (pkt->handle_std->proto->eth->eth_type == 38775&& mac_to_port_check_timeout(mac_port, pkt->handle_std->proto->eth->eth_src) != 0)
 	{
-		if(recuperacion == 0 || pkt->dp->ports[out_port].conf->state == OFPPS_LIVE)
-		{
-			if (recuperacion == 1 && (*puerto_no_disponible) == 1)
-			{
-				gettimeofday(&t_fin_recuperacion, NULL);
-				*(puerto_no_disponible) = 2;
-			}
-			mac_to_port_time_refresh(mac_port, pkt->handle_std->proto->eth->eth_dst,LT_TIME);
-			dp_actions_output_port(pkt,out_port,pkt->out_queue, pkt->out_port_max_len, 0xffffffffffffffff);
-		}
-		else if (recuperacion == 1)
-		{
- 			if (*(puerto_no_disponible) == 0)
-			{
-				gettimeofday(t_ini_recuperacion, NULL);
-				*(puerto_no_disponible) = 1;
-			}
-			if( mac_to_port_check_timeout(recovery_table, pkt->handle_std->proto->eth->eth_dst) != 0)
-			{
-				mac_to_port_add(recovery_table, pkt->handle_std->proto->eth->eth_dst, pkt->in_port, TIME_RECOVERY);
-				mac_to_port_delete_port(mac_port, out_port);
-				if (RECOVERY_DIST == 0) 
-					send_packet_to_controller_uah(pl, pkt, 0, OFPR_NO_MATCH);
-				else
-					send_packet_recovery(pl->dp, pkt, 1); 
-			} 
-		}
+		dp_trace_pkt(pl->dp->trace, OFP_EXT_TRACE_RECOVERY, OFP_EXT_TRACE_RECOVERY_RX, pkt, 0, 1);
+		apply_recovery(pl, pkt, mac_port, 1, TIME_RECOVERY);
+		return true;
 	}
-	else if(recuperacion == 1)
+	if (pkt->handle_std->proto->eth->eth_type == 39031 && mac_to_port_check_timeout(mac_port, pkt->handle_std->proto->eth->eth_src) != 0)
+	{
+		dp_trace_pkt(pl->dp->trace, OFP_EXT_TRACE_RECOVERY, OFP_EXT_TRACE_RECOVERY_RX, pkt, 0, 2);
+		apply_recovery(pl, pkt, mac_port, 2, TIME_RECOVERY);
+		return true;
+	}
+	return false;
+}
+
+static bool
+uah_recovery_rx_none(struct pipeline *pl UNUSED, struct packet *pkt UNUSED,
+		struct mac_to_port *mac_port UNUSED, int TIME_RECOVERY UNUSED)
+{
+	return false;
+}
+
+static void
+uah_tcp_recover_in(struct pipeline *pl, struct packet *pkt, struct mac_to_port *mac_port,
+		struct mac_to_port *recovery_table, struct table_tcp *tcp_table, int TIME_RECOVERY,
+		uint8_t *puerto_no_disponible, struct timeval * t_ini_recuperacion)
+{
+	if(pkt->handle_std->proto->tcp != NULL)
 	{
- 		if (*(puerto_no_disponible) == 0)
+		if(table_tcp_found_port(tcp_table, pkt->handle_std->proto->eth->eth_dst,
+				pkt->handle_std->proto->eth->eth_src, pkt->handle_std->proto->tcp->tcp_dst,
+				pkt->handle_std->proto->tcp->tcp_src) == pkt->in_port)
 		{
-			gettimeofday(t_ini_recuperacion, NULL);
-			*(puerto_no_disponible) = 1; 
+			recovery_tcp_path(pl, pkt, mac_port, tcp_table, recovery_table,TIME_RECOVERY,
+				pkt->in_port, puerto_no_disponible, t_ini_recuperacion);
 		}
-		if(mac_to_port_check_timeout(recovery_table, pkt->handle_std->proto->eth->eth_dst) != 0)
+	}
+	if(pkt->handle_std->proto->path != NULL)
+	{
+		if(table_tcp_found_port(tcp_table, pkt->handle_std->proto->eth->eth_dst,
+				pkt->handle_std->proto->eth->eth_src, pkt->handle_std->proto->path->tcp_dst,
+				pkt->handle_std->proto->path->tcp_src) == pkt->in_port)
 		{
-			mac_to_port_add(recovery_table, pkt->handle_std->proto->eth->eth_dst, pkt->in_port, TIME_RECOVERY);
-			if (RECOVERY_DIST == 0) 
-				send_packet_to_controller_uah(pl, pkt, 0, OFPR_NO_MATCH);
-			else
-				send_packet_recovery(pl->dp, pkt, 1);
+			recovery_tcp_path(pl, pkt, mac_port, tcp_table, recovery_table,TIME_RECOVERY,
+				pkt->in_port, puerto_no_disponible, t_ini_recuperacion);
 		}
 	}
-	return 0;
+}
+
+static void
+uah_tcp_recover_in_none(struct pipeline *pl UNUSED, struct packet *pkt UNUSED,
+		struct mac_to_port *mac_port UNUSED, struct mac_to_port *recovery_table UNUSED,
+		struct table_tcp *tcp_table UNUSED, int TIME_RECOVERY UNUSED,
+		uint8_t *puerto_no_disponible UNUSED, struct timeval * t_ini_recuperacion UNUSED)
+{
+}
+
+static int
+uah_tcp_lost_recover(struct pipeline *pl, struct packet *pkt, struct mac_to_port *mac_port,
+		struct table_tcp *tcp_table, struct mac_to_port *recovery_table, int TIME_RECOVERY,
+		int puerto_mac, uint8_t *puerto_no_disponible, struct timeval * t_ini_recuperacion)
+{
+	recovery_tcp_path(pl, pkt, mac_port, tcp_table, recovery_table, TIME_RECOVERY, puerto_mac, puerto_no_disponible, t_ini_recuperacion);
+	if (pkt != NULL)
+		packet_destroy(pkt); 
+	return 0; 
+}
+
+static int
+uah_tcp_lost_none(struct pipeline *pl UNUSED, struct packet *pkt UNUSED,
+		struct mac_to_port *mac_port UNUSED, struct table_tcp *tcp_table UNUSED,
+		struct mac_to_port *recovery_table UNUSED, int TIME_RECOVERY UNUSED, int puerto_mac UNUSED,
+		uint8_t *puerto_no_disponible UNUSED, struct timeval * t_ini_recuperacion UNUSED)
+{
+	return 1;
+}
+
+static int
+uah_failover_backup(struct packet *pkt, struct mac_to_port *mac_port, int out_port)
+{
+	int backup = mac_to_port_failover(mac_port, pkt->dp, pkt->handle_std->proto->eth->eth_dst);
+
+	return backup != -1 ? backup : out_port;
+}
+
+static int
+uah_failover_none(struct packet *pkt UNUSED, struct mac_to_port *mac_port UNUSED, int out_port)
+{
+	return out_port;
+}
+
+/* Arranca la recuperacion del camino hacia el destino de 'pkt'. */
+static void
+uah_lost_recover(struct pipeline *pl, struct packet *pkt, struct mac_to_port *mac_port,
+		struct mac_to_port *recovery_table, int TIME_RECOVERY, int out_port,
+		uint8_t *puerto_no_disponible, struct timeval * t_ini_recuperacion)
+{
+	if (*(puerto_no_disponible) == 0)
+		recuperacion_inicio(pl, puerto_no_disponible, t_ini_recuperacion);
+	if (mac_to_port_check_timeout(recovery_table, pkt->handle_std->proto->eth->eth_dst) != 0)
+	{
+		mac_to_port_add(recovery_table, pkt->handle_std->proto->eth->eth_dst, pkt->in_port, TIME_RECOVERY);
+		if (out_port != -1)
+			mac_to_port_delete_port(mac_port, out_port);
+		pl->uah_ops->recover(pl, pkt, out_port != -1 ? out_port : 0);
+	}
+}
+
+/* Sin recuperacion se envia igualmente por el puerto aprendido. */
+static void
+uah_lost_none(struct pipeline *pl, struct packet *pkt, struct mac_to_port *mac_port,
+		struct mac_to_port *recovery_table UNUSED, int TIME_RECOVERY UNUSED, int out_port,
+		uint8_t *puerto_no_disponible, struct timeval * t_ini_recuperacion)
+{
+	if (out_port != -1)
+		arp_path_output(pl, pkt, mac_port, out_port, puerto_no_disponible, t_ini_recuperacion);
+	else
+		dp_trace_pkt(pl->dp->trace, OFP_EXT_TRACE_DROP, OFP_EXT_TRACE_DROP_NO_ROUTE, pkt, 0, 0);
+}
+
+static void
+uah_recover_ctrl(struct pipeline *pl, struct packet *pkt, int out_port)
+{
+	dp_trace_pkt(pl->dp->trace, OFP_EXT_TRACE_RECOVERY, OFP_EXT_TRACE_RECOVERY_CTRL, pkt, out_port, 0);
+	send_packet_to_controller_uah(pl, pkt, 0, OFPR_NO_MATCH);
+}
+
+static void
+uah_recover_dist(struct pipeline *pl, struct packet *pkt, int out_port)
+{
+	dp_trace_pkt(pl->dp->trace, OFP_EXT_TRACE_RECOVERY, OFP_EXT_TRACE_RECOVERY_DIST, pkt, out_port, 0);
+	send_packet_recovery(pl->dp, pkt, 1);
+}
+
+/* Llamada por dp_ports cuando el kernel notifica la caida de un puerto. Las
+ * entradas que tienen puerto alternativo vivo pasan a el en el momento; con la
+ * recuperacion activa se arranca el tiempo de recuperacion y se olvidan las
+ * demas macs aprendidas por ese puerto, igual que al enviar por un puerto no
+ * vivo. */
+void pipeline_port_down(struct pipeline *pl, uint32_t port_no, struct mac_to_port *mac_port,
+		struct table_tcp * tcp_table, uint8_t *puerto_no_disponible, struct timeval * t_ini_recuperacion)
+{
+	if ((pl->uah.recuperacion || pl->uah.medir_recuperacion) && *(puerto_no_disponible) == 0)
+		recuperacion_inicio(pl, puerto_no_disponible, t_ini_recuperacion);
+	if (pl->uah.fast_failover)
+	{
+		int macs = mac_to_port_failover_port(mac_port, pl->dp, port_no);
+		int conexiones = table_tcp_failover_port(tcp_table, pl->dp, port_no);
+		dp_trace_port(pl->dp->trace, OFP_EXT_TRACE_RECOVERY, OFP_EXT_TRACE_RECOVERY_PORT_DOWN, 0, port_no,
+				macs + conexiones);
+		if (macs > 0 || conexiones > 0)
+			VLOG_INFO(LOG_MODULE, "puerto %u caido: %d macs y %d conexiones tcp pasan a su puerto alternativo",
+					port_no, macs, conexiones);
+	}
+	if (pl->uah.recuperacion)
+		mac_to_port_delete_port(mac_port, port_no);
 }
 
 int send_macs_to_ctr(struct pipeline *pl, struct packet *pkt)
 {
+	packet_make_writable(pkt);
 	pkt->handle_std->proto->eth->eth_type = 30360;
 	if (is_neighbor(pkt) != 1)
 		return -1; 
@@ -1140,9 +1641,13 @@ int apply_recovery (struct pipeline * pl, struct packet * pkt, struct mac_to_por
 	{
 		int puerto_mac = mac_to_port_found_port(mac_port, pkt->handle_std->proto->eth->eth_src);
 		if (puerto_mac == -1)
+		{
 			mac_to_port_add_arp_table(mac_port, pkt->handle_std->proto->eth->eth_src, pkt->in_port, TIME_RECOVERY, pkt);
+			dp_trace_pkt(pl->dp->trace, OFP_EXT_TRACE_LEARN, OFP_EXT_TRACE_LEARN_NEW, pkt, pkt->in_port, 0);
+		}
 		else
 		{
+			dp_trace_pkt(pl->dp->trace, OFP_EXT_TRACE_LEARN, OFP_EXT_TRACE_LEARN_MOVE, pkt, pkt->in_port, puerto_mac);
 			puerto_mac = mac_to_port_update(mac_port, pkt->handle_std->proto->eth->eth_src, pkt->in_port, TIME_RECOVERY);
 			if (puerto_mac == 1)
 			{
@@ -1150,6 +1655,7 @@ int apply_recovery (struct pipeline * pl, struct packet * pkt, struct mac_to_por
 				return 0;
 			}
 		}
+		dp_trace_pkt(pl->dp->trace, OFP_EXT_TRACE_FLOOD, 0, pkt, 0, 0);
 		dp_actions_output_port(pkt, OFPP_RANDOM, pkt->out_queue, pkt->out_port_max_len, 0xffffffffffffffff);
 		if(pkt)
 			packet_destroy(pkt);
@@ -1157,7 +1663,10 @@ int apply_recovery (struct pipeline * pl, struct packet * pkt, struct mac_to_por
 	else
 	{
 		if(dst_is_neighbor(pkt, mac_port) == 0)
+		{
+			dp_trace_pkt(pl->dp->trace, OFP_EXT_TRACE_FLOOD, 0, pkt, 0, 0);
 			dp_actions_output_port(pkt, OFPP_RANDOM, pkt->out_queue, pkt->out_port_max_len, 0xffffffffffffffff);
+		}
 		else
 			send_packet_recovery(pl->dp, pkt, 2);
 		if(pkt)
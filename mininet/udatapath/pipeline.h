@@ -37,6 +37,8 @@
 #include "flow_table.h"
 #include "oflib/ofl.h"
 #include "oflib/ofl-messages.h"
+#include "oflib-exp/ofl-exp-openflow.h"
+#include "openflow/openflow-ext.h"
 
 #include <time.h>
 #include <sys/time.h>
@@ -48,10 +50,35 @@ struct sender;
  * including the execution of instructions.
  ****************************************************************************/
 
+/* Modos de reenvio de los paquetes que no casan con ninguna entrada. */
+enum uah_mode {
+    UAH_MODE_ARP_PATH          = OFP_PATH_MODE_ARP,         /* todo por ARP-Path */
+    UAH_MODE_TCP_PATH          = OFP_PATH_MODE_TCP,         /* conexiones tcp por TCP-Path */
+    UAH_MODE_TCP_PATH_ELEFANTE = OFP_PATH_MODE_TCP_ELEPHANT /* solo las conexiones elefante */
+};
+
+/* Configuracion de ARP-Path/TCP-Path, elegida al arrancar (opciones de
+ * ofdatapath) o con el mensaje OFP_EXT_SET_PATH_MODE. */
+struct uah_config {
+    enum uah_mode  mode;
+    bool           controlador;        /* copia al controlador las tramas ARP-Path */
+    bool           recuperacion;       /* recupera los caminos al caer un enlace */
+    bool           recovery_dist;      /* recuperacion distribuida, no por el controlador */
+    bool           fast_failover;      /* pasa al puerto alternativo al caer un puerto */
+    bool           medir_recuperacion; /* registra el tiempo de cada recuperacion */
+    int            bt_time;            /* tiempo de bloqueo (s) */
+    int            lt_time;            /* tiempo de aprendizaje (s) */
+    int            tcp_time;           /* tiempo de las entradas de TCP-Path (s) */
+};
+
+struct uah_ops;
+
 /* A pipeline structure */
 struct pipeline {
-    struct datapath    *dp;
-    struct flow_table  *tables[PIPELINE_TABLES];
+    struct datapath       *dp;
+    struct flow_table     *tables[PIPELINE_TABLES];
+    struct uah_config      uah;
+    struct uah_ops        *uah_ops;   /* funciones elegidas segun uah. */
 };
 
 
@@ -104,10 +131,28 @@ pipeline_handle_stats_request_aggregate(struct pipeline *pl,
 void
 pipeline_timeout(struct pipeline *pl);
 
+/* Batches the flow mods handled until pipeline_batch_end(), so that the
+ * new entries are ordered into the tables once. */
+void
+pipeline_batch_begin(struct pipeline *pl);
+
+void
+pipeline_batch_end(struct pipeline *pl);
+
 /* Detroys the pipeline. */
 void
 pipeline_destroy(struct pipeline *pl);
 
+/* Cambia la configuracion de ARP-Path/TCP-Path y las funciones del modo. */
+void
+pipeline_set_uah_config(struct pipeline *pl, const struct uah_config *cfg);
+
+/* Handles an OFP_EXT_SET_PATH_MODE message. */
+ofl_err
+pipeline_handle_set_path_mode(struct pipeline *pl,
+                              struct ofl_exp_openflow_msg_set_path_mode *msg,
+                              const struct sender *sender);
+
 //vecinos globales para asi poder pasar y seleccionar envios
 extern struct mac_to_port neighbor_table;
 
@@ -130,6 +175,9 @@ int recovery_tcp_path(struct pipeline *pl, struct packet * pkt, struct mac_to_po
 //send frames unicast method ARP PATH
 int arp_path_send_unicast(struct pipeline * pl, struct packet * pkt, struct mac_to_port * mac_port,
         struct mac_to_port * recovery_table, int TIME_RECOVERY, int out_port, uint8_t *puerto_no_disponible, struct timeval * t_ini_recuperacion);
+//aviso de caida de enlace de un puerto: fast failover y arranque de la recuperacion sin esperar trafico
+void pipeline_port_down(struct pipeline *pl, uint32_t port_no, struct mac_to_port *mac_port,
+		struct table_tcp * tcp_table, uint8_t *puerto_no_disponible, struct timeval * t_ini_recuperacion);
 //obtener direfencias de tiempo		
 double timeval_diff_uah(struct timeval *a, struct timeval *b);
 //reenvia los paquetes de recuperacion distribuida
@@ -0,0 +1,165 @@
+/* Copyright (c) 2011, TrafficLab, Ericsson Research, Hungary
+ * Copyright (c) 2012, CPqD, Brazil 
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Ericsson Research nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "list.h"
+#include "timer_wheel.h"
+#include "util.h"
+
+#define SLOT_MASK  (TIMER_WHEEL_SLOTS - 1)
+
+/* Number of ticks covered by the levels below 'level'. */
+#define LEVEL_SPAN(level) (1ULL << ((level) * TIMER_WHEEL_BITS))
+
+/* Largest distance, in ticks, a timer can be placed at. */
+#define MAX_DELTA (LEVEL_SPAN(TIMER_WHEEL_LEVELS) - 1)
+
+static inline uint64_t
+msec_to_tick(uint64_t msec) {
+    return msec / TIMER_WHEEL_TICK_MS;
+}
+
+/* Links the timer into the slot of the level matching its distance from the
+ * current tick. */
+static void
+place(struct timer_wheel *wheel, struct timer_wheel_timer *timer) {
+    /* Round up, so a timer never fires before its expiration time. */
+    uint64_t tick = msec_to_tick(timer->expires + TIMER_WHEEL_TICK_MS - 1);
+    uint64_t delta;
+    size_t level;
+
+    if (tick <= wheel->tick) {
+        tick = wheel->tick + 1;
+    }
+    delta = tick - wheel->tick;
+    if (delta > MAX_DELTA) {
+        /* Parked in the last level; it is re-placed when cascaded. */
+        delta = MAX_DELTA;
+        tick = wheel->tick + delta;
+    }
+
+    for (level = 0; level < TIMER_WHEEL_LEVELS - 1; level++) {
+        if (delta < LEVEL_SPAN(level + 1)) {
+            break;
+        }
+    }
+    list_push_back(&wheel->slots[level][(tick >> (level * TIMER_WHEEL_BITS)) & SLOT_MASK],
+                   &timer->node);
+}
+
+/* Re-places the timers of the given slot into the lower levels. Returns the
+ * index of the slot. */
+static size_t
+cascade(struct timer_wheel *wheel, size_t level) {
+    size_t idx = (wheel->tick >> (level * TIMER_WHEEL_BITS)) & SLOT_MASK;
+    struct list *slot = &wheel->slots[level][idx];
+
+    while (!list_is_empty(slot)) {
+        struct timer_wheel_timer *timer;
+
+        timer = CONTAINER_OF(list_pop_front(slot), struct timer_wheel_timer, node);
+        place(wheel, timer);
+    }
+    return idx;
+}
+
+void
+timer_wheel_init(struct timer_wheel *wheel, uint64_t now) {
+    size_t i, j;
+
+    wheel->tick = msec_to_tick(now);
+    wheel->n_timers = 0;
+    for (i = 0; i < TIMER_WHEEL_LEVELS; i++) {
+        for (j = 0; j < TIMER_WHEEL_SLOTS; j++) {
+            list_init(&wheel->slots[i][j]);
+        }
+    }
+}
+
+void
+timer_wheel_timer_init(struct timer_wheel_timer *timer) {
+    list_init(&timer->node);
+    timer->expires = 0;
+}
+
+bool
+timer_wheel_timer_is_armed(const struct timer_wheel_timer *timer) {
+    return !list_is_empty(&timer->node);
+}
+
+void
+timer_wheel_add(struct timer_wheel *wheel, struct timer_wheel_timer *timer,
+                uint64_t expires) {
+    timer->expires = expires;
+    place(wheel, timer);
+    wheel->n_timers++;
+}
+
+void
+timer_wheel_cancel(struct timer_wheel *wheel, struct timer_wheel_timer *timer) {
+    if (timer_wheel_timer_is_armed(timer)) {
+        list_remove(&timer->node);
+        list_init(&timer->node);
+        wheel->n_timers--;
+    }
+}
+
+void
+timer_wheel_advance(struct timer_wheel *wheel, uint64_t now,
+                    struct list *expired) {
+    uint64_t target = msec_to_tick(now);
+
+    if (wheel->n_timers == 0 && target > wheel->tick) {
+        /* Nothing to expire; skip the idle ticks. */
+        wheel->tick = target;
+        return;
+    }
+
+    while (wheel->tick < target) {
+        struct list *slot;
+        size_t level;
+
+        wheel->tick++;
+        /* When a level wraps around, the next slot of the level above is
+         * distributed among the levels below. */
+        for (level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+            if ((wheel->tick & (LEVEL_SPAN(level) - 1)) != 0 ||
+                cascade(wheel, level) != 0) {
+                break;
+            }
+        }
+
+        slot = &wheel->slots[0][wheel->tick & SLOT_MASK];
+        if (!list_is_empty(slot)) {
+            list_splice(expired, list_front(slot), slot);
+        }
+    }
+}
@@ -0,0 +1,92 @@
+/* Copyright (c) 2011, TrafficLab, Ericsson Research, Hungary
+ * Copyright (c) 2012, CPqD, Brazil 
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Ericsson Research nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H 1
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "list.h"
+
+/****************************************************************************
+ * Hierarchical timing wheel. Timers are inserted in O(1) into a slot chosen
+ * by their distance from the current time, and advancing the wheel only
+ * touches the slots that are due, so sweeping costs O(expired) instead of
+ * O(timers). The wheel does not call back; expired timers are handed to
+ * the caller in a list.
+ ****************************************************************************/
+
+#define TIMER_WHEEL_TICK_MS  10   /* Resolution of the wheel. */
+#define TIMER_WHEEL_BITS     6
+#define TIMER_WHEEL_SLOTS    (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_LEVELS   4    /* 64^4 ticks of 10ms: about 1.9 days. */
+
+struct timer_wheel_timer {
+    struct list   node;     /* Slot or expired list node. */
+    uint64_t      expires;  /* Expiration time, in msec. */
+};
+
+struct timer_wheel {
+    uint64_t      tick;     /* Last processed tick. */
+    size_t        n_timers; /* Number of armed timers. */
+    struct list   slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+};
+
+/* Initializes the wheel with the current time, in msec. */
+void
+timer_wheel_init(struct timer_wheel *wheel, uint64_t now);
+
+/* Initializes a timer as not armed. */
+void
+timer_wheel_timer_init(struct timer_wheel_timer *timer);
+
+/* Returns true if the timer is armed. */
+bool
+timer_wheel_timer_is_armed(const struct timer_wheel_timer *timer);
+
+/* Arms the timer to expire at 'expires' msec. The timer must not be armed.
+ * Timers in the past expire on the next advance. */
+void
+timer_wheel_add(struct timer_wheel *wheel, struct timer_wheel_timer *timer,
+                uint64_t expires);
+
+/* Disarms the timer, if it is armed. */
+void
+timer_wheel_cancel(struct timer_wheel *wheel, struct timer_wheel_timer *timer);
+
+/* Advances the wheel to 'now' msec, and moves all the timers that expired
+ * in the meantime to the 'expired' list. The timers stay armed until the
+ * caller takes them off 'expired' with timer_wheel_cancel(); after that they
+ * may be re-armed. */
+void
+timer_wheel_advance(struct timer_wheel *wheel, uint64_t now,
+                    struct list *expired);
+
+#endif /* TIMER_WHEEL_H */
@@ -49,6 +49,9 @@
 #include "command-line.h"
 #include "daemon.h"
 #include "datapath.h"
+#include "dp_buffers.h"
+#include "dp_stages.h"
+#include "pipeline.h"
 #include "fault.h"
 #include "openflow/openflow.h"
 #include "poll-loop.h"
@@ -71,7 +74,6 @@
 #include <time.h>
 #include <sys/time.h>
 
-#define TIME_SEND 10
 #define TIME_ARP 10
 #define TIME_DELETE_NEIGHBOR 10 
 #define TIME_RECOVERY 2
@@ -81,6 +83,9 @@ int udatapath_cmd(int argc, char *argv[]);
 
 static void parse_options(struct datapath *dp, int argc, char *argv[]);
 static void usage(void) NO_RETURN;
+static int parse_path_time(const char *arg, const char *option);
+static void parse_rate(const char *arg, const char *option,
+                       unsigned int *rate, unsigned int *burst);
 
 static struct datapath *dp;
 
@@ -125,7 +130,7 @@ udatapath_cmd(int argc, char *argv[])
     int error;
     int i;
 
-    uint64_t sendtime = 0, arptime=0, tcptime=0;
+    uint64_t arptime=0, tcptime=0;
 
 	
 	uint8_t puerto_no_disponible = 0;
@@ -159,7 +164,7 @@ udatapath_cmd(int argc, char *argv[])
         OFP_FATAL(0, "when using multiple connections, you must specify an even number of listeners");
         
     n_listeners = 0;
-    for (i = optind; i < argc; i += 2) {
+    for (i = optind; i < argc; i += use_multiple_connections ? 2 : 1) {
         const char *pvconn_name = argv[i];
         const char *pvconn_name_aux = NULL;
         struct pvconn *pvconn, *pvconn_aux = NULL;
@@ -205,9 +210,9 @@ udatapath_cmd(int argc, char *argv[])
 
     die_if_already_running();
     daemonize();
+    vlog_start_writer();
 
 	matriz_aleatoria_gen();
-	pkt_hello_propio_aoss = packet_hello_create(dp, 0, 1);
 	arptime=time_msec();
 	tcptime=time_msec();
 	
@@ -215,11 +220,6 @@ udatapath_cmd(int argc, char *argv[])
 		dp_run(dp,&mac_port, &recovery_table, &tcp_table, &puerto_no_disponible, &t_ini_recuperacion);
 		dp_wait(dp);
 		poll_block();
-		if(time_msec() - sendtime > TIME_SEND*1000)
-		{
-			packet_hello_send();
-			sendtime = time_msec();
-		}
 		if(time_msec() - arptime > TIME_ARP*1000)
 		{
 			arptime = time_msec();
@@ -265,7 +265,28 @@ parse_options(struct datapath *dp, int argc, char *argv[])
         OPT_SERIAL_NUM,
         OPT_BOOTSTRAP_CA_CERT,
         OPT_NO_LOCAL_PORT,
-        OPT_NO_SLICING
+        OPT_NO_SLICING,
+        OPT_BUFFERS,
+        OPT_RX_BUDGET,
+        OPT_MSG_BUDGET,
+        OPT_PKTIN_RATE,
+        OPT_PKTIN_PORT_RATE,
+        OPT_PKTIN_DUP_WINDOW,
+        OPT_AUX_CONNS,
+        OPT_HELLO_INTERVAL,
+        OPT_HELLO_MULT,
+        OPT_STAGE_TIMERS,
+        OPT_TRACE,
+        OPT_TRACE_FILE,
+        OPT_PATH_MODE,
+        OPT_CTRL_NOTIFY,
+        OPT_RECOVERY,
+        OPT_NO_FAST_FAILOVER,
+        OPT_MEASURE_RECOVERY,
+        OPT_BT_TIME,
+        OPT_LT_TIME,
+        OPT_TCP_TIME,
+        VLOG_OPTION_ENUMS
     };
 
     static struct option long_options[] = {
@@ -274,10 +295,30 @@ parse_options(struct datapath *dp, int argc, char *argv[])
         {"no-local-port", no_argument, 0, OPT_NO_LOCAL_PORT},
         {"datapath-id", required_argument, 0, 'd'},
         {"multiconn",     no_argument, 0, 'm'},
-        {"verbose",     optional_argument, 0, 'v'},
+        {"aux-conns",   required_argument, 0, OPT_AUX_CONNS},
+        VLOG_LONG_OPTIONS,
         {"help",        no_argument, 0, 'h'},
         {"version",     no_argument, 0, 'V'},
         {"no-slicing",  no_argument, 0, OPT_NO_SLICING},
+        {"buffers",     required_argument, 0, OPT_BUFFERS},
+        {"rx-budget",   required_argument, 0, OPT_RX_BUDGET},
+        {"msg-budget",  required_argument, 0, OPT_MSG_BUDGET},
+        {"pktin-rate",  required_argument, 0, OPT_PKTIN_RATE},
+        {"pktin-port-rate", required_argument, 0, OPT_PKTIN_PORT_RATE},
+        {"pktin-dup-window", required_argument, 0, OPT_PKTIN_DUP_WINDOW},
+        {"hello-interval", required_argument, 0, OPT_HELLO_INTERVAL},
+        {"hello-mult",  required_argument, 0, OPT_HELLO_MULT},
+        {"stage-timers", no_argument, 0, OPT_STAGE_TIMERS},
+        {"trace",       optional_argument, 0, OPT_TRACE},
+        {"trace-file",  required_argument, 0, OPT_TRACE_FILE},
+        {"path-mode",   required_argument, 0, OPT_PATH_MODE},
+        {"ctrl-notify", no_argument, 0, OPT_CTRL_NOTIFY},
+        {"recovery",    required_argument, 0, OPT_RECOVERY},
+        {"no-fast-failover", no_argument, 0, OPT_NO_FAST_FAILOVER},
+        {"measure-recovery", no_argument, 0, OPT_MEASURE_RECOVERY},
+        {"bt-time",     required_argument, 0, OPT_BT_TIME},
+        {"lt-time",     required_argument, 0, OPT_LT_TIME},
+        {"tcp-time",    required_argument, 0, OPT_TCP_TIME},
         {"mfr-desc",    required_argument, 0, OPT_MFR_DESC},
         {"hw-desc",     required_argument, 0, OPT_HW_DESC},
         {"sw-desc",     required_argument, 0, OPT_SW_DESC},
@@ -291,6 +332,9 @@ parse_options(struct datapath *dp, int argc, char *argv[])
         {0, 0, 0, 0},
     };
     char *short_options = long_options_to_short_options(long_options);
+    unsigned int hello_interval = DP_LIVENESS_INTERVAL_DEFAULT;
+    unsigned int hello_mult = DP_LIVENESS_MULT_DEFAULT;
+    struct uah_config uah = dp->pipeline->uah;
 
     for (;;) {
         int indexptr;
@@ -322,6 +366,16 @@ parse_options(struct datapath *dp, int argc, char *argv[])
             use_multiple_connections = true;
             break;
         }
+
+        case OPT_AUX_CONNS: {
+            int n = atoi(optarg);
+            if (n < 1 || n > REMOTE_MAX_AUX) {
+                ofp_fatal(0, "argument to --aux-conns must be between "
+                          "1 and %d", REMOTE_MAX_AUX);
+            }
+            dp_set_max_aux(dp, n);
+            break;
+        }
         
         case 'h':
             usage();
@@ -331,9 +385,7 @@ parse_options(struct datapath *dp, int argc, char *argv[])
                    program_name, VERSION BUILDNR);
             exit(EXIT_SUCCESS);
 
-        case 'v':
-            vlog_set_verbosity(optarg);
-            break;
+        VLOG_OPTION_HANDLERS
 
         case 'i':
             if (!port_list) {
@@ -375,6 +427,156 @@ parse_options(struct datapath *dp, int argc, char *argv[])
             dp_set_max_queues(dp, 0);
             break;
 
+        case OPT_BUFFERS: {
+            int n = atoi(optarg);
+            if (n < 2 || n > 65536) {
+                ofp_fatal(0, "argument to --buffers must be between "
+                          "2 and 65536");
+            }
+            dp_set_buffers_num(dp, n);
+            break;
+        }
+
+        case OPT_RX_BUDGET: {
+            int n = atoi(optarg);
+            if (n < 1 || n > 65536) {
+                ofp_fatal(0, "argument to --rx-budget must be between "
+                          "1 and 65536");
+            }
+            dp_set_budgets(dp, n, dp->sched.msg_budget);
+            break;
+        }
+
+        case OPT_MSG_BUDGET: {
+            int n = atoi(optarg);
+            if (n < 1 || n > 65536) {
+                ofp_fatal(0, "argument to --msg-budget must be between "
+                          "1 and 65536");
+            }
+            dp_set_budgets(dp, dp->sched.rx_budget, n);
+            break;
+        }
+
+        case OPT_PKTIN_RATE:
+        case OPT_PKTIN_PORT_RATE: {
+            unsigned int rate, burst;
+
+            parse_rate(optarg, c == OPT_PKTIN_RATE ? "--pktin-rate"
+                                                   : "--pktin-port-rate",
+                       &rate, &burst);
+            if (c == OPT_PKTIN_RATE) {
+                dp_pktin_set_reason_rate(dp->pktin, rate, burst);
+            } else {
+                dp_pktin_set_port_rate(dp->pktin, rate, burst);
+            }
+            break;
+        }
+
+        case OPT_PKTIN_DUP_WINDOW: {
+            int msec = atoi(optarg);
+            if (msec < 0 || msec > 60000) {
+                ofp_fatal(0, "argument to --pktin-dup-window must be between "
+                          "0 and 60000");
+            }
+            dp_pktin_set_dup_window(dp->pktin, msec);
+            break;
+        }
+
+        case OPT_HELLO_INTERVAL: {
+            int msec = atoi(optarg);
+            if (msec < 0 || msec > 60000) {
+                ofp_fatal(0, "argument to --hello-interval must be between "
+                          "0 and 60000");
+            }
+            hello_interval = msec;
+            break;
+        }
+
+        case OPT_HELLO_MULT: {
+            int n = atoi(optarg);
+            if (n < 1 || n > 255) {
+                ofp_fatal(0, "argument to --hello-mult must be between "
+                          "1 and 255");
+            }
+            hello_mult = n;
+            break;
+        }
+
+        case OPT_STAGE_TIMERS:
+            if (!dp_stages_set_enabled(true)) {
+                ofp_fatal(0, "--stage-timers requires a build configured "
+                          "with --enable-stage-timers");
+            }
+            break;
+
+        case OPT_TRACE:
+            if (optarg) {
+                int n = atoi(optarg);
+                if (n < 1 || n > DP_TRACE_SIZE_MAX) {
+                    ofp_fatal(0, "argument to --trace must be between 1 and %d",
+                              DP_TRACE_SIZE_MAX);
+                }
+                dp_trace_set_size(dp->trace, n);
+            }
+            dp_trace_set_enabled(dp->trace, true);
+            break;
+
+        case OPT_TRACE_FILE:
+            dp_trace_set_file(dp->trace, optarg);
+            break;
+
+        case OPT_PATH_MODE:
+            if (!strcmp(optarg, "arp")) {
+                uah.mode = UAH_MODE_ARP_PATH;
+            } else if (!strcmp(optarg, "tcp")) {
+                uah.mode = UAH_MODE_TCP_PATH;
+            } else if (!strcmp(optarg, "elephant")) {
+                uah.mode = UAH_MODE_TCP_PATH_ELEFANTE;
+            } else {
+                ofp_fatal(0, "argument to --path-mode must be arp, tcp "
+                          "or elephant");
+            }
+            break;
+
+        case OPT_CTRL_NOTIFY:
+            uah.controlador = true;
+            break;
+
+        case OPT_RECOVERY:
+            if (!strcmp(optarg, "off")) {
+                uah.recuperacion = false;
+            } else if (!strcmp(optarg, "dist")) {
+                uah.recuperacion = true;
+                uah.recovery_dist = true;
+            } else if (!strcmp(optarg, "ctrl")) {
+                uah.recuperacion = true;
+                uah.recovery_dist = false;
+            } else {
+                ofp_fatal(0, "argument to --recovery must be off, dist "
+                          "or ctrl");
+            }
+            break;
+
+        case OPT_NO_FAST_FAILOVER:
+            uah.fast_failover = false;
+            break;
+
+        case OPT_MEASURE_RECOVERY:
+            uah.medir_recuperacion = true;
+            break;
+
+        case OPT_BT_TIME:
+            uah.bt_time = parse_path_time(optarg, "--bt-time");
+            break;
+
+        case OPT_LT_TIME:
+            uah.lt_time = parse_path_time(optarg, "--lt-time");
+            break;
+
+        case OPT_TCP_TIME:
+            uah.tcp_time = parse_path_time(optarg, "--tcp-time");
+            break;
+
         DAEMON_OPTION_HANDLERS
 
 #ifdef HAVE_OPENSSL
@@ -393,6 +595,36 @@ parse_options(struct datapath *dp, int argc, char *argv[])
         }
     }
     free(short_options);
+    dp_liveness_set(dp->liveness, hello_interval, hello_mult);
+    pipeline_set_uah_config(dp->pipeline, &uah);
+}
+
+/* Parses a path timer of 'option' in seconds. */
+static int
+parse_path_time(const char *arg, const char *option)
+{
+    int sec = atoi(arg);
+    if (sec < 1 || sec > UINT16_MAX) {
+        ofp_fatal(0, "argument to %s must be between 1 and %d", option,
+                  UINT16_MAX);
+    }
+    return sec;
+}
+
+/* Parses RATE[/BURST] for 'option'. BURST defaults to RATE. */
+static void
+parse_rate(const char *arg, const char *option, unsigned int *rate,
+           unsigned int *burst)
+{
+    int n = sscanf(arg, "%u/%u", rate, burst);
+
+    if (n < 1 || *rate > 1000000) {
+        ofp_fatal(0, "argument to %s must be RATE[/BURST], with RATE between "
+                  "0 and 1000000", option);
+    }
+    if (n < 2 || *burst == 0) {
+        *burst = *rate;
+    }
 }
 
 static void
@@ -407,21 +639,70 @@ usage(void)
     printf("\nConfiguration options:\n"
            "  -i, --interfaces=NETDEV[,NETDEV]...\n"
            "                          add specified initial switch ports\n"
+           "                          (pcap:FILE[:RATE[:LOOPS]] replays a capture\n"
+           "                          file, pcap-sink:[FILE] writes one)\n"
            "  -L, --local-port=NETDEV set network device for local port\n"
            "  --no-local-port         disable local port\n"
            "  -d, --datapath-id=ID    Use ID as the OpenFlow switch ID\n"
            "                          (ID must consist of 12 hex digits)\n"
            "  -m, --multiconn         enable multiple connections to the\n"
            "                          same controller.\n"
+           "  --aux-conns=N           with -m, accept up to N auxiliary\n"
+           "                          connections per controller (default: %d)\n"
            "  --no-slicing            disable slicing\n"
+           "  --buffers=N             buffer up to N packets sent to the\n"
+           "                          controller (default: %d)\n"
+           "  --rx-budget=N           receive at most N packets per port\n"
+           "                          per round (default: %d)\n"
+           "  --msg-budget=N          handle at most N messages per\n"
+           "                          connection per round (default: %d)\n"
+           "  --pktin-rate=RATE[/BURST]\n"
+           "                          send at most RATE packet ins per second\n"
+           "                          for each reason (default: unlimited)\n"
+           "  --pktin-port-rate=RATE[/BURST]\n"
+           "                          send at most RATE packet ins per second\n"
+           "                          for each input port (default: unlimited)\n"
+           "  --pktin-dup-window=MS   drop packet ins repeating the reason, port\n"
+           "                          and MAC addresses of one sent within MS ms\n"
+           "  --hello-interval=MS     send hellos to neighbour switches every MS\n"
+           "                          ms, 0 to only discover them (default: %d)\n"
+           "  --hello-mult=N          declare a neighbour down after N missed\n"
+           "                          hellos (default: %d)\n"
+           "  --stage-timers          time the pipeline stages from start-up\n"
+           "  --trace[=N]             trace datapath events from start-up, keeping\n"
+           "                          the last N (default: %d)\n"
+           "  --trace-file=FILE       write the trace to FILE on SIGUSR1\n"
+           "                          (default: %s/ofdatapath.trace)\n"
+           "\nPath options:\n"
+           "  --path-mode=MODE        forward with arp (ARP-Path), tcp (TCP-Path)\n"
+           "                          or elephant (TCP-Path for elephant flows\n"
+           "                          only) (default: arp)\n"
+           "  --ctrl-notify           copy ARP-Path frames to the controller\n"
+           "  --recovery=off|dist|ctrl\n"
+           "                          repair broken paths between the switches\n"
+           "                          (dist) or through the controller (ctrl)\n"
+           "                          (default: off)\n"
+           "  --no-fast-failover      do not move to the backup port when a port\n"
+           "                          goes down\n"
+           "  --measure-recovery      log the time each path repair takes\n"
+           "  --bt-time=S             keep blocked ARP-Path entries S seconds\n"
+           "                          (default: 15)\n"
+           "  --lt-time=S             keep learnt ARP-Path entries S seconds\n"
+           "                          (default: 20)\n"
+           "  --tcp-time=S            keep TCP-Path entries S seconds\n"
+           "                          (default: 10)\n"
            "\nOther options:\n"
            "  -D, --detach            run in background as daemon\n"
            "  -P, --pidfile[=FILE]    create pidfile (default: %s/ofdatapath.pid)\n"
            "  -f, --force             with -P, start even if already running\n"
            "  -v, --verbose=MODULE[:FACILITY[:LEVEL]]  set logging levels\n"
            "  -v, --verbose           set maximum verbosity level\n"
+           "  --log-file[=FILE]       enable logging to specified FILE\n"
            "  -h, --help              display this help message\n"
            "  -V, --version           display version information\n",
+        REMOTE_AUX_DEFAULT, DP_BUFFERS_DEFAULT, DP_RX_BUDGET_DEFAULT,
+        DP_MSG_BUDGET_DEFAULT, DP_LIVENESS_INTERVAL_DEFAULT,
+        DP_LIVENESS_MULT_DEFAULT, DP_TRACE_SIZE_DEFAULT, ofp_rundir,
         ofp_rundir);
     exit(EXIT_SUCCESS);
 }
@@ -49,6 +49,7 @@
 #include "oflib/ofl-actions.h"
 #include "oflib/ofl-print.h"
 #include "oflib/ofl.h"
+#include "oflib/ofl-utils.h"
 #include "oflib-exp/ofl-exp.h"
 #include "oflib-exp/ofl-exp-openflow.h"
 #include "oflib/oxm-match.h"
@@ -56,11 +57,14 @@
 #include "command-line.h"
 #include "compiler.h"
 #include "dpif.h"
+#include "dynamic-string.h"
 #include "openflow/nicira-ext.h"
 #include "openflow/openflow-ext.h"
+#include "ofp.h"
 #include "ofpbuf.h"
 #include "openflow/openflow.h"
 #include "packets.h"
+#include "poll-loop.h"
 #include "random.h"
 #include "socket-util.h"
 #include "timeval.h"
@@ -84,6 +88,8 @@
 
 static uint32_t global_xid = XID;
 
+static bool strict = false;
+
 struct command {
     char *name;
     int min_args;
@@ -136,6 +142,9 @@ parse_port_mod(char *str, struct ofl_msg_port_mod *msg);
 static void
 parse_table_mod(char *str, struct ofl_msg_table_mod *msg);
 
+static void
+parse_path_mode(char *str, struct ofl_exp_openflow_msg_set_path_mode *msg);
+
 static void
 parse_band(char *str, struct ofl_msg_meter_mod *m, struct ofl_meter_band_header **b);
 
@@ -196,11 +205,21 @@ static struct ofl_exp_msg dpctl_exp_msg =
          .free      = ofl_exp_msg_free,
          .to_string = ofl_exp_msg_to_string};
 
+static struct ofl_exp_stats dpctl_exp_stats =
+        {.req_pack        = ofl_exp_stats_req_pack,
+         .req_unpack      = ofl_exp_stats_req_unpack,
+         .req_free        = ofl_exp_stats_req_free,
+         .req_to_string   = ofl_exp_stats_req_to_string,
+         .reply_pack      = ofl_exp_stats_reply_pack,
+         .reply_unpack    = ofl_exp_stats_reply_unpack,
+         .reply_free      = ofl_exp_stats_reply_free,
+         .reply_to_string = ofl_exp_stats_reply_to_string};
+
 static struct ofl_exp dpctl_exp =
         {.act   = NULL,
          .inst  = NULL,
          .match = NULL,
-         .stats = NULL,
+         .stats = &dpctl_exp_stats,
          .msg   = &dpctl_exp_msg};
 
 
@@ -283,14 +302,14 @@ dpctl_barrier(struct vconn *vconn) {
 
 }
 
-static void
-dpctl_send(struct vconn *vconn, struct ofl_msg_header *msg) {
+static struct ofpbuf *
+dpctl_pack(struct ofl_msg_header *msg, uint32_t xid) {
     struct ofpbuf *ofpbuf;
     uint8_t *buf;
     size_t buf_size;
     int error;
 
-    error = ofl_msg_pack(msg, global_xid, &buf, &buf_size, &dpctl_exp);
+    error = ofl_msg_pack(msg, xid, &buf, &buf_size, &dpctl_exp);
     if (error) {
         ofp_fatal(0, "Error packing request.");
     }
@@ -298,7 +317,15 @@ dpctl_send(struct vconn *vconn, struct ofl_msg_header *msg) {
     ofpbuf = ofpbuf_new(0);
     ofpbuf_use(ofpbuf, buf, buf_size);
     ofpbuf_put_uninit(ofpbuf, buf_size);
+    return ofpbuf;
+}
 
+static void
+dpctl_send(struct vconn *vconn, struct ofl_msg_header *msg) {
+    struct ofpbuf *ofpbuf;
+    int error;
+
+    ofpbuf = dpctl_pack(msg, global_xid);
     error = vconn_send_block(vconn, ofpbuf);
     if (error) {
         ofp_fatal(0, "Error during transaction.");
@@ -445,6 +472,179 @@ stats_desc(struct vconn *vconn, int argc UNUSED, char *argv[] UNUSED) {
     dpctl_transact_and_print(vconn, (struct ofl_msg_header *)&req, NULL);
 }
 
+static void
+stats_stages(struct vconn *vconn, int argc, char *argv[]) {
+    struct ofl_exp_openflow_mp_request_stages req =
+            {{{{{.type = OFPT_MULTIPART_REQUEST},
+                .type = OFPMP_EXPERIMENTER, .flags = 0x0000},
+               .experimenter_id = OPENFLOW_VENDOR_ID},
+              .type = OFP_EXT_MP_STAGES},
+             .command = OFP_EXT_STAGES_GET};
+
+    if (argc > 0) {
+        if (strcmp(argv[0], "on") == 0) {
+            req.command = OFP_EXT_STAGES_ENABLE;
+        } else if (strcmp(argv[0], "off") == 0) {
+            req.command = OFP_EXT_STAGES_DISABLE;
+        } else if (strcmp(argv[0], "clear") == 0) {
+            req.command = OFP_EXT_STAGES_CLEAR;
+        } else {
+            ofp_fatal(0, "Error parsing stats-stages command: %s.", argv[0]);
+        }
+    }
+
+    dpctl_transact_and_print(vconn, (struct ofl_msg_header *)&req, NULL);
+}
+
+static void
+stats_counters(struct vconn *vconn, int argc UNUSED, char *argv[] UNUSED) {
+    struct ofl_exp_openflow_mp_request_counters req =
+            {{{{{.type = OFPT_MULTIPART_REQUEST},
+                .type = OFPMP_EXPERIMENTER, .flags = 0x0000},
+               .experimenter_id = OPENFLOW_VENDOR_ID},
+              .type = OFP_EXT_MP_COUNTERS}};
+
+    dpctl_transact_and_print(vconn, (struct ofl_msg_header *)&req, NULL);
+}
+
+/* Returns the next reply to 'xid' from the switch. Unlike vconn_recv_xid(),
+ * returns each part of a multipart reply. */
+static struct ofl_msg_header *
+dpctl_recv_xid(struct vconn *vconn, uint32_t xid) {
+    struct ofl_msg_header *reply;
+    struct ofpbuf *ofpbuf;
+    uint32_t repl_xid;
+    int error;
+
+    for (;;) {
+        error = vconn_recv_block(vconn, &ofpbuf);
+        if (error) {
+            ofp_fatal(error, "Error receiving reply");
+        }
+        if (((struct ofp_header *)ofpbuf->data)->xid == htonl(xid)) {
+            break;
+        }
+        ofpbuf_delete(ofpbuf);
+    }
+    error = ofl_msg_unpack(ofpbuf->data, ofpbuf->size, &reply, &repl_xid, &dpctl_exp);
+    if (error) {
+        ofp_fatal(0, "Error unpacking reply.");
+    }
+    ofpbuf->base = NULL;
+    ofpbuf->data = NULL;
+    ofpbuf_delete(ofpbuf);
+
+    if (reply->type == OFPT_ERROR) {
+        char *str = ofl_msg_to_string(reply, &dpctl_exp);
+        ofp_fatal(0, "Switch replied with an error: %s", str);
+    }
+    return reply;
+}
+
+static void
+dump_trace(struct vconn *vconn, int argc, char *argv[]) {
+    struct ofl_exp_openflow_mp_request_trace req =
+            {{{{{.type = OFPT_MULTIPART_REQUEST},
+                .type = OFPMP_EXPERIMENTER, .flags = 0x0000},
+               .experimenter_id = OPENFLOW_VENDOR_ID},
+              .type = OFP_EXT_MP_TRACE},
+             .command = OFP_EXT_TRACE_GET, .size = 0};
+    struct ofl_msg_header features_req = {.type = OFPT_FEATURES_REQUEST};
+    struct ofl_exp_openflow_mp_reply_trace *trace = NULL;
+    struct ofl_msg_header *reply;
+    uint32_t repl_xid;
+    uint64_t dpid;
+    bool more;
+    int error;
+
+    dpctl_transact(vconn, &features_req, &reply, &repl_xid);
+    dpid = ((struct ofl_msg_features_reply *)reply)->datapath_id;
+    ofl_msg_free(reply, &dpctl_exp);
+
+    global_xid++;
+    error = vconn_send_block(vconn, dpctl_pack((struct ofl_msg_header *)&req, global_xid));
+    if (error) {
+        ofp_fatal(error, "Error sending request");
+    }
+
+    /* The ring comes in several replies; the first one keeps the records of
+     * all of them. */
+    do {
+        struct ofl_exp_openflow_mp_reply_trace *part;
+
+        reply = dpctl_recv_xid(vconn, global_xid);
+        part = (struct ofl_exp_openflow_mp_reply_trace *)reply;
+        if (reply->type != OFPT_MULTIPART_REPLY
+            || part->header.header.header.type != OFPMP_EXPERIMENTER
+            || part->header.header.experimenter_id != OPENFLOW_VENDOR_ID
+            || part->header.type != OFP_EXT_MP_TRACE) {
+            ofp_fatal(0, "Unexpected reply from the switch.");
+        }
+        more = (part->header.header.header.flags & OFPMPF_REPLY_MORE) != 0;
+        if (trace == NULL) {
+            trace = part;
+        } else {
+            trace->records = xrealloc(trace->records,
+                                      (trace->records_num + part->records_num)
+                                      * sizeof *trace->records);
+            memcpy(trace->records + trace->records_num, part->records,
+                   part->records_num * sizeof *part->records);
+            trace->records_num += part->records_num;
+            ofl_msg_free(reply, &dpctl_exp);
+        }
+    } while (more);
+
+    if (argc > 0) {
+        FILE *file = fopen(argv[0], "w");
+
+        if (file == NULL) {
+            ofp_fatal(errno, "%s: open failed", argv[0]);
+        }
+        error = ofl_exp_trace_save(file, dpid, trace);
+        if (fclose(file) != 0 && error == 0) {
+            error = errno;
+        }
+        if (error) {
+            ofp_fatal(error, "%s: write failed", argv[0]);
+        }
+        printf("%zu trace records written to %s.\n", trace->records_num, argv[0]);
+    } else {
+        printf("dpid=0x%016"PRIx64" trace=%s size=%"PRIu32" total=%"PRIu64" records=%zu\n",
+               dpid, (trace->flags & OFP_EXT_TRACE_ENABLED) ? "on" : "off",
+               trace->size, trace->total, trace->records_num);
+        ofl_exp_trace_print(stdout, trace);
+    }
+    ofl_msg_free((struct ofl_msg_header *)trace, &dpctl_exp);
+}
+
+static void
+set_trace(struct vconn *vconn, int argc, char *argv[]) {
+    struct ofl_exp_openflow_mp_request_trace req =
+            {{{{{.type = OFPT_MULTIPART_REQUEST},
+                .type = OFPMP_EXPERIMENTER, .flags = 0x0000},
+               .experimenter_id = OPENFLOW_VENDOR_ID},
+              .type = OFP_EXT_MP_TRACE},
+             .command = OFP_EXT_TRACE_GET, .size = 0};
+
+    if (strcmp(argv[0], "on") == 0) {
+        req.command = OFP_EXT_TRACE_ENABLE;
+        if (argc > 1 && parse32(argv[1], NULL, 0, UINT32_MAX, &req.size)) {
+            ofp_fatal(0, "Error parsing set-trace size: %s.", argv[1]);
+        }
+    } else if (strcmp(argv[0], "off") == 0) {
+        req.command = OFP_EXT_TRACE_DISABLE;
+    } else if (strcmp(argv[0], "clear") == 0) {
+        req.command = OFP_EXT_TRACE_CLEAR;
+    } else {
+        ofp_fatal(0, "Error parsing set-trace command: %s.", argv[0]);
+    }
+    if (argc > 1 && req.command != OFP_EXT_TRACE_ENABLE) {
+        ofp_fatal(0, "set-trace %s takes no size.", argv[0]);
+    }
+
+    dpctl_transact_and_print(vconn, (struct ofl_msg_header *)&req, NULL);
+}
+
 static void
 port_desc(struct vconn *vconn, int argc UNUSED, char *argv[] UNUSED) {
     struct ofl_msg_multipart_request_header req =
@@ -595,65 +795,356 @@ set_config(struct vconn *vconn, int argc UNUSED, char *argv[]) {
 
 
 
-static void
-flow_mod(struct vconn *vconn, int argc, char *argv[]) {
-    struct ofl_msg_flow_mod msg =
-            {{.type = OFPT_FLOW_MOD},
-             .cookie = 0x0000000000000000ULL,
-             .cookie_mask = 0x0000000000000000ULL,
-             .table_id = 0xff,
-             .command = OFPFC_ADD,
-             .idle_timeout = OFP_FLOW_PERMANENT,
-             .hard_timeout = OFP_FLOW_PERMANENT,
-             .priority = OFP_DEFAULT_PRIORITY,
-             .buffer_id = 0xffffffff,
-             .out_port = OFPP_ANY,
-             .out_group = OFPG_ANY,
-             .flags = 0x0000,
-             .match = NULL,
-             .instructions_num = 0,
-             .instructions = NULL};
+static const struct ofl_msg_flow_mod flow_mod_defaults =
+        {{.type = OFPT_FLOW_MOD},
+         .cookie = 0x0000000000000000ULL,
+         .cookie_mask = 0x0000000000000000ULL,
+         .table_id = 0xff,
+         .command = OFPFC_ADD,
+         .idle_timeout = OFP_FLOW_PERMANENT,
+         .hard_timeout = OFP_FLOW_PERMANENT,
+         .priority = OFP_DEFAULT_PRIORITY,
+         .buffer_id = 0xffffffff,
+         .out_port = OFPP_ANY,
+         .out_group = OFPG_ANY,
+         .flags = 0x0000,
+         .match = NULL,
+         .instructions_num = 0,
+         .instructions = NULL};
 
-    parse_flow_mod_args(argv[0], &msg);
+/* Parses the arguments of the flow-mod command into 'msg', which must be
+ * initialized to 'flow_mod_defaults'. */
+static void
+parse_flow_mod(int argc, char *argv[], struct ofl_msg_flow_mod *msg) {
+    parse_flow_mod_args(argv[0], msg);
     if (argc > 1) {
         size_t i, j;
         size_t inst_num = 0;
         if (argc > 2){
             inst_num = argc - 2;
             j = 2;
-            parse_match(argv[1], &(msg.match));
+            parse_match(argv[1], &(msg->match));
         }
         else {
-            if(msg.command == OFPFC_DELETE) {
+            if(msg->command == OFPFC_DELETE) {
                 inst_num = 0;
-                parse_match(argv[1], &(msg.match));
+                parse_match(argv[1], &(msg->match));
             } else {
                 /*We copy the value because we don't know if
                 it is an instruction or match.
                 If the match is empty, the argv is modified
                 causing errors to instructions parsing*/
-                char *cpy = malloc(strlen(argv[1]));
-                memcpy(cpy, argv[1], strlen(argv[1])); 
-                parse_match(cpy, &(msg.match));
+                char *cpy = xstrdup(argv[1]);
+                parse_match(cpy, &(msg->match));
                 free(cpy);
-                if(msg.match->length <= 4){
+                if(msg->match->length <= 4){
                     inst_num = argc - 1;
                     j = 1;
                 }
             }
         }
 
-        msg.instructions_num = inst_num;
-        msg.instructions = xmalloc(sizeof(struct ofl_instruction_header *) * inst_num);
+        msg->instructions_num = inst_num;
+        msg->instructions = xmalloc(sizeof(struct ofl_instruction_header *) * inst_num);
         for (i=0; i < inst_num; i++) {
-            parse_inst(argv[j+i], &(msg.instructions[i]));
+            parse_inst(argv[j+i], &(msg->instructions[i]));
         }
     } else {
-        make_all_match(&(msg.match));
+        make_all_match(&(msg->match));
     }
+}
+
+static void
+flow_mod(struct vconn *vconn, int argc, char *argv[]) {
+    struct ofl_msg_flow_mod msg = flow_mod_defaults;
+
+    parse_flow_mod(argc, argv, &msg);
     dpctl_send_and_print(vconn, (struct ofl_msg_header *)&msg);
 }
 
+/* A flow_mod read from a flow file, packed, and the line it came from. */
+struct file_flow {
+    struct ofpbuf *buf;
+    int line;
+};
+
+/* Flow file and line being parsed, for reporting parse errors. */
+static const char *flow_file_name;
+static int flow_file_line;
+
+/* Sends a barrier every 'flow_file_barrier' flow_mods of a flow file, or
+ * only after the last one if it is 0. */
+static unsigned int flow_file_barrier = 0;
+
+static void
+flow_file_parse_error(void) {
+    if (flow_file_name != NULL) {
+        fprintf(stderr, "%s: while parsing %s, line %d\n",
+                program_name, flow_file_name, flow_file_line);
+    }
+}
+
+/* Reads the flows of 'file_name', one flow-mod argument list per line, and
+ * packs them as flow_mods with 'command'.  The xid of the i-th flow_mod is
+ * 'global_xid' + i.  Sets the entries of 'tables' the flows are put in. */
+static size_t
+read_flow_file(const char *file_name, enum ofp_flow_mod_command command,
+               struct file_flow **flowsp, bool tables[]) {
+    struct file_flow *flows = NULL;
+    size_t n_flows = 0, allocated = 0;
+    struct ds line = DS_EMPTY_INITIALIZER;
+    FILE *file;
+
+    file = !strcmp(file_name, "-") ? stdin : fopen(file_name, "r");
+    if (file == NULL) {
+        ofp_fatal(errno, "%s: open failed", file_name);
+    }
+
+    flow_file_name = file_name;
+    flow_file_line = 0;
+    atexit(flow_file_parse_error);
+
+    while (!ds_get_line(&line, file)) {
+        char *argv[9];  /* As many as the flow-mod command takes. */
+        char *token, *saveptr = NULL;
+        struct ofl_msg_flow_mod *msg;
+        int argc = 0;
+
+        flow_file_line++;
+        for (token = strtok_r(ds_cstr(&line), " \t\r\n", &saveptr);
+             token != NULL && token[0] != '#';
+             token = strtok_r(NULL, " \t\r\n", &saveptr)) {
+            if (argc >= NUM_ELEMS(argv)) {
+                ofp_fatal(0, "too many arguments");
+            }
+            argv[argc++] = token;
+        }
+        if (argc == 0) {
+            continue;
+        }
+
+        msg = xmemdup(&flow_mod_defaults, sizeof *msg);
+        parse_flow_mod(argc, argv, msg);
+        msg->command = command;
+        if (command == OFPFC_DELETE || command == OFPFC_DELETE_STRICT) {
+            OFL_UTILS_FREE_ARR_FUN2(msg->instructions, msg->instructions_num,
+                                    ofl_structs_free_instruction, &dpctl_exp);
+            msg->instructions = NULL;
+            msg->instructions_num = 0;
+        }
+        tables[msg->table_id] = true;
+
+        if (n_flows >= allocated) {
+            flows = x2nrealloc(flows, &allocated, sizeof *flows);
+        }
+        flows[n_flows].buf = dpctl_pack((struct ofl_msg_header *)msg,
+                                        global_xid + n_flows);
+        flows[n_flows].line = flow_file_line;
+        n_flows++;
+        ofl_msg_free((struct ofl_msg_header *)msg, &dpctl_exp);
+    }
+    if (ferror(file)) {
+        ofp_fatal(errno, "%s: read failed", file_name);
+    }
+    flow_file_name = NULL;
+
+    if (file != stdin) {
+        fclose(file);
+    }
+    ds_destroy(&line);
+    *flowsp = flows;
+    return n_flows;
+}
+
+static void
+flow_file_error(const char *file_name, struct file_flow *flows,
+                size_t n_flows, struct ofpbuf *buf) {
+    const struct ofp_error_msg *oem = buf->data;
+    uint32_t i = ntohl(oem->header.xid) - global_xid;
+
+    if (buf->size < sizeof *oem) {
+        fprintf(stderr, "%s: short error message\n", file_name);
+        return;
+    }
+    if (i < n_flows && flows[i].line > 0) {
+        fprintf(stderr, "%s:%d: ", file_name, flows[i].line);
+    } else {
+        fprintf(stderr, "%s: ", file_name);
+    }
+    ofl_error_type_print(stderr, ntohs(oem->type));
+    fprintf(stderr, ", ");
+    ofl_error_code_print(stderr, ntohs(oem->type), ntohs(oem->code));
+    fprintf(stderr, "\n");
+}
+
+/* Streams the flow_mods in 'flows' to the switch without waiting for each
+ * to be processed, with a barrier every 'flow_file_barrier' of them and
+ * after the last one.  Errors are reported as they arrive, with the line
+ * of the flow_mod that caused them.  Returns the number of errors. */
+static size_t
+send_flow_file(struct vconn *vconn, const char *file_name,
+               struct file_flow *flows, size_t n_flows) {
+    struct ofpbuf *pending = NULL;
+    size_t n_sent = 0, n_errors = 0;
+    unsigned int since_barrier = 0;
+    unsigned int n_barriers = 0, n_replies = 0;
+    int error;
+
+    for (;;) {
+        struct ofpbuf *buf;
+
+        while ((error = vconn_recv(vconn, &buf)) == 0) {
+            struct ofp_header *oh = buf->data;
+
+            switch (oh->type) {
+            case OFPT_ERROR:
+                flow_file_error(file_name, flows, n_flows, buf);
+                n_errors++;
+                break;
+            case OFPT_BARRIER_REPLY:
+                n_replies++;
+                break;
+            case OFPT_ECHO_REQUEST: {
+                struct ofpbuf *reply = make_echo_reply(oh);
+
+                /* Dropped if the connection is busy; the switch retries. */
+                if (vconn_send(vconn, reply)) {
+                    ofpbuf_delete(reply);
+                }
+                break;
+            }
+            default:
+                break;
+            }
+            ofpbuf_delete(buf);
+        }
+        if (error != EAGAIN) {
+            ofp_fatal(error == EOF ? 0 : error, "%s: connection %s",
+                      vconn_get_name(vconn),
+                      error == EOF ? "closed" : "failed");
+        }
+
+        for (;;) {
+            if (pending == NULL) {
+                if (since_barrier > 0 && (n_sent == n_flows
+                                          || since_barrier == flow_file_barrier)) {
+                    struct ofl_msg_header req = {.type = OFPT_BARRIER_REQUEST};
+
+                    pending = dpctl_pack(&req, global_xid + n_flows + n_barriers);
+                    since_barrier = 0;
+                    n_barriers++;
+                } else if (n_sent < n_flows && n_barriers - n_replies < 2) {
+                    /* Keeps at most two batches in flight, so that errors are
+                     * reported close to the flow_mods that caused them. */
+                    pending = flows[n_sent].buf;
+                    flows[n_sent].buf = NULL;
+                    n_sent++;
+                    since_barrier++;
+                } else {
+                    break;
+                }
+            }
+            error = vconn_send(vconn, pending);
+            if (error == EAGAIN) {
+                break;
+            } else if (error) {
+                ofp_fatal(error, "%s: send failed", vconn_get_name(vconn));
+            }
+            pending = NULL;
+        }
+
+        if (n_sent == n_flows && pending == NULL && since_barrier == 0
+            && n_replies == n_barriers) {
+            break;
+        }
+        vconn_recv_wait(vconn);
+        if (pending != NULL) {
+            vconn_send_wait(vconn);
+        }
+        poll_block();
+    }
+    return n_errors;
+}
+
+/* Implements the add-flows, del-flows and replace-flows commands. */
+static void
+flows_from_file(struct vconn *vconn, const char *file_name,
+                enum ofp_flow_mod_command command, bool replace) {
+    bool tables[UINT8_MAX + 1] = {false};
+    struct file_flow *flows;
+    size_t n_flows, n_errors, i;
+
+    n_flows = read_flow_file(file_name, command, &flows, tables);
+
+    if (replace && n_flows > 0) {
+        /* Puts deletes of all the flows in the tables the file adds flows to
+         * in front of them, and renumbers them to keep the xids in order. */
+        struct file_flow *all;
+        size_t n_tables = 0;
+
+        for (i = 0; i < NUM_ELEMS(tables); i++) {
+            n_tables += tables[i];
+        }
+        if (tables[OFPTT_ALL]) {
+            n_tables = 1;
+        }
+        all = xmalloc((n_tables + n_flows) * sizeof *all);
+        n_tables = 0;
+        for (i = 0; i < NUM_ELEMS(tables); i++) {
+            if (tables[OFPTT_ALL] ? i == OFPTT_ALL : tables[i]) {
+                struct ofl_msg_flow_mod *msg;
+
+                msg = xmemdup(&flow_mod_defaults, sizeof *msg);
+                msg->table_id = i;
+                msg->command = OFPFC_DELETE;
+                make_all_match(&msg->match);
+                all[n_tables].buf = dpctl_pack((struct ofl_msg_header *)msg,
+                                               global_xid + n_tables);
+                all[n_tables].line = 0;
+                n_tables++;
+                ofl_msg_free((struct ofl_msg_header *)msg, &dpctl_exp);
+            }
+        }
+        for (i = 0; i < n_flows; i++) {
+            struct ofp_header *oh = flows[i].buf->data;
+
+            oh->xid = htonl(global_xid + n_tables + i);
+            all[n_tables + i] = flows[i];
+        }
+        free(flows);
+        flows = all;
+        n_flows += n_tables;
+    }
+
+    n_errors = send_flow_file(vconn, file_name, flows, n_flows);
+
+    printf("%zu flow_mods sent from %s, %zu errors.\n",
+           n_flows, file_name, n_errors);
+    for (i = 0; i < n_flows; i++) {
+        ofpbuf_delete(flows[i].buf);
+    }
+    free(flows);
+    if (n_errors > 0) {
+        vconn_close(vconn);
+        exit(EXIT_FAILURE);
+    }
+}
+
+static void
+add_flows(struct vconn *vconn, int argc UNUSED, char *argv[]) {
+    flows_from_file(vconn, argv[0], OFPFC_ADD, false);
+}
+
+static void
+del_flows(struct vconn *vconn, int argc UNUSED, char *argv[]) {
+    flows_from_file(vconn, argv[0],
+                    strict ? OFPFC_DELETE_STRICT : OFPFC_DELETE, false);
+}
+
+static void
+replace_flows(struct vconn *vconn, int argc UNUSED, char *argv[]) {
+    flows_from_file(vconn, argv[0], OFPFC_ADD, true);
+}
 
 static void
 group_mod(struct vconn *vconn, int argc, char *argv[]) {
@@ -824,6 +1315,20 @@ set_desc(struct vconn *vconn, int argc UNUSED, char *argv[]) {
     dpctl_send_and_print(vconn, (struct ofl_msg_header *)&msg);
 }
 
+static void
+set_path_mode(struct vconn *vconn, int argc UNUSED, char *argv[]) {
+    struct ofl_exp_openflow_msg_set_path_mode msg =
+            {{{{.type = OFPT_EXPERIMENTER},
+               .experimenter_id = OPENFLOW_VENDOR_ID},
+              .type = OFP_EXT_SET_PATH_MODE},
+             .mode = OFP_PATH_MODE_KEEP,
+             .flags = 0x0000, .flags_mask = 0x0000,
+             .bt_time = 0, .lt_time = 0, .tcp_time = 0};
+
+    parse_path_mode(argv[0], &msg);
+    dpctl_send_and_print(vconn, (struct ofl_msg_header *)&msg);
+}
+
 
 
 static void
@@ -924,6 +1429,9 @@ static struct command all_commands[] = {
     {"port-desc", 0, 0, port_desc},
     {"set-config", 1, 1, set_config},
     {"flow-mod", 1, 8/*+1 for each inst type*/, flow_mod },
+    {"add-flows", 1, 1, add_flows },
+    {"del-flows", 1, 1, del_flows },
+    {"replace-flows", 1, 1, replace_flows },
     {"group-mod", 1, UINT8_MAX, group_mod },
     {"meter-mod", 1, UINT8_MAX, meter_mod},
     {"get-async",0,0, get_async},
@@ -931,10 +1439,15 @@ static struct command all_commands[] = {
     {"table-mod", 1, 1, table_mod },
     {"queue-get-config", 1, 1, queue_get_config},
     {"set-desc", 1, 1, set_desc},
+    {"set-path-mode", 1, 1, set_path_mode},
     {"set-table-match", 0, 2, set_table_features_match},
 
     {"queue-mod", 3, 3, queue_mod},
-    {"queue-del", 2, 2, queue_del}
+    {"queue-del", 2, 2, queue_del},
+    {"stats-stages", 0, 1, stats_stages},
+    {"stats-counters", 0, 0, stats_counters},
+    {"dump-trace", 0, 1, dump_trace},
+    {"set-trace", 1, 2, set_trace}
 };
 
 
@@ -998,12 +1511,14 @@ static void
 parse_options(int argc, char *argv[])
 {
     enum {
-        OPT_STRICT = UCHAR_MAX + 1
+        OPT_STRICT = UCHAR_MAX + 1,
+        OPT_BARRIER
     };
     static struct option long_options[] = {
         {"timeout", required_argument, 0, 't'},
         {"verbose", optional_argument, 0, 'v'},
         {"strict", no_argument, 0, OPT_STRICT},
+        {"barrier", required_argument, 0, OPT_BARRIER},
         {"help", no_argument, 0, 'h'},
         {"version", no_argument, 0, 'V'},
         {"xid", required_argument, 0, 'x'},
@@ -1048,6 +1563,14 @@ parse_options(int argc, char *argv[])
             global_xid = strtoul(optarg, NULL, 0);
             break;
 
+        case OPT_STRICT:
+            strict = true;
+            break;
+
+        case OPT_BARRIER:
+            flow_file_barrier = strtoul(optarg, NULL, 10);
+            break;
+
         VCONN_SSL_OPTION_HANDLERS
 
         case '?':
@@ -1086,6 +1609,9 @@ usage(void)
             "\n"
             "  SWITCH set-config ARG                  set switch configuration\n"
             "  SWITCH flow-mod ARG [MATCH [INST...]]  send flow_mod message\n"
+            "  SWITCH add-flows FILE                  add the flows in FILE\n"
+            "  SWITCH del-flows FILE                  delete the flows in FILE\n"
+            "  SWITCH replace-flows FILE              replace flows with those in FILE\n"
             "  SWITCH group-mod ARG [BUCARG ACT...]   send group_mod message\n"
             "  SWITCH meter-mod ARG [BANDARG ...]     send meter_mod message\n"
             "  SWITCH port-mod ARG                    send port_mod message\n"
@@ -1094,14 +1620,20 @@ usage(void)
             "\n"
             "OpenFlow extensions\n"
             "  SWITCH set-desc DESC                   sets the DP description\n"
+            "  SWITCH set-path-mode ARG               sets the ARP-Path/TCP-Path mode\n"
             "  SWITCH queue-mod PORT QUEUE BW         adds/modifies queue\n"
             "  SWITCH queue-del PORT QUEUE            deletes queue\n"
+            "  SWITCH stats-stages [on|off|clear]     print stage latencies\n"
+            "  SWITCH stats-counters                  print datapath counters\n"
+            "  SWITCH dump-trace [FILE]               print or save the event trace\n"
+            "  SWITCH set-trace on [N]|off|clear      switch the event trace\n"
             "\n",
             program_name, program_name);
      vconn_usage(true, false, false);
      vlog_usage();
      printf("\nOther options:\n"
             "  --strict                    use strict match for flow commands\n"
+            "  --barrier=N                 send a barrier every N flows from a file\n"
             "  -t, --timeout=SECS          give up after SECS seconds\n"
             "  -h, --help                  display this help message\n"
             "  -V, --version               display version information\n");
@@ -2413,6 +2945,83 @@ parse_config(char *str, struct ofl_config *c) {
     }
 }
 
+static void
+parse_path_flag(char *str, const char *token, uint16_t flag,
+                struct ofl_exp_openflow_msg_set_path_mode *msg) {
+    uint8_t on;
+
+    if (parse8(str, path_onoff_names, sizeof(path_onoff_names)/sizeof(struct names8), 1, &on)) {
+        ofp_fatal(0, "Error parsing set_path_mode flag: %s.", token);
+    }
+    msg->flags_mask |= flag;
+    if (on) {
+        msg->flags |= flag;
+    }
+}
+
+static void
+parse_path_mode(char *str, struct ofl_exp_openflow_msg_set_path_mode *msg) {
+    char *token, *saveptr = NULL;
+
+    for (token = strtok_r(str, KEY_SEP, &saveptr); token != NULL; token = strtok_r(NULL, KEY_SEP, &saveptr)) {
+        if (strncmp(token, PATH_MODE_MODE KEY_VAL, strlen(PATH_MODE_MODE KEY_VAL)) == 0) {
+            if (parse8(token + strlen(PATH_MODE_MODE KEY_VAL), path_mode_names, sizeof(path_mode_names)/sizeof(struct names8), OFP_PATH_MODE_COUNT - 1, &msg->mode)) {
+                ofp_fatal(0, "Error parsing set_path_mode mode: %s.", token);
+            }
+            continue;
+        }
+        if (strncmp(token, PATH_MODE_CTRL KEY_VAL, strlen(PATH_MODE_CTRL KEY_VAL)) == 0) {
+            parse_path_flag(token + strlen(PATH_MODE_CTRL KEY_VAL), token, OFP_PATH_CTRL_NOTIFY, msg);
+            continue;
+        }
+        if (strncmp(token, PATH_MODE_RECOVERY KEY_VAL, strlen(PATH_MODE_RECOVERY KEY_VAL)) == 0) {
+            uint8_t recovery;
+            if (parse8(token + strlen(PATH_MODE_RECOVERY KEY_VAL), path_recovery_names, sizeof(path_recovery_names)/sizeof(struct names8), PATH_RECOVERY_CTRL, &recovery)) {
+                ofp_fatal(0, "Error parsing set_path_mode recovery: %s.", token);
+            }
+            msg->flags_mask |= OFP_PATH_RECOVERY;
+            if (recovery != PATH_RECOVERY_OFF) {
+                msg->flags |= OFP_PATH_RECOVERY;
+                msg->flags_mask |= OFP_PATH_RECOVERY_DIST;
+                if (recovery == PATH_RECOVERY_DIST) {
+                    msg->flags |= OFP_PATH_RECOVERY_DIST;
+                }
+            }
+            continue;
+        }
+        if (strncmp(token, PATH_MODE_FAILOVER KEY_VAL, strlen(PATH_MODE_FAILOVER KEY_VAL)) == 0) {
+            parse_path_flag(token + strlen(PATH_MODE_FAILOVER KEY_VAL), token, OFP_PATH_FAST_FAILOVER, msg);
+            continue;
+        }
+        if (strncmp(token, PATH_MODE_MEASURE KEY_VAL, strlen(PATH_MODE_MEASURE KEY_VAL)) == 0) {
+            parse_path_flag(token + strlen(PATH_MODE_MEASURE KEY_VAL), token, OFP_PATH_MEASURE_RECOVERY, msg);
+            continue;
+        }
+        if (strncmp(token, PATH_MODE_BT KEY_VAL, strlen(PATH_MODE_BT KEY_VAL)) == 0) {
+            if (parse16(token + strlen(PATH_MODE_BT KEY_VAL), NULL, 0, UINT16_MAX, &msg->bt_time)
+                || msg->bt_time == 0) {
+                ofp_fatal(0, "Error parsing set_path_mode bt: %s.", token);
+            }
+            continue;
+        }
+        if (strncmp(token, PATH_MODE_LT KEY_VAL, strlen(PATH_MODE_LT KEY_VAL)) == 0) {
+            if (parse16(token + strlen(PATH_MODE_LT KEY_VAL), NULL, 0, UINT16_MAX, &msg->lt_time)
+                || msg->lt_time == 0) {
+                ofp_fatal(0, "Error parsing set_path_mode lt: %s.", token);
+            }
+            continue;
+        }
+        if (strncmp(token, PATH_MODE_TCP KEY_VAL, strlen(PATH_MODE_TCP KEY_VAL)) == 0) {
+            if (parse16(token + strlen(PATH_MODE_TCP KEY_VAL), NULL, 0, UINT16_MAX, &msg->tcp_time)
+                || msg->tcp_time == 0) {
+                ofp_fatal(0, "Error parsing set_path_mode tcp: %s.", token);
+            }
+            continue;
+        }
+        ofp_fatal(0, "Error parsing set_path_mode arg: %s.", token);
+    }
+}
+
 static void
 parse_port_mod(char *str, struct ofl_msg_port_mod *msg) {
     char *token, *saveptr = NULL;
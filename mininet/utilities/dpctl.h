@@ -33,6 +33,7 @@
 #define DPCTL_H 1
 
 #include "openflow/openflow.h"
+#include "openflow/openflow-ext.h"
 
 struct names8 {
     uint8_t   code;
@@ -123,6 +124,29 @@ static struct names8 flow_mod_cmd_names[] = {
         {OFPFC_DELETE_STRICT, "dels"}
 };
 
+static struct names8 path_mode_names[] = {
+        {OFP_PATH_MODE_ARP,          "arp"},
+        {OFP_PATH_MODE_TCP,          "tcp"},
+        {OFP_PATH_MODE_TCP_ELEPHANT, "elephant"}
+};
+
+static struct names8 path_onoff_names[] = {
+        {0, "off"},
+        {1, "on"}
+};
+
+enum path_recovery {
+        PATH_RECOVERY_OFF,
+        PATH_RECOVERY_DIST,
+        PATH_RECOVERY_CTRL
+};
+
+static struct names8 path_recovery_names[] = {
+        {PATH_RECOVERY_OFF,  "off"},
+        {PATH_RECOVERY_DIST, "dist"},
+        {PATH_RECOVERY_CTRL, "ctrl"}
+};
+
 static struct names32 buffer_names[] = {
         {0xffffffff, "none"}
 };
@@ -246,6 +270,15 @@ static struct names16 band_names[] = {
 #define TABLE_MOD_TABLE  "table"
 #define TABLE_MOD_CONFIG "conf"
 
+#define PATH_MODE_MODE     "mode"
+#define PATH_MODE_CTRL     "ctrl"
+#define PATH_MODE_RECOVERY "recovery"
+#define PATH_MODE_FAILOVER "failover"
+#define PATH_MODE_MEASURE  "measure"
+#define PATH_MODE_BT       "bt"
+#define PATH_MODE_LT       "lt"
+#define PATH_MODE_TCP      "tcp"
+
 #define KEY_VAL    "="
 #define KEY_VAL2   ":"
 #define KEY_SEP    ","
@@ -0,0 +1,1106 @@
+/* Copyright (c) 2011, TrafficLab, Ericsson Research, Hungary
+ * Copyright (c) 2012, CPqD, Brazil 
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Ericsson Research nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* ofp-bench: a controller-side load generator for OpenFlow switches.
+ *
+ * In flow-mod mode every connection pipelines flow_mods, following each
+ * batch with a barrier, and measures how long the switch takes to confirm
+ * each batch. In packet-in mode every connection keeps probe packets
+ * circulating through the switch (packet_out to the flow table, which sends
+ * them back as packet_ins) to measure the packet_in round trip, and answers
+ * any other packet_in with a flow_mod or a packet_out. */
+
+#include <config.h>
+#include <arpa/inet.h>
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "command-line.h"
+#include "compiler.h"
+#include "hash.h"
+#include "hmap.h"
+#include "ofp.h"
+#include "ofpbuf.h"
+#include "oflib/ofl-actions.h"
+#include "oflib/ofl-messages.h"
+#include "oflib/ofl-structs.h"
+#include "openflow/openflow.h"
+#include "packets.h"
+#include "poll-loop.h"
+#include "queue.h"
+#include "timeval.h"
+#include "util.h"
+#include "vconn-ssl.h"
+#include "vconn.h"
+
+#include "vlog.h"
+
+#define LOG_MODULE VLM_ofp_bench
+
+static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(60, 60);
+
+enum bench_mode {
+    MODE_FLOW_MOD,
+    MODE_PACKET_IN
+};
+
+/* -m, --mode: what to measure. */
+static enum bench_mode mode = MODE_FLOW_MOD;
+
+/* --connections: number of connections to the switch. */
+static unsigned int n_conns = 1;
+
+/* -d, --duration: seconds to run for. */
+static unsigned int duration = 10;
+
+/* -i, --interval: seconds between reports. */
+static unsigned int interval = 1;
+
+/* -n, --flows: distinct flows installed in flow-mod mode. */
+static unsigned int n_flows = 1000;
+
+/* -b, --barrier: flow_mods between barriers. */
+static unsigned int batch_size = 100;
+
+/* -w, --window: barriers (flow-mod mode) or probes (packet-in mode) in
+ * flight per connection. */
+static unsigned int window = 4;
+
+/* -r, --rate: flow_mods (flow-mod mode) or replies (packet-in mode) per
+ * second over all connections, 0 for as many as possible. */
+static unsigned int rate;
+
+/* -t, --table: table the flows are installed in. */
+static uint8_t table_id;
+
+/* -o, --out-port: port the flows of flow-mod mode output to. */
+static uint32_t out_port = 1;
+
+/* --reply: answer packet_ins that are not probes with a flow_mod, instead
+ * of a packet_out. */
+static bool reply_flow_mod;
+
+/* Every flow installed by ofp-bench carries this cookie, so they can be
+ * removed at the end without touching the rest of the table. */
+#define BENCH_COOKIE 0x0fbe4c4f0fbe4c4fULL
+
+/* Probes are sent with the local experimental ethertype, and carry the
+ * connection that owns them, their sequence number on it and their sending
+ * time. */
+#define PROBE_ETH_TYPE 0x88b5
+#define PROBE_MAGIC    0x0fbe4c4f
+#define PROBE_PRIORITY 0xffff
+
+struct probe_header {
+    uint32_t magic;
+    uint32_t conn;
+    uint32_t seq;
+    uint32_t pad;
+    uint64_t sent;              /* time_nsec() when it was sent. */
+};
+
+/* Probes that do not come back within this time are considered lost. */
+#define PROBE_TIMEOUT_MS 1000
+
+/* A probe sent and not back yet. */
+struct probe {
+    bool in_flight;
+    uint32_t seq;
+    long long int sent;         /* time_msec() when it was sent. */
+};
+
+/* A barrier waiting for its reply. */
+struct batch {
+    uint32_t xid;
+    unsigned int n_flow_mods;
+    long long int start;        /* time_nsec() of its first flow_mod. */
+};
+
+struct conn {
+    struct vconn *vconn;
+    unsigned int idx;
+    uint32_t xid;
+    struct ofp_queue txq;       /* Messages not yet taken by 'vconn'. */
+
+    /* Flow-mod mode. */
+    struct batch *batches;      /* Ring of 'window' batches. */
+    unsigned int batch_head;
+    unsigned int n_batches;
+    unsigned int next_flow;
+    struct batch cur;           /* Batch being sent. */
+
+    /* Packet-in mode. */
+    struct probe *probes;       /* Ring of 'window' probes, by sequence. */
+    uint32_t next_seq;
+    unsigned int in_flight;     /* Probes sent and not back yet. */
+    unsigned int deferred;      /* Probes back, waiting for the rate. */
+    long long int next_expiry;  /* time_msec() no probe expires before. */
+};
+
+/* Latency samples, in microseconds. */
+struct samples {
+    uint32_t *us;
+    size_t n, allocated;
+};
+
+struct counters {
+    unsigned long long int flow_mods;   /* Confirmed by a barrier. */
+    unsigned long long int batches;
+    unsigned long long int packet_ins;
+    unsigned long long int probes;      /* Own probes back. */
+    unsigned long long int replies;     /* Flow_mods/packet_outs answering
+                                         * other packet_ins. */
+    unsigned long long int unanswered;  /* Packet_ins over the rate, or
+                                         * with neither data nor buffer. */
+    unsigned long long int lost;        /* Probes that did not come back. */
+    unsigned long long int errors;
+};
+
+static struct conn *conns;
+static struct samples samples;
+static struct counters total;
+
+/* Prepacked flow_mods, one for each flow of flow-mod mode. */
+static struct ofpbuf **flow_mods;
+
+/* Rate limiting. */
+static double tokens;
+static long long int tokens_refilled;
+
+static void parse_options(int argc, char *argv[]);
+static void usage(void) NO_RETURN;
+
+static void
+samples_add(struct samples *s, long long int ns) {
+    if (s->n >= s->allocated) {
+        s->us = x2nrealloc(s->us, &s->allocated, sizeof *s->us);
+    }
+    s->us[s->n++] = MIN(ns / 1000, UINT32_MAX);
+}
+
+static int
+compare_us(const void *a_, const void *b_) {
+    uint32_t a = *(const uint32_t *) a_;
+    uint32_t b = *(const uint32_t *) b_;
+
+    return a < b ? -1 : a > b;
+}
+
+/* Formats the percentiles of samples 'start' to the end of 's' into
+ * 'buf'. */
+static void
+samples_format(struct samples *s, size_t start, char *buf, size_t size) {
+    size_t n = s->n - start;
+    uint32_t *us;
+
+    if (n == 0) {
+        snprintf(buf, size, "-");
+        return;
+    }
+    us = xmemdup(&s->us[start], n * sizeof *us);
+    qsort(us, n, sizeof *us, compare_us);
+    snprintf(buf, size, "%"PRIu32"/%"PRIu32"/%"PRIu32"/%"PRIu32"/%"PRIu32,
+             us[0], us[n / 2], us[n * 9 / 10], us[n * 99 / 100], us[n - 1]);
+    free(us);
+}
+
+/* Rate limiting: a token bucket holding up to a tenth of a second worth of
+ * messages. */
+static void
+tokens_refill(void) {
+    long long int now = time_nsec();
+
+    if (rate != 0) {
+        tokens += (double) (now - tokens_refilled) * rate / 1e9;
+        tokens = MIN(tokens, MAX(rate / 10.0, 1.0));
+    }
+    tokens_refilled = now;
+}
+
+static bool
+tokens_take(void) {
+    if (rate == 0) {
+        return true;
+    }
+    if (tokens < 1.0) {
+        return false;
+    }
+    tokens -= 1.0;
+    return true;
+}
+
+static void
+tokens_wait(void) {
+    if (rate != 0 && tokens < 1.0) {
+        poll_timer_wait(MAX(1, (int) ((1.0 - tokens) * 1000 / rate)));
+    }
+}
+
+/* Messages. */
+
+static struct ofpbuf *
+pack(struct ofl_msg_header *msg, uint32_t xid) {
+    struct ofpbuf *buf;
+    uint8_t *data;
+    size_t size;
+
+    if (ofl_msg_pack(msg, xid, &data, &size, NULL)) {
+        ofp_fatal(0, "cannot pack message");
+    }
+    buf = ofpbuf_new(0);
+    ofpbuf_use(buf, data, size);
+    ofpbuf_put_uninit(buf, size);
+    return buf;
+}
+
+static void
+conn_send(struct conn *c, struct ofpbuf *buf) {
+    queue_push_tail(&c->txq, buf);
+}
+
+static void
+conn_send_msg(struct conn *c, struct ofl_msg_header *msg) {
+    conn_send(c, pack(msg, c->xid++));
+}
+
+/* Fills in 'fm' to add a flow with 'match' and a single output action to
+ * 'port'. The caller must free 'fm' with free_flow_mod(). */
+static void
+init_flow_mod(struct ofl_msg_flow_mod *fm, struct ofl_match *match,
+              uint16_t priority, uint32_t port, uint32_t buffer_id) {
+    struct ofl_instruction_actions *ia = xmalloc(sizeof *ia);
+    struct ofl_action_output *out = xmalloc(sizeof *out);
+
+    out->header.type = OFPAT_OUTPUT;
+    out->header.len = sizeof(struct ofp_action_output);
+    out->port = port;
+    out->max_len = port == OFPP_CONTROLLER ? OFPCML_NO_BUFFER : 0;
+
+    ia->header.type = OFPIT_APPLY_ACTIONS;
+    ia->actions_num = 1;
+    ia->actions = xmalloc(sizeof *ia->actions);
+    ia->actions[0] = &out->header;
+
+    fm->header.type = OFPT_FLOW_MOD;
+    fm->cookie = BENCH_COOKIE;
+    fm->cookie_mask = 0;
+    fm->table_id = table_id;
+    fm->command = OFPFC_ADD;
+    fm->idle_timeout = 0;
+    fm->hard_timeout = 0;
+    fm->priority = priority;
+    fm->buffer_id = buffer_id;
+    fm->out_port = OFPP_ANY;
+    fm->out_group = OFPG_ANY;
+    fm->flags = 0;
+    fm->match = &match->header;
+    fm->instructions_num = 1;
+    fm->instructions = xmalloc(sizeof *fm->instructions);
+    fm->instructions[0] = &ia->header;
+}
+
+static void
+free_flow_mod(struct ofl_msg_flow_mod *fm) {
+    ofl_structs_free_match(fm->match, NULL);
+    if (fm->instructions != NULL) {
+        ofl_structs_free_instruction(fm->instructions[0], NULL);
+    }
+    free(fm->instructions);
+}
+
+static void
+set_xid(struct ofpbuf *buf, uint32_t xid) {
+    struct ofp_header *oh = buf->data;
+
+    oh->xid = htonl(xid);
+}
+
+static struct ofpbuf *
+make_barrier(uint32_t xid) {
+    struct ofl_msg_header msg = {.type = OFPT_BARRIER_REQUEST};
+
+    return pack(&msg, xid);
+}
+
+static void
+handle_error(struct conn *c, struct ofpbuf *buf) {
+    const struct ofp_error_msg *oem = buf->data;
+
+    total.errors++;
+    if (buf->size >= sizeof *oem) {
+        VLOG_WARN_RL(LOG_MODULE, &rl, "%s: error type %"PRIu16" code %"PRIu16,
+                     vconn_get_name(c->vconn), ntohs(oem->type),
+                     ntohs(oem->code));
+    }
+}
+
+/* Sends a barrier on 'c' and waits for its reply.  Fails if an error
+ * answering the message with '*xid' arrives meanwhile, if 'xid' is nonnull;
+ * other errors are counted and anything else is dropped. */
+static void
+barrier_block(struct conn *c, const uint32_t *xid) {
+    uint32_t barrier_xid = c->xid++;
+    int error;
+
+    error = vconn_send_block(c->vconn, make_barrier(barrier_xid));
+    while (!error) {
+        struct ofp_header *oh;
+        struct ofpbuf *buf;
+
+        error = vconn_recv_block(c->vconn, &buf);
+        if (error) {
+            break;
+        }
+        oh = buf->data;
+        if (oh->type == OFPT_ERROR && xid != NULL
+            && ntohl(oh->xid) == *xid) {
+            ofp_fatal(0, "%s: switch refused the flow_mod",
+                      vconn_get_name(c->vconn));
+        } else if (oh->type == OFPT_ERROR) {
+            handle_error(c, buf);
+        } else if (oh->type == OFPT_ECHO_REQUEST) {
+            error = vconn_send_block(c->vconn, make_echo_reply(oh));
+        } else if (oh->type == OFPT_BARRIER_REPLY
+                   && ntohl(oh->xid) == barrier_xid) {
+            ofpbuf_delete(buf);
+            return;
+        }
+        ofpbuf_delete(buf);
+    }
+    ofp_fatal(error == EOF ? 0 : error, "%s: transaction failed",
+              vconn_get_name(c->vconn));
+}
+
+/* Sends 'buf' and a barrier on 'c' and waits for the barrier reply, failing
+ * if the switch refuses 'buf'. */
+static void
+transact_barrier(struct conn *c, struct ofpbuf *buf) {
+    uint32_t xid = ntohl(((struct ofp_header *) buf->data)->xid);
+    int error;
+
+    error = vconn_send_block(c->vconn, buf);
+    if (error) {
+        ofp_fatal(error, "%s: transaction failed", vconn_get_name(c->vconn));
+    }
+    barrier_block(c, &xid);
+}
+
+/* Sends everything still queued on 'c' and waits until the switch has
+ * processed it. */
+static void
+conn_sync(struct conn *c) {
+    while (c->txq.n > 0) {
+        int error;
+
+        error = vconn_send_block(c->vconn, queue_pop_head(&c->txq));
+        if (error) {
+            ofp_fatal(error, "%s: send failed", vconn_get_name(c->vconn));
+        }
+    }
+    barrier_block(c, NULL);
+}
+
+/* Flow 'i' of flow-mod mode: an exact IPv4/TCP 5-tuple, so that the
+ * flows never overlap and adding flow 'i' again replaces it. */
+static struct ofpbuf *
+make_bench_flow(unsigned int i) {
+    struct ofl_msg_flow_mod fm;
+    struct ofl_match *m = xmalloc(sizeof *m);
+    struct ofpbuf *buf;
+
+    ofl_structs_match_init(m);
+    ofl_structs_match_put16(m, OXM_OF_ETH_TYPE, ETH_TYPE_IP);
+    ofl_structs_match_put8(m, OXM_OF_IP_PROTO, IP_TYPE_TCP);
+    ofl_structs_match_put32(m, OXM_OF_IPV4_SRC, htonl(0x0a000000 + i));
+    ofl_structs_match_put32(m, OXM_OF_IPV4_DST, htonl(0x0a800000 + i));
+    ofl_structs_match_put16(m, OXM_OF_TCP_SRC, 1024 + i % 60000);
+    ofl_structs_match_put16(m, OXM_OF_TCP_DST, 80);
+    init_flow_mod(&fm, m, 100, out_port, OFP_NO_BUFFER);
+    buf = pack(&fm.header, 0);
+    free_flow_mod(&fm);
+    return buf;
+}
+
+/* Removes every flow installed by ofp-bench. */
+static void
+delete_bench_flows(struct conn *c) {
+    struct ofl_msg_flow_mod fm;
+    struct ofl_match *m = xmalloc(sizeof *m);
+
+    ofl_structs_match_init(m);
+    init_flow_mod(&fm, m, 0, OFPP_ANY, OFP_NO_BUFFER);
+    ofl_structs_free_instruction(fm.instructions[0], NULL);
+    free(fm.instructions);
+    fm.instructions_num = 0;
+    fm.instructions = NULL;
+    fm.command = OFPFC_DELETE;
+    fm.table_id = OFPTT_ALL;
+    fm.cookie_mask = UINT64_MAX;
+    transact_barrier(c, pack(&fm.header, c->xid++));
+    free_flow_mod(&fm);
+}
+
+/* Installs the flow returning probes to the controller. */
+static void
+install_probe_flow(struct conn *c) {
+    struct ofl_msg_flow_mod fm;
+    struct ofl_match *m = xmalloc(sizeof *m);
+
+    ofl_structs_match_init(m);
+    ofl_structs_match_put16(m, OXM_OF_ETH_TYPE, PROBE_ETH_TYPE);
+    init_flow_mod(&fm, m, PROBE_PRIORITY, OFPP_CONTROLLER, OFP_NO_BUFFER);
+    transact_barrier(c, pack(&fm.header, c->xid++));
+    free_flow_mod(&fm);
+}
+
+/* Sends a probe through the flow table of the switch. */
+static void
+send_probe(struct conn *c) {
+    struct ofl_msg_packet_out po;
+    struct ofl_action_output out;
+    struct ofl_action_header *act = &out.header;
+    uint8_t frame[ETH_TOTAL_MIN];
+    struct eth_header *eth = (struct eth_header *) frame;
+    struct probe_header probe;
+    struct probe *p;
+
+    /* The probe with the sequence number of a slot may still be in flight
+     * while later ones are back, but some slot is always free. */
+    do {
+        p = &c->probes[c->next_seq % window];
+        c->next_seq++;
+    } while (p->in_flight);
+    p->in_flight = true;
+    p->seq = c->next_seq - 1;
+    p->sent = time_msec();
+
+    memset(frame, 0, sizeof frame);
+    memset(eth->eth_dst, 0xff, ETH_ADDR_LEN);
+    eth->eth_src[0] = 0x02;
+    eth->eth_src[5] = c->idx;
+    eth->eth_type = htons(PROBE_ETH_TYPE);
+    probe.magic = htonl(PROBE_MAGIC);
+    probe.conn = htonl(c->idx);
+    probe.seq = htonl(p->seq);
+    probe.pad = 0;
+    probe.sent = time_nsec();
+    memcpy(frame + ETH_HEADER_LEN, &probe, sizeof probe);
+
+    out.header.type = OFPAT_OUTPUT;
+    out.header.len = sizeof(struct ofp_action_output);
+    out.port = OFPP_TABLE;
+    out.max_len = 0;
+
+    po.header.type = OFPT_PACKET_OUT;
+    po.buffer_id = OFP_NO_BUFFER;
+    po.in_port = OFPP_CONTROLLER;
+    po.actions_num = 1;
+    po.actions = &act;
+    po.data_length = sizeof frame;
+    po.data = frame;
+    conn_send_msg(c, &po.header);
+
+    c->in_flight++;
+}
+
+/* Answers a packet_in that is not a probe, flooding the packet and, with
+ * --reply=flow-mod, installing a flow for the rest of its flow. */
+static void
+reply_packet_in(struct conn *c, struct ofl_msg_packet_in *pin) {
+    if ((pin->buffer_id == OFP_NO_BUFFER && pin->data_length == 0)
+        || !tokens_take()) {
+        total.unanswered++;
+        return;
+    }
+    total.replies++;
+
+    if (reply_flow_mod && pin->data_length >= ETH_HEADER_LEN) {
+        struct eth_header *eth = (struct eth_header *) pin->data;
+        struct ofl_msg_flow_mod fm;
+        struct ofl_match *m = xmalloc(sizeof *m);
+        struct ofl_match_tlv *f;
+
+        ofl_structs_match_init(m);
+        HMAP_FOR_EACH_WITH_HASH (f, struct ofl_match_tlv, hmap_node,
+                                 hash_int(OXM_OF_IN_PORT, 0),
+                                 &((struct ofl_match *) pin->match)->match_fields) {
+            uint32_t in_port;
+
+            memcpy(&in_port, f->value, sizeof in_port);
+            ofl_structs_match_put32(m, OXM_OF_IN_PORT, in_port);
+        }
+        ofl_structs_match_put_eth(m, OXM_OF_ETH_SRC, eth->eth_src);
+        ofl_structs_match_put_eth(m, OXM_OF_ETH_DST, eth->eth_dst);
+        init_flow_mod(&fm, m, 10, OFPP_FLOOD, pin->buffer_id);
+        fm.idle_timeout = 10;
+        conn_send_msg(c, &fm.header);
+        free_flow_mod(&fm);
+        if (pin->buffer_id != OFP_NO_BUFFER) {
+            return;
+        }
+    }
+
+    {
+        struct ofl_msg_packet_out po;
+        struct ofl_action_output out;
+        struct ofl_action_header *act = &out.header;
+        struct ofl_match_tlv *f;
+
+        out.header.type = OFPAT_OUTPUT;
+        out.header.len = sizeof(struct ofp_action_output);
+        out.port = OFPP_FLOOD;
+        out.max_len = 0;
+
+        po.header.type = OFPT_PACKET_OUT;
+        po.buffer_id = pin->buffer_id;
+        po.in_port = OFPP_CONTROLLER;
+        HMAP_FOR_EACH_WITH_HASH (f, struct ofl_match_tlv, hmap_node,
+                                 hash_int(OXM_OF_IN_PORT, 0),
+                                 &((struct ofl_match *) pin->match)->match_fields) {
+            memcpy(&po.in_port, f->value, sizeof po.in_port);
+        }
+        po.actions_num = 1;
+        po.actions = &act;
+        if (pin->buffer_id == OFP_NO_BUFFER) {
+            po.data_length = pin->data_length;
+            po.data = pin->data;
+        } else {
+            po.data_length = 0;
+            po.data = NULL;
+        }
+        conn_send_msg(c, &po.header);
+    }
+}
+
+static void
+handle_packet_in(struct conn *c, struct ofpbuf *buf) {
+    struct ofl_msg_header *msg;
+    struct ofl_msg_packet_in *pin;
+    struct probe_header probe;
+    uint32_t xid;
+
+    if (ofl_msg_unpack(buf->data, buf->size, &msg, &xid, NULL)) {
+        VLOG_WARN_RL(LOG_MODULE, &rl, "%s: cannot parse packet_in",
+                     vconn_get_name(c->vconn));
+        return;
+    }
+    pin = (struct ofl_msg_packet_in *) msg;
+
+    if (pin->data_length >= ETH_HEADER_LEN + sizeof probe
+        && ((struct eth_header *) pin->data)->eth_type == htons(PROBE_ETH_TYPE)) {
+        memcpy(&probe, pin->data + ETH_HEADER_LEN, sizeof probe);
+        /* Every connection receives every probe; count them once.  A probe
+         * back after it was counted as lost is ignored. */
+        if (probe.magic == htonl(PROBE_MAGIC)
+            && ntohl(probe.conn) == c->idx) {
+            uint32_t seq = ntohl(probe.seq);
+            struct probe *p = &c->probes[seq % window];
+
+            if (p->in_flight && p->seq == seq) {
+                total.packet_ins++;
+                total.probes++;
+                samples_add(&samples, time_nsec() - probe.sent);
+                p->in_flight = false;
+                c->in_flight--;
+                c->deferred++;
+            }
+        }
+    } else {
+        total.packet_ins++;
+        reply_packet_in(c, pin);
+    }
+    ofl_msg_free(msg, NULL);
+}
+
+static void
+handle_barrier_reply(struct conn *c, uint32_t xid) {
+    struct batch *b;
+
+    if (c->n_batches == 0 || c->batches[c->batch_head].xid != xid) {
+        VLOG_WARN_RL(LOG_MODULE, &rl, "%s: unexpected barrier reply "
+                     "(xid=%"PRIu32")", vconn_get_name(c->vconn), xid);
+        return;
+    }
+    b = &c->batches[c->batch_head];
+    samples_add(&samples, time_nsec() - b->start);
+    total.flow_mods += b->n_flow_mods;
+    total.batches++;
+    c->batch_head = (c->batch_head + 1) % window;
+    c->n_batches--;
+}
+
+static void
+conn_recv(struct conn *c) {
+    int i;
+
+    for (i = 0; i < 50; i++) {
+        struct ofp_header *oh;
+        struct ofpbuf *buf;
+        int error;
+
+        error = vconn_recv(c->vconn, &buf);
+        if (error == EAGAIN) {
+            return;
+        } else if (error) {
+            ofp_fatal(error == EOF ? 0 : error, "%s: connection %s",
+                      vconn_get_name(c->vconn),
+                      error == EOF ? "closed" : "failed");
+        }
+
+        oh = buf->data;
+        switch (oh->type) {
+        case OFPT_ECHO_REQUEST:
+            conn_send(c, make_echo_reply(oh));
+            break;
+        case OFPT_BARRIER_REPLY:
+            handle_barrier_reply(c, ntohl(oh->xid));
+            break;
+        case OFPT_PACKET_IN:
+            handle_packet_in(c, buf);
+            break;
+        case OFPT_ERROR:
+            handle_error(c, buf);
+            break;
+        default:
+            break;
+        }
+        ofpbuf_delete(buf);
+    }
+}
+
+/* Hands queued messages to the connection, as far as it takes them. */
+static void
+conn_flush(struct conn *c) {
+    while (c->txq.n > 0) {
+        struct ofpbuf *next = c->txq.head->next;
+        int error;
+
+        error = vconn_send(c->vconn, c->txq.head);
+        if (error == EAGAIN) {
+            return;
+        } else if (error) {
+            ofp_fatal(error, "%s: send failed", vconn_get_name(c->vconn));
+        }
+        queue_advance_head(&c->txq, next);
+    }
+}
+
+/* Flow-mod mode: sends flow_mods as far as the window and the rate allow,
+ * closing every batch with a barrier. */
+static void
+run_flow_mods(struct conn *c) {
+    while (c->txq.n == 0 && c->n_batches < window && tokens_take()) {
+        struct ofpbuf *fm;
+
+        fm = ofpbuf_clone(flow_mods[c->next_flow]);
+        set_xid(fm, c->xid++);
+        c->next_flow = (c->next_flow + 1) % n_flows;
+        if (c->cur.n_flow_mods++ == 0) {
+            c->cur.start = time_nsec();
+        }
+        conn_send(c, fm);
+
+        if (c->cur.n_flow_mods == batch_size) {
+            unsigned int tail = (c->batch_head + c->n_batches) % window;
+
+            c->cur.xid = c->xid++;
+            conn_send(c, make_barrier(c->cur.xid));
+            c->batches[tail] = c->cur;
+            c->n_batches++;
+            c->cur.n_flow_mods = 0;
+        }
+    }
+}
+
+/* Packet-in mode: sends back the probes that returned, as far as the rate
+ * allows, and replaces the ones that did not. */
+static void
+run_probes(struct conn *c) {
+    long long int now = time_msec();
+
+    if (now >= c->next_expiry) {
+        unsigned int i;
+
+        c->next_expiry = now + PROBE_TIMEOUT_MS;
+        for (i = 0; i < window; i++) {
+            struct probe *p = &c->probes[i];
+
+            if (!p->in_flight) {
+                continue;
+            } else if (now - p->sent >= PROBE_TIMEOUT_MS) {
+                p->in_flight = false;
+                c->in_flight--;
+                c->deferred++;
+                total.lost++;
+            } else {
+                c->next_expiry = MIN(c->next_expiry,
+                                     p->sent + PROBE_TIMEOUT_MS);
+            }
+        }
+    }
+    while (c->deferred > 0 && tokens_take()) {
+        c->deferred--;
+        send_probe(c);
+    }
+}
+
+static void
+report(double secs, const struct counters *d, size_t first_sample,
+       const char *prefix) {
+    char lat[128];
+
+    samples_format(&samples, first_sample, lat, sizeof lat);
+    if (mode == MODE_FLOW_MOD) {
+        printf("%s%8.1f flow_mods/s %8.1f barriers/s  "
+               "latency min/50/90/99/max %s us", prefix,
+               d->flow_mods / secs, d->batches / secs, lat);
+    } else {
+        printf("%s%8.1f packet_ins/s %8.1f replies/s  "
+               "rtt min/50/90/99/max %s us", prefix,
+               d->packet_ins / secs, (d->probes + d->replies) / secs, lat);
+        if (d->unanswered || d->lost) {
+            printf("  %llu unanswered %llu lost", d->unanswered, d->lost);
+        }
+    }
+    if (d->errors) {
+        printf("  %llu errors", d->errors);
+    }
+    putchar('\n');
+    fflush(stdout);
+}
+
+static void
+counters_sub(struct counters *d, const struct counters *a,
+             const struct counters *b) {
+    d->flow_mods = a->flow_mods - b->flow_mods;
+    d->batches = a->batches - b->batches;
+    d->packet_ins = a->packet_ins - b->packet_ins;
+    d->probes = a->probes - b->probes;
+    d->replies = a->replies - b->replies;
+    d->unanswered = a->unanswered - b->unanswered;
+    d->lost = a->lost - b->lost;
+    d->errors = a->errors - b->errors;
+}
+
+int
+main(int argc, char *argv[]) {
+    long long int start, end, next_report, last_report;
+    struct counters last;
+    size_t last_samples;
+    unsigned int i;
+
+    set_program_name(argv[0]);
+    time_init();
+    vlog_init();
+    parse_options(argc, argv);
+    signal(SIGPIPE, SIG_IGN);
+
+    if (argc - optind != 1) {
+        ofp_fatal(0, "need exactly one non-option argument; "
+                  "use --help for usage");
+    }
+
+    conns = xcalloc(n_conns, sizeof *conns);
+    for (i = 0; i < n_conns; i++) {
+        struct conn *c = &conns[i];
+        int error;
+
+        error = vconn_open_block(argv[optind], OFP_VERSION, &c->vconn);
+        if (error) {
+            ofp_fatal(error, "connecting to %s", argv[optind]);
+        }
+        c->idx = i;
+        c->xid = (i + 1) << 24;
+        queue_init(&c->txq);
+        c->batches = xmalloc(window * sizeof *c->batches);
+    }
+
+    if (mode == MODE_FLOW_MOD) {
+        flow_mods = xmalloc(n_flows * sizeof *flow_mods);
+        for (i = 0; i < n_flows; i++) {
+            flow_mods[i] = make_bench_flow(i);
+        }
+        for (i = 0; i < n_conns; i++) {
+            /* Spread the connections over the flows. */
+            conns[i].next_flow = (unsigned long long int) i * n_flows
+                                 / n_conns;
+        }
+    } else {
+        install_probe_flow(&conns[0]);
+        for (i = 0; i < n_conns; i++) {
+            conns[i].probes = xcalloc(window, sizeof *conns[i].probes);
+            conns[i].deferred = window;
+        }
+    }
+
+    printf("ofp-bench: %s mode, %u connection%s to %s, %u s\n",
+           mode == MODE_FLOW_MOD ? "flow-mod" : "packet-in", n_conns,
+           n_conns == 1 ? "" : "s", argv[optind], duration);
+
+    tokens_refilled = time_nsec();
+    tokens = MAX(rate / 10.0, 1.0);
+    start = last_report = time_msec();
+    end = start + duration * 1000LL;
+    next_report = start + interval * 1000LL;
+    last = total;
+    last_samples = 0;
+    for (;;) {
+        long long int now;
+
+        tokens_refill();
+        for (i = 0; i < n_conns; i++) {
+            struct conn *c = &conns[i];
+
+            conn_recv(c);
+            if (mode == MODE_FLOW_MOD) {
+                run_flow_mods(c);
+            } else {
+                run_probes(c);
+            }
+            conn_flush(c);
+        }
+
+        time_refresh();
+        now = time_msec();
+        if (now >= next_report) {
+            struct counters d;
+            char prefix[32];
+
+            counters_sub(&d, &total, &last);
+            snprintf(prefix, sizeof prefix, "%6.1f s: ",
+                     (now - start) / 1000.0);
+            report((now - last_report) / 1000.0, &d, last_samples, prefix);
+            last = total;
+            last_samples = samples.n;
+            last_report = now;
+            next_report += interval * 1000LL;
+        }
+        if (now >= end) {
+            break;
+        }
+
+        for (i = 0; i < n_conns; i++) {
+            vconn_recv_wait(conns[i].vconn);
+            if (conns[i].txq.n > 0) {
+                vconn_send_wait(conns[i].vconn);
+            }
+        }
+        tokens_wait();
+        poll_timer_wait(MAX(1, MIN(next_report, end) - now));
+        if (mode == MODE_PACKET_IN) {
+            for (i = 0; i < n_conns; i++) {
+                poll_timer_wait(MAX(1, conns[i].next_expiry - now));
+            }
+        }
+        poll_block();
+    }
+
+    report((time_msec() - start) / 1000.0, &total, 0, "total:  ");
+
+    /* Flow_mods still in flight on any connection could otherwise be
+     * applied after the delete. */
+    for (i = 0; i < n_conns; i++) {
+        conn_sync(&conns[i]);
+    }
+    for (i = 0; i < n_conns; i++) {
+        struct conn *c = &conns[i];
+
+        queue_destroy(&c->txq);
+        if (i == 0) {
+            delete_bench_flows(c);
+        }
+        vconn_close(c->vconn);
+        free(c->batches);
+        free(c->probes);
+    }
+    return total.errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+static void
+parse_options(int argc, char *argv[]) {
+    enum {
+        OPT_CONNECTIONS = UCHAR_MAX + 1,
+        OPT_REPLY
+    };
+    static struct option long_options[] = {
+        {"mode", required_argument, 0, 'm'},
+        {"connections", required_argument, 0, OPT_CONNECTIONS},
+        {"duration", required_argument, 0, 'd'},
+        {"interval", required_argument, 0, 'i'},
+        {"flows", required_argument, 0, 'n'},
+        {"barrier", required_argument, 0, 'b'},
+        {"window", required_argument, 0, 'w'},
+        {"rate", required_argument, 0, 'r'},
+        {"table", required_argument, 0, 't'},
+        {"out-port", required_argument, 0, 'o'},
+        {"reply", required_argument, 0, OPT_REPLY},
+        {"verbose", optional_argument, 0, 'v'},
+        {"help", no_argument, 0, 'h'},
+        {"version", no_argument, 0, 'V'},
+        VCONN_SSL_LONG_OPTIONS
+        {0, 0, 0, 0},
+    };
+    char *short_options = long_options_to_short_options(long_options);
+
+    for (;;) {
+        unsigned int value;
+        int c;
+
+        c = getopt_long(argc, argv, short_options, long_options, NULL);
+        if (c == -1) {
+            break;
+        }
+
+        switch (c) {
+        case 'm':
+            if (!strcmp(optarg, "flow-mod")) {
+                mode = MODE_FLOW_MOD;
+            } else if (!strcmp(optarg, "packet-in")) {
+                mode = MODE_PACKET_IN;
+            } else {
+                ofp_fatal(0, "unknown mode \"%s\"", optarg);
+            }
+            break;
+
+        case OPT_CONNECTIONS:
+        case 'd':
+        case 'i':
+        case 'n':
+        case 'b':
+        case 'w':
+            if (!str_to_uint(optarg, 10, &value) || value == 0) {
+                ofp_fatal(0, "\"%s\" is not a positive number", optarg);
+            }
+            if (c == OPT_CONNECTIONS) {
+                n_conns = value;
+            } else if (c == 'd') {
+                duration = value;
+            } else if (c == 'i') {
+                interval = value;
+            } else if (c == 'n') {
+                n_flows = value;
+            } else if (c == 'b') {
+                batch_size = value;
+            } else {
+                window = value;
+            }
+            break;
+
+        case 'r':
+            if (!str_to_uint(optarg, 10, &rate)) {
+                ofp_fatal(0, "-r requires a number");
+            }
+            break;
+
+        case 't':
+            if (!str_to_uint(optarg, 10, &value) || value >= OFPTT_MAX) {
+                ofp_fatal(0, "-t requires a table number");
+            }
+            table_id = value;
+            break;
+
+        case 'o':
+            if (!str_to_uint(optarg, 10, &value) || value == 0
+                || value > OFPP_MAX) {
+                ofp_fatal(0, "-o requires a port number");
+            }
+            out_port = value;
+            break;
+
+        case OPT_REPLY:
+            if (!strcmp(optarg, "flow-mod")) {
+                reply_flow_mod = true;
+            } else if (!strcmp(optarg, "packet-out")) {
+                reply_flow_mod = false;
+            } else {
+                ofp_fatal(0, "--reply must be flow-mod or packet-out");
+            }
+            break;
+
+        case 'h':
+            usage();
+
+        case 'V':
+            printf("%s %s compiled "__DATE__" "__TIME__"\n",
+                   program_name, VERSION BUILDNR);
+            exit(EXIT_SUCCESS);
+
+        case 'v':
+            vlog_set_verbosity(optarg);
+            break;
+
+        VCONN_SSL_OPTION_HANDLERS
+
+        case '?':
+            exit(EXIT_FAILURE);
+
+        default:
+            abort();
+        }
+    }
+    free(short_options);
+}
+
+static void
+usage(void) {
+    printf("%s: OpenFlow switch load generator\n"
+           "usage: %s [OPTIONS] SWITCH\n"
+           "where SWITCH is an active OpenFlow connection method.\n"
+           "\nOptions:\n"
+           "  -m, --mode=flow-mod|packet-in  what to measure (default: flow-mod)\n"
+           "  --connections=N         open N connections to SWITCH (default: 1)\n"
+           "  -d, --duration=SECS     run for SECS seconds (default: 10)\n"
+           "  -i, --interval=SECS     report every SECS seconds (default: 1)\n"
+           "  -n, --flows=N           cycle through N flows (default: 1000)\n"
+           "  -b, --barrier=N         send a barrier every N flow_mods (default: 100)\n"
+           "  -w, --window=N          barriers or probes in flight per connection\n"
+           "                          (default: 4)\n"
+           "  -r, --rate=N            flow_mods or replies per second, 0 for no\n"
+           "                          limit (default: 0)\n"
+           "  -t, --table=N           install the flows in table N (default: 0)\n"
+           "  -o, --out-port=PORT     output port of the flows (default: 1)\n"
+           "  --reply=flow-mod|packet-out  answer other packet_ins with a flow_mod\n"
+           "                          or a packet_out (default: packet-out)\n",
+           program_name, program_name);
+    vconn_usage(true, false, false);
+    printf("\nOther options:\n"
+           "  -v, --verbose=MODULE[:FACILITY[:LEVEL]]  set logging levels\n"
+           "  -v, --verbose           set maximum verbosity level\n"
+           "  -h, --help              display this help message\n"
+           "  -V, --version           display version information\n");
+    exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,170 @@
+/* Copyright (c) 2011, TrafficLab, Ericsson Research, Hungary
+ * Copyright (c) 2012, CPqD, Brazil 
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Ericsson Research nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <config.h>
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "command-line.h"
+#include "compiler.h"
+#include "oflib/ofl-messages.h"
+#include "oflib-exp/ofl-exp-openflow.h"
+#include "openflow/openflow-ext.h"
+#include "timeval.h"
+#include "util.h"
+#include "vlog.h"
+
+static void parse_options(int argc, char *argv[]);
+static void usage(void) NO_RETURN;
+
+/* Prints the trace in 'file_name', or standard input if it is "-". Returns
+ * false if it can not be read. */
+static bool
+print_trace(const char *file_name)
+{
+    struct ofl_exp_openflow_mp_reply_trace *trace;
+    FILE *file;
+    uint64_t dpid;
+    int error;
+
+    file = strcmp(file_name, "-") ? fopen(file_name, "rb") : stdin;
+    if (file == NULL) {
+        ofp_error(errno, "%s: open failed", file_name);
+        return false;
+    }
+    error = ofl_exp_trace_load(file, &dpid, &trace);
+    if (file != stdin) {
+        fclose(file);
+    }
+    if (error) {
+        ofp_error(error, "%s: %s", file_name,
+                  error == EINVAL ? "not a datapath trace" : "read failed");
+        return false;
+    }
+
+    printf("%s: dpid=0x%016"PRIx64" trace=%s size=%"PRIu32
+           " total=%"PRIu64" records=%zu", file_name, dpid,
+           (trace->flags & OFP_EXT_TRACE_ENABLED) ? "on" : "off",
+           trace->size, trace->total, trace->records_num);
+    if (trace->total > trace->records_num) {
+        printf(" (%"PRIu64" overwritten)", trace->total - trace->records_num);
+    }
+    printf("\n");
+    ofl_exp_trace_print(stdout, trace);
+    ofl_exp_openflow_stats_reply_free((struct ofl_msg_multipart_reply_header *)trace);
+    return true;
+}
+
+int
+main(int argc, char *argv[])
+{
+    bool ok = true;
+    int i;
+
+    set_program_name(argv[0]);
+    time_init();
+    vlog_init();
+    parse_options(argc, argv);
+
+    argc -= optind;
+    argv += optind;
+    if (argc < 1) {
+        ofp_fatal(0, "need at least one trace file; use --help for usage");
+    }
+
+    for (i = 0; i < argc; i++) {
+        if (i > 0) {
+            printf("\n");
+        }
+        ok &= print_trace(argv[i]);
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static void
+parse_options(int argc, char *argv[])
+{
+    static struct option long_options[] = {
+        {"verbose",     optional_argument, 0, 'v'},
+        {"help",        no_argument, 0, 'h'},
+        {"version",     no_argument, 0, 'V'},
+        {0, 0, 0, 0},
+    };
+    char *short_options = long_options_to_short_options(long_options);
+
+    for (;;) {
+        int c;
+
+        c = getopt_long(argc, argv, short_options, long_options, NULL);
+        if (c == -1) {
+            break;
+        }
+
+        switch (c) {
+        case 'h':
+            usage();
+
+        case 'V':
+            printf("%s %s compiled "__DATE__" "__TIME__"\n",
+                   program_name, VERSION BUILDNR);
+            exit(EXIT_SUCCESS);
+
+        case 'v':
+            vlog_set_verbosity(optarg);
+            break;
+
+        case '?':
+            exit(EXIT_FAILURE);
+
+        default:
+            abort();
+        }
+    }
+    free(short_options);
+}
+
+static void
+usage(void)
+{
+    printf("%s: prints datapath event traces\n"
+           "usage: %s [OPTIONS] FILE [FILE...]\n"
+           "where each FILE is a trace written by \"dpctl dump-trace\" or by\n"
+           "ofdatapath on SIGUSR1, or \"-\" for standard input.\n",
+           program_name, program_name);
+    vlog_usage();
+    printf("\nOther options:\n"
+           "  -h, --help              display this help message\n"
+           "  -V, --version           display version information\n");
+    exit(EXIT_SUCCESS);
+}